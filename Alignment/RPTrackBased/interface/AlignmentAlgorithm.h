@@ -23,11 +23,28 @@
 
 class AlignmentTask;
 class TDirectory;
+class TGraph;
 
 namespace edm {
   class ParameterSet;
 }
 
+/// appends the points of the graph saved (in a state file) under the given key, if present
+void AppendGraphPoints(TGraph *g, TDirectory *dir, const char *key);
+
+/**
+ *\brief Partial accumulation of an alignment algorithm for one processing stream.
+ * Filled independently of the other streams and merged into the algorithm at the end of the job.
+ **/
+class AlignmentAccumulator
+{
+  public:
+    virtual ~AlignmentAccumulator() {}
+
+    /// process one track
+    virtual void Feed(const HitCollection&, const LocalTrackFit&, const LocalTrackFit&) = 0;
+};
+
 /**
  *\brief Abstract parent for all (track-based) alignment algorithms
  **/
@@ -64,9 +81,32 @@ class AlignmentAlgorithm
     /// prepare for processing
     virtual void Begin(const edm::EventSetup&) = 0;
 
+    /// prepare for processing outside of the framework (e.g. in standalone tools), can be called instead of Begin
+    /// returns false if the algorithm needs the event setup
+    virtual bool BeginStandalone()
+      { return false; }
+
     /// process one track
     virtual void Feed(const HitCollection&, const LocalTrackFit&, const LocalTrackFit&) = 0;
 
+    /// returns a new (empty) accumulator for a processing stream, to be called after Begin
+    /// NULL means that the algorithm can only be fed serially
+    virtual AlignmentAccumulator* NewStreamAccumulator()
+      { return NULL; }
+
+    /// adds an accumulator, created by NewStreamAccumulator, to the data collected
+    virtual void Merge(const AlignmentAccumulator &) {}
+
+    /// writes the data collected so far to a directory (of a state file)
+    /// returns false if the algorithm doesn't support state files
+    virtual bool SaveState(TDirectory *)
+      { return false; }
+
+    /// adds the data saved by SaveState to the data collected, can be called instead of Begin
+    /// returns false if the algorithm doesn't support state files
+    virtual bool LoadState(TDirectory *)
+      { return false; }
+
     /// saves diagnostic histograms/plots
     virtual void SaveDiagnostics(TDirectory *) = 0;
     
@@ -12,6 +12,7 @@
 #include <map>
 #include <set>
 #include <string>
+#include <vector>
 
 /**
  *\brief A structure to hold relevant geometrical information about one detector/sensor.
@@ -23,10 +24,10 @@ struct DetGeometry {
   double s;                     ///< detector nominal shift in sensitive direction; in mm
 
   unsigned int matrixIndex;     ///< index (0 ... AlignmentGeometry::Detectors()) within a S matrix block (for detector-related quantities)
-                                ///< assigned by StraightTrackAlignment::PrepareGeometry
+                                ///< assigned by AlignmentGeometry::AssignMatrixIndices
 
   unsigned int rpMatrixIndex;   ///< index (0 ... AlignmentGeometry::RPs()) within a S matrix block (for RP-related quantities)
-                                ///< assigned by StraightTrackAlignment::PrepareGeometry
+                                ///< assigned by AlignmentGeometry::AssignMatrixIndices
 
   bool isU;                     ///< true for U detectors, false for V detectors
                                 ///< global U, V frame is used - that matches with u, v frame of the 1200 detector
@@ -40,19 +41,64 @@ struct DetGeometry {
 /**
  *\brief A collection of geometrical information.
  * Map: (decimal) detector ID --> DetGeometry
+ *
+ * BuildIndex makes dense tables of pointers to the detector data, ordered by matrix index, and of
+ * detector id <--> matrix index translation, so that Get and MatrixIndexToDetId don't need to
+ * search. Modified detector data are seen through the tables immediately. Insert, erase and clear
+ * invalidate the tables (the map insert methods are not accessible), changes of matrix indices require
+ * BuildIndex to be called again.
  **/
 class AlignmentGeometry : public std::map<unsigned int, DetGeometry>
 {
   protected:
     std::set<unsigned int> rps;
 
+    /// detector data by matrix index (pointers to the map elements)
+    std::vector<const DetGeometry *> dets;
+
+    /// map: matrix index --> detector id
+    std::vector<unsigned int> detIds;
+
+    /// map: detector id --> matrix index, -1 for detectors not in the geometry
+    std::vector<signed int> matrixIndices;
+
+    /// set by BuildIndex, reset by all methods adding or removing detectors
+    bool indexValid;
+
+    /// whether the dense tables correspond to the map (operator[] may still add a detector)
+    bool IndexValid() const
+      { return indexValid && dets.size() == size(); }
+
+    /// clears the dense tables
+    void InvalidateIndex();
+
+    // the detectors are added by Insert only
+    using std::map<unsigned int, DetGeometry>::insert;
+    using std::map<unsigned int, DetGeometry>::emplace;
+    using std::map<unsigned int, DetGeometry>::emplace_hint;
+
   public:
     /// a characteristic z in mm
     double z0;
 
+    AlignmentGeometry() : indexValid(false) {}
+
+    /// the tables of a copy point to its own elements
+    AlignmentGeometry(const AlignmentGeometry &o) : std::map<unsigned int, DetGeometry>(o), rps(o.rps),
+      indexValid(false), z0(o.z0)
+      { if (o.IndexValid()) BuildIndex(); }
+
+    AlignmentGeometry& operator=(const AlignmentGeometry &o);
+
     /// puts an element to the map
     void Insert(unsigned int id, const DetGeometry &g)
-      { insert(value_type(id, g)); rps.insert(id / 10); }
+      { InvalidateIndex(); insert(value_type(id, g)); rps.insert(id / 10); }
+
+    /// removes a detector, returns the number of removed elements
+    size_type erase(unsigned int id);
+
+    /// removes all detectors and RPs
+    void clear();
 
     /// returns the number of RPs in the collection
     unsigned int RPs()
@@ -61,6 +107,23 @@ class AlignmentGeometry : public std::map<unsigned int, DetGeometry>
     /// returns the number of detectors in the collection
     unsigned int Detectors()
       { return size(); }
+
+    /// assigns the matrix and RP matrix indices (in the order of detector ids) and calls BuildIndex
+    void AssignMatrixIndices();
+
+    /// builds the dense tables from the (already assigned) matrix indices
+    void BuildIndex();
+
+    /// returns the geometry of the given detector, NULL if not present
+    const DetGeometry* Get(unsigned int id) const
+    {
+      if (!IndexValid()) {
+        const_iterator it = find(id);
+        return (it == end()) ? NULL : &it->second;
+      }
+
+      return (id < matrixIndices.size() && matrixIndices[id] >= 0) ? dets[matrixIndices[id]] : NULL;
+    }
     
     /// returns detector id corresponding to the given matrix index
     unsigned int MatrixIndexToDetId(unsigned int) const;
@@ -73,7 +136,7 @@ class AlignmentGeometry : public std::map<unsigned int, DetGeometry>
 
     /// check whether the sensor Id is valid (present in the map)
     bool ValidSensorId(unsigned int id) const
-      { return (find(id) != end()); }
+      { return (Get(id) != NULL); }
 
     /// check whether the RP Id is valid (present in the set)
     bool ValidRPId(unsigned int id) const
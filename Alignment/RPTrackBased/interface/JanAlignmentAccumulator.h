@@ -0,0 +1,97 @@
+/****************************************************************************
+*
+* This is a part of TOTEM offline software.
+* Per-stream accumulation of the S matrix and M vector of JanAlignmentAlgorithm.
+*
+****************************************************************************/
+
+#ifndef Alignment_RPTrackBased_JanAlignmentAccumulator
+#define Alignment_RPTrackBased_JanAlignmentAccumulator
+
+#include "Alignment/RPTrackBased/interface/AlignmentAlgorithm.h"
+
+#include "TMatrixD.h"
+#include "TVectorD.h"
+
+#include <vector>
+
+class AlignmentTask;
+
+/**
+ *\brief The S matrix and M vector sums of JanAlignmentAlgorithm.
+ *
+ * Accumulators filled with disjoint track samples can be added with Merge, the result equals
+ * (up to rounding) the accumulation of all tracks by a single accumulator.
+ **/
+class JanAlignmentAccumulator : public AlignmentAccumulator
+{
+  public:
+    /// per-track data of a hit
+    struct HitTerm {
+      unsigned int id;  ///< detector id
+      double position;  ///< hit position in the readout direction
+      double w;         ///< weight, 1/sigma^2
+      double a[4];      ///< row of the track-fit matrix A
+      double m;         ///< measurement
+    };
+
+    /// per-track data of a quantity class, Gamma has one non-zero element per hit (row)
+    struct ClassBuffer {
+      std::vector<unsigned int> col;      ///< column of the non-zero Gamma element, per hit
+      std::vector<double> g;              ///< value of the non-zero Gamma element, per hit
+      std::vector<unsigned int> touched;  ///< columns with a non-zero Gamma element
+      std::vector<double> P;              ///< sum of g w a over the hits of a touched column, 4 per touched column
+      std::vector<double> NiP;            ///< (A^T Vi A)^-1 P, 4 per touched column
+      std::vector<int> slot;              ///< column -> index in touched, -1 if untouched
+    };
+
+    /// S matrix components
+    /// indeces correspond to the qClToOpt list
+    std::vector< std::vector<TMatrixD> > Sc;
+
+    /// M vector components
+    /// indeces correspond to the qClToOpt list
+    std::vector<TVectorD> Mc;
+
+    /// event count
+    unsigned int events;
+
+    /// dummy constructor (not to be used)
+    JanAlignmentAccumulator() : events(0), task(NULL), useExternalFitter(false), verbosity(0) {}
+
+    /// allocates zero S and M components and work buffers for the task (with geometry built)
+    JanAlignmentAccumulator(AlignmentTask *_t, bool _useExternalFitter, unsigned int _verbosity);
+
+    /// process one track
+    virtual void Feed(const HitCollection&, const LocalTrackFit&, const LocalTrackFit&);
+
+    /// first step of Feed: fills the hit terms and Gamma coefficients of a track
+    void Collect(const HitCollection&, const LocalTrackFit&, const LocalTrackFit&);
+
+    /// second step of Feed: adds the collected track to S and M
+    void Accumulate();
+
+    /// adds S, M and event count of another accumulator (of the same task)
+    void Merge(const JanAlignmentAccumulator &);
+
+    /// the hits collected by the last call of Collect
+    const std::vector<HitTerm>& Hits() const
+      { return hitTerms; }
+
+    /// the Gamma coefficients collected by the last call of Collect
+    const ClassBuffer& Coefficients(unsigned int classIndex) const
+      { return classBuffers[classIndex]; }
+
+  protected:
+    AlignmentTask *task;
+
+    bool useExternalFitter;
+
+    unsigned int verbosity;
+
+    /// work buffers, allocated in the constructor
+    std::vector<HitTerm> hitTerms;
+    std::vector<ClassBuffer> classBuffers;
+};
+
+#endif
@@ -11,6 +11,7 @@
 
 
 #include "Alignment/RPTrackBased/interface/AlignmentAlgorithm.h"
+#include "Alignment/RPTrackBased/interface/JanAlignmentAccumulator.h"
 
 #include "TMatrixD.h"
 #include "TVectorD.h"
@@ -43,13 +44,8 @@ class JanAlignmentAlgorithm : public AlignmentAlgorithm
     };
     
   private:
-    /// S matrix components
-    /// indeces correspond to the qClToOpt list
-    TMatrixD **Sc;
-
-    /// M vector components
-    /// indeces correspond to the qClToOpt list
-    TVectorD *Mc;
+    /// S matrix and M vector components
+    JanAlignmentAccumulator accumulator;
 
     /// final S matrix
     TMatrixD S;
@@ -72,8 +68,8 @@ class JanAlignmentAlgorithm : public AlignmentAlgorithm
     /// normalized eigen value below which the (CS) eigen vectors are considered as weak
     double weakLimit;
 
-    /// event count
-    unsigned int events;
+    /// whether to run the eigen analysis of S and CS matrices (singular and weak modes)
+    bool eigenAnalysis;
 
     /// statistical data collection
     std::map<unsigned int, DetStat> statistics;
@@ -81,6 +77,12 @@ class JanAlignmentAlgorithm : public AlignmentAlgorithm
     /// flag whether to build statistical plots
     bool buildDiagnosticPlots;
 
+    /// allocates the S and M components and the statistics plots
+    void Init();
+
+    /// fills the statistics plots with the track collected by the accumulator
+    void FillDiagnosticPlots(const HitCollection&, const LocalTrackFit&);
+
   public:
     /// dummy constructor (not to be used)
     JanAlignmentAlgorithm() {}
@@ -97,7 +99,12 @@ class JanAlignmentAlgorithm : public AlignmentAlgorithm
       { return true; }
 
     virtual void Begin(const edm::EventSetup&);
+    virtual bool BeginStandalone();
     virtual void Feed(const HitCollection&, const LocalTrackFit&, const LocalTrackFit&);
+    virtual AlignmentAccumulator* NewStreamAccumulator();
+    virtual void Merge(const AlignmentAccumulator &);
+    virtual bool SaveState(TDirectory *);
+    virtual bool LoadState(TDirectory *);
     virtual void SaveDiagnostics(TDirectory *);
     virtual std::vector<SingularMode> Analyze();
     virtual unsigned int Solve(const std::vector<AlignmentConstraint>&,
@@ -13,12 +13,18 @@
 #include "Alignment/RPTrackBased/interface/AlignmentGeometry.h"
 #include "Alignment/RPTrackBased/interface/HitCollection.h"
 
+#include <bitset>
+#include <vector>
+
 namespace edm {
   class ParameterSet;
 }
 
 /**
  *\brief Performs straight-line fit and outlier rejection.
+ *
+ * The 4x4 normal equations are accumulated once per RP, removed hits and pots are subtracted
+ * from them, so that every refit only costs a 4x4 inversion and a pass over the hits.
  **/
 class LocalTrackFitter
 {
@@ -44,15 +50,45 @@ class LocalTrackFitter
     
     /// hits with higher ratio residual/sigma will be dropped
     double maxResidualToSigma;
+
+    /// fit data of one hit
+    struct HitRow {
+      unsigned int id;    ///< detector decimal id
+      unsigned int rp;    ///< index in rpSums
+      bool isU;           ///< whether the detector measures U
+      bool active;        ///< false once the hit has been removed
+      double a[4];        ///< row of the fit matrix A
+      double m;           ///< measurement (in mm)
+      double w;           ///< weight 1/sigma^2, 0 for detectors not in geometry
+      double sigma;       ///< uncertainty (in mm)
+    };
+
+    /// normal equations (A^T Vi A, A^T Vi m) of the active hits of one RP
+    struct RPSums {
+      unsigned int id;    ///< RP decimal id
+      bool active;        ///< false once the pot has been removed
+      double N[16];       ///< 4x4, row-major
+      double b[4];
+      std::bitset<10> uPlanes, vPlanes;  ///< active planes, filled by RemoveInsufficientPots
+    };
+
+    /// work buffers, one row per hit of the selection and one entry per RP
+    std::vector<HitRow> rows;
+    std::vector<RPSums> rpSums;
+
+    /// looks the hits up in the geometry and accumulates the normal equations
+    void BuildRows(const HitCollection&, const AlignmentGeometry&);
+
+    /// adds (sign = +1) or subtracts (sign = -1) the contribution of a hit to the sums of its RP
+    void UpdateSums(const HitRow &, double sign);
     
-    /// fits the collection of hits and removes hits with too high residual/sigma ratio
+    /// fits the active hits and removes hits with too high residual/sigma ratio
     /// \param failed whether the fit has failed
     /// \param selectionChanged whether some hits have been removed
-    void FitAndRemoveOutliers(HitCollection&, const AlignmentGeometry&, LocalTrackFit&, 
-      bool &failed, bool &selectionChanged);
+    void FitAndRemoveOutliers(double z0, LocalTrackFit&, bool &failed, bool &selectionChanged);
     
     /// removes the hits of pots with too few planes active
-    void RemoveInsufficientPots(HitCollection&, bool &selectionChanged);
+    void RemoveInsufficientPots(bool &selectionChanged);
 };
 
 #endif
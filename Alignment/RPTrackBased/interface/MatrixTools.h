@@ -11,3 +11,7 @@
 
 extern void Print(TMatrixD& m, const char *label = NULL, bool mathematicaFormat = false);
 
+
+/// inverts a symmetric positive-definite 4x4 matrix (row-major) via Cholesky decomposition
+/// returns false if the matrix is not positive definite
+extern bool InvertSymmetric4x4(const double *N, double *Ni);
@@ -2,6 +2,9 @@
 #define MILLE_H
 
 #include <fstream>
+#include <vector>
+
+#include <zlib.h>
 
 /**
  * \class Mille
@@ -16,12 +19,17 @@
  *  But note that pede will not be able to read text output and has not been tested with 
  *  derivatives/labels ==0.
  *
+ *  Binary records are collected in a block of (at least) blockSize bytes, which is written at once.
+ *  With compress = true the file is written as a gzip stream (pede reads it when the file name
+ *  ends with .gz), the uncompressed content is the same as that of a plain binary file.
+ *
  */
 
 class Mille 
 {
 	public:
-		Mille(const char *outFileName, bool asBinary = true, bool writeZero = false);
+		Mille(const char *outFileName, bool asBinary = true, bool writeZero = false,
+			bool compress = false, unsigned int blockSize = 1 << 20);
 		~Mille();
 		
 		/**\brief Writes one record (i.e. one track) data to buffer.
@@ -43,12 +51,18 @@ class Mille
 
 		/// Saves buffer to the file.
 		void end();
+
+		/// Writes the collected records to the file.
+		void flush();
 		
 	private:
 		void newSet();
 		bool checkBufferSize(int nLocal, int nGlobal);
 		
 		std::ofstream myOutFile; 								///< C-binary for output
+		gzFile myGzFile;         								///< compressed output, NULL if not compressed
+		std::vector<char> myBlock;  							///< records not yet written to the file
+		unsigned int myBlockSize;  								///< the block is written once it reaches this size (in bytes)
 		bool myAsBinary;         								///< if false output as text
 		bool myWriteZero;        								///< if true also write out derivatives/lables ==0
 		
@@ -25,8 +25,19 @@ class MillepedeAlgorithm : public AlignmentAlgorithm
 {
   private:
     std::string workingDir;
+
+    /// whether the Mille file shall be written compressed (gzip)
+    bool compressInput;
+
+    /// size (in bytes) of the blocks in which the Mille records are written
+    unsigned int blockSize;
+
     Mille *mille;
 
+    /// name of the Mille file, relative to workingDir
+    std::string InputFileName() const
+      { return (compressInput) ? "mp.input.gz" : "mp.input"; }
+
   public:
     /// dummy constructor (not to be used)
     MillepedeAlgorithm() {}
@@ -43,6 +54,7 @@ class MillepedeAlgorithm : public AlignmentAlgorithm
       { return false; }
 
     virtual void Begin(const edm::EventSetup&);
+    virtual bool BeginStandalone();
     virtual void Feed(const HitCollection&, const LocalTrackFit&, const LocalTrackFit&);
     virtual void SaveDiagnostics(TDirectory *) {}
     virtual std::vector<SingularMode> Analyze();
@@ -0,0 +1,90 @@
+/****************************************************************************
+*
+* This is a part of TOTEM offline software.
+* Pot occupancy of both arms as bit masks, for the overlap track filters.
+*
+****************************************************************************/
+
+#ifndef Alignment_RPTrackBased_RPOccupancy
+#define Alignment_RPTrackBased_RPOccupancy
+
+#include "DataFormats/Common/interface/DetSet.h"
+#include "DataFormats/CTPPSReco/interface/TotemRPUVPattern.h"
+
+#include <bitset>
+
+/**
+ *\brief Pot occupancy of both arms, as one bit mask per arm.
+ *
+ * The bit of a RP with decimal id 100*arm + 10*station + rp is 6*station + rp.
+ **/
+struct RPOccupancy
+{
+  /// bit masks of the occupied RPs, per arm
+  unsigned int arms[2];
+
+  /// numbers of occupied top, bottom and horizontal RPs in one arm
+  struct Signature
+  {
+    unsigned int top, bot, hor;
+  };
+
+  RPOccupancy()
+    { arms[0] = arms[1] = 0; }
+
+  void Clear()
+    { arms[0] = arms[1] = 0; }
+
+  static unsigned int Bit(unsigned int rpId)
+    { return 6*((rpId / 10) % 10) + rpId % 10; }
+
+  void Insert(unsigned int rpId)
+    { arms[(rpId / 100) % 2] |= 1U << Bit(rpId); }
+
+  bool Contains(unsigned int rpId) const
+    { return arms[(rpId / 100) % 2] & (1U << Bit(rpId)); }
+
+  /// finds the fittable U and V patterns of a RP, returns false unless there is exactly one of each
+  static bool GetUVPatterns(const edm::DetSet<TotemRPUVPattern> &ds, unsigned int &idx_U, unsigned int &idx_V)
+  {
+    unsigned int n_U = 0, n_V = 0;
+    for (unsigned int idx = 0; idx < ds.size(); ++idx)
+    {
+      const TotemRPUVPattern &p = ds[idx];
+
+      if (! p.getFittable())
+        continue;
+
+      if (p.getProjection() == TotemRPUVPattern::projU)
+      {
+        n_U++;
+        idx_U = idx;
+      }
+
+      if (p.getProjection() == TotemRPUVPattern::projV)
+      {
+        n_V++;
+        idx_V = idx;
+      }
+    }
+
+    return (n_U == 1 && n_V == 1);
+  }
+
+  /// RPs 0 and 4 are top, 1 and 5 bottom, 2 and 3 horizontal, in all stations
+  Signature GetSignature(unsigned int arm) const
+  {
+    const unsigned int topMask = 0x11 | 0x11 << 6 | 0x11 << 12;
+    const unsigned int botMask = 0x22 | 0x22 << 6 | 0x22 << 12;
+    const unsigned int horMask = 0x0C | 0x0C << 6 | 0x0C << 12;
+
+    const unsigned int m = arms[arm];
+    Signature s;
+    s.top = std::bitset<18>(m & topMask).count();
+    s.bot = std::bitset<18>(m & botMask).count();
+    s.hor = std::bitset<18>(m & horMask).count();
+    return s;
+  }
+};
+
+#endif
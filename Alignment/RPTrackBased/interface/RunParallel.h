@@ -0,0 +1,41 @@
+/****************************************************************************
+*
+* This is a part of TOTEM offline software.
+* A minimal thread pool for the standalone tools of this package.
+*
+****************************************************************************/
+
+#ifndef Alignment_RPTrackBased_RunParallel
+#define Alignment_RPTrackBased_RunParallel
+
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+/// runs f(0), ..., f(n-1) using the given number of threads (the calling one included),
+/// the indices are handed out in increasing order
+inline void RunParallel(unsigned int n, unsigned int threads, const std::function<void (unsigned int)> &f)
+{
+  std::atomic<unsigned int> next(0);
+  auto worker = [&] () {
+    for (unsigned int i = next++; i < n; i = next++)
+      f(i);
+  };
+
+  std::vector<std::thread> pool;
+  for (unsigned int t = 1; t < threads && t < n; t++)
+    pool.push_back(std::thread(worker));
+  worker();
+  for (unsigned int t = 0; t < pool.size(); t++)
+    pool[t].join();
+}
+
+/// returns the number of hardware threads, at least 1
+inline unsigned int DefaultThreads()
+{
+  unsigned int threads = std::thread::hardware_concurrency();
+  return (threads > 0) ? threads : 1;
+}
+
+#endif
@@ -17,6 +17,9 @@
 #include <TVectorD.h>
 #include <TFile.h>
 
+#include "FWCore/Utilities/interface/EDGetToken.h"
+#include "DataFormats/Common/interface/DetSetVector.h"
+#include "DataFormats/CTPPSReco/interface/TotemRPUVPattern.h"
 #include "DataFormats/CTPPSAlignment/interface/LocalTrackFit.h"
 #include "DataFormats/CTPPSAlignment/interface/RPAlignmentCorrectionsData.h"
 #include "Alignment/RPTrackBased/interface/AlignmentGeometry.h"
@@ -46,13 +49,24 @@ class StraightTrackAlignment
     virtual ~StraightTrackAlignment();
 
     virtual void Begin(const edm::EventSetup&);
-    virtual void ProcessEvent(const edm::Event&, const edm::EventSetup&);
+    /// the tokens must be registered by the calling module for tagRecognizedPatterns and tagExternalFit
+    virtual void ProcessEvent(const edm::Event&, const edm::EventSetup&,
+      const edm::EDGetTokenT< edm::DetSetVector<TotemRPUVPattern> > &patternsToken,
+      const edm::EDGetTokenT<LocalTrackFit> &externalFitToken);
     
     /// performs analyses and fill results variable
     virtual void Finish();
 
+    /// saves the data collected so far (counters, diagnostic plots, data of algorithms) to a ROOT file
+    void SaveState(const std::string &fileName);
+
+    /// adds the data from a file written by SaveState, can be called instead of Begin
+    /// the first file loaded also sets the alignment geometry and the initial alignments
+    void LoadState(const std::string &fileName);
+
   protected:
     friend class RPStraightTrackAligner;
+    friend class RPStraightTrackAlignerMT;
     friend class StraightTrackAlignmentIdealResult;
 
     // ---------- input parameters -----------
@@ -142,6 +156,12 @@ class StraightTrackAlignment
 
     /// the file with task data
     TFile *taskDataFile;
+
+    /// the name of the file where Finish saves the collected data, see SaveState
+    std::string stateFileName;
+
+    /// whether Finish shall solve the alignment problem (false: only save the collected data)
+    bool solveAtEndOfJob;
     
     // ---------- internal data members ----------        
 
@@ -188,6 +208,12 @@ class StraightTrackAlignment
       ChiSqHistograms() : lin_fitted(NULL), lin_selected(NULL), 
         log_fitted(NULL), log_selected(NULL) {}
       ChiSqHistograms(const std::string &name);
+
+      /// writes the histograms to the current directory, under short names
+      void Write() const;
+
+      /// adds the histograms written by Write to the given directory
+      void Add(TDirectory *);
     };
 
     /// global (all RP sets) chi^2 histograms
@@ -208,8 +234,29 @@ class StraightTrackAlignment
 
     // ----------- methods ------------
 
+    /// outcome of the track selection in an event
+    enum SelectionResult { srNoHits, srFitFailed, srRejected, srSelected };
+
+    /// collects the hits of an event, fits them and applies the track quality cuts
+    /// doesn't modify the object, can be called concurrently with different fitters
+    /// \param selectedRPs set of RPs with hits in the fitted selection
+    /// \param externalFitToken only used with useExternalFitter
+    SelectionResult SelectTrack(const edm::Event&, const edm::EDGetTokenT< edm::DetSetVector<TotemRPUVPattern> > &patternsToken,
+      const edm::EDGetTokenT<LocalTrackFit> &externalFitToken, LocalTrackFitter &trackFitter, HitCollection &selection,
+      LocalTrackFit &trackFit, LocalTrackFit &extTrackFit, std::set<unsigned int> &selectedRPs) const;
+
     /// creates a new residua histogram
     TH1D* NewResiduaHist(const char *name);
+
+    /// returns the chi^2 histograms of a RP set, creates them if needed
+    ChiSqHistograms& GetChiSqHistograms(const std::set<unsigned int> &);
+
+    /// returns the residua histograms of a detector, creates them if needed
+    ResiduaHistogramSet& GetResiduaHistogramSet(unsigned int id);
+
+    /// returns the residua histogram of a detector in a RP set, creates it if needed
+    TH1D* GetPerRPSetResiduaHist(std::map< std::set<unsigned int>, TH1D* > &, unsigned int id,
+      const std::set<unsigned int> &);
     
     /// fits the collection of hits and removes hits with too high residual/sigma ratio
     /// \param failed whether the fit has failed
@@ -237,6 +284,14 @@ class StraightTrackAlignment
 
     /// saves a ROOT file with diagnostic plots
     void SaveDiagnostics() const;
+
+    /// the diagnostic histograms and graphs common to all tracks
+    std::vector<TH1D *> CommonHistograms() const;
+    std::vector<TGraph *> CommonGraphs() const;
+
+    /// writes/adds the diagnostic plots to/from a state file directory
+    void SaveDiagnosticsState(TDirectory *) const;
+    void LoadDiagnosticsState(TDirectory *);
 };
 
 #endif
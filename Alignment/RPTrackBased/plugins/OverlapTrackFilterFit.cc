@@ -23,12 +23,15 @@
 #include "Alignment/RPTrackBased/interface/LocalTrackFitter.h"
 #include "Alignment/RPTrackBased/interface/AlignmentGeometry.h"
 #include "Alignment/RPTrackBased/interface/AlignmentTask.h"
+#include "Alignment/RPTrackBased/interface/RPOccupancy.h"
 
-#include <map>
-#include <unordered_set>
+#include <cmath>
 
 /**
  * \brief Filters track candidates useful for track-based alignment (mainly tracks in overlap).
+ *
+ * The hits of RPs with exactly one fittable U and one fittable V pattern are fitted, separately
+ * in each arm. The fit is skipped if the pot occupancy of the arm can't satisfy any condition.
  */
 class OverlapTrackFilterFit : public edm::EDFilter
 {
@@ -51,8 +54,11 @@ class OverlapTrackFilterFit : public edm::EDFilter
     unsigned int prescale_lx;
     unsigned int prescale_ly;
 
-    /// map: arm --> geometry
-    std::map<unsigned int, AlignmentGeometry> alGeometries;
+    /// alignment geometry of each arm
+    AlignmentGeometry alGeometries[2];
+
+    /// hit selection buffer, reused between events
+    HitCollection selection;
 
     unsigned int counter_tth, counter_bbh;
     unsigned int counter_ttt, counter_bbb;
@@ -93,6 +99,8 @@ OverlapTrackFilterFit::OverlapTrackFilterFit(const ParameterSet &ps) :
 
   counter_tth(0), counter_bbh(0),
   counter_ttt(0), counter_bbb(0),
+  counter_hh(0),
+  counter_lx(0), counter_ly(0),
   counter_all_events(0), counter_selected_events(0)
 {
   printf(">> OverlapTrackFilterFit::OverlapTrackFilterFit\n");
@@ -112,9 +120,9 @@ void OverlapTrackFilterFit::beginRun(edm::Run const&, edm::EventSetup const& es)
   es.get<VeryForwardRealGeometryRecord>().get(geom);
 
   // build alignment geometry for each arm
-  vector<unsigned int> rps;
   for (unsigned int a = 0; a < 2; a++)
   {
+    vector<unsigned int> rps;
     for (unsigned int s = 0; s < 3; s++)
     {
       if (s == 1)
@@ -142,55 +150,65 @@ bool OverlapTrackFilterFit::filter(edm::Event &event, const EventSetup &es)
   Handle< DetSetVector<TotemRPUVPattern> > patterns;
   event.getByLabel(tagRecognizedPatterns, patterns);
 
+  // occupancy of RPs with a unique U-V pattern pair
+  RPOccupancy occupancy;
+  const DetSet<TotemRPUVPattern> *rpPatterns[2][18];
+  unsigned int rpIdx_U[2][18], rpIdx_V[2][18];
+  for (const auto &ds : *patterns)
+  {
+    unsigned int rp = ds.detId();
+
+    // station 1 is not in the alignment geometry
+    if ((rp / 10) % 10 == 1)
+      continue;
+
+    unsigned int arm = (rp / 100) % 2, bit = RPOccupancy::Bit(rp);
+    if (!RPOccupancy::GetUVPatterns(ds, rpIdx_U[arm][bit], rpIdx_V[arm][bit]))
+      continue;
+
+    occupancy.Insert(rp);
+    rpPatterns[arm][bit] = &ds;
+  }
+
   // flag whether to keep this event
   bool keep = false;
 
-  // TODO: update
-  /*
   // make fits for each arm
-  for (const auto &gp : alGeometries)
+  for (unsigned int arm = 0; arm < 2; arm++)
   {
-    unsigned int arm = gp.first;
+    // the fit can only remove RPs, skip the arm if no condition below can be met
+    RPOccupancy::Signature sig = occupancy.GetSignature(arm);
+    if (sig.top < 2 && sig.bot < 2 && sig.hor < 2)
+      continue;
 
     // select hits
-    HitCollection selection;
-    for (const auto &tp : *trackColl)
+    selection.clear();
+    for (unsigned int bit = 0; bit < 18; bit++)
     {
-      if (!tp.second.Fittable())
-        continue;
-    
-      unsigned int rp = tp.first;
-      if (rp / 100 != arm)
+      if (!(occupancy.arms[arm] & (1U << bit)))
         continue;
 
-      for (const auto &hit : tp.second.TrackRecoHits())
-        selection.push_back(hit);
+      const DetSet<TotemRPUVPattern> &ds = *rpPatterns[arm][bit];
+      for (auto &hds : ds[rpIdx_U[arm][bit]].getHits())
+        for (auto &h : hds)
+          selection.push_back(h);
+      for (auto &hds : ds[rpIdx_V[arm][bit]].getHits())
+        for (auto &h : hds)
+          selection.push_back(h);
     }
 
     // make fit
     LocalTrackFit trackFit;
-    if (! fitter.Fit(selection, gp.second, trackFit))
+    if (! fitter.Fit(selection, alGeometries[arm], trackFit))
       continue;
 
     // analyze RP structure of the fit
-    unordered_set<unsigned int> selectedRPs;
+    RPOccupancy fitOccupancy;
     for (const auto &hit : selection)
-      selectedRPs.insert(hit.id/10);
+      fitOccupancy.Insert(hit.id/10);
 
-    unsigned int top=0, bot=0, hor=0;
-    for (const auto &rp : selectedRPs)
-    {
-      unsigned int idx = rp % 10;
-  
-      if (idx == 0 || idx == 4)
-        top++;
-  
-      if (idx == 2 || idx == 3)
-        hor++;
-  
-      if (idx == 1 || idx == 5)
-        bot++;
-    }
+    sig = fitOccupancy.GetSignature(arm);
+    unsigned int top = sig.top, bot = sig.bot, hor = sig.hor;
 
     // update keep flag
     if (top >= 3)
@@ -265,7 +283,6 @@ bool OverlapTrackFilterFit::filter(edm::Event &event, const EventSetup &es)
       }
     }
   }
-  */
 
   counter_all_events++;
 
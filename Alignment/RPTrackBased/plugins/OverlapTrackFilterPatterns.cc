@@ -16,9 +16,13 @@
 
 #include "DataFormats/CTPPSReco/interface/TotemRPUVPattern.h"
 
+#include "Alignment/RPTrackBased/interface/RPOccupancy.h"
+
 
 /**
  * \brief Filters track candidates useful for track-based alignment (mainly tracks in overlap).
+ *
+ * A RP is active if it has exactly one fittable U and one fittable V pattern.
  */
 class OverlapTrackFilterPatterns : public edm::EDFilter
 {
@@ -66,97 +70,65 @@ OverlapTrackFilterPatterns::OverlapTrackFilterPatterns(const ParameterSet &ps) :
 
 bool OverlapTrackFilterPatterns::filter(edm::Event &event, const EventSetup &es)
 {
-  //printf("--------------------------------------------------------\n");
-
   Handle< DetSetVector<TotemRPUVPattern> > patterns;
   event.getByLabel(tagRecognizedPatterns, patterns);
 
-  // keep event?
-  bool keep = false;
-
-// TODO:uncomment
-#if 0
-  struct RPCount
+  // occupancy of RPs with a unique U-V pattern pair
+  RPOccupancy occupancy;
+  for (const auto &ds : *patterns)
   {
-    unsigned int top, bot, hor;
-    RPCount() : top(0), bot(0), hor(0) {}
-  };
+    unsigned int idx_U, idx_V;
+    if (RPOccupancy::GetUVPatterns(ds, idx_U, idx_V))
+      occupancy.Insert(ds.detId());
+  }
 
-  // map: arm --> number of active RPs
-  map<unsigned int, RPCount> activity;
+  // keep event?
+  bool keep = false;
 
-  for (const auto &p : *patterns)
+  for (unsigned int arm = 0; arm < 2; arm++)
   {
-    if (!p.second.Fittable())
-      continue;
-
-    unsigned int rp = p.first;
-    unsigned int arm = rp / 100;
-    unsigned int idx = rp % 10;
-
-    //printf("RP %u\n", rp);
-    
-    if (idx == 0 || idx == 4)
-      activity[arm].top++;
-
-    if (idx == 2 || idx == 3)
-      activity[arm].hor++;
+    const RPOccupancy::Signature sig = occupancy.GetSignature(arm);
 
-    if (idx == 1 || idx == 5)
-      activity[arm].bot++;
-  }
-
-  for (const auto &ac : activity)
-  {
-    if (ac.second.top >= 3)
+    if (sig.top >= 3)
     {
       counter_ttt++;
-      //printf("counter_ttt ---> %u\n", counter_ttt);
       if (counter_ttt >= prescale_vvv)
       {
         keep = true;
-        //printf("    ==> keep\n");
         counter_ttt = 0;
       }
     }
 
-    if (ac.second.bot >= 3)
+    if (sig.bot >= 3)
     {
       counter_bbb++;
-      //printf("counter_bbb ---> %u\n", counter_bbb);
       if (counter_bbb >= prescale_vvv)
       {
         keep = true;
-        //printf("    ==> keep\n");
         counter_bbb = 0;
       }
     }
 
-    if (ac.second.top >= 2 && ac.second.hor >= 1)
+    if (sig.top >= 2 && sig.hor >= 1)
     {
       counter_tth++;
-      //printf("counter_tth ---> %u\n", counter_tth);
       if (counter_tth >= prescale_vvh)
       {
         keep = true;
-        //printf("    ==> keep\n");
         counter_tth = 0;
       }
     }
 
-    if (ac.second.bot >= 2 && ac.second.hor >= 1)
+    if (sig.bot >= 2 && sig.hor >= 1)
     {
       counter_bbh++;
-      //printf("counter_bbh ---> %u\n", counter_bbh);
       if (counter_bbh >= prescale_vvh)
       {
         keep = true;
-        //printf("    ==> keep\n");
         counter_bbh = 0;
       }
     }
   }
-#endif
 
   counter_all_events++;
 
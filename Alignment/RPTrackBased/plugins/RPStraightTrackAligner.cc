@@ -31,6 +31,9 @@ class RPStraightTrackAligner : public edm::EDAnalyzer
     bool worker_initialized;
     StraightTrackAlignment worker;
 
+    edm::EDGetTokenT< edm::DetSetVector<TotemRPUVPattern> > patternsToken;
+    edm::EDGetTokenT<LocalTrackFit> externalFitToken;
+
     edm::ESWatcher<VeryForwardRealGeometryRecord> geometryWatcher;
 
     virtual void beginJob() {}
@@ -49,6 +52,9 @@ RPStraightTrackAligner::RPStraightTrackAligner(const ParameterSet &ps) :
   worker_initialized(false),
   worker(ps)
 {
+  patternsToken = consumes< DetSetVector<TotemRPUVPattern> >(worker.tagRecognizedPatterns);
+  if (worker.useExternalFitter)
+    externalFitToken = consumes<LocalTrackFit>(worker.tagExternalFit);
 }
 
 //----------------------------------------------------------------------------------------------------
@@ -72,7 +78,7 @@ void RPStraightTrackAligner::analyze(const edm::Event &e, const edm::EventSetup
     worker_initialized = true;
   }
 
-  worker.ProcessEvent(e, es);
+  worker.ProcessEvent(e, es, patternsToken, externalFitToken);
 }
 
 //----------------------------------------------------------------------------------------------------
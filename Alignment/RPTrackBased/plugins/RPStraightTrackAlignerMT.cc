@@ -0,0 +1,222 @@
+/****************************************************************************
+*
+* This is a part of TOTEM offline software.
+* Track-based RP alignment as a global module, the tracks are accumulated per stream.
+*
+****************************************************************************/
+
+#include "FWCore/Framework/interface/global/EDAnalyzer.h"
+#include "FWCore/Framework/interface/Event.h"
+#include "FWCore/ParameterSet/interface/ParameterSet.h"
+#include "FWCore/Framework/interface/EventSetup.h"
+#include "FWCore/Framework/interface/MakerMacros.h"
+#include "FWCore/Utilities/interface/StreamID.h"
+
+#include "Alignment/RPTrackBased/interface/StraightTrackAlignment.h"
+#include "Geometry/Records/interface/VeryForwardRealGeometryRecord.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace rpstraighttrackaligner
+{
+  /// accumulated data of one stream
+  struct StreamData
+  {
+    /// stream index
+    unsigned int index;
+
+    /// own copy of the track fitter
+    LocalTrackFitter fitter;
+
+    /// whether the accumulators have been created
+    bool initialized;
+
+    /// one per algorithm, NULL for algorithms that can only be fed serially
+    std::vector<AlignmentAccumulator *> accumulators;
+
+    unsigned long eventsTotal, eventsFitted, eventsSelected;
+    std::map< std::set<unsigned int>, unsigned long> fittedTracksPerRPSet, selectedTracksPerRPSet;
+
+    StreamData(unsigned int _i, const LocalTrackFitter &_f) : index(_i), fitter(_f), initialized(false),
+      eventsTotal(0), eventsFitted(0), eventsSelected(0) {}
+
+    ~StreamData()
+    {
+      for (unsigned int i = 0; i < accumulators.size(); i++)
+        delete accumulators[i];
+    }
+  };
+}
+
+/**
+ *\brief Multi-threaded variant of RPStraightTrackAligner.
+ *
+ * Every stream selects and fits the tracks on its own and feeds them to its own accumulators of
+ * the algorithms supporting it (see AlignmentAlgorithm::NewStreamAccumulator). The accumulators are
+ * merged at the end of the job in the order of the stream indices, then StraightTrackAlignment::Finish
+ * runs as usual. The other algorithms and the diagnostic histograms are fed under a lock. The per-detector
+ * plots of JanAlignmentAlgorithm are only filled by the serial RPStraightTrackAligner.
+ **/
+class RPStraightTrackAlignerMT : public edm::global::EDAnalyzer< edm::StreamCache<rpstraighttrackaligner::StreamData> >
+{
+  public:
+    RPStraightTrackAlignerMT(const edm::ParameterSet &ps);
+    ~RPStraightTrackAlignerMT() {}
+
+  private:
+    typedef rpstraighttrackaligner::StreamData StreamData;
+
+    unsigned int verbosity;
+
+    /// guarded by the mutex, except for the members which are read-only after worker.Begin
+    mutable StraightTrackAlignment worker;
+    mutable std::mutex workerMutex;
+
+    edm::EDGetTokenT< edm::DetSetVector<TotemRPUVPattern> > patternsToken;
+    edm::EDGetTokenT<LocalTrackFit> externalFitToken;
+
+    mutable std::once_flag workerInitialized;
+    mutable unsigned long long geometryCacheId;
+
+    /// counter of selected tracks of all streams, for the maxEvents limit
+    mutable std::atomic<unsigned long> eventsSelected;
+
+    /// the stream data, in the order of endStream calls
+    mutable std::vector<StreamData *> finishedStreams;
+
+    virtual std::unique_ptr<StreamData> beginStream(edm::StreamID) const;
+    virtual void analyze(edm::StreamID, const edm::Event &e, const edm::EventSetup &es) const;
+    virtual void endStream(edm::StreamID) const;
+    virtual void endJob();
+};
+
+using namespace std;
+using namespace edm;
+
+//----------------------------------------------------------------------------------------------------
+
+RPStraightTrackAlignerMT::RPStraightTrackAlignerMT(const ParameterSet &ps) :
+  verbosity(ps.getUntrackedParameter<unsigned int>("verbosity", 0)),
+  worker(ps),
+  geometryCacheId(0),
+  eventsSelected(0)
+{
+  patternsToken = consumes< DetSetVector<TotemRPUVPattern> >(worker.tagRecognizedPatterns);
+  if (worker.useExternalFitter)
+    externalFitToken = consumes<LocalTrackFit>(worker.tagExternalFit);
+}
+
+//----------------------------------------------------------------------------------------------------
+
+unique_ptr<RPStraightTrackAlignerMT::StreamData> RPStraightTrackAlignerMT::beginStream(StreamID id) const
+{
+  return unique_ptr<StreamData>(new StreamData(id.value(), worker.fitter));
+}
+
+//----------------------------------------------------------------------------------------------------
+
+void RPStraightTrackAlignerMT::analyze(StreamID id, const Event &e, const EventSetup &es) const
+{
+  // the alignment geometry is built once, from the first event
+  call_once(workerInitialized, [&] () {
+    worker.Begin(es);
+    geometryCacheId = es.get<VeryForwardRealGeometryRecord>().cacheIdentifier();
+  });
+
+  if (es.get<VeryForwardRealGeometryRecord>().cacheIdentifier() != geometryCacheId)
+    throw cms::Exception("RPStraightTrackAlignerMT") <<
+      "RPStraightTrackAlignerMT can't cope with changing geometry - change in event " << e.id() << endl;
+
+  StreamData &sd = *streamCache(id);
+  if (!sd.initialized) {
+    for (unsigned int i = 0; i < worker.algorithms.size(); i++)
+      sd.accumulators.push_back(worker.algorithms[i]->NewStreamAccumulator());
+    sd.initialized = true;
+  }
+
+  // selection and fit
+  HitCollection selection;
+  LocalTrackFit trackFit, extTrackFit;
+  set<unsigned int> selectedRPs;
+  StraightTrackAlignment::SelectionResult result = worker.SelectTrack(e, patternsToken, externalFitToken,
+    sd.fitter, selection, trackFit, extTrackFit, selectedRPs);
+
+  sd.eventsTotal++;
+
+  if (result == StraightTrackAlignment::srNoHits || result == StraightTrackAlignment::srFitFailed)
+    return;
+
+  sd.eventsFitted++;
+  sd.fittedTracksPerRPSet[selectedRPs]++;
+
+  bool selected = (result == StraightTrackAlignment::srSelected);
+
+  if (worker.buildDiagnosticPlots) {
+    lock_guard<mutex> lock(workerMutex);
+    worker.UpdateDiagnosticHistograms(selection, selectedRPs, trackFit, selected);
+  }
+
+  if (!selected)
+    return;
+
+  sd.eventsSelected++;
+  sd.selectedTracksPerRPSet[selectedRPs]++;
+
+  // feed algorithms
+  for (unsigned int i = 0; i < worker.algorithms.size(); i++) {
+    if (sd.accumulators[i]) {
+      sd.accumulators[i]->Feed(selection, trackFit, extTrackFit);
+    } else {
+      lock_guard<mutex> lock(workerMutex);
+      worker.algorithms[i]->Feed(selection, trackFit, extTrackFit);
+    }
+  }
+
+  if (++eventsSelected == worker.maxEvents)
+      throw "Number of tracks processed reached maximum";
+}
+
+//----------------------------------------------------------------------------------------------------
+
+void RPStraightTrackAlignerMT::endStream(StreamID id) const
+{
+  // the stream caches are kept until the module is destructed
+  lock_guard<mutex> lock(workerMutex);
+  finishedStreams.push_back(streamCache(id));
+}
+
+//----------------------------------------------------------------------------------------------------
+
+void RPStraightTrackAlignerMT::endJob()
+{
+  // merge in the stream order, to make the result independent of the stream completion order
+  sort(finishedStreams.begin(), finishedStreams.end(),
+    [] (const StreamData *a, const StreamData *b) { return a->index < b->index; });
+
+  for (const StreamData *sd : finishedStreams) {
+    worker.eventsTotal += sd->eventsTotal;
+    worker.eventsFitted += sd->eventsFitted;
+    worker.eventsSelected += sd->eventsSelected;
+
+    for (const auto &p : sd->fittedTracksPerRPSet)
+      worker.fittedTracksPerRPSet[p.first] += p.second;
+    for (const auto &p : sd->selectedTracksPerRPSet)
+      worker.selectedTracksPerRPSet[p.first] += p.second;
+
+    for (unsigned int i = 0; i < sd->accumulators.size(); i++)
+      if (sd->accumulators[i])
+        worker.algorithms[i]->Merge(*sd->accumulators[i]);
+
+    if (verbosity)
+      printf(">> RPStraightTrackAlignerMT::endJob > stream %u: %lu events, %lu tracks selected\n",
+        sd->index, sd->eventsTotal, sd->eventsSelected);
+  }
+
+  worker.Finish();
+}
+
+DEFINE_FWK_MODULE(RPStraightTrackAlignerMT);
@@ -92,6 +92,11 @@ RPStraightTrackAligner = cms.EDAnalyzer("RPStraightTrackAligner",
     saveIntermediateResults = cms.bool(True),
     taskDataFileName = cms.string(''),
 
+    # file where the collected data are saved at the end of the job (e.g. to be merged with
+    # mergeAlignmentStates), empty = don't save
+    stateFileName = cms.string(''),
+    solveAtEndOfJob = cms.bool(True),
+
     diagnosticsFile = cms.string(''),
     buildDiagnosticPlots = cms.bool(True),
 
@@ -106,12 +111,27 @@ RPStraightTrackAligner = cms.EDAnalyzer("RPStraightTrackAligner",
     ),
 
     MillepedeAlgorithm = cms.PSet(
-      workingDir = cms.string('/tmp/')
+      workingDir = cms.string('/tmp/'),
+
+      # the Mille records are written in blocks of this size (in bytes), optionally gzip-compressed
+      # (pede reads .gz input when built with zlib), use readMilleFile to inspect/decompress
+      compressInput = cms.bool(False),
+      blockSize = cms.uint32(1048576)
     ),
 
     JanAlignmentAlgorithm = cms.PSet(
       weakLimit = cms.double(1E-6),
       stopOnSingularModes = cms.bool(True),
       buildDiagnosticPlots = cms.bool(True),
+
+      # eigen analysis of the S and CS matrices (singular and weak modes), only for diagnostics,
+      # the constrained system is always solved by LDL^T decomposition
+      eigenAnalysis = cms.bool(False),
     )
 )
+
+# multi-threaded variant, with the same parameters; algorithms without per-stream
+# accumulation (Ideal, Millepede) and diagnostic plots are fed serially
+RPStraightTrackAlignerMT = cms.EDAnalyzer("RPStraightTrackAlignerMT",
+    **RPStraightTrackAligner.parameters_()
+)
@@ -11,6 +11,23 @@
 
 #include "FWCore/ParameterSet/interface/ParameterSet.h"
 
+#include "TGraph.h"
+#include "TDirectory.h"
+
+//----------------------------------------------------------------------------------------------------
+
+void AppendGraphPoints(TGraph *g, TDirectory *dir, const char *key)
+{
+  TGraph *s = (TGraph *) dir->Get(key);
+  if (!s)
+    return;
+
+  for (int i = 0; i < s->GetN(); i++)
+    g->SetPoint(g->GetN(), s->GetX()[i], s->GetY()[i]);
+
+  delete s;
+}
+
 //----------------------------------------------------------------------------------------------------
 
 AlignmentAlgorithm::AlignmentAlgorithm(const edm::ParameterSet& ps, AlignmentTask *_t) :
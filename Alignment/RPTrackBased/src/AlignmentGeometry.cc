@@ -14,8 +14,116 @@
 using namespace std;
 using namespace edm;
 
+AlignmentGeometry& AlignmentGeometry::operator=(const AlignmentGeometry &o)
+{
+  if (this == &o)
+    return *this;
+
+  std::map<unsigned int, DetGeometry>::operator=(o);
+  rps = o.rps;
+  z0 = o.z0;
+
+  InvalidateIndex();
+  if (o.IndexValid())
+    BuildIndex();
+
+  return *this;
+}
+
+//----------------------------------------------------------------------------------------------------
+
+void AlignmentGeometry::InvalidateIndex()
+{
+  indexValid = false;
+  dets.clear();
+  detIds.clear();
+  matrixIndices.clear();
+}
+
+//----------------------------------------------------------------------------------------------------
+
+AlignmentGeometry::size_type AlignmentGeometry::erase(unsigned int id)
+{
+  InvalidateIndex();
+  size_type n = std::map<unsigned int, DetGeometry>::erase(id);
+
+  // keep the RP only if another of its detectors remains
+  const_iterator it = lower_bound(id / 10 * 10);
+  if (it == end() || it->first / 10 != id / 10)
+    rps.erase(id / 10);
+
+  return n;
+}
+
+//----------------------------------------------------------------------------------------------------
+
+void AlignmentGeometry::clear()
+{
+  InvalidateIndex();
+  std::map<unsigned int, DetGeometry>::clear();
+  rps.clear();
+}
+
+//----------------------------------------------------------------------------------------------------
+
+void AlignmentGeometry::AssignMatrixIndices()
+{
+  unsigned int index = 0;
+  unsigned int rpIndex = 0;
+  signed int lastRP = -1;
+  for (iterator it = begin(); it != end(); ++it, ++index) {
+    it->second.matrixIndex = index;
+    signed int rp = it->first / 10;
+    if (lastRP >= 0 && lastRP != rp)
+      rpIndex++; 
+    lastRP = rp;
+    it->second.rpMatrixIndex = rpIndex;
+  }
+
+  BuildIndex();
+}
+
+//----------------------------------------------------------------------------------------------------
+
+void AlignmentGeometry::BuildIndex()
+{
+  InvalidateIndex();
+
+  if (empty()) {
+    indexValid = true;
+    return;
+  }
+
+  // the ids are the map keys, the last is the largest
+  matrixIndices.assign(rbegin()->first + 1, -1);
+  dets.resize(size());
+  detIds.resize(size());
+
+  vector<bool> assigned(size(), false);
+  for (const_iterator it = begin(); it != end(); ++it) {
+    unsigned int mi = it->second.matrixIndex;
+    if (mi >= size() || assigned[mi]) {
+      InvalidateIndex();
+      throw cms::Exception("AlignmentGeometry::BuildIndex") << "Invalid matrix index " << mi << " of detector "
+        << it->first << ".";
+    }
+
+    assigned[mi] = true;
+    dets[mi] = &it->second;
+    detIds[mi] = it->first;
+    matrixIndices[it->first] = mi;
+  }
+
+  indexValid = true;
+}
+
+//----------------------------------------------------------------------------------------------------
+
 unsigned int AlignmentGeometry::MatrixIndexToDetId(unsigned int mi) const
 {
+  if (IndexValid() && mi < detIds.size())
+    return detIds[mi];
+
   const_iterator it = FindByMatrixIndex(mi);
   if (it != end())
     return it->first;
@@ -30,6 +138,9 @@ unsigned int AlignmentGeometry::MatrixIndexToDetId(unsigned int mi) const
 
 AlignmentGeometry::const_iterator AlignmentGeometry::FindByMatrixIndex(unsigned int mi) const
 {
+  if (IndexValid())
+    return (mi < detIds.size()) ? find(detIds[mi]) : end();
+
   for (const_iterator it = begin(); it != end(); ++it)
     if (it->second.matrixIndex == mi)
       return it;
@@ -86,5 +197,7 @@ void AlignmentGeometry::LoadFromFile(const std::string filename)
   }
 
   fclose(f);
+
+  AssignMatrixIndices();
 }
 
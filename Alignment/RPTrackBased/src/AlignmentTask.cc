@@ -78,18 +78,8 @@ void AlignmentTask::BuildGeometry(const vector<unsigned int> &RPIds,
     }
   }
 
-  // set matrix and rpMatrix indeces
-  unsigned int index = 0;
-  unsigned int rpIndex = 0;
-  signed int lastRP = -1;
-  for (AlignmentGeometry::iterator it = geometry.begin(); it != geometry.end(); ++it, ++index) {
-    it->second.matrixIndex = index;
-    signed int rp = it->first / 10;
-    if (lastRP > 0 && lastRP != rp)
-      rpIndex++; 
-    lastRP = rp;
-    it->second.rpMatrixIndex = rpIndex;
-  }
+  // set matrix and rpMatrix indeces, build the lookup tables
+  geometry.AssignMatrixIndices();
 }
 
 //----------------------------------------------------------------------------------------------------
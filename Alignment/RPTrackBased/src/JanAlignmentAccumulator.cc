@@ -0,0 +1,254 @@
+/****************************************************************************
+*
+* This is a part of TOTEM offline software.
+* Per-stream accumulation of the S matrix and M vector of JanAlignmentAlgorithm.
+*
+****************************************************************************/
+
+#include "Alignment/RPTrackBased/interface/JanAlignmentAccumulator.h"
+#include "Alignment/RPTrackBased/interface/MatrixTools.h"
+#include "Alignment/RPTrackBased/interface/AlignmentTask.h"
+
+//#define DEBUG 1
+
+using namespace std;
+
+//----------------------------------------------------------------------------------------------------
+
+JanAlignmentAccumulator::JanAlignmentAccumulator(AlignmentTask *_t, bool _useExternalFitter, unsigned int _verbosity) :
+  events(0), task(_t), useExternalFitter(_useExternalFitter), verbosity(_verbosity)
+{
+  const unsigned int classes = task->quantityClasses.size();
+
+  // initialize M and S components
+  Mc.resize(classes);
+  Sc.resize(classes);
+  for (unsigned int i = 0; i < classes; i++) {
+    unsigned int rows = task->QuantitiesOfClass(task->quantityClasses[i]);
+
+    Mc[i].ResizeTo(rows);
+    Mc[i].Zero();
+
+    Sc[i].resize(classes);
+    for (unsigned int j = 0; j < classes; j++) {
+      unsigned int cols = task->QuantitiesOfClass(task->quantityClasses[j]);
+      Sc[i][j].ResizeTo(rows, cols);
+      Sc[i][j].Zero();
+    }
+  }
+
+  // allocate the work buffers
+  hitTerms.reserve(task->geometry.size());
+  classBuffers.assign(classes, ClassBuffer());
+  for (unsigned int i = 0; i < classes; i++) {
+    ClassBuffer &cb = classBuffers[i];
+    cb.col.reserve(task->geometry.size());
+    cb.g.reserve(task->geometry.size());
+    cb.touched.reserve(task->geometry.size());
+    cb.P.reserve(4 * task->geometry.size());
+    cb.NiP.reserve(4 * task->geometry.size());
+    cb.slot.assign(Mc[i].GetNrows(), -1);
+  }
+}
+
+//----------------------------------------------------------------------------------------------------
+
+void JanAlignmentAccumulator::Feed(const HitCollection &selection, const LocalTrackFit &trackFit,
+  const LocalTrackFit &extTrackFit)
+{
+  Collect(selection, trackFit, extTrackFit);
+  Accumulate();
+}
+
+//----------------------------------------------------------------------------------------------------
+
+void JanAlignmentAccumulator::Collect(const HitCollection &selection, const LocalTrackFit &trackFit,
+  const LocalTrackFit &extTrackFit)
+{
+  events++;
+
+  // track parameters for Gamma coefficient calculations, made z0 compatible
+  // either hat values or external fit
+  const LocalTrackFit &cFit = (useExternalFitter) ? extTrackFit : trackFit;
+  double cax = cFit.ax;
+  double cay = cFit.ay;
+  double cbx = cFit.bx + cFit.ax * (task->geometry.z0 - cFit.z0);
+  double cby = cFit.by + cFit.ay * (task->geometry.z0 - cFit.z0);
+
+  const unsigned int classes = task->quantityClasses.size();
+
+  hitTerms.clear();
+  for (unsigned int i = 0; i < classes; i++) {
+    classBuffers[i].col.clear();
+    classBuffers[i].g.clear();
+  }
+
+  // collect fit matrix rows and the non-zero Gamma elements
+  for (HitCollection::const_iterator it = selection.begin(); it != selection.end(); ++it) {
+    // skip hits that don't have associated geometry record
+    const DetGeometry *dp = task->geometry.Get(it->id);
+    if (!dp)
+      continue;
+
+    const DetGeometry &d = *dp;
+
+    HitTerm h;
+    h.id = it->id;
+    h.position = it->position;
+    h.w = 1./it->sigma/it->sigma;
+    h.a[0] = d.z * d.dx;
+    h.a[1] = d.dx;
+    h.a[2] = d.z * d.dy;
+    h.a[3] = d.dy;
+    h.m = it->position + d.s;  // in mm
+    hitTerms.push_back(h);
+
+    double C = d.dx, S = d.dy;
+
+    for (unsigned int i = 0; i < classes; i++) {
+      unsigned int col = d.matrixIndex;
+      double g = 0.;
+      switch (task->quantityClasses[i]) {
+        case AlignmentTask::qcShR:
+          g = -1.; break;
+        case AlignmentTask::qcShZ:
+          g = cax*C + cay*S; break;
+        case AlignmentTask::qcRPShZ:
+          col = d.rpMatrixIndex; g = cax*C + cay*S; break;
+        case AlignmentTask::qcRotZ:
+          g = (cax*d.z + cbx - d.sx)*(-S) + (cay*d.z + cby - d.sy)*C; break;
+      }
+
+      classBuffers[i].col.push_back(col);
+      classBuffers[i].g.push_back(g);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------
+
+void JanAlignmentAccumulator::Accumulate()
+{
+  const unsigned int classes = task->quantityClasses.size();
+
+  // The hit weights Vi are diagonal, hence
+  //   sigma = Vi - B^T N^-1 B,  with N = A^T Vi A (4x4) and B = A^T Vi (4 x hits)
+  // and since every Gamma row has a single non-zero element, Gamma^T B^T is sparse with 4 rows.
+  const unsigned int hits = hitTerms.size();
+  double N[16] = { 0. }, Ni[16], ATVim[4] = { 0. };
+  for (unsigned int k = 0; k < hits; k++) {
+    const HitTerm &h = hitTerms[k];
+    for (unsigned int a = 0; a < 4; a++) {
+      ATVim[a] += h.w * h.a[a] * h.m;
+      for (unsigned int b = a; b < 4; b++)
+        N[4*a + b] += h.w * h.a[a] * h.a[b];
+    }
+  }
+  for (unsigned int a = 0; a < 4; a++)
+    for (unsigned int b = 0; b < a; b++)
+      N[4*a + b] = N[4*b + a];
+
+  if (!InvertSymmetric4x4(N, Ni)) {
+    if (verbosity)
+      printf("WARNING in JanAlignmentAccumulator::Accumulate > singular track-fit matrix, track skipped.\n");
+    return;
+  }
+
+  // track parameters in the A basis, p = N^-1 A^T Vi m
+  double p[4];
+  for (unsigned int a = 0; a < 4; a++) {
+    p[a] = 0.;
+    for (unsigned int b = 0; b < 4; b++)
+      p[a] += Ni[4*a + b] * ATVim[b];
+  }
+
+  // increment M with Gamma^T r, r = sigma m = Vi (m - A p) are the normalized residuals;
+  // sum Gamma^T B^T per column
+  for (unsigned int i = 0; i < classes; i++) {
+    ClassBuffer &cb = classBuffers[i];
+    double *Mi = Mc[i].GetMatrixArray();
+
+    cb.touched.clear();
+    cb.P.clear();
+
+    for (unsigned int k = 0; k < hits; k++) {
+      const HitTerm &h = hitTerms[k];
+      const unsigned int col = cb.col[k];
+      const double g = cb.g[k];
+
+      double r = h.m;
+      for (unsigned int a = 0; a < 4; a++)
+        r -= h.a[a] * p[a];
+      Mi[col] += g * h.w * r;
+
+#ifdef DEBUG
+      printf("\tclass %u, hit %u (%u): r = %E, gamma = %E at %u\n", i, k, h.id, h.w * r, g, col);
+#endif
+
+      if (cb.slot[col] < 0) {
+        cb.slot[col] = cb.touched.size();
+        cb.touched.push_back(col);
+        cb.P.resize(cb.P.size() + 4, 0.);
+      }
+
+      double *P = &cb.P[4 * cb.slot[col]];
+      for (unsigned int a = 0; a < 4; a++)
+        P[a] += g * h.w * h.a[a];
+    }
+
+    cb.NiP.resize(cb.P.size());
+    for (unsigned int t = 0; t < cb.touched.size(); t++) {
+      for (unsigned int a = 0; a < 4; a++) {
+        double v = 0.;
+        for (unsigned int b = 0; b < 4; b++)
+          v += Ni[4*a + b] * cb.P[4*t + b];
+        cb.NiP[4*t + a] = v;
+      }
+    }
+  }
+
+  // increment S with Gamma^T sigma Gamma = Gamma^T Vi Gamma - (Gamma^T B^T) N^-1 (B Gamma)
+  for (unsigned int i = 0; i < classes; i++) {
+    const ClassBuffer &ci = classBuffers[i];
+
+    for (unsigned int j = 0; j < classes; j++) {
+      const ClassBuffer &cj = classBuffers[j];
+      double *Sij = Sc[i][j].GetMatrixArray();
+      const unsigned int cols = Sc[i][j].GetNcols();
+
+      // diagonal part
+      for (unsigned int k = 0; k < hits; k++)
+        Sij[ci.col[k]*cols + cj.col[k]] += ci.g[k] * hitTerms[k].w * cj.g[k];
+
+      // rank-4 correction
+      for (unsigned int ti = 0; ti < ci.touched.size(); ti++) {
+        const double *P = &ci.P[4*ti];
+        double *row = Sij + ci.touched[ti]*cols;
+        for (unsigned int tj = 0; tj < cj.touched.size(); tj++) {
+          const double *NiP = &cj.NiP[4*tj];
+          row[cj.touched[tj]] -= P[0]*NiP[0] + P[1]*NiP[1] + P[2]*NiP[2] + P[3]*NiP[3];
+        }
+      }
+    }
+  }
+
+  // release the column slots for the next track
+  for (unsigned int i = 0; i < classes; i++) {
+    ClassBuffer &cb = classBuffers[i];
+    for (unsigned int t = 0; t < cb.touched.size(); t++)
+      cb.slot[cb.touched[t]] = -1;
+  }
+}
+
+//----------------------------------------------------------------------------------------------------
+
+void JanAlignmentAccumulator::Merge(const JanAlignmentAccumulator &other)
+{
+  for (unsigned int i = 0; i < Mc.size(); i++) {
+    Mc[i] += other.Mc[i];
+    for (unsigned int j = 0; j < Sc[i].size(); j++)
+      Sc[i][j] += other.Sc[i][j];
+  }
+
+  events += other.events;
+}
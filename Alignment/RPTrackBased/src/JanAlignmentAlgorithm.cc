@@ -8,6 +8,7 @@
 
 #include "FWCore/MessageLogger/interface/MessageLogger.h"
 #include "FWCore/ParameterSet/interface/ParameterSet.h"
+#include "FWCore/Utilities/interface/Exception.h"
 
 #include "Alignment/RPTrackBased/interface/JanAlignmentAlgorithm.h"
 #include "Alignment/RPTrackBased/interface/MatrixTools.h"
@@ -15,11 +16,15 @@
 
 #include "TMatrixDSymEigen.h"
 #include "TDecompSVD.h"
+#include "TDecompBK.h"
 #include "TFile.h"
 #include "TCanvas.h"
 #include "TH2D.h"
+#include "TKey.h"
 
 #include <cmath>
+#include <cstring>
+#include <thread>
 
 //#define DEBUG 1
 
@@ -27,13 +32,13 @@ using namespace std;
 using namespace edm;
 
 JanAlignmentAlgorithm::JanAlignmentAlgorithm(const ParameterSet& ps, AlignmentTask *_t) :
-  AlignmentAlgorithm(ps, _t),
-  Sc(NULL), Mc(NULL)
+  AlignmentAlgorithm(ps, _t)
 {
   const ParameterSet& lps = ps.getParameterSet("JanAlignmentAlgorithm");
   weakLimit = lps.getParameter<double>("weakLimit");
   stopOnSingularModes = lps.getParameter<bool>("stopOnSingularModes");
   buildDiagnosticPlots = lps.getParameter<bool>("buildDiagnosticPlots");
+  eigenAnalysis = lps.getParameter<bool>("eigenAnalysis");
 }
 
 //----------------------------------------------------------------------------------------------------
@@ -46,22 +51,23 @@ JanAlignmentAlgorithm::~JanAlignmentAlgorithm()
 
 void JanAlignmentAlgorithm::Begin(const edm::EventSetup&)
 {
-  // initialize M and S components
-  Mc = new TVectorD[task->quantityClasses.size()];
-  Sc = new TMatrixD* [task->quantityClasses.size()];
-  for (unsigned int i = 0; i < task->quantityClasses.size(); i++) {
-    unsigned int rows = task->QuantitiesOfClass(task->quantityClasses[i]);
+  Init();
+}
 
-    Mc[i].ResizeTo(rows);
-    Mc[i].Zero();
+//----------------------------------------------------------------------------------------------------
 
-    Sc[i] = new TMatrixD[task->quantityClasses.size()];
-    for (unsigned int j = 0; j < task->quantityClasses.size(); j++) {
-      unsigned int cols = task->QuantitiesOfClass(task->quantityClasses[j]);
-      Sc[i][j].ResizeTo(rows, cols);
-      Sc[i][j].Zero();
-    }
-  }
+bool JanAlignmentAlgorithm::BeginStandalone()
+{
+  Init();
+  return true;
+}
+
+//----------------------------------------------------------------------------------------------------
+
+void JanAlignmentAlgorithm::Init()
+{
+  // initialize M and S components
+  accumulator = JanAlignmentAccumulator(task, useExternalFitter, verbosity);
 
   // prepare statistics plots
   if (buildDiagnosticPlots) {
@@ -87,8 +93,6 @@ void JanAlignmentAlgorithm::Begin(const edm::EventSetup&)
       statistics[id] = s;
     } 
   }
-
-  events = 0;
 }
 
 //----------------------------------------------------------------------------------------------------
@@ -99,160 +103,222 @@ void JanAlignmentAlgorithm::Feed(const HitCollection &selection, const LocalTrac
   if (verbosity > 9)
     printf("\n>> JanAlignmentAlgorithm::Feed\n");
 
-  events++;
+  accumulator.Collect(selection, trackFit, extTrackFit);
 
-  // prepare fit - make z0 compatible
+  if (buildDiagnosticPlots)
+    FillDiagnosticPlots(selection, trackFit);
+
+  accumulator.Accumulate();
+}
+
+//----------------------------------------------------------------------------------------------------
+
+void JanAlignmentAlgorithm::FillDiagnosticPlots(const HitCollection &selection, const LocalTrackFit &trackFit)
+{
+  // hat values, z0 compatible
   double hax = trackFit.ax;
   double hay = trackFit.ay;
   double hbx = trackFit.bx + trackFit.ax * (task->geometry.z0 - trackFit.z0);
   double hby = trackFit.by + trackFit.ay * (task->geometry.z0 - trackFit.z0);
 
-  // track parameters for Gamma coefficient calculations
-  // either hat values or external fit
-  double cax = hax, cbx=hbx, cay=hay, cby=hby; 
-  if (useExternalFitter) {
-    cax = extTrackFit.ax;
-    cay = extTrackFit.ay;
-    cbx = extTrackFit.bx + extTrackFit.ax * (task->geometry.z0 - extTrackFit.z0);
-    cby = extTrackFit.by + extTrackFit.ay * (task->geometry.z0 - extTrackFit.z0);
-  }
+  set<unsigned int> rpSet;
+  for (HitCollection::const_iterator it = selection.begin(); it != selection.end(); ++it)
+    rpSet.insert(it->id/10);
 
-  // prepare Gamma matrices
-  TMatrixD *Ga = new TMatrixD[task->quantityClasses.size()];
-  for (unsigned int i = 0; i < task->quantityClasses.size(); i++) {
-    Ga[i].ResizeTo(selection.size(), Mc[i].GetNrows());
-    Ga[i].Zero();
+  const vector<JanAlignmentAccumulator::HitTerm> &hits = accumulator.Hits();
+  for (unsigned int k = 0; k < hits.size(); k++) {
+    const JanAlignmentAccumulator::HitTerm &h = hits[k];
+    DetStat &s = statistics[h.id];
+
+    s.m_dist->Fill(h.position);
+
+    // (standard) residual, in mm
+    double R = h.m - (hax*h.a[0] + hbx*h.a[1] + hay*h.a[2] + hby*h.a[3]);
+
+    for (unsigned int i = 0; i < task->quantityClasses.size(); i++) {
+      double c = accumulator.Coefficients(i).g[k];
+      s.coefHist[i]->Fill(c);
+      s.resVsCoef[i]->SetPoint(s.resVsCoef[i]->GetN(), c, R);
+
+      if (task->quantityClasses[i] == AlignmentTask::qcRotZ) {
+        map< set<unsigned int>, ScatterPlot>::iterator it = s.resVsCoefRot_perRPSet.find(rpSet);
+        if (it == s.resVsCoefRot_perRPSet.end()) {
+          ScatterPlot sp;
+          sp.g = new TGraph();
+          sp.h = new TH2D("", "", 40, -20., +20., 60, -0.15, +0.15);
+          it = s.resVsCoefRot_perRPSet.insert(pair< set<unsigned int>, ScatterPlot>(rpSet, sp)).first;
+        }
+        it->second.g->SetPoint(it->second.g->GetN(), c, R);
+        it->second.h->Fill(c, R);
+      }
+    }
   }
+}
 
-  TMatrixD A(selection.size(), 4);
-  TMatrixD Vi(selection.size(), selection.size());
-  TVectorD m(selection.size());
-  
-  set<unsigned int> rpSet;
-  if (buildDiagnosticPlots)
-    for (HitCollection::const_iterator it = selection.begin(); it != selection.end(); ++it)
-      rpSet.insert(it->id/10);
+//----------------------------------------------------------------------------------------------------
 
-  // fill fit matrix and Gamma matrices
-  unsigned int j = 0;
-  
-  for (HitCollection::const_iterator it = selection.begin(); it != selection.end(); ++it, ++j) {
-    unsigned int id = it->id;
+AlignmentAccumulator* JanAlignmentAlgorithm::NewStreamAccumulator()
+{
+  return new JanAlignmentAccumulator(task, useExternalFitter, verbosity);
+}
 
-    // skip hits that don't have associated geometry record
-    auto git = task->geometry.find(id);
-    if (git == task->geometry.end())
-      continue;
+//----------------------------------------------------------------------------------------------------
 
-    DetGeometry &d = git->second;
+void JanAlignmentAlgorithm::Merge(const AlignmentAccumulator &partial)
+{
+  accumulator.Merge(dynamic_cast<const JanAlignmentAccumulator &>(partial));
+}
 
-    A(j, 0) = d.z * d.dx;
-    A(j, 1) = d.dx;
-    A(j, 2) = d.z * d.dy;
-    A(j, 3) = d.dy;
+//----------------------------------------------------------------------------------------------------
 
-    m(j) = it->position + d.s;  // in mm
+bool JanAlignmentAlgorithm::SaveState(TDirectory *dir)
+{
+  char buf[50];
+  dir->cd();
 
-    Vi(j, j) = 1./it->sigma/it->sigma;
+  TVectorD events(1);
+  events[0] = accumulator.events;
+  events.Write("events");
 
-    double C = d.dx, S = d.dy;
+  for (unsigned int i = 0; i < accumulator.Mc.size(); i++) {
+    sprintf(buf, "M_%u", i);
+    accumulator.Mc[i].Write(buf);
 
-    //printf("%i\t%i\t%i\t%.3f\n", j, id, idx, measVec[j]);
-    
-    if (buildDiagnosticPlots) {
-      statistics[id].m_dist->Fill(it->position);
+    for (unsigned int j = 0; j < accumulator.Sc[i].size(); j++) {
+      sprintf(buf, "S_%u_%u", i, j);
+      accumulator.Sc[i][j].Write(buf);
     }
+  }
 
-    for (unsigned int i = 0; i < task->quantityClasses.size(); i++) {
-      switch (task->quantityClasses[i]) {
-        case AlignmentTask::qcShR:
-          Ga[i][j][d.matrixIndex] = -1.; break;
-        case AlignmentTask::qcShZ:
-          Ga[i][j][d.matrixIndex] = cax*C + cay*S; break;
-        case AlignmentTask::qcRPShZ:
-          Ga[i][j][d.rpMatrixIndex] = cax*C + cay*S; break;
-        case AlignmentTask::qcRotZ:
-          Ga[i][j][d.matrixIndex] = (cax*d.z + cbx - d.sx)*(-S) + (cay*d.z + cby - d.sy)*C; break;
-      }
+  if (!buildDiagnosticPlots)
+    return true;
 
-      if (buildDiagnosticPlots) {
-        double hx = hax * d.z + hbx;  // in mm
-        double hy = hay * d.z + hby;
-        double R = m(j) - (hx*C + hy*S);    // (standard) residual
-        double c = Ga[i][j][d.matrixIndex];
-        DetStat &s = statistics[id];
-        s.coefHist[i]->Fill(c);
-        s.resVsCoef[i]->SetPoint(s.resVsCoef[i]->GetN(), c, R);
-
-        if (task->quantityClasses[i] == AlignmentTask::qcRotZ) {
-          map< set<unsigned int>, ScatterPlot>::iterator it = s.resVsCoefRot_perRPSet.find(rpSet);
-          if (it == s.resVsCoefRot_perRPSet.end()) {
-            ScatterPlot sp;
-            sp.g = new TGraph();
-            sp.h = new TH2D("", "", 40, -20., +20., 60, -0.15, +0.15);
-            it = s.resVsCoefRot_perRPSet.insert(pair< set<unsigned int>, ScatterPlot>(rpSet, sp)).first;
-          }
-          it->second.g->SetPoint(it->second.g->GetN(), c, R);
-          it->second.h->Fill(c, R);
-        }
-      }
+  TDirectory *statDir = dir->mkdir("statistics");
+  for (map<unsigned int, DetStat>::iterator it = statistics.begin(); it != statistics.end(); ++it) {
+    sprintf(buf, "%u", it->first);
+    TDirectory *detDir = statDir->mkdir(buf);
+    detDir->cd();
+
+    it->second.m_dist->Write("m_dist");
+
+    for (unsigned int c = 0; c < task->quantityClasses.size(); c++) {
+      sprintf(buf, "coef_%u", c);
+      it->second.coefHist[c]->Write(buf);
+      sprintf(buf, "resVsCoef_%u", c);
+      it->second.resVsCoef[c]->Write(buf);
+    }
+
+    // one directory per RP set, the set is saved as a vector of RP ids
+    unsigned int idx = 0;
+    for (map< set<unsigned int>, ScatterPlot>::iterator sit = it->second.resVsCoefRot_perRPSet.begin();
+        sit != it->second.resVsCoefRot_perRPSet.end(); ++sit, ++idx) {
+      sprintf(buf, "rotZ_%u", idx);
+      detDir->mkdir(buf)->cd();
+
+      TVectorD rps(sit->first.size());
+      unsigned int r = 0;
+      for (set<unsigned int>::const_iterator rit = sit->first.begin(); rit != sit->first.end(); ++rit, ++r)
+        rps[r] = *rit;
+      rps.Write("rps");
+
+      sit->second.g->Write("g");
+      sit->second.h->Write("h");
     }
   }
 
-  // sigma matrix
-  TMatrixD AT(TMatrixD::kTransposed, A);
-  TMatrixD ATViA(4, 4);
-  ATViA = AT * Vi * A;
-  TMatrixD ATViAI(ATViA);
-  ATViAI = ATViA.Invert();  
-  TMatrixD sigma(Vi);
-  sigma -= Vi * A * ATViAI * AT * Vi;
-
-  // traspose Gamma matrices
-  TMatrixD *GaT = new TMatrixD[task->quantityClasses.size()];
-  for (unsigned int i = 0; i < task->quantityClasses.size(); i++) {
-    GaT[i].ResizeTo(Mc[i].GetNrows(), selection.size());
-    GaT[i].Transpose(Ga[i]);
+  return true;
+}
+
+//----------------------------------------------------------------------------------------------------
+
+bool JanAlignmentAlgorithm::LoadState(TDirectory *dir)
+{
+  if (accumulator.Mc.empty())
+    Init();
+
+  char buf[50];
+
+  TVectorD *events = (TVectorD *) dir->Get("events");
+  if (!events)
+    throw cms::Exception("JanAlignmentAlgorithm") << "No saved state in `" << dir->GetPath() << "'.";
+  accumulator.events += (unsigned int) (*events)[0];
+  delete events;
+
+  for (unsigned int i = 0; i < accumulator.Mc.size(); i++) {
+    sprintf(buf, "M_%u", i);
+    TVectorD *M_s = (TVectorD *) dir->Get(buf);
+    if (!M_s || M_s->GetNrows() != accumulator.Mc[i].GetNrows())
+      throw cms::Exception("JanAlignmentAlgorithm") << "Block `" << buf << "' in `" << dir->GetPath()
+        << "' missing or incompatible with the alignment task.";
+    accumulator.Mc[i] += *M_s;
+    delete M_s;
+
+    for (unsigned int j = 0; j < accumulator.Sc[i].size(); j++) {
+      sprintf(buf, "S_%u_%u", i, j);
+      TMatrixD *S_s = (TMatrixD *) dir->Get(buf);
+      if (!S_s || S_s->GetNrows() != accumulator.Sc[i][j].GetNrows() || S_s->GetNcols() != accumulator.Sc[i][j].GetNcols())
+        throw cms::Exception("JanAlignmentAlgorithm") << "Block `" << buf << "' in `" << dir->GetPath()
+          << "' missing or incompatible with the alignment task.";
+      accumulator.Sc[i][j] += *S_s;
+      delete S_s;
+    }
   }
 
-  // normalized residuals
-  TVectorD r(selection.size());
-  r = sigma * m;
+  TDirectory *statDir = dir->GetDirectory("statistics");
+  if (!buildDiagnosticPlots || !statDir)
+    return true;
 
-  // increment M
-  for (unsigned int i = 0; i < task->quantityClasses.size(); i++)
-    Mc[i] += GaT[i] * r;
+  // the histograms read are owned by the file, the other objects must be deleted
+  for (map<unsigned int, DetStat>::iterator it = statistics.begin(); it != statistics.end(); ++it) {
+    sprintf(buf, "%u", it->first);
+    TDirectory *detDir = statDir->GetDirectory(buf);
+    if (!detDir)
+      continue;
 
-  // increment S
-  for (unsigned int i = 0; i < task->quantityClasses.size(); i++)
-    for (unsigned int j = 0; j < task->quantityClasses.size(); j++)
-      Sc[i][j] += GaT[i] * sigma * Ga[j];
+    DetStat &s = it->second;
 
-#ifdef DEBUG
-  printf("* checking normalized residuals, selection.size = %u\n", selection.size());
-  r.Print(); 
+    TH1D *h = (TH1D *) detDir->Get("m_dist");
+    if (h)
+      s.m_dist->Add(h);
 
-  for (unsigned int i = 0; i < task->quantityClasses.size(); i++) {
-    printf("- class %u\n", i);
-    TVectorD t(Mc[i].GetNrows());
-    for (int j = 0; j < t.GetNrows(); j++)
-      t[j] = 1.;
-    t.Print();
+    for (unsigned int c = 0; c < task->quantityClasses.size(); c++) {
+      sprintf(buf, "coef_%u", c);
+      h = (TH1D *) detDir->Get(buf);
+      if (h)
+        s.coefHist[c]->Add(h);
 
-    Ga[i].Print();
+      sprintf(buf, "resVsCoef_%u", c);
+      AppendGraphPoints(s.resVsCoef[c], detDir, buf);
+    }
 
-    TVectorD tt(selection.size());
-    tt = sigma * Ga[i] * t;
+    TIter next(detDir->GetListOfKeys());
+    while (TKey *key = (TKey *) next()) {
+      if (strncmp(key->GetName(), "rotZ_", 5) != 0)
+        continue;
+
+      TDirectory *spDir = detDir->GetDirectory(key->GetName());
+      TVectorD *rps = (TVectorD *) spDir->Get("rps");
+      set<unsigned int> rpSet;
+      for (int r = 0; r < rps->GetNrows(); r++)
+        rpSet.insert((unsigned int) (*rps)[r]);
+      delete rps;
+
+      map< set<unsigned int>, ScatterPlot>::iterator sit = s.resVsCoefRot_perRPSet.find(rpSet);
+      if (sit == s.resVsCoefRot_perRPSet.end()) {
+        ScatterPlot sp;
+        sp.g = new TGraph();
+        sp.h = new TH2D("", "", 40, -20., +20., 60, -0.15, +0.15);
+        sit = s.resVsCoefRot_perRPSet.insert(pair< set<unsigned int>, ScatterPlot>(rpSet, sp)).first;
+      }
 
-    double ttn = sqrt(tt.Norm2Sqr());
-    printf("|tt| = %E\n", ttn);
-    if (ttn > 1E-8)
-      tt.Print();
+      AppendGraphPoints(sit->second.g, spDir, "g");
+      TH2D *h2 = (TH2D *) spDir->Get("h");
+      if (h2)
+        sit->second.h->Add(h2);
+    }
   }
-#endif
 
-  delete [] Ga;
-  delete [] GaT;
+  return true;
 }
 
 //----------------------------------------------------------------------------------------------------
@@ -265,7 +331,7 @@ vector<SingularMode> JanAlignmentAlgorithm::Analyze()
   // calculate full dimension
   unsigned int dim = 0;
   for (unsigned int i = 0; i < task->quantityClasses.size(); i++)
-    dim += Mc[i].GetNrows();
+    dim += accumulator.Mc[i].GetNrows();
 
   if (verbosity > 2) {
     printf("\tdetectors: %u\n", task->geometry.Detectors());
@@ -278,8 +344,8 @@ vector<SingularMode> JanAlignmentAlgorithm::Analyze()
   M.ResizeTo(dim);
   unsigned int offset = 0;
   for (unsigned int i = 0; i < task->quantityClasses.size(); i++) {
-    M.SetSub(offset, Mc[i]);
-    offset += Mc[i].GetNrows();
+    M.SetSub(offset, accumulator.Mc[i]);
+    offset += accumulator.Mc[i].GetNrows();
   }
 
   // build full S
@@ -289,9 +355,9 @@ vector<SingularMode> JanAlignmentAlgorithm::Analyze()
     c_offset = 0;
     unsigned int r_size = 0, c_size = 0;
     for (unsigned int j = 0; j < task->quantityClasses.size(); j++) {
-      r_size = Sc[i][j].GetNrows();
-      c_size = Sc[i][j].GetNcols();
-      TMatrixDSub(S, r_offset, r_offset+r_size-1, c_offset, c_offset+c_size-1) = Sc[i][j];
+      r_size = accumulator.Sc[i][j].GetNrows();
+      c_size = accumulator.Sc[i][j].GetNcols();
+      TMatrixDSub(S, r_offset, r_offset+r_size-1, c_offset, c_offset+c_size-1) = accumulator.Sc[i][j];
       c_offset += c_size;
     }
     r_offset += r_size;
@@ -312,6 +378,10 @@ vector<SingularMode> JanAlignmentAlgorithm::Analyze()
     printf("\n* S matrix:\n\tdimension = %i\n\tmaximum asymmetry: %E\t(ratio to maximum element %E)\n", dim, maxDiff, maxDiff/maxElem);
   }
 
+  // the eigen analysis is only needed for diagnostics
+  if (!eigenAnalysis)
+    return singularModes;
+
   // make a symmetric copy
   TMatrixDSym S_sym(dim);
   for (unsigned int j = 0; j < dim; j++)
@@ -330,7 +400,7 @@ vector<SingularMode> JanAlignmentAlgorithm::Analyze()
 
   // identify singular modes
   for (int i = 0; i < S_eigVal.GetNrows(); i++) {
-    double nev = S_eigVal[i] / events;
+    double nev = S_eigVal[i] / accumulator.events;
     if (fabs(nev) < singularLimit) {
       SingularMode sM;
       sM.val = S_eigVal[i];
@@ -378,14 +448,12 @@ unsigned int JanAlignmentAlgorithm::Solve(const std::vector<AlignmentConstraint>
   // build C matrix
   unsigned int dim = S.GetNrows();
   TMatrixD C(dim, constraints.size());
-  TMatrixD C2(dim, constraints.size());
   for (unsigned int i = 0; i < constraints.size(); i++) {
     unsigned int offset = 0;
     for (unsigned int j = 0; j < task->quantityClasses.size(); j++) {
       const TVectorD &cv = constraints[i].coef.find(task->quantityClasses[j])->second;
       for (int k = 0; k < cv.GetNrows(); k++) {
-        C[offset][i] = events * cv[k];
-        C2[offset][i] = events * cv[k]*1E3;
+        C[offset][i] = accumulator.events * cv[k];
         offset++;
       }
     }
@@ -396,199 +464,253 @@ unsigned int JanAlignmentAlgorithm::Solve(const std::vector<AlignmentConstraint>
   Print(C);
 #endif
 
-  // build E matrix (singular vectors of S as its columns)
-  TMatrixD E(S.GetNrows(), singularModes.size());
-  for (unsigned int i = 0; i < singularModes.size(); i++)
-    for (int j = 0; j < S.GetNrows(); j++)
-      E(j, i) = singularModes[i].vec[j];
-
   // build CS matrix
   TMatrixDSym CS(dim + constraints.size());
-  TMatrixDSym CS2(dim + constraints.size());
   CS.Zero();
-  CS2.Zero();
   for (unsigned int j = 0; j < dim; j++)
-    for (unsigned int i = 0; i < dim; i++) {
+    for (unsigned int i = 0; i < dim; i++)
       CS[i][j] = S[i][j];
-      CS2[i][j] = S[i][j];
-    }
   for (unsigned int i = 0; i < constraints.size(); i++)
-    for (unsigned int j = 0; j < dim; j++) {
+    for (unsigned int j = 0; j < dim; j++)
       CS[j][dim + i] = CS[dim + i][j] =  C(j, i);
-      CS2[j][dim + i] = CS2[dim + i][j] =  C2(j, i);
-  }
 
-  // eigen analysis of CS matrix
-  TMatrixDSymEigen CS_eig(CS);
-  TVectorD CS_eigVal = CS_eig.GetEigenValues();
-  TMatrixD CS_eigVec = CS_eig.GetEigenVectors();
-
-  // check regularity of CS matrix
-  printf("\n* eigen values of CS and S matrices (events = %u)\n", events);
-  printf("   #          CS    norm. CS               S     norm. S\n");
-  unsigned int singularModeCount = 0;
-  vector<unsigned int> weakModeIdx;
-  for (int i = 0; i < CS_eigVal.GetNrows(); i++) {
-
-    double CS_nev = CS_eigVal[i]/events;
-    printf("%4i%+12.2E%+12.2E", i, CS_eigVal[i], CS_nev);
-    if (fabs(CS_nev) < singularLimit) {
-      singularModeCount++;
-      printf(" (S)");
-    } else
-      if (fabs(CS_nev) < weakLimit) {
-        weakModeIdx.push_back(i);
-        printf(" (W)");
-      } else {
-        printf("    ");
-      }
+  // build MV vector
+  TVectorD MV(dim + constraints.size());
+  for (unsigned int i = 0; i < dim; i++)
+    MV[i] = M[i];
+  for (unsigned int i = 0; i < constraints.size(); i++)
+    MV[dim + i] = accumulator.events*constraints[i].val;
 
-    if (i < S_eigVal.GetNrows()) {
-      double S_nev = S_eigVal[i]/events;
-      printf("%+12.2E%+12.2E", S_eigVal[i], S_nev);
-      if (fabs(S_nev) < singularLimit)
-        printf(" (S)");
-      else
-        if (fabs(S_nev) < weakLimit)
-          printf(" (W)");
-    }
+  TMatrixD S0(S); // new parts full of zeros
+  S0.ResizeTo(dim + constraints.size(), dim + constraints.size());
 
-    printf("\n");
+  // diagnostic pass, runs concurrently with the solution below:
+  // eigen analysis of CS and error matrix with constraints scaled by 1E3
+  TVectorD CS_eigVal;
+  TMatrixD CS_eigVec;
+  TMatrixD EM2;
+  vector<thread> diagnostics;
+  if (eigenAnalysis) {
+    diagnostics.push_back(thread([&] () {
+      TMatrixDSymEigen CS_eig(CS);
+      CS_eigVal.ResizeTo(CS_eig.GetEigenValues().GetNrows());
+      CS_eigVal = CS_eig.GetEigenValues();
+      CS_eigVec.ResizeTo(CS_eig.GetEigenVectors());
+      CS_eigVec = CS_eig.GetEigenVectors();
+    }));
+
+    diagnostics.push_back(thread([&] () {
+      TMatrixDSym CS2(CS);
+      for (unsigned int i = 0; i < constraints.size(); i++)
+        for (unsigned int j = 0; j < dim; j++)
+          CS2[j][dim + i] = CS2[dim + i][j] = C(j, i)*1E3;
+
+      TMatrixDSym CS2I_sym(CS2.GetNrows());
+      TDecompBK CS2_bk(CS2);
+      if (!CS2_bk.Decompose() || !CS2_bk.Invert(CS2I_sym))
+        return;
+      TMatrixD CS2I(CS2I_sym);
+      EM2.ResizeTo(CS2I);
+      EM2 = CS2I * S0 * CS2I;
+    }));
   }
 
-  // print weak vectors
-  if (weakModeIdx.size() > 0) {
-    unsigned int columns = 10;
-    unsigned int first = 0;
-    
-    while (first < weakModeIdx.size()) {
-      unsigned int last = first + columns;
-      if (last >= weakModeIdx.size())
-        last = weakModeIdx.size();
-
-      printf("\n* CS weak modes\n    | ");
-      for (unsigned int i = first; i < last; i++)
-        printf("%+10.3E   ", CS_eigVal[weakModeIdx[i]]);
-      printf("\n--- | ");
-  
-      for (unsigned int i = first; i < last; i++)
-        printf("----------   ");
-      printf("\n");
-      
-      // determine maximum elements
-      vector<double> maxs;
-      for (unsigned int i = first; i < last; i++) {
-        double max = 0;
-        for (unsigned int j = 0; j < dim + constraints.size(); j++) {
-          double v = fabs(CS_eigVec(weakModeIdx[i], j));
-          if (v > max)
-            max = v;
-        }
-        maxs.push_back(max);
-      }
-  
-      for (unsigned int j = 0; j < dim + constraints.size(); j++) {
-        printf("%3u | ", j);
-        for (unsigned int i = first; i < last; i++) {
-          double v = CS_eigVec(weakModeIdx[i], j);
-          if (fabs(v)/maxs[i-first] > 1E-3)
-            printf("%+10.3E   ", v);
-          else
-            printf("         .   ");
-        }
-        printf("\n");
-      }
-
-      first = last;
-    }
-  } else
-    printf("\n* CS has no weak modes\n");
-
-  // check the regularity of C^T E
-  if (E.GetNcols() == C.GetNcols()) {
-    TMatrixD CTE(C, TMatrixD::kTransposeMult, E);
-    Print(CTE, "* CTE matrix:");
-    const double &det = CTE.Determinant();
-    printf("\n* det(CTE) = %E, max(CTE) = %E, det(CTE)/max(CTE) = %E\n\tmax(C) = %E, max(E) = %E, det(CTE)/max(C)/max(E) = %E\n",
-        det, CTE.Max(), det/CTE.Max(), C.Max(), E.Max(), det/C.Max()/E.Max());
-  } else
-    printf(">> JanAlignmentAlgorithm::Solve > WARNING: C matrix has %u, while E matrix %u columns.\n", C.GetNcols(), E.GetNcols());
+  // solve the constrained system by LDL^T (Bunch-Kaufman) decomposition
+  TDecompBK CS_bk(CS);
+  TMatrixDSym CSI_sym(CS.GetNrows());
+  bool solved = CS_bk.Decompose() && CS_bk.Invert(CSI_sym);
 
   // stop if CS is singular
-  if (singularModeCount > 0) {
-    LogProblem("JanAlignmentAlgorithm") << "\n>> JanAlignmentAlgorithm::Solve > ERROR: There are "
-      << singularModeCount << " singular modes in CS matrix.";
-    if (stopOnSingularModes)
-      return 1;
+  if (!solved) {
+    for (unsigned int i = 0; i < diagnostics.size(); i++)
+      diagnostics[i].join();
+
+    LogProblem("JanAlignmentAlgorithm") << "\n>> JanAlignmentAlgorithm::Solve > ERROR: The CS matrix is singular.";
+    return 1;
   }
 
-  // build MV vector
-  TVectorD MV(dim + constraints.size());
-  for (unsigned int i = 0; i < dim; i++)
-    MV[i] = M[i];
-  for (unsigned int i = 0; i < constraints.size(); i++)
-    MV[dim + i] = events*constraints[i].val;
-  
-  // perform inversion and solution
-  TMatrixD CSI(TMatrixD::kInverted, CS);
-  TMatrixD CS2I(TMatrixD::kInverted, CS2);
+  TMatrixD CSI(CSI_sym);
   TVectorD AL(MV);
   AL = CSI * MV;
 
   // evaluate error matrix
-  TMatrixD S0(S); // new parts full of zeros
-  S0.ResizeTo(dim + constraints.size(), dim + constraints.size());
-  TMatrixD EM(CS);
+  TMatrixD EM(CSI);
   EM = CSI * S0 * CSI;
-  
-  TMatrixD EM2(CS2);
-  EM2 = CS2I * S0 * CS2I;
 
-  TMatrixD EMdiff(EM2 - EM);
-  //Print(EMdiff, "EMdiff");
-  
-  double max1 = -1., max2 = -1., maxDiff = -1.;
-  for (int i = 0; i < EMdiff.GetNrows(); i++)
-    for (int j = 0; j < EMdiff.GetNcols(); j++) {
-      if (maxDiff < fabs(EMdiff(i, j)))
-        maxDiff = fabs(EMdiff(i, j));
-
-      if (max1 < fabs(EM(i, j)))
-        max1 = fabs(EM(i, j));
-      
-      if (max2 < fabs(EM2(i, j)))
-        max2 = fabs(EM2(i, j));
+  for (unsigned int i = 0; i < diagnostics.size(); i++)
+    diagnostics[i].join();
+
+  // regularity check without the eigen analysis: the smallest |eigenvalue| of CS is the inverse of the
+  // largest |eigenvalue| of CS^-1, estimated by power iteration; only a warning, the estimate converges
+  // from above (with the eigen analysis, the singular modes are counted exactly below)
+  if (!eigenAnalysis) {
+    TVectorD v(CSI_sym.GetNrows()), w(CSI_sym.GetNrows());
+    for (int i = 0; i < v.GetNrows(); i++)
+      v[i] = 1. + 1E-3 * i;
+    v *= 1. / sqrt(v.Norm2Sqr());
+
+    double maxInvEigenValue = 0.;
+    for (unsigned int it = 0; it < 100; it++) {
+      w = CSI_sym * v;
+      double norm = sqrt(w.Norm2Sqr());
+      if (norm == 0.)
+        break;
+      v = w;
+      v *= 1. / norm;
+
+      bool converged = (fabs(norm - maxInvEigenValue) < 1E-6 * norm);
+      maxInvEigenValue = norm;
+      if (converged)
+        break;
+    }
+
+    double minEigenValue = (maxInvEigenValue > 0.) ? 1. / maxInvEigenValue / accumulator.events : 0.;
+    if (minEigenValue < singularLimit)
+      LogProblem("JanAlignmentAlgorithm") << "\n>> JanAlignmentAlgorithm::Solve > WARNING: The CS matrix may be close to singular"
+        << " (estimated normalized smallest |eigenvalue| = " << minEigenValue << ").";
   }
 
-  printf("EM max = %E, EM2 max = %E, EM2 - EM max = %E\n", max1, max2, maxDiff);
+  // build E matrix (singular vectors of S as its columns)
+  TMatrixD E(S.GetNrows(), singularModes.size());
+  for (unsigned int i = 0; i < singularModes.size(); i++)
+    for (int j = 0; j < S.GetNrows(); j++)
+      E(j, i) = singularModes[i].vec[j];
 
-  // tests
-  TMatrixD &U = CS_eigVec;
-  TMatrixD UT(TMatrixD::kTransposed, U);
-  //TMatrixD CSEi(CS);
-  //CSEi = UT * CS * U;
-  //Print(CSEi, "CSEi");
+  if (eigenAnalysis) {
+    // check regularity of CS matrix
+    printf("\n* eigen values of CS and S matrices (events = %u)\n", accumulator.events);
+    printf("   #          CS    norm. CS               S     norm. S\n");
+    unsigned int singularModeCount = 0;
+    vector<unsigned int> weakModeIdx;
+    for (int i = 0; i < CS_eigVal.GetNrows(); i++) {
+
+      double CS_nev = CS_eigVal[i]/accumulator.events;
+      printf("%4i%+12.2E%+12.2E", i, CS_eigVal[i], CS_nev);
+      if (fabs(CS_nev) < singularLimit) {
+        singularModeCount++;
+        printf(" (S)");
+      } else
+        if (fabs(CS_nev) < weakLimit) {
+          weakModeIdx.push_back(i);
+          printf(" (W)");
+        } else {
+          printf("    ");
+        }
 
+      if (i < S_eigVal.GetNrows()) {
+        double S_nev = S_eigVal[i]/accumulator.events;
+        printf("%+12.2E%+12.2E", S_eigVal[i], S_nev);
+        if (fabs(S_nev) < singularLimit)
+          printf(" (S)");
+        else
+          if (fabs(S_nev) < weakLimit)
+            printf(" (W)");
+      }
 
-  TMatrixD EMEi(EM);
-  EMEi = UT * EM * U;
-  //Print(EMEi, "*EMEi"); 
+      printf("\n");
+    }
 
-  double max = -1.;
-  for (int i = 0; i < EMEi.GetNrows(); i++)
-    for (int j = 0; j < EMEi.GetNcols(); j++)
-      if (max < EMEi(i, j))
-        max = EMEi(i, j);
+    // print weak vectors
+    if (weakModeIdx.size() > 0) {
+      unsigned int columns = 10;
+      unsigned int first = 0;
+      
+      while (first < weakModeIdx.size()) {
+        unsigned int last = first + columns;
+        if (last >= weakModeIdx.size())
+          last = weakModeIdx.size();
+
+        printf("\n* CS weak modes\n    | ");
+        for (unsigned int i = first; i < last; i++)
+          printf("%+10.3E   ", CS_eigVal[weakModeIdx[i]]);
+        printf("\n--- | ");
+    
+        for (unsigned int i = first; i < last; i++)
+          printf("----------   ");
+        printf("\n");
+        
+        // determine maximum elements
+        vector<double> maxs;
+        for (unsigned int i = first; i < last; i++) {
+          double max = 0;
+          for (unsigned int j = 0; j < dim + constraints.size(); j++) {
+            double v = fabs(CS_eigVec(weakModeIdx[i], j));
+            if (v > max)
+              max = v;
+          }
+          maxs.push_back(max);
+        }
+    
+        for (unsigned int j = 0; j < dim + constraints.size(); j++) {
+          printf("%3u | ", j);
+          for (unsigned int i = first; i < last; i++) {
+            double v = CS_eigVec(weakModeIdx[i], j);
+            if (fabs(v)/maxs[i-first] > 1E-3)
+              printf("%+10.3E   ", v);
+            else
+              printf("         .   ");
+          }
+          printf("\n");
+        }
 
-  printf("max = %E\n", max);
-  
-  /*
-  double th = max / 100;
-  for (int i = 0; i < EMEi.GetNrows(); i++)
-    for (int j = 0; j < EMEi.GetNcols(); j++)
-      if (th < EMEi(i, j))
-        printf("element %u, %u: %E\n", i, j, EMEi(i, j));
-  */
+        first = last;
+      }
+    } else
+      printf("\n* CS has no weak modes\n");
+
+    // check the regularity of C^T E
+    if (E.GetNcols() == C.GetNcols()) {
+      TMatrixD CTE(C, TMatrixD::kTransposeMult, E);
+      Print(CTE, "* CTE matrix:");
+      const double &det = CTE.Determinant();
+      printf("\n* det(CTE) = %E, max(CTE) = %E, det(CTE)/max(CTE) = %E\n\tmax(C) = %E, max(E) = %E, det(CTE)/max(C)/max(E) = %E\n",
+          det, CTE.Max(), det/CTE.Max(), C.Max(), E.Max(), det/C.Max()/E.Max());
+    } else
+      printf(">> JanAlignmentAlgorithm::Solve > WARNING: C matrix has %u, while E matrix %u columns.\n", C.GetNcols(), E.GetNcols());
+
+    // stop if CS is singular
+    if (singularModeCount > 0) {
+      LogProblem("JanAlignmentAlgorithm") << "\n>> JanAlignmentAlgorithm::Solve > ERROR: There are "
+        << singularModeCount << " singular modes in CS matrix.";
+      if (stopOnSingularModes)
+        return 1;
+    }
+
+    // compare error matrices with differently scaled constraints
+    if (EM2.GetNrows() == EM.GetNrows()) {
+      TMatrixD EMdiff(EM2 - EM);
+      
+      double max1 = -1., max2 = -1., maxDiff = -1.;
+      for (int i = 0; i < EMdiff.GetNrows(); i++)
+        for (int j = 0; j < EMdiff.GetNcols(); j++) {
+          if (maxDiff < fabs(EMdiff(i, j)))
+            maxDiff = fabs(EMdiff(i, j));
+
+          if (max1 < fabs(EM(i, j)))
+            max1 = fabs(EM(i, j));
+          
+          if (max2 < fabs(EM2(i, j)))
+            max2 = fabs(EM2(i, j));
+      }
+
+      printf("EM max = %E, EM2 max = %E, EM2 - EM max = %E\n", max1, max2, maxDiff);
+    } else
+      printf(">> JanAlignmentAlgorithm::Solve > WARNING: CS matrix with scaled constraints is singular.\n");
+
+    // tests
+    TMatrixD &U = CS_eigVec;
+    TMatrixD UT(TMatrixD::kTransposed, U);
+    TMatrixD EMEi(EM);
+    EMEi = UT * EM * U;
+
+    double max = -1.;
+    for (int i = 0; i < EMEi.GetNrows(); i++)
+      for (int j = 0; j < EMEi.GetNcols(); j++)
+        if (max < EMEi(i, j))
+          max = EMEi(i, j);
+
+    printf("max = %E\n", max);
+  }
 
   // print lambda values
   printf("\n* Lambda (from the contribution of singular modes to MV)\n");
@@ -603,7 +725,7 @@ unsigned int JanAlignmentAlgorithm::Solve(const std::vector<AlignmentConstraint>
   vector<unsigned int> offsets;
   for (unsigned int i = 0; i < task->quantityClasses.size(); i++) {
     offsets.push_back(offset);
-    offset += Mc[i].GetNrows();
+    offset += accumulator.Mc[i].GetNrows();
   }
 
   for (AlignmentGeometry::const_iterator dit = task->geometry.begin(); dit != task->geometry.end(); ++dit) {
@@ -630,15 +752,16 @@ unsigned int JanAlignmentAlgorithm::Solve(const std::vector<AlignmentConstraint>
     dir->cd();
 
     S.Write("S");
-    S_eigVal.Write("S_eigen_values");
-    S_eigVec.Write("S_eigen_vectors");
- 
-    E.Write("E");
     C.Write("C");
-
     CS.Write("CS");
-    CS_eigVal.Write("CS_eigen_values");
-    CS_eigVec.Write("CS_eigen_vectors");
+
+    if (eigenAnalysis) {
+      S_eigVal.Write("S_eigen_values");
+      S_eigVec.Write("S_eigen_vectors");
+      E.Write("E");
+      CS_eigVal.Write("CS_eigen_values");
+      CS_eigVec.Write("CS_eigen_vectors");
+    }
 
     MV.Write("MV");
     AL.Write("AL");
@@ -655,12 +778,8 @@ unsigned int JanAlignmentAlgorithm::Solve(const std::vector<AlignmentConstraint>
 
 void JanAlignmentAlgorithm::End()
 {
-  delete [] Mc;
-
-  for (unsigned int i = 0; i < task->quantityClasses.size(); i++) {
-    delete [] Sc[i];
-  }
-  delete [] Sc;
+  // release M and S components
+  accumulator = JanAlignmentAccumulator();
 }
 
 //----------------------------------------------------------------------------------------------------
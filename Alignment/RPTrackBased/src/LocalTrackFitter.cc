@@ -12,10 +12,9 @@
 #include "DataFormats/TotemRPDetId/interface/TotemRPDetId.h"
 #include "Alignment/RPTrackBased/interface/LocalTrackFitter.h"
 
-#include <set>
+#include "Alignment/RPTrackBased/interface/MatrixTools.h"
 
-#include "TMatrixD.h"
-#include "TVectorD.h"
+#include <cmath>
 
 using namespace std;
 
@@ -36,167 +35,222 @@ bool LocalTrackFitter::Fit(HitCollection &selection, const AlignmentGeometry &ge
   if (verbosity > 5)
     printf(">> LocalTrackFitter::Fit\n");
 
+  BuildRows(selection, geometry);
+
+  bool fitFailed = false;
   bool selectionChanged = true;
   unsigned int loopCounter = 0;
-  while (selectionChanged) {
+  while (selectionChanged && !fitFailed) {
     // fit/outlier-removal loop
-    while (selectionChanged) {
+    while (selectionChanged && !fitFailed) {
       if (verbosity > 5)
         printf("* fit loop %u\n", loopCounter++);
 
-      bool fitFailed = false;
-      FitAndRemoveOutliers(selection, geometry, trackFit, fitFailed, selectionChanged);
+      FitAndRemoveOutliers(geometry.z0, trackFit, fitFailed, selectionChanged);
+    }
 
-      if (fitFailed) {
-        if (verbosity > 5)
-          printf("\tFIT FAILED\n");
-        return false;
-      }
+    if (fitFailed) {
+      if (verbosity > 5)
+        printf("\tFIT FAILED\n");
+      break;
     }
 
     // remove pots with too few active planes
     if (verbosity > 5)
       printf("* removing insufficient pots\n");
-    RemoveInsufficientPots(selection, selectionChanged);
+    RemoveInsufficientPots(selectionChanged);
   }
 
-  return true;
+  // drop the removed hits from the selection, keeping the order
+  unsigned int k = 0;
+  for (unsigned int j = 0; j < rows.size(); j++) {
+    if (rows[j].active && rpSums[rows[j].rp].active)
+      selection[k++] = selection[j];
+  }
+  selection.resize(k);
+
+  return !fitFailed;
 }
 
 //----------------------------------------------------------------------------------------------------
 
-void LocalTrackFitter::FitAndRemoveOutliers(HitCollection &selection, const AlignmentGeometry &geometry, 
-  LocalTrackFit &trackFit, bool &failed, bool &selectionChanged)
+void LocalTrackFitter::BuildRows(const HitCollection &selection, const AlignmentGeometry &geometry)
 {
-  if (verbosity > 5)
-    printf(">> LocalTrackFitter::FitAndRemoveOutliers\n");
-  
-  if (selection.empty()) {
-    failed = true;
-    return;
-  }
-  
-  TMatrixD A(selection.size(), 4);
-  TMatrixD Vi(selection.size(), selection.size());
-  TVectorD measVec(selection.size());
-  unsigned int j = 0;
-  for (HitCollection::iterator it = selection.begin(); it != selection.end(); ++it, ++j) {
-	unsigned int decId = it->id;
-
-    AlignmentGeometry::const_iterator dit = geometry.find(decId);
-    if (dit == geometry.end())
-    {
-      printf("ERROR in LocalTrackFitter::FitAndRemoveOutliers > detector %u not in geometry.\n", decId);
+  rows.resize(selection.size());
+  rpSums.clear();
+
+  for (unsigned int j = 0; j < selection.size(); j++) {
+    const Hit &hit = selection[j];
+    HitRow &r = rows[j];
+    r.id = hit.id;
+    r.isU = TotemRPDetId::isStripsCoordinateUDirection(hit.id);
+    r.active = true;
+    r.sigma = hit.sigma;
+
+    // RP index
+    unsigned int rpId = hit.id / 10;
+    for (r.rp = 0; r.rp < rpSums.size() && rpSums[r.rp].id != rpId; r.rp++) {}
+    if (r.rp == rpSums.size()) {
+      rpSums.resize(rpSums.size() + 1);
+      RPSums &rs = rpSums.back();
+      rs.id = rpId;
+      rs.active = true;
+      for (unsigned int i = 0; i < 16; i++)
+        rs.N[i] = 0.;
+      for (unsigned int i = 0; i < 4; i++)
+        rs.b[i] = 0.;
+    }
+
+    // a detector missing in the geometry gets a zero row (no influence on the fit)
+    const DetGeometry *dp = geometry.Get(hit.id);
+    if (!dp) {
+      printf("ERROR in LocalTrackFitter::BuildRows > detector %u not in geometry.\n", hit.id);
+      for (unsigned int i = 0; i < 4; i++)
+        r.a[i] = 0.;
+      r.m = 0.;
+      r.w = 0.;
       continue;
     }
 
-    const DetGeometry &d = dit->second;
+    const DetGeometry &d = *dp;
 
     if (verbosity > 5)
-      printf("\t%4u | %+9.3f  %+.4f  %+.4f | %+10.4f %+10.4f\n", decId, d.z, d.dx, d.dy, d.s, it->position);
+      printf("\t%4u | %+9.3f  %+.4f  %+.4f | %+10.4f %+10.4f\n", hit.id, d.z, d.dx, d.dy, d.s, hit.position);
 
-    A(j, 0) = d.z * d.dx;
-    A(j, 1) = d.dx;
-    A(j, 2) = d.z * d.dy;
-    A(j, 3) = d.dy;
+    r.a[0] = d.z * d.dx;
+    r.a[1] = d.dx;
+    r.a[2] = d.z * d.dy;
+    r.a[3] = d.dy;
+    r.m = hit.position + d.s;  // in mm
+    r.w = 1./hit.sigma/hit.sigma;
 
-    measVec(j) = it->position + d.s;  // in mm
+    UpdateSums(r, +1.);
+  }
+}
 
-    Vi(j, j) = 1./it->sigma/it->sigma;
+//----------------------------------------------------------------------------------------------------
+
+void LocalTrackFitter::UpdateSums(const HitRow &r, double sign)
+{
+  RPSums &rs = rpSums[r.rp];
+  double sw = sign * r.w;
+  for (unsigned int i = 0; i < 4; i++) {
+    double swa = sw * r.a[i];
+    for (unsigned int j = 0; j < 4; j++)
+      rs.N[4*i + j] += swa * r.a[j];
+    rs.b[i] += swa * r.m;
   }
-  //Print(A, "alpha");
+}
 
-  // evaluate local track parameter estimates (h ... like hat)
-  TMatrixD AT(4, selection.size());
-  AT.Transpose(A);
-  TMatrixD ATViA(4, 4);
-  ATViA = AT * Vi * A;
-  TMatrixD ATViAI(ATViA);
-  try {
-    ATViAI = ATViA.Invert();
+//----------------------------------------------------------------------------------------------------
+
+void LocalTrackFitter::FitAndRemoveOutliers(double z0, LocalTrackFit &trackFit, bool &failed, bool &selectionChanged)
+{
+  if (verbosity > 5)
+    printf(">> LocalTrackFitter::FitAndRemoveOutliers\n");
+
+  // normal equations of the active pots
+  double N[16] = { 0. }, b[4] = { 0. };
+  for (unsigned int p = 0; p < rpSums.size(); p++) {
+    if (!rpSums[p].active)
+      continue;
+    for (unsigned int i = 0; i < 16; i++)
+      N[i] += rpSums[p].N[i];
+    for (unsigned int i = 0; i < 4; i++)
+      b[i] += rpSums[p].b[i];
   }
-  catch (...) {
+
+  unsigned int activeHits = 0;
+  for (unsigned int j = 0; j < rows.size(); j++)
+    if (rows[j].active && rpSums[rows[j].rp].active)
+      activeHits++;
+
+  // evaluate local track parameter estimates (h ... like hat)
+  double Ni[16];
+  if (activeHits == 0 || !InvertSymmetric4x4(N, Ni)) {
     failed = true;
     return;
   }
-  TVectorD theta(4);
-  theta = ATViAI * AT * Vi * measVec;
 
-  // residuals
-  TVectorD R(measVec);
-  R -= A * theta;
+  double theta[4];
+  for (unsigned int i = 0; i < 4; i++) {
+    theta[i] = 0.;
+    for (unsigned int j = 0; j < 4; j++)
+      theta[i] += Ni[4*i + j] * b[j];
+  }
 
   // save results to trackFit
-  trackFit.ax = theta(0);
-  trackFit.bx = theta(1);
-  trackFit.ay = theta(2);
-  trackFit.by = theta(3);
-  trackFit.z0 = geometry.z0;
-  trackFit.ndf = selection.size() - 4;
+  trackFit.ax = theta[0];
+  trackFit.bx = theta[1];
+  trackFit.ay = theta[2];
+  trackFit.by = theta[3];
+  trackFit.z0 = z0;
+  trackFit.ndf = activeHits - 4;
   trackFit.chi_sq = 0;
-  for (int i = 0; i < R.GetNrows(); i++)
-    trackFit.chi_sq += R(i)*R(i)*Vi(i, i);
-  
-  if (verbosity > 5) {
-    printf("\tax = %.3f mrad\tbx = %.4f mm\tay = %.3f mrad\tby = %.4f mm\n", trackFit.ax*1E3, trackFit.bx, trackFit.ay*1E3, trackFit.by);
-    printf("\tndof = %i, chi^2/ndof/si^2 = %.3f\n", trackFit.ndf, trackFit.chi_sq / trackFit.ndf);
-  }
 
-  // check residuals
+  // residuals, chi^2 and outliers
   selectionChanged = false;
-  TVectorD interpolation(A * theta);
-  j = 0;
-  for (HitCollection::iterator it = selection.begin(); it != selection.end(); ++j) {
+  for (unsigned int j = 0; j < rows.size(); j++) {
+    HitRow &r = rows[j];
+    if (!r.active || !rpSums[r.rp].active)
+      continue;
+
+    double interpolation = r.a[0]*theta[0] + r.a[1]*theta[1] + r.a[2]*theta[2] + r.a[3]*theta[3];
+    double R = r.m - interpolation;
+    trackFit.chi_sq += R*R*r.w;
+
     if (verbosity > 5)
       printf("\t\t\t\t%2u, %4u: interpolation = %+8.1f um, R = %+6.1f um, R / sigma = %+6.2f\n", j, 
-        it->id, interpolation[j]*1E3, R[j]*1E3, R[j]/it->sigma);
+        r.id, interpolation*1E3, R*1E3, R/r.sigma);
 
-    double resToSigma = R[j] / it->sigma;
+    double resToSigma = R / r.sigma;
     if (fabs(resToSigma) > maxResidualToSigma) {
-      selection.erase(it);
+      r.active = false;
+      UpdateSums(r, -1.);
       selectionChanged = true;
       if (verbosity > 5)
         printf("\t\t\t\t\tRemoved\n");
-    } else
-      ++it;
-  } 
+    }
+  }
+
+  if (verbosity > 5) {
+    printf("\tax = %.3f mrad\tbx = %.4f mm\tay = %.3f mrad\tby = %.4f mm\n", trackFit.ax*1E3, trackFit.bx, trackFit.ay*1E3, trackFit.by);
+    printf("\tndof = %i, chi^2/ndof/si^2 = %.3f\n", trackFit.ndf, trackFit.chi_sq / trackFit.ndf);
+  }
 }
 
 //----------------------------------------------------------------------------------------------------
 
-void LocalTrackFitter::RemoveInsufficientPots(HitCollection &selection, bool &selectionChanged)
+void LocalTrackFitter::RemoveInsufficientPots(bool &selectionChanged)
 {
-  // map: rp id -> (active u planes, active v planes)
-  map<unsigned int, pair< set<unsigned int>, set<unsigned int> > > planeMap;
-  for (HitCollection::iterator it = selection.begin(); it != selection.end(); ++it) {
-    unsigned int decId = it->id;
-    unsigned int rpId = decId / 10;
-    if (TotemRPDetId::isStripsCoordinateUDirection(decId))
-      planeMap[rpId].first.insert(decId);
+  // active u and v planes (bit = plane number) per RP
+  for (unsigned int p = 0; p < rpSums.size(); p++) {
+    rpSums[p].uPlanes.reset();
+    rpSums[p].vPlanes.reset();
+  }
+
+  for (unsigned int j = 0; j < rows.size(); j++) {
+    const HitRow &r = rows[j];
+    if (!r.active)
+      continue;
+    if (r.isU)
+      rpSums[r.rp].uPlanes.set(r.id % 10);
     else
-      planeMap[rpId].second.insert(decId);
+      rpSums[r.rp].vPlanes.set(r.id % 10);
   }
 
   selectionChanged = false;
-  for (map<unsigned int, pair< set<unsigned int>, set<unsigned int> > >::iterator it = planeMap.begin();
-    it != planeMap.end(); ++it) {
-    if (it->second.first.size() < minimumHitsPerProjectionPerRP
-        || it->second.second.size() < minimumHitsPerProjectionPerRP) {
+  for (unsigned int p = 0; p < rpSums.size(); p++) {
+    if (!rpSums[p].active)
+      continue;
+
+    if (rpSums[p].uPlanes.count() < minimumHitsPerProjectionPerRP || rpSums[p].vPlanes.count() < minimumHitsPerProjectionPerRP) {
       if (verbosity > 5)
-        printf("\tRP %u: u=%lu, v=%lu\n", it->first, it->second.first.size(), it->second.second.size());
-      
+        printf("\tRP %u: u=%lu, v=%lu, removing\n", rpSums[p].id, rpSums[p].uPlanes.count(), rpSums[p].vPlanes.count());
+
       // remove all hits from that RP
-      for (HitCollection::iterator dit = selection.begin(); dit != selection.end();) {
-        if (it->first == dit->id/10) {
-          if (verbosity > 5)
-            printf("\t\tremoving %u\n", dit->id);
-          selection.erase(dit);
-          selectionChanged = true;
-        } else
-          dit++;
-      }
+      rpSums[p].active = false;
+      selectionChanged = true;
     }
   }
 }
-
-
@@ -55,3 +55,49 @@ void Print(TMatrixD& m, const char *label, bool mathematicaFormat)
   }
 }
 
+
+//----------------------------------------------------------------------------------------------------
+
+bool InvertSymmetric4x4(const double *N, double *Ni)
+{
+  // N = L L^T
+  double L[4][4] = { {0.} };
+  for (unsigned int i = 0; i < 4; i++) {
+    for (unsigned int j = 0; j <= i; j++) {
+      double s = N[4*i + j];
+      for (unsigned int k = 0; k < j; k++)
+        s -= L[i][k] * L[j][k];
+
+      if (i == j) {
+        if (!(s > 1E-12 * fabs(N[4*i + i])))
+          return false;
+        L[i][i] = sqrt(s);
+      } else
+        L[i][j] = s / L[j][j];
+    }
+  }
+
+  // LI = L^-1, lower triangular
+  double LI[4][4] = { {0.} };
+  for (unsigned int i = 0; i < 4; i++) {
+    LI[i][i] = 1. / L[i][i];
+    for (unsigned int j = 0; j < i; j++) {
+      double s = 0.;
+      for (unsigned int k = j; k < i; k++)
+        s -= L[i][k] * LI[k][j];
+      LI[i][j] = s / L[i][i];
+    }
+  }
+
+  // N^-1 = LI^T LI
+  for (unsigned int i = 0; i < 4; i++) {
+    for (unsigned int j = i; j < 4; j++) {
+      double s = 0.;
+      for (unsigned int k = j; k < 4; k++)
+        s += LI[k][i] * LI[k][j];
+      Ni[4*i + j] = Ni[4*j + i] = s;
+    }
+  }
+
+  return true;
+}
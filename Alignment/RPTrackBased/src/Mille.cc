@@ -7,31 +7,49 @@
 
 #include <fstream>
 #include <iostream>
+#include <cstring>
 
 //----------------------------------------------------------------------
 
-Mille::Mille(const char *outFileName, bool asBinary, bool writeZero) : 
-  myOutFile(outFileName, (asBinary ? (std::ios::binary | std::ios::out) : std::ios::out)),
-  myAsBinary(asBinary), myWriteZero(writeZero), myBufferPos(-1), myHasSpecial(false)
+Mille::Mille(const char *outFileName, bool asBinary, bool writeZero, bool compress, unsigned int blockSize) : 
+  myGzFile(NULL), myBlockSize(blockSize),
+  myAsBinary(asBinary || compress), myWriteZero(writeZero), myBufferPos(-1), myHasSpecial(false)
 {
+  // compressed output is always binary, fast compression level
+  if (compress) {
+    myGzFile = gzopen(outFileName, "wb1");
+    if (myGzFile == NULL)
+      std::cerr << "Mille::Mille: Could not open " << outFileName 
+	      << " as compressed output file." << std::endl;
+    else
+      gzbuffer(myGzFile, myBlockSize > (1 << 17) ? myBlockSize : (1 << 17));
+  } else {
+    myOutFile.open(outFileName, (asBinary ? (std::ios::binary | std::ios::out) : std::ios::out));
+    if (!myOutFile.is_open()) {
+      std::cerr << "Mille::Mille: Could not open " << outFileName 
+	      << " as output file." << std::endl;
+    }
+  }
+
+  myBlock.reserve(myBlockSize + (2*myBufferSize + 1) * sizeof(int));
 
   // Instead myBufferPos(-1), myHasSpecial(false) and the following two lines
   // we could call newSet() and kill()...
   myBufferInt[0]   = 0;
   myBufferFloat[0] = 0.;
-
-  if (!myOutFile.is_open()) {
-    std::cerr << "Mille::Mille: Could not open " << outFileName 
-	      << " as output file." << std::endl;
-  }
 }
 
 //----------------------------------------------------------------------
 
 Mille::~Mille()
 {
-  // closes file
-  myOutFile.close();
+  // writes the last block and closes file
+  flush();
+
+  if (myGzFile)
+    gzclose(myGzFile);
+  else
+    myOutFile.close();
 }
 
 //----------------------------------------------------------------------
@@ -129,12 +147,18 @@ void Mille::end()
     const int numWordsToWrite = (myBufferPos + 1)*2;
 
     if (myAsBinary) {
-      myOutFile.write(reinterpret_cast<const char*>(&numWordsToWrite), 
-		      sizeof(numWordsToWrite));
-      myOutFile.write(reinterpret_cast<char*>(myBufferFloat), 
-		      (myBufferPos+1) * sizeof(myBufferFloat[0]));
-      myOutFile.write(reinterpret_cast<char*>(myBufferInt), 
-		      (myBufferPos+1) * sizeof(myBufferInt[0]));
+      // append the record to the block: word count, floats, ints
+      const unsigned int floatBytes = (myBufferPos+1) * sizeof(myBufferFloat[0]);
+      const unsigned int intBytes = (myBufferPos+1) * sizeof(myBufferInt[0]);
+      const unsigned int offset = myBlock.size();
+      myBlock.resize(offset + sizeof(numWordsToWrite) + floatBytes + intBytes);
+      char *p = &myBlock[offset];
+      memcpy(p, &numWordsToWrite, sizeof(numWordsToWrite));
+      memcpy(p + sizeof(numWordsToWrite), myBufferFloat, floatBytes);
+      memcpy(p + sizeof(numWordsToWrite) + floatBytes, myBufferInt, intBytes);
+
+      if (myBlock.size() >= myBlockSize)
+	flush();
     } else {
       myOutFile << numWordsToWrite << "\n";
       for (int i = 0; i < myBufferPos+1; ++i) {
@@ -153,6 +177,22 @@ void Mille::end()
 
 //----------------------------------------------------------------------
 
+void Mille::flush()
+{
+  if (myBlock.empty()) return;
+
+  if (myGzFile) {
+    if (gzwrite(myGzFile, &myBlock[0], myBlock.size()) != (int) myBlock.size())
+      std::cerr << "Mille::flush: Error writing compressed block." << std::endl;
+  } else {
+    myOutFile.write(&myBlock[0], myBlock.size());
+  }
+
+  myBlock.clear();
+}
+
+//----------------------------------------------------------------------
+
 void Mille::newSet()
 {
   // initilise for new set of locals, e.g. new track
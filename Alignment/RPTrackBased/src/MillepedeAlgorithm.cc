@@ -25,6 +25,10 @@ MillepedeAlgorithm::MillepedeAlgorithm(const edm::ParameterSet& ps, AlignmentTas
   workingDir(ps.getParameterSet("MillepedeAlgorithm").getParameter<string>("workingDir")),
   mille(NULL)
 {
+  const ParameterSet &lps = ps.getParameterSet("MillepedeAlgorithm");
+  compressInput = lps.getParameter<bool>("compressInput");
+  blockSize = lps.getParameter<unsigned int>("blockSize");
+
   if (task->resolveRPShZ)
     throw cms::Exception("MillepedeAlgorithm::MillepedeAlgorithm") << "RP shifts in z not yet implemented";
 }
@@ -39,8 +43,16 @@ MillepedeAlgorithm::~MillepedeAlgorithm()
 
 void MillepedeAlgorithm::Begin(const edm::EventSetup&)
 {
-  string dataFile = workingDir + "/mp.input";
-   mille = new Mille(dataFile.c_str());
+  BeginStandalone();
+}
+
+//----------------------------------------------------------------------------------------------------
+
+bool MillepedeAlgorithm::BeginStandalone()
+{
+  string dataFile = workingDir + "/" + InputFileName();
+  mille = new Mille(dataFile.c_str(), true, false, compressInput, blockSize);
+  return true;
 }
 
 //----------------------------------------------------------------------------------------------------
@@ -59,7 +71,10 @@ void MillepedeAlgorithm::Feed(const HitCollection &selection, const LocalTrackFi
 
   for (HitCollection::const_iterator it = selection.begin(); it != selection.end(); ++it) {
     unsigned int id = it->id;
-    DetGeometry &d = task->geometry[id];
+    const DetGeometry *dp = task->geometry.Get(id);
+    if (!dp)
+      continue;
+    const DetGeometry &d = *dp;
 
     double hx = hax * d.z + hbx;  // in mm
     double hy = hay * d.z + hby;
@@ -121,7 +136,7 @@ unsigned int MillepedeAlgorithm::Solve(const std::vector<AlignmentConstraint> &c
   FILE *f;
   f = fopen("mp.steer", "w");
   fprintf(f, "Cfiles\n");
-  fprintf(f, "mp.input\n\n");
+  fprintf(f, "%s\n\n", InputFileName().c_str());
 
   for (unsigned int i = 0; i < constraints.size(); ++i) {
     fprintf(f, "Constraint %E\n", constraints[i].val);
@@ -27,12 +27,18 @@
 #include <unordered_set>
 #include <vector>
 #include <string>
+#include <memory>
+#include <cstring>
+#include <cstdlib>
 
 #include "TDecompLU.h"
 #include "TH1D.h"
 #include "TFile.h"
 #include "TGraph.h"
 #include "TCanvas.h"
+#include "TTree.h"
+#include "TKey.h"
+#include "TROOT.h"
   
 //#define DEBUG
 
@@ -58,6 +64,64 @@ StraightTrackAlignment::ChiSqHistograms::ChiSqHistograms(const string &name)
 
 //----------------------------------------------------------------------------------------------------
 
+void StraightTrackAlignment::ChiSqHistograms::Write() const
+{
+  lin_fitted->Write("lin_fitted");
+  log_fitted->Write("log_fitted");
+  lin_selected->Write("lin_selected");
+  log_selected->Write("log_selected");
+}
+
+//----------------------------------------------------------------------------------------------------
+
+/// adds the histogram saved under the given key, if present
+/// (the histograms read are owned by the file)
+static void AddHistogram(TH1 *h, TDirectory *dir, const char *key)
+{
+  TH1 *s = (TH1 *) dir->Get(key);
+  if (s)
+    h->Add(s);
+}
+
+//----------------------------------------------------------------------------------------------------
+
+/// writes a set of RPs to the current directory, as a vector of RP ids
+static void WriteRPSet(const set<unsigned int> &rps)
+{
+  TVectorD v(rps.size());
+  unsigned int i = 0;
+  for (set<unsigned int>::const_iterator it = rps.begin(); it != rps.end(); ++it, ++i)
+    v[i] = *it;
+  v.Write("rps");
+}
+
+//----------------------------------------------------------------------------------------------------
+
+/// reads a set of RPs written by WriteRPSet
+static set<unsigned int> ReadRPSet(TDirectory *dir)
+{
+  set<unsigned int> rps;
+  TVectorD *v = (TVectorD *) dir->Get("rps");
+  if (v) {
+    for (int i = 0; i < v->GetNrows(); i++)
+      rps.insert((unsigned int) (*v)[i]);
+    delete v;
+  }
+  return rps;
+}
+
+//----------------------------------------------------------------------------------------------------
+
+void StraightTrackAlignment::ChiSqHistograms::Add(TDirectory *dir)
+{
+  AddHistogram(lin_fitted, dir, "lin_fitted");
+  AddHistogram(log_fitted, dir, "log_fitted");
+  AddHistogram(lin_selected, dir, "lin_selected");
+  AddHistogram(log_selected, dir, "log_selected");
+}
+
+//----------------------------------------------------------------------------------------------------
+
 TGraph* NewGraph(const string &name, const string &title)
 {
   TGraph *g = new TGraph();
@@ -99,12 +163,17 @@ StraightTrackAlignment::StraightTrackAlignment(const ParameterSet& ps) :
   saveIntermediateResults(ps.getParameter<bool>("saveIntermediateResults")),
   taskDataFileName(ps.getParameter<string>("taskDataFileName")),
   taskDataFile(NULL),
+  stateFileName(ps.exists("stateFileName") ? ps.getParameter<string>("stateFileName") : ""),
+  solveAtEndOfJob(ps.exists("solveAtEndOfJob") ? ps.getParameter<bool>("solveAtEndOfJob") : true),
 
   task(ps),
   fitter(ps),
 
   buildDiagnosticPlots(ps.getParameter<bool>("buildDiagnosticPlots")),
   diagnosticsFile(ps.getParameter<string>("diagnosticsFile")),
+  eventsTotal(0),
+  eventsFitted(0),
+  eventsSelected(0),
   fitNdfHist_fitted(new TH1D("ndf_fitted", ";ndf;", 41, -4.5, 36.5)),
   fitNdfHist_selected(new TH1D("ndf_selected", ";ndf;", 41, -4.5, 36.5)),
   fitPHist_fitted(new TH1D("p_fitted", ";p value;", 100, 0., 1.)),
@@ -268,19 +337,64 @@ void StraightTrackAlignment::Begin(const EventSetup &es)
 
 //----------------------------------------------------------------------------------------------------
 
-void StraightTrackAlignment::ProcessEvent(const Event& event, const EventSetup&)
+void StraightTrackAlignment::ProcessEvent(const Event& event, const EventSetup&,
+  const EDGetTokenT< DetSetVector<TotemRPUVPattern> > &patternsToken, const EDGetTokenT<LocalTrackFit> &externalFitToken)
 {
   if (verbosity > 9)
     printf("\n---------- StraightTrackAlignment::ProcessEvent > event %llu\n", event.id().event());
+
+  HitCollection selection;
+  LocalTrackFit trackFit, extTrackFit;
+  set<unsigned int> selectedRPs;
+  SelectionResult result = SelectTrack(event, patternsToken, externalFitToken, fitter, selection, trackFit,
+    extTrackFit, selectedRPs);
+
+  eventsTotal++;
+
+  if (result == srNoHits || result == srFitFailed)
+    return;
+
+  eventsFitted++;
+  fittedTracksPerRPSet[selectedRPs]++;
+
+  bool selected = (result == srSelected);
+
+  UpdateDiagnosticHistograms(selection, selectedRPs, trackFit, selected);
+
+  if (verbosity > 5)
+    printf("* SELECTED: %u\n", selected);
+
+  if (!selected)
+    return;
+  
+  eventsSelected++;
+  selectedTracksPerRPSet[selectedRPs]++;
   
+  // -------------------- STEP 4: FEED ALGORITHMS
+
+  for (vector<AlignmentAlgorithm *>::iterator it = algorithms.begin(); it != algorithms.end(); ++it)
+    (*it)->Feed(selection, trackFit, extTrackFit);
+
+  // -------------------- STEP 5: ENOUGH TRACKS?
+
+  if (eventsSelected == maxEvents)
+      throw "Number of tracks processed reached maximum";
+}
+
+//----------------------------------------------------------------------------------------------------
+
+StraightTrackAlignment::SelectionResult StraightTrackAlignment::SelectTrack(const Event& event,
+  const EDGetTokenT< DetSetVector<TotemRPUVPattern> > &patternsToken, const EDGetTokenT<LocalTrackFit> &externalFitToken,
+  LocalTrackFitter &trackFitter, HitCollection &selection, LocalTrackFit &trackFit, LocalTrackFit &extTrackFit,
+  set<unsigned int> &selectedRPs) const
+{
   // -------------------- STEP 1: get hits from selected RPs
   Handle< DetSetVector<TotemRPUVPattern> > patterns;
-  event.getByLabel(tagRecognizedPatterns, patterns);
+  event.getByToken(patternsToken, patterns);
 
   bool skipHorRP = ( find(runsWithoutHorizontalRPs.begin(), runsWithoutHorizontalRPs.end(),
     event.id().run()/10000) != runsWithoutHorizontalRPs.end() );
 
-  HitCollection selection;
   for (auto &ds : *patterns)
   {
     unsigned int rpId = ds.detId();
@@ -330,32 +444,23 @@ void StraightTrackAlignment::ProcessEvent(const Event& event, const EventSetup&)
           selection.push_back(h);
   }
 
-  eventsTotal++;
-
   if (selection.empty())
-    return;
+    return srNoHits;
 
   // -------------------- STEP 2: fit + outlier rejection
 
-  LocalTrackFit trackFit;
-  if (! fitter.Fit(selection, task.geometry, trackFit))
-     return;
+  if (! trackFitter.Fit(selection, task.geometry, trackFit))
+     return srFitFailed;
 
-  LocalTrackFit extTrackFit;
   if (useExternalFitter) {
     Handle< LocalTrackFit > hTrackFit;
-    vector< Handle< LocalTrackFit> > hTrackFitList;
-    event.getByLabel(tagExternalFit, hTrackFit);
+    event.getByToken(externalFitToken, hTrackFit);
     extTrackFit = *hTrackFit;
   }
   
-  set<unsigned int> selectedRPs;
   for (const auto &hit : selection)
     selectedRPs.insert(hit.id/10);
 
-  eventsFitted++;
-  fittedTracksPerRPSet[selectedRPs]++;
-
   // -------------------- STEP 3: quality checks
 
   bool top = false, bottom = false, horizontal = false;
@@ -392,26 +497,7 @@ void StraightTrackAlignment::ProcessEvent(const Event& event, const EventSetup&)
   if (cutOnChiSqPerNdf && trackFit.ChiSqPerNdf() > chiSqPerNdfCut)
     selected = false;
 
-  UpdateDiagnosticHistograms(selection, selectedRPs, trackFit, selected);
-
-  if (verbosity > 5)
-    printf("* SELECTED: %u\n", selected);
-
-  if (!selected)
-    return;
-  
-  eventsSelected++;
-  selectedTracksPerRPSet[selectedRPs]++;
-  
-  // -------------------- STEP 4: FEED ALGORITHMS
-
-  for (vector<AlignmentAlgorithm *>::iterator it = algorithms.begin(); it != algorithms.end(); ++it)
-    (*it)->Feed(selection, trackFit, extTrackFit);
-
-  // -------------------- STEP 5: ENOUGH TRACKS?
-
-  if (eventsSelected == maxEvents)
-      throw "Number of tracks processed reached maximum";
+  return (selected) ? srSelected : srRejected;
 }
 
 //----------------------------------------------------------------------------------------------------
@@ -446,23 +532,21 @@ void StraightTrackAlignment::UpdateDiagnosticHistograms(const HitCollection &sel
     chiSqHists.log_selected->Fill(log10(trackFit.ChiSqPerNdf()));
   }
 
-  map< set<unsigned int>, ChiSqHistograms >::iterator it = chiSqHists_perRP.find(selectedRPs);
-  if (it == chiSqHists_perRP.end())
-    it = chiSqHists_perRP.insert(pair< set<unsigned int>, ChiSqHistograms >(selectedRPs, ChiSqHistograms(SetToString(selectedRPs)))).first;
-  it->second.lin_fitted->Fill(trackFit.ChiSqPerNdf());
-  it->second.log_fitted->Fill(log10(trackFit.ChiSqPerNdf()));
+  ChiSqHistograms &rpSetChiSqHists = GetChiSqHistograms(selectedRPs);
+  rpSetChiSqHists.lin_fitted->Fill(trackFit.ChiSqPerNdf());
+  rpSetChiSqHists.log_fitted->Fill(log10(trackFit.ChiSqPerNdf()));
   if (trackSelected) { 
-    it->second.lin_selected->Fill(trackFit.ChiSqPerNdf());
-    it->second.log_selected->Fill(log10(trackFit.ChiSqPerNdf()));
+    rpSetChiSqHists.lin_selected->Fill(trackFit.ChiSqPerNdf());
+    rpSetChiSqHists.log_selected->Fill(log10(trackFit.ChiSqPerNdf()));
   }
   
   for (HitCollection::const_iterator hitCollectionIterator = selection.begin(); hitCollectionIterator != selection.end(); ++hitCollectionIterator) {
     unsigned int id = hitCollectionIterator->id;
 
-    AlignmentGeometry::iterator dit = task.geometry.find(id);
-    if (dit == task.geometry.end())
+    const DetGeometry *dp = task.geometry.Get(id);
+    if (!dp)
       continue;
-    DetGeometry &d = dit->second;
+    const DetGeometry &d = *dp;
 
     double m = hitCollectionIterator->position + d.s;
     double x = trackFit.ax * d.z + trackFit.bx;
@@ -470,44 +554,61 @@ void StraightTrackAlignment::UpdateDiagnosticHistograms(const HitCollection &sel
     double f = x*d.dx + y*d.dy;
     double R = m - f;
 
-    map<unsigned int, ResiduaHistogramSet>::iterator it = residuaHistograms.find(id);
-    if (it == residuaHistograms.end()) {
-      it = residuaHistograms.insert(pair<unsigned int, ResiduaHistogramSet>(id, ResiduaHistogramSet())).first;
-      char buf[30];
-      sprintf(buf, "%u: total_fitted", id); it->second.total_fitted = NewResiduaHist(buf);
-      sprintf(buf, "%u: total_selected", id); it->second.total_selected = NewResiduaHist(buf);
-      it->second.selected_vs_chiSq = new TGraph();
-      sprintf(buf, "%u: selected_vs_chiSq", id);
-      it->second.selected_vs_chiSq->SetName(buf);
-    }
-    it->second.total_fitted->Fill(R);
+    ResiduaHistogramSet &rhs = GetResiduaHistogramSet(id);
+    rhs.total_fitted->Fill(R);
     if (trackSelected) {
-      it->second.total_selected->Fill(R);
-      it->second.selected_vs_chiSq->SetPoint(it->second.selected_vs_chiSq->GetN(), trackFit.ChiSqPerNdf(), R);
+      rhs.total_selected->Fill(R);
+      rhs.selected_vs_chiSq->SetPoint(rhs.selected_vs_chiSq->GetN(), trackFit.ChiSqPerNdf(), R);
     }
 
-    map< set<unsigned int>, TH1D* >::iterator sit = it->second.perRPSet_fitted.find(selectedRPs);
-    if (sit == it->second.perRPSet_fitted.end()) {
-      char buf[10];
-      sprintf(buf, "%u: ", id);
-      string label = buf;
-      label += SetToString(selectedRPs);
-      sit = it->second.perRPSet_fitted.insert(pair< set<unsigned int>, TH1D* >(selectedRPs, NewResiduaHist(label.c_str()))).first;
-    }
-    sit->second->Fill(R);
+    GetPerRPSetResiduaHist(rhs.perRPSet_fitted, id, selectedRPs)->Fill(R);
     
-    if (trackSelected) {
-      sit = it->second.perRPSet_selected.find(selectedRPs);
-      if (sit == it->second.perRPSet_selected.end()) {
-        char buf[10];
-        sprintf(buf, "%u: ", id);
-        string label = buf;
-        label += SetToString(selectedRPs);
-        sit = it->second.perRPSet_selected.insert(pair< set<unsigned int>, TH1D* >(selectedRPs, NewResiduaHist(label.c_str()))).first;
-      }
-      sit->second->Fill(R);
-    }
+    if (trackSelected)
+      GetPerRPSetResiduaHist(rhs.perRPSet_selected, id, selectedRPs)->Fill(R);
+  }
+}
+
+//----------------------------------------------------------------------------------------------------
+
+StraightTrackAlignment::ChiSqHistograms& StraightTrackAlignment::GetChiSqHistograms(const set<unsigned int> &rps)
+{
+  map< set<unsigned int>, ChiSqHistograms >::iterator it = chiSqHists_perRP.find(rps);
+  if (it == chiSqHists_perRP.end())
+    it = chiSqHists_perRP.insert(pair< set<unsigned int>, ChiSqHistograms >(rps, ChiSqHistograms(SetToString(rps)))).first;
+  return it->second;
+}
+
+//----------------------------------------------------------------------------------------------------
+
+StraightTrackAlignment::ResiduaHistogramSet& StraightTrackAlignment::GetResiduaHistogramSet(unsigned int id)
+{
+  map<unsigned int, ResiduaHistogramSet>::iterator it = residuaHistograms.find(id);
+  if (it == residuaHistograms.end()) {
+    it = residuaHistograms.insert(pair<unsigned int, ResiduaHistogramSet>(id, ResiduaHistogramSet())).first;
+    char buf[30];
+    sprintf(buf, "%u: total_fitted", id); it->second.total_fitted = NewResiduaHist(buf);
+    sprintf(buf, "%u: total_selected", id); it->second.total_selected = NewResiduaHist(buf);
+    it->second.selected_vs_chiSq = new TGraph();
+    sprintf(buf, "%u: selected_vs_chiSq", id);
+    it->second.selected_vs_chiSq->SetName(buf);
+  }
+  return it->second;
+}
+
+//----------------------------------------------------------------------------------------------------
+
+TH1D* StraightTrackAlignment::GetPerRPSetResiduaHist(map< set<unsigned int>, TH1D* > &hists, unsigned int id,
+  const set<unsigned int> &rps)
+{
+  map< set<unsigned int>, TH1D* >::iterator it = hists.find(rps);
+  if (it == hists.end()) {
+    char buf[10];
+    sprintf(buf, "%u: ", id);
+    string label = buf;
+    label += SetToString(rps);
+    it = hists.insert(pair< set<unsigned int>, TH1D* >(rps, NewResiduaHist(label.c_str()))).first;
   }
+  return it->second;
 }
 
 //----------------------------------------------------------------------------------------------------
@@ -557,6 +658,16 @@ void StraightTrackAlignment::Finish()
   // write diagnostics plots
   SaveDiagnostics();
 
+  // save the collected data, e.g. to be merged with the data of other jobs
+  if (!stateFileName.empty())
+    SaveState(stateFileName);
+
+  if (!solveAtEndOfJob) {
+    for (vector<AlignmentAlgorithm *>::iterator it = algorithms.begin(); it != algorithms.end(); ++it)
+      (*it)->End();
+    return;
+  }
+
   // run analysis
   for (vector<AlignmentAlgorithm *>::iterator it = algorithms.begin(); it != algorithms.end(); ++it)
     (*it)->Analyze();
@@ -880,3 +991,350 @@ void StraightTrackAlignment::SaveDiagnostics() const
   delete df;
 }
 
+//----------------------------------------------------------------------------------------------------
+
+vector<TH1D *> StraightTrackAlignment::CommonHistograms() const
+{
+  vector<TH1D *> hists = {
+    fitNdfHist_fitted, fitNdfHist_selected, fitPHist_fitted, fitPHist_selected,
+    fitAxHist_fitted, fitAxHist_selected, fitAyHist_fitted, fitAyHist_selected,
+    fitBxHist_fitted, fitBxHist_selected, fitByHist_fitted, fitByHist_selected
+  };
+  return hists;
+}
+
+//----------------------------------------------------------------------------------------------------
+
+vector<TGraph *> StraightTrackAlignment::CommonGraphs() const
+{
+  vector<TGraph *> graphs = {
+    fitAxVsAyGraph_fitted, fitAxVsAyGraph_selected, fitBxVsByGraph_fitted, fitBxVsByGraph_selected
+  };
+  return graphs;
+}
+
+//----------------------------------------------------------------------------------------------------
+
+void StraightTrackAlignment::SaveDiagnosticsState(TDirectory *dir) const
+{
+  char buf[30];
+
+  dir->cd();
+  for (TH1D *h : CommonHistograms())
+    h->Write();
+  for (TGraph *g : CommonGraphs())
+    g->Write();
+
+  dir->mkdir("chiSq")->cd();
+  chiSqHists.Write();
+
+  // per RP set objects: one directory per set, the set is saved as a vector of RP ids
+  TDirectory *chiDir = dir->mkdir("chiSq per RP set");
+  unsigned int idx = 0;
+  for (map< set<unsigned int>, ChiSqHistograms >::const_iterator it = chiSqHists_perRP.begin();
+      it != chiSqHists_perRP.end(); ++it, ++idx) {
+    sprintf(buf, "%u", idx);
+    chiDir->mkdir(buf)->cd();
+    WriteRPSet(it->first);
+    it->second.Write();
+  }
+
+  TDirectory *resDir = dir->mkdir("residuals");
+  for (map<unsigned int, ResiduaHistogramSet>::const_iterator it = residuaHistograms.begin(); it != residuaHistograms.end(); ++it) {
+    sprintf(buf, "%u", it->first);
+    TDirectory *detDir = resDir->mkdir(buf);
+    detDir->cd();
+    it->second.total_fitted->Write("total_fitted");
+    it->second.total_selected->Write("total_selected");
+    it->second.selected_vs_chiSq->Write("selected_vs_chiSq");
+
+    const map< set<unsigned int>, TH1D* > *perRPSet[2] = { &it->second.perRPSet_fitted, &it->second.perRPSet_selected };
+    const char *perRPSetNames[2] = { "fitted per RP set", "selected per RP set" };
+    for (unsigned int i = 0; i < 2; i++) {
+      TDirectory *setsDir = detDir->mkdir(perRPSetNames[i]);
+      idx = 0;
+      for (map< set<unsigned int>, TH1D* >::const_iterator sit = perRPSet[i]->begin(); sit != perRPSet[i]->end(); ++sit, ++idx) {
+        sprintf(buf, "%u", idx);
+        setsDir->mkdir(buf)->cd();
+        WriteRPSet(sit->first);
+        sit->second->Write("h");
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------
+
+void StraightTrackAlignment::LoadDiagnosticsState(TDirectory *dir)
+{
+  for (TH1D *h : CommonHistograms())
+    AddHistogram(h, dir, h->GetName());
+  for (TGraph *g : CommonGraphs())
+    AppendGraphPoints(g, dir, g->GetName());
+
+  TDirectory *chiGlobalDir = dir->GetDirectory("chiSq");
+  if (chiGlobalDir)
+    chiSqHists.Add(chiGlobalDir);
+
+  TDirectory *chiDir = dir->GetDirectory("chiSq per RP set");
+  if (chiDir) {
+    TIter next(chiDir->GetListOfKeys());
+    while (TKey *key = (TKey *) next()) {
+      TDirectory *setDir = chiDir->GetDirectory(key->GetName());
+      GetChiSqHistograms(ReadRPSet(setDir)).Add(setDir);
+    }
+  }
+
+  TDirectory *resDir = dir->GetDirectory("residuals");
+  if (!resDir)
+    return;
+
+  TIter next(resDir->GetListOfKeys());
+  while (TKey *key = (TKey *) next()) {
+    unsigned int id = atoi(key->GetName());
+    TDirectory *detDir = resDir->GetDirectory(key->GetName());
+
+    ResiduaHistogramSet &rhs = GetResiduaHistogramSet(id);
+    AddHistogram(rhs.total_fitted, detDir, "total_fitted");
+    AddHistogram(rhs.total_selected, detDir, "total_selected");
+    AppendGraphPoints(rhs.selected_vs_chiSq, detDir, "selected_vs_chiSq");
+
+    map< set<unsigned int>, TH1D* > *perRPSet[2] = { &rhs.perRPSet_fitted, &rhs.perRPSet_selected };
+    const char *perRPSetNames[2] = { "fitted per RP set", "selected per RP set" };
+    for (unsigned int i = 0; i < 2; i++) {
+      TDirectory *setsDir = detDir->GetDirectory(perRPSetNames[i]);
+      if (!setsDir)
+        continue;
+
+      TIter nextSet(setsDir->GetListOfKeys());
+      while (TKey *setKey = (TKey *) nextSet()) {
+        TDirectory *setDir = setsDir->GetDirectory(setKey->GetName());
+        AddHistogram(GetPerRPSetResiduaHist(*perRPSet[i], id, ReadRPSet(setDir)), setDir, "h");
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------
+
+void StraightTrackAlignment::SaveState(const string &fileName)
+{
+  printf(">> StraightTrackAlignment::SaveState > %s\n", fileName.c_str());
+
+  // closed (and deleted) also when an exception is thrown
+  unique_ptr<TFile> sf(new TFile(fileName.c_str(), "recreate"));
+  if (sf->IsZombie())
+    throw cms::Exception("StraightTrackAlignment::SaveState") << "Cannot open file `" << 
+      fileName << "' for writing.";
+
+  // alignment geometry
+  TTree *geometryTree = new TTree("geometry", "alignment geometry");
+  unsigned int id;
+  DetGeometry d;
+  geometryTree->Branch("id", &id, "id/i");
+  geometryTree->Branch("z", &d.z, "z/D");
+  geometryTree->Branch("dx", &d.dx, "dx/D");
+  geometryTree->Branch("dy", &d.dy, "dy/D");
+  geometryTree->Branch("sx", &d.sx, "sx/D");
+  geometryTree->Branch("sy", &d.sy, "sy/D");
+  geometryTree->Branch("matrixIndex", &d.matrixIndex, "matrixIndex/i");
+  geometryTree->Branch("rpMatrixIndex", &d.rpMatrixIndex, "rpMatrixIndex/i");
+  geometryTree->Branch("isU", &d.isU, "isU/O");
+  for (AlignmentGeometry::const_iterator it = task.geometry.begin(); it != task.geometry.end(); ++it) {
+    id = it->first;
+    d = it->second;
+    geometryTree->Fill();
+  }
+  geometryTree->Write();
+
+  TVectorD geometryZ0(1);
+  geometryZ0[0] = task.geometry.z0;
+  geometryZ0.Write("z0");
+
+  // initial alignments, level 0 for RP and 1 for sensor corrections
+  TTree *alignmentTree = new TTree("initialAlignments", "alignments before this iteration");
+  unsigned int level;
+  double v[10];
+  alignmentTree->Branch("level", &level, "level/i");
+  alignmentTree->Branch("id", &id, "id/i");
+  alignmentTree->Branch("values", v, "sh_r/D:sh_r_e:sh_x:sh_x_e:sh_y:sh_y_e:sh_z:sh_z_e:rot_z:rot_z_e");
+  const RPAlignmentCorrectionsData::mapType *alignmentMaps[2] = { &initialAlignments.GetRPMap(),
+    &initialAlignments.GetSensorMap() };
+  for (level = 0; level < 2; level++) {
+    for (RPAlignmentCorrectionsData::mapType::const_iterator it = alignmentMaps[level]->begin();
+        it != alignmentMaps[level]->end(); ++it) {
+      const RPAlignmentCorrectionData &ac = it->second;
+      id = it->first;
+      v[0] = ac.sh_r(); v[1] = ac.sh_r_e();
+      v[2] = ac.sh_x(); v[3] = ac.sh_x_e();
+      v[4] = ac.sh_y(); v[5] = ac.sh_y_e();
+      v[6] = ac.sh_z(); v[7] = ac.sh_z_e();
+      v[8] = ac.rot_z(); v[9] = ac.rot_z_e();
+      alignmentTree->Fill();
+    }
+  }
+  alignmentTree->Write();
+
+  // event counters
+  sf->cd();
+  TVectorD counters(3);
+  counters[0] = eventsTotal;
+  counters[1] = eventsFitted;
+  counters[2] = eventsSelected;
+  counters.Write("counters");
+
+  TDirectory *rpSetDir = sf->mkdir("tracksPerRPSet");
+  unsigned int idx = 0;
+  for (map< set<unsigned int>, unsigned long >::const_iterator it = fittedTracksPerRPSet.begin();
+      it != fittedTracksPerRPSet.end(); ++it, ++idx) {
+    char buf[10];
+    sprintf(buf, "%u", idx);
+    rpSetDir->mkdir(buf)->cd();
+    WriteRPSet(it->first);
+
+    map< set<unsigned int>, unsigned long >::const_iterator sit = selectedTracksPerRPSet.find(it->first);
+    TVectorD tracks(2);
+    tracks[0] = it->second;
+    tracks[1] = (sit == selectedTracksPerRPSet.end()) ? 0 : sit->second;
+    tracks.Write("tracks");
+  }
+
+  // diagnostic plots
+  if (buildDiagnosticPlots)
+    SaveDiagnosticsState(sf->mkdir("diagnostics"));
+
+  // data of algorithms
+  for (vector<AlignmentAlgorithm *>::iterator it = algorithms.begin(); it != algorithms.end(); ++it) {
+    if (!(*it)->SaveState(sf->mkdir((*it)->GetName().c_str())))
+      throw cms::Exception("StraightTrackAlignment::SaveState") << "Algorithm `" << (*it)->GetName()
+        << "' doesn't support state files.";
+  }
+}
+
+//----------------------------------------------------------------------------------------------------
+
+void StraightTrackAlignment::LoadState(const string &fileName)
+{
+  printf(">> StraightTrackAlignment::LoadState > %s\n", fileName.c_str());
+
+  // closed (and deleted) also when an exception is thrown
+  unique_ptr<TFile> sf(new TFile(fileName.c_str()));
+  if (sf->IsZombie())
+    throw cms::Exception("StraightTrackAlignment::LoadState") << "Cannot open file `" << 
+      fileName << "' for reading.";
+
+  // histograms created while loading must not be attached to (and deleted with) the file
+  gROOT->cd();
+
+  // alignment geometry
+  TTree *geometryTree = (TTree *) sf->Get("geometry");
+  TVectorD *geometryZ0 = (TVectorD *) sf->Get("z0");
+  if (!geometryTree || !geometryZ0) {
+    delete geometryZ0;
+    throw cms::Exception("StraightTrackAlignment::LoadState") << "File `" << fileName << "' is not a state file.";
+  }
+
+  AlignmentGeometry geometry;
+  geometry.z0 = (*geometryZ0)[0];
+  delete geometryZ0;
+
+  unsigned int id;
+  DetGeometry d;
+  geometryTree->SetBranchAddress("id", &id);
+  geometryTree->SetBranchAddress("z", &d.z);
+  geometryTree->SetBranchAddress("dx", &d.dx);
+  geometryTree->SetBranchAddress("dy", &d.dy);
+  geometryTree->SetBranchAddress("sx", &d.sx);
+  geometryTree->SetBranchAddress("sy", &d.sy);
+  geometryTree->SetBranchAddress("matrixIndex", &d.matrixIndex);
+  geometryTree->SetBranchAddress("rpMatrixIndex", &d.rpMatrixIndex);
+  geometryTree->SetBranchAddress("isU", &d.isU);
+  for (Long64_t i = 0; i < geometryTree->GetEntries(); i++) {
+    geometryTree->GetEntry(i);
+    d.s = d.sx*d.dx + d.sy*d.dy;
+    geometry.Insert(id, d);
+  }
+  geometry.BuildIndex();
+
+  if (task.geometry.empty()) {
+    task.geometry = geometry;
+
+    // initial alignments
+    TTree *alignmentTree = (TTree *) sf->Get("initialAlignments");
+    if (!alignmentTree)
+      throw cms::Exception("StraightTrackAlignment::LoadState") << "File `" << fileName << "' contains no initial alignments.";
+
+    unsigned int level;
+    double v[10];
+    alignmentTree->SetBranchAddress("level", &level);
+    alignmentTree->SetBranchAddress("id", &id);
+    alignmentTree->SetBranchAddress("values", v);
+    for (Long64_t i = 0; i < alignmentTree->GetEntries(); i++) {
+      alignmentTree->GetEntry(i);
+      RPAlignmentCorrectionData ac(v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7], v[8], v[9]);
+      if (level == 0)
+        initialAlignments.SetRPCorrection(id, ac);
+      else
+        initialAlignments.SetSensorCorrection(id, ac);
+    }
+  } else {
+    bool compatible = (geometry.size() == task.geometry.size() && geometry.z0 == task.geometry.z0);
+    for (AlignmentGeometry::const_iterator it = geometry.begin(); compatible && it != geometry.end(); ++it) {
+      AlignmentGeometry::const_iterator tit = task.geometry.find(it->first);
+      compatible = (tit != task.geometry.end() && tit->second.z == it->second.z
+        && tit->second.dx == it->second.dx && tit->second.dy == it->second.dy
+        && tit->second.sx == it->second.sx && tit->second.sy == it->second.sy
+        && tit->second.matrixIndex == it->second.matrixIndex && tit->second.rpMatrixIndex == it->second.rpMatrixIndex);
+    }
+
+    if (!compatible)
+      throw cms::Exception("StraightTrackAlignment::LoadState") << "The alignment geometry in `" << fileName
+        << "' differs from the geometry loaded before.";
+  }
+
+  // event counters
+  TVectorD *counters = (TVectorD *) sf->Get("counters");
+  if (!counters)
+    throw cms::Exception("StraightTrackAlignment::LoadState") << "File `" << fileName << "' contains no event counters.";
+
+  eventsTotal += (unsigned long) (*counters)[0];
+  eventsFitted += (unsigned long) (*counters)[1];
+  eventsSelected += (unsigned long) (*counters)[2];
+  delete counters;
+
+  TDirectory *rpSetDir = sf->GetDirectory("tracksPerRPSet");
+  if (!rpSetDir)
+    throw cms::Exception("StraightTrackAlignment::LoadState") << "File `" << fileName << "' contains no track counters.";
+
+  TIter next(rpSetDir->GetListOfKeys());
+  while (TKey *key = (TKey *) next()) {
+    TDirectory *setDir = rpSetDir->GetDirectory(key->GetName());
+    TVectorD *tracks = (setDir) ? (TVectorD *) setDir->Get("tracks") : NULL;
+    if (!tracks)
+      throw cms::Exception("StraightTrackAlignment::LoadState") << "File `" << fileName << "' contains no track counters"
+        << " in directory `tracksPerRPSet/" << key->GetName() << "'.";
+
+    set<unsigned int> rps = ReadRPSet(setDir);
+    fittedTracksPerRPSet[rps] += (unsigned long) (*tracks)[0];
+    if ((*tracks)[1] > 0)
+      selectedTracksPerRPSet[rps] += (unsigned long) (*tracks)[1];
+    delete tracks;
+  }
+
+  // diagnostic plots
+  TDirectory *diagnosticsDir = sf->GetDirectory("diagnostics");
+  if (buildDiagnosticPlots && diagnosticsDir)
+    LoadDiagnosticsState(diagnosticsDir);
+
+  // data of algorithms
+  for (vector<AlignmentAlgorithm *>::iterator it = algorithms.begin(); it != algorithms.end(); ++it) {
+    TDirectory *algDir = sf->GetDirectory((*it)->GetName().c_str());
+    if (!algDir)
+      throw cms::Exception("StraightTrackAlignment::LoadState") << "File `" << fileName << "' contains no data of algorithm `"
+        << (*it)->GetName() << "'.";
+
+    if (!(*it)->LoadState(algDir))
+      throw cms::Exception("StraightTrackAlignment::LoadState") << "Algorithm `" << (*it)->GetName()
+        << "' doesn't support state files.";
+  }
+}
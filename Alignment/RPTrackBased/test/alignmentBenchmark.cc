@@ -0,0 +1,401 @@
+/****************************************************************************
+*
+* This is a part of TOTEM offline software.
+* Standalone alignment benchmark: synthetic tracks through a misaligned geometry.
+*
+****************************************************************************/
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "FWCore/ParameterSet/interface/ParameterSet.h"
+#include "FWCore/Utilities/interface/Exception.h"
+
+#include "DataFormats/CTPPSAlignment/interface/RPAlignmentCorrectionsData.h"
+#include "Alignment/RPTrackBased/interface/AlignmentTask.h"
+#include "Alignment/RPTrackBased/interface/JanAlignmentAlgorithm.h"
+#include "Alignment/RPTrackBased/interface/MillepedeAlgorithm.h"
+#include "Alignment/RPTrackBased/interface/LocalTrackFitter.h"
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+//----------------------------------------------------------------------------------------------------
+
+void PrintHelp(const char *name)
+{
+  printf("USAGE: %s [options]\n", name);
+  printf("       %s --help (to print this help)\n", name);
+  printf("OPTIONS:\n");
+  printf("\t-t tracks\t number of generated tracks (default 50000)\n");
+  printf("\t-r sigma\t hit resolution in um (default 20)\n");
+  printf("\t-shr sigma\t spread of the true shifts in um (default 10)\n");
+  printf("\t-rotz sigma\t spread of the true rotations in mrad (default 0.3)\n");
+  printf("\t-d distance\t distance of the RP centers from the beam in mm (default 20)\n");
+  printf("\t-cut ratio\t maximal residual/sigma in the track fit (default 3)\n");
+  printf("\t-g file\t load the geometry from a file (format of AlignmentGeometry::LoadFromFile)\n");
+  printf("\t-seed seed\t random seed (default 1)\n");
+  printf("\t-w dir\t working directory of the Millepede algorithm (default .)\n");
+  printf("\t-pede\t run also the Millepede solution (needs pede in PATH)\n");
+  printf("\t-tol-shr tol\t maximum allowed |recovered - true| shift in um (default 3)\n");
+  printf("\t-tol-rotz tol\t maximum allowed |recovered - true| rotation in mrad (default 0.15)\n");
+  printf("\t-v level\t verbosity of the algorithms (default 0)\n");
+  printf("Generates straight tracks through a geometry with known misalignments and feeds them, through\n");
+  printf("LocalTrackFitter, to the Jan and Millepede algorithms. Prints the Feed rates, the Analyze/Solve times and\n");
+  printf("the recovered - true misalignments. Returns 1 if the recovered misalignments are out of the tolerance.\n");
+}
+
+//----------------------------------------------------------------------------------------------------
+
+/// builds a geometry of both stations of one arm, 6 RPs each with 10 planes (odd ones U),
+/// the strips are at +-45 degrees, the RPs of a unit overlap near the beam
+/// the detectors have the decimal ids of arm 1 (Millepede labels must not be 0)
+void BuildSyntheticGeometry(double rpDistance, AlignmentGeometry &geometry)
+{
+  geometry.clear();
+  geometry.z0 = 0.;
+
+  const double zStation[3] = { -70000., 0., 0. };
+  const double c = 1. / sqrt(2.);
+
+  for (unsigned int st = 0; st < 3; st += 2) {
+    for (unsigned int rp = 0; rp < 6; rp++) {
+      unsigned int rpId = 100 + 10*st + rp;
+      double zRP = zStation[st] + ((rp < 3) ? 0. : 1500.);
+
+      // RP center: 0, 4 top, 1, 5 bottom, 2, 3 horizontal
+      double cx = 0., cy = 0.;
+      if (rp == 0 || rp == 4) cy = +rpDistance;
+      if (rp == 1 || rp == 5) cy = -rpDistance;
+      if (rp == 2 || rp == 3) cx = +rpDistance;
+      bool horizontal = (rp == 2 || rp == 3);
+
+      for (unsigned int det = 0; det < 10; det++) {
+        bool odd = (det % 2 != 0);
+        double dx = (odd) ? c : -c, dy = c;
+        if (horizontal) {
+          // rotated by 90 degrees
+          double t = dx;
+          dx = -dy;
+          dy = t;
+        }
+
+        bool isU = (horizontal) ? !odd : odd;
+        geometry.Insert(rpId*10 + det, DetGeometry(zRP + 9.*det, dx, dy, cx, cy, isU));
+      }
+    }
+  }
+
+  geometry.AssignMatrixIndices();
+}
+
+//----------------------------------------------------------------------------------------------------
+
+/// true misalignment of one detector
+struct Misalignment
+{
+  double shr;   ///< mm
+  double rotz;  ///< rad
+};
+
+//----------------------------------------------------------------------------------------------------
+
+/// generates one track and its hits, the sensitive area of a detector is a square of half-size
+/// 18 mm (in the strip frame) around its center
+void GenerateTrack(const AlignmentGeometry &geometry, const map<unsigned int, Misalignment> &misalignments,
+  double sigma, mt19937 &gen, HitCollection &hits)
+{
+  const double halfSize = 18.;
+
+  // the horizontal RPs are at positive x
+  uniform_real_distribution<double> positionX(-25., +40.), positionY(-40., +40.);
+  normal_distribution<double> angle(0., 20E-6), noise(0., sigma);
+
+  double ax = angle(gen), ay = angle(gen);
+  double bx = positionX(gen), by = positionY(gen);
+
+  hits.clear();
+  for (AlignmentGeometry::const_iterator it = geometry.begin(); it != geometry.end(); ++it) {
+    const DetGeometry &d = it->second;
+    double x = ax*(d.z - geometry.z0) + bx;
+    double y = ay*(d.z - geometry.z0) + by;
+
+    // acceptance
+    double u = (x - d.sx)*d.dx + (y - d.sy)*d.dy;
+    double v = -(x - d.sx)*d.dy + (y - d.sy)*d.dx;
+    if (fabs(u) > halfSize || fabs(v) > halfSize)
+      continue;
+
+    // misaligned read-out: direction rotated by rot_z around the center, shifted by sh_r,
+    // the position is measured from the nominal center (LocalTrackFitter adds DetGeometry::s)
+    const Misalignment &m = misalignments.find(it->first)->second;
+    double C = d.dx*cos(m.rotz) - d.dy*sin(m.rotz);
+    double S = d.dx*sin(m.rotz) + d.dy*cos(m.rotz);
+    double position = (x - d.sx)*C + (y - d.sy)*S - m.shr;
+
+    hits.push_back(Hit(it->first, position + noise(gen), sigma));
+  }
+}
+
+//----------------------------------------------------------------------------------------------------
+
+double Seconds(const Clock::duration &d)
+{
+  return chrono::duration_cast< chrono::duration<double> >(d).count();
+}
+
+//----------------------------------------------------------------------------------------------------
+
+/// prints recovered - true misalignments, returns the maximal differences
+void Compare(const string &name, const AlignmentGeometry &geometry, const map<unsigned int, Misalignment> &misalignments,
+  const RPAlignmentCorrectionsData &result, double &maxShR, double &maxRotZ)
+{
+  printf("\n* %s: recovered - true\n", name.c_str());
+  printf("%6s%14s%14s%16s%16s\n", "id", "sh_r (um)", "diff (um)", "rot_z (mrad)", "diff (mrad)");
+
+  maxShR = maxRotZ = 0.;
+  double sumShR = 0., sumRotZ = 0.;
+  for (AlignmentGeometry::const_iterator it = geometry.begin(); it != geometry.end(); ++it) {
+    const Misalignment &m = misalignments.find(it->first)->second;
+    RPAlignmentCorrectionData r = result.GetSensorCorrection(it->first);
+
+    double dShR = r.sh_r() - m.shr, dRotZ = r.rot_z() - m.rotz;
+    printf("%6u%+14.2f%+14.2f%+16.4f%+16.4f\n", it->first, m.shr*1E3, dShR*1E3, m.rotz*1E3, dRotZ*1E3);
+
+    maxShR = max(maxShR, fabs(dShR));
+    maxRotZ = max(maxRotZ, fabs(dRotZ));
+    sumShR += dShR*dShR;
+    sumRotZ += dRotZ*dRotZ;
+  }
+
+  printf("\tRMS: sh_r %.2f um, rot_z %.4f mrad\n", sqrt(sumShR / geometry.size())*1E3, sqrt(sumRotZ / geometry.size())*1E3);
+  printf("\tmax: sh_r %.2f um, rot_z %.4f mrad\n", maxShR*1E3, maxRotZ*1E3);
+}
+
+//----------------------------------------------------------------------------------------------------
+
+int main(int argc, const char* argv[])
+{
+  unsigned int tracks = 50000, seed = 1, verbosity = 0;
+  double resolution = 20E-3, shrSpread = 10E-3, rotzSpread = 0.3E-3, rpDistance = 20., cut = 3.;
+  double tolShR = 3E-3, tolRotZ = 0.15E-3;
+  string geometryFile, workingDir = ".";
+  bool runPede = false;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+      PrintHelp(argv[0]);
+      return 0;
+    }
+
+    if (!strcmp(argv[i], "-pede")) {
+      runPede = true;
+      continue;
+    }
+
+    if (i + 1 >= argc) {
+      PrintHelp(argv[0]);
+      return 1;
+    }
+
+    const char *value = argv[++i];
+    if (!strcmp(argv[i-1], "-t")) tracks = atoi(value); else
+    if (!strcmp(argv[i-1], "-r")) resolution = atof(value) * 1E-3; else
+    if (!strcmp(argv[i-1], "-shr")) shrSpread = atof(value) * 1E-3; else
+    if (!strcmp(argv[i-1], "-rotz")) rotzSpread = atof(value) * 1E-3; else
+    if (!strcmp(argv[i-1], "-d")) rpDistance = atof(value); else
+    if (!strcmp(argv[i-1], "-cut")) cut = atof(value); else
+    if (!strcmp(argv[i-1], "-g")) geometryFile = value; else
+    if (!strcmp(argv[i-1], "-seed")) seed = atoi(value); else
+    if (!strcmp(argv[i-1], "-w")) workingDir = value; else
+    if (!strcmp(argv[i-1], "-tol-shr")) tolShR = atof(value) * 1E-3; else
+    if (!strcmp(argv[i-1], "-tol-rotz")) tolRotZ = atof(value) * 1E-3; else
+    if (!strcmp(argv[i-1], "-v")) verbosity = atoi(value); else {
+      PrintHelp(argv[0]);
+      return 1;
+    }
+  }
+
+  try {
+    // parameters, as in RPStraightTrackAligner_cfi, only sh_r and rot_z are resolved
+    edm::ParameterSet ps;
+    ps.addUntrackedParameter<unsigned int>("verbosity", verbosity);
+    ps.addParameter<bool>("resolveShR", true);
+    ps.addParameter<bool>("resolveShZ", false);
+    ps.addParameter<bool>("resolveRotZ", true);
+    ps.addParameter<bool>("resolveRPShZ", false);
+    ps.addParameter<bool>("useExtendedRotZConstraint", true);
+    ps.addParameter<bool>("useZeroThetaRotZConstraint", true);
+    ps.addParameter<bool>("useExtendedShZConstraints", false);
+    ps.addParameter<bool>("useExtendedRPShZConstraint", false);
+    ps.addParameter<bool>("oneRotZPerPot", false);
+    ps.addParameter<double>("singularLimit", 1E-8);
+    ps.addParameter<bool>("useExternalFitter", false);
+    ps.addParameter<unsigned int>("minimumHitsPerProjectionPerRP", 4);
+    ps.addParameter<double>("maxResidualToSigma", cut);
+
+    edm::ParameterSet homogeneousConstraints;
+    homogeneousConstraints.addParameter< vector<double> >("ShR_values", vector<double>(4, 0.));
+    homogeneousConstraints.addParameter< vector<double> >("RotZ_values", vector<double>(4, 0.));
+    ps.addParameter<edm::ParameterSet>("homogeneousConstraints", homogeneousConstraints);
+    ps.addParameter<edm::ParameterSet>("fixedDetectorsConstraints", edm::ParameterSet());
+
+    edm::ParameterSet janPS;
+    janPS.addParameter<double>("weakLimit", 1E-6);
+    janPS.addParameter<bool>("stopOnSingularModes", false);
+    janPS.addParameter<bool>("buildDiagnosticPlots", false);
+    janPS.addParameter<bool>("eigenAnalysis", false);
+    ps.addParameter<edm::ParameterSet>("JanAlignmentAlgorithm", janPS);
+
+    edm::ParameterSet millepedePS;
+    millepedePS.addParameter<string>("workingDir", workingDir);
+    millepedePS.addParameter<bool>("compressInput", false);
+    millepedePS.addParameter<unsigned int>("blockSize", 1 << 20);
+    ps.addParameter<edm::ParameterSet>("MillepedeAlgorithm", millepedePS);
+
+    // geometry
+    AlignmentTask task(ps);
+    if (geometryFile.empty())
+      BuildSyntheticGeometry(rpDistance, task.geometry);
+    else {
+      task.geometry.z0 = 0.;
+      task.geometry.LoadFromFile(geometryFile);
+    }
+
+    printf(">> geometry: %u RPs, %u detectors\n", task.geometry.RPs(), task.geometry.Detectors());
+
+    // true misalignments
+    mt19937 gen(seed);
+    normal_distribution<double> shrDist(0., shrSpread), rotzDist(0., rotzSpread);
+    map<unsigned int, Misalignment> misalignments;
+    for (AlignmentGeometry::const_iterator it = task.geometry.begin(); it != task.geometry.end(); ++it) {
+      Misalignment &m = misalignments[it->first];
+      m.shr = shrDist(gen);
+      m.rotz = rotzDist(gen);
+    }
+
+    // the constraints fix the singular (and weak) modes to the true values, hence the solution shall reproduce them
+    vector<AlignmentConstraint> constraints;
+    task.BuildHomogeneousConstraints(constraints);
+    for (unsigned int i = 0; i < constraints.size(); i++) {
+      AlignmentConstraint &ac = constraints[i];
+      ac.val = 0.;
+      for (AlignmentGeometry::const_iterator it = task.geometry.begin(); it != task.geometry.end(); ++it) {
+        const Misalignment &m = misalignments[it->first];
+        unsigned int idx = it->second.matrixIndex;
+        ac.val += ac.coef[AlignmentTask::qcShR][idx] * m.shr + ac.coef[AlignmentTask::qcRotZ][idx] * m.rotz;
+      }
+    }
+
+    // algorithms
+    LocalTrackFitter fitter(ps);
+    JanAlignmentAlgorithm jan(ps, &task);
+    MillepedeAlgorithm millepede(ps, &task);
+    AlignmentAlgorithm *algorithms[2] = { &jan, &millepede };
+
+    for (unsigned int a = 0; a < 2; a++)
+      if (!algorithms[a]->BeginStandalone())
+        throw cms::Exception("alignmentBenchmark") << "Algorithm " << algorithms[a]->GetName() << " needs an event setup.";
+
+    // generate, fit and feed
+    Clock::duration tGenerate(0), tFit(0), tFeed[2] = { Clock::duration(0), Clock::duration(0) };
+    unsigned long fitted = 0, hitsFed = 0;
+    HitCollection hits;
+    for (unsigned int t = 0; t < tracks; t++) {
+      Clock::time_point t0 = Clock::now();
+      GenerateTrack(task.geometry, misalignments, resolution, gen, hits);
+
+      Clock::time_point t1 = Clock::now();
+      LocalTrackFit trackFit;
+      bool success = (hits.size() > 4 && fitter.Fit(hits, task.geometry, trackFit));
+
+      Clock::time_point t2 = Clock::now();
+      tGenerate += t1 - t0;
+      tFit += t2 - t1;
+
+      if (!success)
+        continue;
+
+      fitted++;
+      hitsFed += hits.size();
+
+      for (unsigned int a = 0; a < 2; a++) {
+        Clock::time_point f0 = Clock::now();
+        algorithms[a]->Feed(hits, trackFit, trackFit);
+        tFeed[a] += Clock::now() - f0;
+      }
+    }
+
+    // analyze and solve
+    RPAlignmentCorrectionsData results[2];
+    double tAnalyze[2] = { 0., 0. }, tSolve[2] = { 0., 0. };
+    bool solved[2] = { false, false };
+    for (unsigned int a = 0; a < 2; a++) {
+      Clock::time_point t0 = Clock::now();
+      algorithms[a]->Analyze();
+      Clock::time_point t1 = Clock::now();
+      tAnalyze[a] = Seconds(t1 - t0);
+
+      if (algorithms[a] == &millepede && !runPede)
+        continue;
+
+      solved[a] = (algorithms[a]->Solve(constraints, results[a], NULL) == 0);
+      tSolve[a] = Seconds(Clock::now() - t1);
+    }
+
+    for (unsigned int a = 0; a < 2; a++)
+      algorithms[a]->End();
+
+    // summary
+    int status = 0;
+    for (unsigned int a = 0; a < 2; a++) {
+      if (!solved[a])
+        continue;
+
+      double maxShR, maxRotZ;
+      Compare(algorithms[a]->GetName(), task.geometry, misalignments, results[a], maxShR, maxRotZ);
+      if (maxShR > tolShR || maxRotZ > tolRotZ) {
+        printf("ERROR: %s out of tolerance (%.2f um, %.4f mrad).\n", algorithms[a]->GetName().c_str(), tolShR*1E3, tolRotZ*1E3);
+        status = 1;
+      }
+    }
+
+    if (runPede && !solved[1]) {
+      printf("ERROR: Millepede solution failed.\n");
+      status = 1;
+    }
+
+    if (!solved[0]) {
+      printf("ERROR: Jan solution failed.\n");
+      status = 1;
+    }
+
+    printf("\n* timing\n");
+    printf("\ttracks generated = %u, fitted = %lu, hits fed = %lu\n", tracks, fitted, hitsFed);
+    printf("\tgeneration: %.3f s, fit: %.3f s (%.0f tracks/s)\n", Seconds(tGenerate), Seconds(tFit), tracks / Seconds(tFit));
+    for (unsigned int a = 0; a < 2; a++) {
+      double feed = Seconds(tFeed[a]);
+      printf("\t%-10s Feed: %.3f s (%.0f tracks/s), Analyze: %.3f s, Solve: ", algorithms[a]->GetName().c_str(),
+        feed, (feed > 0.) ? fitted / feed : 0., tAnalyze[a]);
+      if (solved[a])
+        printf("%.3f s\n", tSolve[a]);
+      else
+        printf("-\n");
+    }
+
+    return status;
+  }
+
+  catch (cms::Exception &e) {
+    printf("ERROR: cms::Exception caught.\n%s\n", e.what());
+    return 2;
+  }
+}
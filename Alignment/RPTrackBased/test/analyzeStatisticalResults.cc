@@ -14,7 +14,9 @@
 #include <unistd.h>
 #include <map>
 #include <string>
+#include <vector>
 #include <cmath>
+#include <algorithm>
 
 #include "TFile.h"
 #include "TGraph.h"
@@ -26,6 +28,10 @@
 #include "Geometry/VeryForwardGeometryBuilder/interface/RPAlignmentCorrectionsMethods.h"
 #include "DataFormats/CTPPSAlignment/interface/RPAlignmentCorrectionsData.h"
 
+#include "Alignment/RPTrackBased/interface/RunParallel.h"
+
+#include <xercesc/util/PlatformUtils.hpp>
+
 using namespace std;
 
 //#define DEBUG
@@ -557,6 +563,27 @@ bool IsRegDir(const dirent *de)
 
 //----------------------------------------------------------------------------------------------------
 
+/// returns the sorted list of subdirectories
+vector<string> ListDirs(const string &path)
+{
+  vector<string> list;
+
+  DIR *dp = opendir(path.c_str());
+  if (!dp)
+    return list;
+
+  dirent *de;
+  while ( (de = readdir(dp)) )
+    if (IsRegDir(de))
+      list.push_back(de->d_name);
+  closedir(dp);
+
+  sort(list.begin(), list.end());
+  return list;
+}
+
+//----------------------------------------------------------------------------------------------------
+
 // Choices for RP input.
 // * First of all, the Jan to Ideal comparison is not possible for RP data -
 //   the factorizations are different, because of zero errors of the Ideal
@@ -584,9 +611,10 @@ string s_ideal_file("./cumulative_expanded_results_Ideal.xml");
 
 void PrintHelp(const char *name)
 {
-  printf("USAGE: %s r_actual_file r_ideal_file s_actual_file s_ideal_file\n", name);
+  printf("USAGE: %s [-j threads] r_actual_file r_ideal_file s_actual_file s_ideal_file\n", name);
   printf("       %s --help (to print this help)\n", name);
   printf("PARAMETERS:\n");
+  printf("\tthreads\t number of threads loading the results (default: number of cores)\n");
   printf("\tr_actual_file\t file with actual RP results (default %s)\n", r_actual_file.c_str());
   printf("\tr_ideal_file\t file with ideal RP results (default %s)\n", r_ideal_file.c_str());
   printf("\ts_actual_file\t file with actual sensor results (default %s)\n", s_actual_file.c_str());
@@ -595,139 +623,181 @@ void PrintHelp(const char *name)
 
 //----------------------------------------------------------------------------------------------------
 
+/// results of one iteration of one repetition
+struct Job
+{
+  unsigned int N, iteration;
+  string N_dir, rep_dir, it_dir;    ///< directory names
+  string path;                      ///< path of the iteration directory
+  RPAlignmentCorrectionsData r_actual, r_ideal, s_actual, s_ideal;
+  bool loaded;
+  string error;
+
+  Job(unsigned int _N, unsigned int _i, const string &_Nd, const string &_rd, const string &_id, const string &_p) :
+    N(_N), iteration(_i), N_dir(_Nd), rep_dir(_rd), it_dir(_id), path(_p), loaded(false) {}
+
+  /// frees the loaded results
+  void Release()
+  {
+    r_actual = RPAlignmentCorrectionsData();
+    r_ideal = RPAlignmentCorrectionsData();
+    s_actual = RPAlignmentCorrectionsData();
+    s_ideal = RPAlignmentCorrectionsData();
+  }
+};
+
+//----------------------------------------------------------------------------------------------------
+
+/// the result files are relative to the iteration directory
+string InDir(const string &dir, const string &file)
+{
+  return (file[0] == '/') ? file : dir + "/" + file;
+}
+
+//----------------------------------------------------------------------------------------------------
+
+void LoadJob(Job &j)
+{
+  try { 
+    j.r_actual = RPAlignmentCorrectionsMethods::ParseXMLFile(InDir(j.path, r_actual_file));
+    j.r_ideal = RPAlignmentCorrectionsMethods::ParseXMLFile(InDir(j.path, r_ideal_file));
+    j.s_actual = RPAlignmentCorrectionsMethods::ParseXMLFile(InDir(j.path, s_actual_file));
+    j.s_ideal = RPAlignmentCorrectionsMethods::ParseXMLFile(InDir(j.path, s_ideal_file));
+    j.loaded = true;
+  }
+  catch (cms::Exception &e) {
+    j.error = e.what();
+  }
+  catch (std::exception &e) {
+    j.error = e.what();
+  }
+  catch (...) {
+    j.error = "unknown exception";
+  }
+}
+
+//----------------------------------------------------------------------------------------------------
+
+/// collects the iterations of all repetitions in a tr_dist directory, sorted by N, repetition and iteration
+void CollectJobs(const string &path, vector<Job> &jobs)
+{
+  // sort the tr_N directories by N
+  map<unsigned int, string> nMap;
+  vector<string> nDirs = ListDirs(path);
+  for (unsigned int i = 0; i < nDirs.size(); i++) {
+    string sN = nDirs[i].substr(nDirs[i].find(':') + 1);
+    unsigned int N = atoi(sN.c_str());
+    nMap[N] = nDirs[i];
+  }
+
+  for (map<unsigned int, string>::iterator nit = nMap.begin(); nit != nMap.end(); ++nit) {
+    string nPath = path + "/" + nit->second;
+    vector<string> repDirs = ListDirs(nPath);
+    for (unsigned int ri = 0; ri < repDirs.size(); ri++) {
+      string repPath = nPath + "/" + repDirs[ri];
+
+      // sort the iteration directories
+      map<unsigned int, string> itMap;
+      vector<string> itDirs = ListDirs(repPath);
+      for (unsigned int ii = 0; ii < itDirs.size(); ii++) {
+        unsigned idx = 9;
+        if (itDirs[ii][9] == ':')
+          idx = 10;
+        unsigned int it = atoi(itDirs[ii].c_str() + idx);
+        itMap[it] = itDirs[ii];
+      }
+
+      for (map<unsigned int, string>::iterator iit = itMap.begin(); iit != itMap.end(); ++iit)
+        jobs.push_back(Job(nit->first, iit->first, nit->second, repDirs[ri], iit->second,
+          repPath + "/" + iit->second));
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------
+
 int main(int argc, const char* argv[])
 {
-  if (argc > 1) {
-    if (!strcmp(argv[1], "-h") || !strcmp(argv[1], "--help")) {
+  unsigned int threads = DefaultThreads();
+
+  vector<string> files;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
       PrintHelp(argv[0]);
       return 0;
     }
 
-    if (argc > 1)
-      r_actual_file = argv[1];
-    if (argc > 2)
-      r_ideal_file = argv[2];
-    if (argc > 3)
-      s_actual_file = argv[3];
-    if (argc > 4)
-      s_ideal_file = argv[4];
+    if (!strcmp(argv[i], "-j") && i + 1 < argc) {
+      threads = max(1, atoi(argv[++i]));
+      continue;
+    }
+
+    files.push_back(argv[i]);
   }
 
+  if (files.size() > 0)
+    r_actual_file = files[0];
+  if (files.size() > 1)
+    r_ideal_file = files[1];
+  if (files.size() > 2)
+    s_actual_file = files[2];
+  if (files.size() > 3)
+    s_ideal_file = files[3];
+
   printf("r_actual_file: %s\n", r_actual_file.c_str());
   printf("r_ideal_file: %s\n", r_ideal_file.c_str());
   printf("s_actual_file: %s\n", s_actual_file.c_str());
   printf("s_ideal_file: %s\n", s_ideal_file.c_str());
+  printf("threads: %u\n", threads);
+
+  // number of iterations whose results are loaded at once
+  const unsigned int jobChunkSize = 16 * threads;
 
   // open output file
   sf = new TFile("result_summary.root", "recreate");
 
+  // Xerces is initialized once for all loading threads
+  xercesc::XMLPlatformUtils::Initialize();
+
   // traverse directory structure
   try {
-    DIR *dp_r = opendir(".");
-    dirent *de_r;
-    // traverse RPs directories
-    while ( (de_r = readdir(dp_r)) ) {
-      if (!IsRegDir(de_r)) continue;
-
-      chdir(de_r->d_name);
-      DIR *dp_o = opendir(".");
-      // traverse optimized directories
-      dirent *de_o;
-      while ( (de_o = readdir(dp_o)) ) {
-        if (!IsRegDir(de_o)) continue;
-
-        chdir(de_o->d_name);
-        DIR *dp_d = opendir(".");
-        dirent *de_d;
-        // traverse tr_dist directories
-        while ( (de_d = readdir(dp_d)) ) {
-          if (!IsRegDir(de_d)) continue;
-    
-          // sort the tr_N directories by N
-          chdir(de_d->d_name);
-          DIR *dp_N = opendir(".");
-          dirent *de_N;
-          map<unsigned int, string> nMap;
-          while ( (de_N = readdir(dp_N)) )
-            if (IsRegDir(de_N)) {
-              string sN = de_N->d_name;
-              sN = sN.substr(sN.find(':') + 1);
-              unsigned int N = atoi(sN.c_str());
-              nMap[N] = de_N->d_name;
-            }
-          
+    // traverse RPs, optimized and tr_dist directories
+    vector<string> rDirs = ListDirs(".");
+    for (unsigned int ri = 0; ri < rDirs.size(); ri++) {
+      vector<string> oDirs = ListDirs("./" + rDirs[ri]);
+      for (unsigned int oi = 0; oi < oDirs.size(); oi++) {
+        vector<string> dDirs = ListDirs("./" + rDirs[ri] + "/" + oDirs[oi]);
+        for (unsigned int di = 0; di < dDirs.size(); di++) {
+          vector<Job> jobs;
+          CollectJobs("./" + rDirs[ri] + "/" + oDirs[oi] + "/" + dDirs[di], jobs);
+
+          // load the results in parallel, chunk by chunk, and fill the statistics in a fixed order;
+          // only the results of one chunk are kept in memory
           ResetStatistics();
+          for (unsigned int first = 0; first < jobs.size(); first += jobChunkSize) {
+            const unsigned int n = min(jobChunkSize, (unsigned int) jobs.size() - first);
+            RunParallel(n, threads, [&] (unsigned int i) { LoadJob(jobs[first + i]); });
 
-          // traverse tr_N directories
-          for (map<unsigned int, string>::iterator nit = nMap.begin(); nit != nMap.end(); ++nit) {
-            chdir(nit->second.c_str());
-            DIR *dp_i = opendir(".");
-            dirent *de_i;
-            // traverse repetitions directories
-            while ( (de_i = readdir(dp_i)) ) {
-              if (!IsRegDir(de_i))
+            for (unsigned int i = first; i < first + n; i++) {
+              Job &j = jobs[i];
+              printf("%s|%s|%s|%s|%s|%s\n", rDirs[ri].c_str(), oDirs[oi].c_str(), dDirs[di].c_str(), 
+                  j.N_dir.c_str(), j.rep_dir.c_str(), j.it_dir.c_str());
+
+              if (!j.loaded) {
+                printf("ERROR: An exception has been caught:\n%s\nSkipping this directory.\n", j.error.c_str());
                 continue;
-              chdir(de_i->d_name);
-
-              // sort the iteration directories
-              DIR *dp_it = opendir(".");
-              dirent *de_it;
-              map<unsigned int, string> itMap;
-              while ( (de_it = readdir(dp_it)) )
-                if (IsRegDir(de_it)) {
-                  unsigned idx = 9;
-                  if (de_it->d_name[9] == ':')
-                    idx = 10;
-                  unsigned int it = atoi(de_it->d_name + idx);
-                  itMap[it] = de_it->d_name;
-                }
-
-              // traverse iteration directories
-              for (map<unsigned int, string>::iterator iit = itMap.begin(); iit != itMap.end(); ++iit) {
-                chdir(iit->second.c_str());
-
-                printf("%s|%s|%s|%s|%s|%s\n", de_r->d_name, de_o->d_name, de_d->d_name, 
-                    nit->second.c_str(), de_i->d_name, iit->second.c_str());
-              
-                // load and process alignments
-                try { 
-                  RPAlignmentCorrectionsData r_actual = RPAlignmentCorrectionsMethods::GetCorrectionsDataFromFile(r_actual_file.c_str());
-                  RPAlignmentCorrectionsData r_ideal = RPAlignmentCorrectionsMethods::GetCorrectionsDataFromFile(r_ideal_file.c_str());
-                  UpdateRPStatistics(nit->first, iit->first, r_actual, r_ideal);
-                  
-                  RPAlignmentCorrectionsData s_actual = RPAlignmentCorrectionsMethods::GetCorrectionsDataFromFile(s_actual_file.c_str());
-                  RPAlignmentCorrectionsData s_ideal = RPAlignmentCorrectionsMethods::GetCorrectionsDataFromFile(s_ideal_file.c_str());
-                  UpdateSensorStatistics(nit->first, iit->first, s_actual, s_ideal);
-                }
-                catch (cms::Exception e) {
-                  printf("ERROR: A CMS exception has been caught:\n%s\nSkipping this directory.\n", e.what());
-                }
-
-                chdir("..");
               }
 
-              closedir(dp_it);
-              chdir("..");
+              UpdateRPStatistics(j.N, j.iteration, j.r_actual, j.r_ideal);
+              UpdateSensorStatistics(j.N, j.iteration, j.s_actual, j.s_ideal);
+              j.Release();
             }
-            
-            closedir(dp_i);
-            chdir("..");
           }
 
-          WriteGraphs(de_r->d_name, de_o->d_name, de_d->d_name);
-
-          closedir(dp_N);
-          chdir("..");
+          WriteGraphs(rDirs[ri], oDirs[oi], dDirs[di]);
         }
-        closedir(dp_d);
-        chdir("..");
       }
-      closedir(dp_o);
-      chdir("..");
     }
-    closedir(dp_r);
-    chdir("..");
-
   }
 
   catch (cms::Exception e) {
@@ -742,9 +812,10 @@ int main(int argc, const char* argv[])
     printf("ERROR: An exception has been caught, stopping.\n");
   }
 
+  xercesc::XMLPlatformUtils::Terminate();
+
   printf(">> CloseFile\n");
   delete sf;
 
   return 0;
 }
-
@@ -0,0 +1,67 @@
+/****************************************************************************
+*
+* This is a part of TOTEM offline software.
+* Merges the state files of several alignment jobs and solves the alignment problem.
+*
+****************************************************************************/
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "FWCore/ParameterSet/interface/ParameterSet.h"
+#include "FWCore/PythonParameterSet/interface/MakeParameterSets.h"
+#include "FWCore/Utilities/interface/Exception.h"
+
+#include "Alignment/RPTrackBased/interface/StraightTrackAlignment.h"
+
+using namespace std;
+
+//----------------------------------------------------------------------------------------------------
+
+void PrintHelp(const char *name)
+{
+  printf("USAGE: %s config module state_file [state_file ...]\n", name);
+  printf("       %s --help (to print this help)\n", name);
+  printf("PARAMETERS:\n");
+  printf("\tconfig\t python configuration with the aligner module\n");
+  printf("\tmodule\t label of the aligner module (e.g. RPStraightTrackAligner)\n");
+  printf("\tstate_file\t file saved by the aligner (parameter stateFileName)\n");
+  printf("Merges the data collected by several jobs and solves the alignment problem, as at the end of a single job.\n");
+}
+
+//----------------------------------------------------------------------------------------------------
+
+int main(int argc, const char* argv[])
+{
+  if (argc > 1 && (!strcmp(argv[1], "-h") || !strcmp(argv[1], "--help"))) {
+    PrintHelp(argv[0]);
+    return 0;
+  }
+
+  if (argc < 4) {
+    PrintHelp(argv[0]);
+    return 1;
+  }
+
+  try {
+    // the module parameters from the configuration, the solve is always run and nothing is saved
+    auto process = edm::boost_python::readConfig(argv[1]);
+    edm::ParameterSet ps(process->getParameterSet(argv[2]));
+    ps.addParameter<string>("stateFileName", "");
+    ps.addParameter<bool>("solveAtEndOfJob", true);
+
+    StraightTrackAlignment alignment(ps);
+    for (int i = 3; i < argc; i++)
+      alignment.LoadState(argv[i]);
+
+    alignment.Finish();
+  }
+
+  catch (cms::Exception &e) {
+    printf("ERROR: cms::Exception caught.\n%s\n", e.what());
+    return 2;
+  }
+
+  return 0;
+}
@@ -0,0 +1,151 @@
+/****************************************************************************
+*
+* This is a part of TOTEM offline software.
+* Checks, prints or converts Mille binary files (plain or gzip-compressed).
+*
+****************************************************************************/
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+using namespace std;
+
+//----------------------------------------------------------------------------------------------------
+
+void PrintHelp(const char *name)
+{
+  printf("USAGE: %s [-p] [-o output] input\n", name);
+  printf("       %s --help (to print this help)\n", name);
+  printf("PARAMETERS:\n");
+  printf("\tinput\t Mille binary file, plain or gzip-compressed\n");
+  printf("\t-p\t print the records (in the Mille text format)\n");
+  printf("\t-o\t write the records to the output file, compressed if the name ends with .gz\n");
+  printf("Checks the record structure and prints the numbers of records and words.\n");
+}
+
+//----------------------------------------------------------------------------------------------------
+
+bool EndsWith(const string &s, const string &suffix)
+{
+  return (s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0);
+}
+
+//----------------------------------------------------------------------------------------------------
+
+int main(int argc, const char* argv[])
+{
+  string inputFile, outputFile;
+  bool print = false;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+      PrintHelp(argv[0]);
+      return 0;
+    }
+
+    if (!strcmp(argv[i], "-p")) {
+      print = true;
+      continue;
+    }
+
+    if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+      outputFile = argv[++i];
+      continue;
+    }
+
+    if (!inputFile.empty()) {
+      PrintHelp(argv[0]);
+      return 1;
+    }
+
+    inputFile = argv[i];
+  }
+
+  if (inputFile.empty()) {
+    PrintHelp(argv[0]);
+    return 1;
+  }
+
+  // gzread reads plain files as well
+  gzFile in = gzopen(inputFile.c_str(), "rb");
+  if (!in) {
+    printf("ERROR: can't open input file `%s'.\n", inputFile.c_str());
+    return 2;
+  }
+  gzbuffer(in, 1 << 20);
+
+  FILE *out = NULL;
+  gzFile gzOut = NULL;
+  if (!outputFile.empty()) {
+    if (EndsWith(outputFile, ".gz"))
+      gzOut = gzopen(outputFile.c_str(), "wb1");
+    else
+      out = fopen(outputFile.c_str(), "wb");
+
+    if (!out && !gzOut) {
+      printf("ERROR: can't open output file `%s'.\n", outputFile.c_str());
+      return 2;
+    }
+  }
+
+  // record: word count (2n), n floats, n ints
+  vector<char> record;
+  unsigned long records = 0, words = 0;
+  int status = 0;
+  while (true) {
+    int numWords;
+    int r = gzread(in, &numWords, sizeof(numWords));
+    if (r == 0)
+      break;
+
+    if (r != sizeof(numWords) || numWords <= 0 || numWords % 2 != 0) {
+      printf("ERROR: corrupted record %lu (word count %i).\n", records, (r == sizeof(numWords)) ? numWords : -1);
+      status = 3;
+      break;
+    }
+
+    const unsigned int n = numWords / 2;
+    const unsigned int dataBytes = n * (sizeof(float) + sizeof(int));
+    record.resize(sizeof(numWords) + dataBytes);
+    memcpy(&record[0], &numWords, sizeof(numWords));
+    if (gzread(in, &record[sizeof(numWords)], dataBytes) != (int) dataBytes) {
+      printf("ERROR: truncated record %lu.\n", records);
+      status = 3;
+      break;
+    }
+
+    if (print) {
+      const float *f = (const float *) &record[sizeof(numWords)];
+      const int *l = (const int *) &record[sizeof(numWords) + n * sizeof(float)];
+      printf("%i\n", numWords);
+      for (unsigned int i = 0; i < n; i++)
+        printf("%g ", f[i]);
+      printf("\n");
+      for (unsigned int i = 0; i < n; i++)
+        printf("%i ", l[i]);
+      printf("\n");
+    }
+
+    if (out)
+      fwrite(&record[0], 1, record.size(), out);
+    if (gzOut)
+      gzwrite(gzOut, &record[0], record.size());
+
+    records++;
+    words += numWords;
+  }
+
+  gzclose(in);
+  if (out)
+    fclose(out);
+  if (gzOut)
+    gzclose(gzOut);
+
+  printf("%s: %lu records, %lu words\n", inputFile.c_str(), records, words);
+
+  return status;
+}
@@ -7,14 +7,21 @@
 ****************************************************************************/
 
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <string>
 #include <vector>
+#include <algorithm>
+#include <atomic>
 
 #include <Math/Rotation3D.h>
 
 #include "Geometry/VeryForwardGeometryBuilder/interface/RPAlignmentCorrectionsMethods.h"
 #include "DataFormats/CTPPSAlignment/interface/RPAlignmentCorrectionsData.h"
 #include "Alignment/RPTrackBased/interface/AlignmentGeometry.h"
+#include "Alignment/RPTrackBased/interface/RunParallel.h"
+
+#include <xercesc/util/PlatformUtils.hpp>
 
 
 using namespace std;
@@ -57,40 +64,90 @@ void AlignmentGeometry_LoadFromFile(AlignmentGeometry &ag, const std::string fil
 
 //----------------------------------------------------------------------------------------------------
 
-int main()
+/// expands and refactors the cumulative results of all algorithms in one directory
+void Refactor(const string &dir)
 {
-  try {
-    AlignmentGeometry geom;
-    
-    //geom.LoadFromFile("geometry");
-    AlignmentGeometry_LoadFromFile(geom, "geometry");
-  
-  
-    vector<string> algorithms;
-    algorithms.push_back("Jan");
-    algorithms.push_back("Ideal");
-  
-    for (vector<string>::iterator it = algorithms.begin(); it != algorithms.end(); ++it) {
-      printf("> %s\n", it->c_str());
-      string input_file = string("./cumulative_results_") + *it + ".xml";
-      RPAlignmentCorrectionsData input(RPAlignmentCorrectionsMethods::GetCorrectionsDataFromFile(input_file));
-  
-      RPAlignmentCorrectionsData expanded, factored;
+  AlignmentGeometry geom;
   
-      RPAlignmentCorrectionsMethods::FactorRPFromSensorCorrections(input, expanded, factored, geom, 2);
-    
-      string exp_output_file = string("expanded_results_") + *it + ".xml";
-      RPAlignmentCorrectionsMethods::WriteXMLFile(expanded, exp_output_file);
+  //geom.LoadFromFile("geometry");
+  AlignmentGeometry_LoadFromFile(geom, dir + "/geometry");
+
+
+  vector<string> algorithms;
+  algorithms.push_back("Jan");
+  algorithms.push_back("Ideal");
+
+  for (vector<string>::iterator it = algorithms.begin(); it != algorithms.end(); ++it) {
+    printf("> %s: %s\n", dir.c_str(), it->c_str());
+    string input_file = dir + "/cumulative_results_" + *it + ".xml";
+    RPAlignmentCorrectionsData input(RPAlignmentCorrectionsMethods::ParseXMLFile(input_file));
+
+    RPAlignmentCorrectionsData expanded, factored;
+
+    RPAlignmentCorrectionsMethods::FactorRPFromSensorCorrections(input, expanded, factored, geom, 2);
   
-      string refac_output_file = string("refactored_results_") + *it + ".xml";
-      RPAlignmentCorrectionsMethods::WriteXMLFile(factored, refac_output_file);
-    }
-  }
-  catch (...) {
-    printf("Exception caught.\n");
-    return 1;
+    string exp_output_file = dir + "/expanded_results_" + *it + ".xml";
+    RPAlignmentCorrectionsMethods::WriteXMLFile(expanded, exp_output_file);
+
+    string refac_output_file = dir + "/refactored_results_" + *it + ".xml";
+    RPAlignmentCorrectionsMethods::WriteXMLFile(factored, refac_output_file);
   }
+}
+
+//----------------------------------------------------------------------------------------------------
 
-  return 0;
+void PrintHelp(const char *name)
+{
+  printf("USAGE: %s [-j threads] [directory ...]\n", name);
+  printf("       %s --help (to print this help)\n", name);
+  printf("PARAMETERS:\n");
+  printf("\tthreads\t number of directories processed in parallel (default: number of cores)\n");
+  printf("\tdirectory\t directory with the geometry and cumulative result files (default: current directory)\n");
 }
 
+//----------------------------------------------------------------------------------------------------
+
+int main(int argc, const char* argv[])
+{
+  unsigned int threads = DefaultThreads();
+
+  vector<string> dirs;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+      PrintHelp(argv[0]);
+      return 0;
+    }
+
+    if (!strcmp(argv[i], "-j") && i + 1 < argc) {
+      threads = max(1, atoi(argv[++i]));
+      continue;
+    }
+
+    // relative paths must start with ./ (see RPAlignmentCorrectionsMethods::ParseXMLFile)
+    string dir = argv[i];
+    if (dir[0] != '/' && dir.find("./") != 0)
+      dir = "./" + dir;
+    dirs.push_back(dir);
+  }
+
+  if (dirs.empty())
+    dirs.push_back(".");
+
+  // Xerces is initialized once for all threads
+  xercesc::XMLPlatformUtils::Initialize();
+
+  atomic<unsigned int> failed(0);
+  RunParallel(dirs.size(), threads, [&] (unsigned int i) {
+    try {
+      Refactor(dirs[i]);
+    }
+    catch (...) {
+      printf("Exception caught in directory `%s'.\n", dirs[i].c_str());
+      failed++;
+    }
+  });
+
+  xercesc::XMLPlatformUtils::Terminate();
+
+  return (failed > 0) ? 1 : 0;
+}
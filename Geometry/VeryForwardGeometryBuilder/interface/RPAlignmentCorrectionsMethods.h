@@ -31,6 +31,10 @@ class RPAlignmentCorrectionsMethods
 
     static RPAlignmentCorrectionsData GetCorrectionsDataFromFile(const std::string &fileName);
 
+    /// as GetCorrectionsDataFromFile, but Xerces must have been initialized by the caller
+    /// (XMLPlatformUtils::Initialize), can then be called from several threads at once
+    static RPAlignmentCorrectionsData ParseXMLFile(const std::string &fileName);
+
     static RPAlignmentCorrectionsData GetCorrectionsData(xercesc::DOMNode *);
 
     static void WriteXML(const RPAlignmentCorrectionData & data, FILE *f, bool precise, bool wrErrors, bool wrSh_r, bool wrSh_xy, bool wrSh_z, bool wrRot_z);
@@ -34,13 +34,6 @@ RPAlignmentCorrectionsData RPAlignmentCorrectionsMethods::GetCorrectionsDataFrom
 {
   printf(">> RPAlignmentCorrectionsMethods::LoadXMLFile(%s)\n", fileName.c_str());
 
-  // prepend CMSSW src dir
-  char *cmsswPath = getenv("CMSSW_BASE");
-  size_t start = fileName.find_first_not_of("   ");
-  string fn = fileName.substr(start);
-  if (cmsswPath && fn[0] != '/' && fn.find("./") != 0)
-    fn = string(cmsswPath) + string("/src/") + fn;
-
   // load DOM tree first the file
   try {
     XMLPlatformUtils::Initialize();
@@ -51,21 +44,37 @@ RPAlignmentCorrectionsData RPAlignmentCorrectionsMethods::GetCorrectionsDataFrom
     XMLString::release(&message);
   }
 
-  XercesDOMParser* parser = new XercesDOMParser();
-  parser->setValidationScheme(XercesDOMParser::Val_Always);
-  parser->setDoNamespaces(true);
+  RPAlignmentCorrectionsData d = ParseXMLFile(fileName);
+
+  XMLPlatformUtils::Terminate();
+
+  return d;
+}
+
+//----------------------------------------------------------------------------------------------------
+
+RPAlignmentCorrectionsData RPAlignmentCorrectionsMethods::ParseXMLFile(const string &fileName)
+{
+  // prepend CMSSW src dir
+  char *cmsswPath = getenv("CMSSW_BASE");
+  size_t start = fileName.find_first_not_of("   ");
+  string fn = fileName.substr(start);
+  if (cmsswPath && fn[0] != '/' && fn.find("./") != 0)
+    fn = string(cmsswPath) + string("/src/") + fn;
+
+  // each call has its own parser
+  XercesDOMParser parser;
+  parser.setValidationScheme(XercesDOMParser::Val_Always);
+  parser.setDoNamespaces(true);
 
   try {
-    parser->parse(fn.c_str());
+    parser.parse(fn.c_str());
   }
   catch (...) {
     throw cms::Exception("RPAlignmentCorrectionsMethods") << "Cannot parse file `" << fn << "' (exception)." << endl;
   }
 
-  if (!parser)
-    throw cms::Exception("RPAlignmentCorrectionsMethods") << "Cannot parse file `" << fn << "' (parser = NULL)." << endl;
-  
-  DOMDocument* xmlDoc = parser->getDocument();
+  DOMDocument* xmlDoc = parser.getDocument();
 
   if (!xmlDoc)
     throw cms::Exception("RPAlignmentCorrectionsMethods") << "Cannot parse file `" << fn << "' (xmlDoc = NULL)." << endl;
@@ -74,11 +83,7 @@ RPAlignmentCorrectionsData RPAlignmentCorrectionsMethods::GetCorrectionsDataFrom
   if (!elementRoot)
     throw cms::Exception("RPAlignmentCorrectionsMethods") << "File `" << fn << "' is empty." << endl;
 
-  RPAlignmentCorrectionsData d = GetCorrectionsData(elementRoot);
-
-  XMLPlatformUtils::Terminate();
-
-  return d;
+  return GetCorrectionsData(elementRoot);
 }
 
 //----------------------------------------------------------------------------------------------------
@@ -0,0 +1,7 @@
+import FWCore.ParameterSet.Config as cms
+
+# columnar copies of the reconstructed protons, an empty label switches the conversion off
+RPCompactProtonConverter = cms.EDProducer("RPCompactProtonConverter",
+    ProtonCollectionLabel = cms.InputTag("RP220Reconst"),
+    ProtonPairCollectionLabel = cms.InputTag("")
+)
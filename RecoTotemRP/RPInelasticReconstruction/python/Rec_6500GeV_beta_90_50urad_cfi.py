@@ -61,6 +61,8 @@ RP220Reconst = cms.EDProducer("RPPrimaryVertexInelasticReconstruction_RunI",
     RandomSearchProbability = cms.double(0.3),
 
     InitIterationsNumber = cms.int32(20),
+    LinearizedInitialization = cms.bool(False), # closed-form initialization tried first, the random xi search is the fallback; off until validated
+    ParallelFits = cms.bool(False), # fit the arms concurrently
     MaxChiSqNDFOfConvergedProton = cms.double(50.0),
     MaxChiSqOfConvergedInitialisation = cms.double(100.0),
     MaxAllowedReconstructedXi = cms.double(0.05),
@@ -0,0 +1,85 @@
+/****************************************************************************
+*
+* This is a part of TOTEM offline software.
+* Converts the reconstructed proton (pair) collections into the columnar
+* RPCompactProtonCollection (RPCompactProtonPairCollection) format.
+*
+****************************************************************************/
+
+#include "FWCore/Framework/interface/EDProducer.h"
+#include "FWCore/Framework/interface/Event.h"
+#include "FWCore/Framework/interface/EventSetup.h"
+#include "FWCore/Framework/interface/MakerMacros.h"
+#include "FWCore/ParameterSet/interface/ParameterSet.h"
+#include "FWCore/Utilities/interface/InputTag.h"
+
+#include "RecoTotemRP/RPRecoDataFormats/interface/RPReconstructedProtonCollection.h"
+#include "RecoTotemRP/RPRecoDataFormats/interface/RPReconstructedProtonPairCollection.h"
+#include "RecoTotemRP/RPRecoDataFormats/interface/RPCompactProtonCollection.h"
+
+#include <memory>
+
+//----------------------------------------------------------------------------------------------------
+
+class RPCompactProtonConverter : public edm::EDProducer
+{
+  public:
+    explicit RPCompactProtonConverter(const edm::ParameterSet& conf);
+    virtual ~RPCompactProtonConverter() {}
+    virtual void produce(edm::Event& e, const edm::EventSetup& c);
+
+  private:
+    bool convertProtons, convertProtonPairs;
+    edm::EDGetTokenT<RPReconstructedProtonCollection> protonCollectionToken;
+    edm::EDGetTokenT<RPReconstructedProtonPairCollection> protonPairCollectionToken;
+};
+
+using namespace std;
+using namespace edm;
+
+//----------------------------------------------------------------------------------------------------
+
+RPCompactProtonConverter::RPCompactProtonConverter(const edm::ParameterSet& conf)
+{
+  // an empty label switches the conversion off
+  InputTag protonCollectionLabel = conf.exists("ProtonCollectionLabel") ?
+    conf.getParameter<InputTag>("ProtonCollectionLabel") : InputTag();
+  InputTag protonPairCollectionLabel = conf.exists("ProtonPairCollectionLabel") ?
+    conf.getParameter<InputTag>("ProtonPairCollectionLabel") : InputTag();
+
+  convertProtons = !protonCollectionLabel.label().empty();
+  convertProtonPairs = !protonPairCollectionLabel.label().empty();
+
+  if (convertProtons)
+  {
+    protonCollectionToken = consumes<RPReconstructedProtonCollection>(protonCollectionLabel);
+    produces<RPCompactProtonCollection>();
+  }
+
+  if (convertProtonPairs)
+  {
+    protonPairCollectionToken = consumes<RPReconstructedProtonPairCollection>(protonPairCollectionLabel);
+    produces<RPCompactProtonPairCollection>();
+  }
+}
+
+//----------------------------------------------------------------------------------------------------
+
+void RPCompactProtonConverter::produce(edm::Event& e, const edm::EventSetup& c)
+{
+  if (convertProtons)
+  {
+    Handle<RPReconstructedProtonCollection> protons;
+    e.getByToken(protonCollectionToken, protons);
+    e.put(make_unique<RPCompactProtonCollection>(*protons));
+  }
+
+  if (convertProtonPairs)
+  {
+    Handle<RPReconstructedProtonPairCollection> pairs;
+    e.getByToken(protonPairCollectionToken, pairs);
+    e.put(make_unique<RPCompactProtonPairCollection>(*pairs));
+  }
+}
+
+DEFINE_FWK_MODULE(RPCompactProtonConverter);
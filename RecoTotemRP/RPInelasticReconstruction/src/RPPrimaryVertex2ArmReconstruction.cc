@@ -23,6 +23,8 @@
 #include <iostream>
 #include <memory>
 
+#include "tbb/task_group.h"
+
 #include "TFile.h"
 #include "TVector3.h"
 #include "TRandom2.h"
@@ -66,6 +68,18 @@ class RPPrimaryVertex2ArmReconstruction : public edm::EDProducer
     int verbosity_;
     std::auto_ptr<RPInverse2SidedParameterization> inv_param_;
 
+    /// one independent proton-pair fit: the hits of both arms and the fitter of the pair
+    struct FitTask
+    {
+      const rec_tracks_collection *hits_left;
+      const rec_tracks_collection *hits_right;
+      RPInverse2SidedParameterization *fitter;
+    };
+
+    /// whether the fit tasks of an event run concurrently
+    /// (the fitter reads the same parameter and then runs its two one-arm initialisation fits concurrently)
+    bool parallel_fits_;
+
     std::string param_file_name_220_right_;
     std::string param_file_name_220_left_;
     std::string param_file_name_210_right_;
@@ -111,9 +125,13 @@ class RPPrimaryVertex2ArmReconstruction : public edm::EDProducer
     bool CollectionContainsBotRP(const rec_tracks_collection& track_coll);
     bool CollectionContainsTopRP(const rec_tracks_collection& track_coll);   
 
+    /// Runs the fit tasks, each with its own fitter, and stores the proton pairs in the order of the tasks.
+    void RunFitTasks(const std::vector<FitTask> &tasks, RPReconstructedProtonPairCollection &rec_prot_pair_col,
+      bool external_prim_vertex);
+
     void Reconstruct(const rec_tracks_collection &rec_col_1, 
       const rec_tracks_collection &rec_col_2, RPInverse2SidedParameterization &inv_par, 
-      RPReconstructedProtonPairCollection & rec_prot_pair_col, bool eternal_prim_vert);
+      RPReconstructedProtonPair &rec_prot_pair, bool eternal_prim_vert);
     
     // TODO: remove ??
     /*
@@ -277,6 +295,8 @@ void RPPrimaryVertex2ArmReconstruction::beginRun(edm::Run const& r, edm::EventSe
   
   inv_param_ = std::auto_ptr<RPInverse2SidedParameterization>(new RPInverse2SidedParameterization(conf_, BOPar_));
 
+  parallel_fits_ = conf_.exists("ParallelFits") ? conf_.getParameter<bool>("ParallelFits") : false;
+
   verbosity_ = conf_.getParameter<int>("Verbosity");
   inv_param_->Verbosity(verbosity_);
   
@@ -366,15 +386,19 @@ void RPPrimaryVertex2ArmReconstruction::produce(edm::Event& e, const edm::EventS
     allow_elastic_recon = true;
   }
   
+  // collect the fits: one pair per event, as SelectHits keeps one hit set per arm
+  std::vector<FitTask> tasks;
   if (right_reconstructable && left_reconstructable && allow_elastic_recon)
   {
     AddInStationMultipleScatteringContribution(hits_l, rp_multiple_scattering_sigma_);
     AddInStationMultipleScatteringContribution(hits_r, rp_multiple_scattering_sigma_);
     
-    Reconstruct(hits_l, hits_r, *inv_param_, 
-        reconstructed_proton_pair_collection, 
-        external_primary_vertex_ || set_primary_vertex_to_zero_);
+    FitTask task = { &hits_l, &hits_r, inv_param_.get() };
+    tasks.push_back(task);
   }
+
+  // run the reconstruction
+  RunFitTasks(tasks, reconstructed_proton_pair_collection, external_primary_vertex_ || set_primary_vertex_to_zero_);
   
   e.put(make_unique<RPReconstructedProtonPairCollection>(reconstructed_proton_pair_collection));
 }
@@ -555,9 +579,40 @@ int RPPrimaryVertex2ArmReconstruction::SelectHits(const DetSetVector<TotemRPLoca
 
 //----------------------------------------------------------------------------------------------------
 
+void RPPrimaryVertex2ArmReconstruction::RunFitTasks(const std::vector<FitTask> &tasks,
+  RPReconstructedProtonPairCollection &rec_prot_pair_col, bool external_prim_vertex)
+{
+  // each task writes only to its own slot, the output order does not depend on the scheduling
+  std::vector<RPReconstructedProtonPair> results(tasks.size());
+
+  if (parallel_fits_ && tasks.size() > 1)
+  {
+    // the fits go to the TBB pool of the framework, no threads are started by the module
+    tbb::task_group group;
+    for (unsigned int i = 1; i < tasks.size(); ++i)
+    {
+      group.run([this, &tasks, &results, i, external_prim_vertex]() {
+        Reconstruct(*tasks[i].hits_left, *tasks[i].hits_right, *tasks[i].fitter, results[i], external_prim_vertex);
+      });
+    }
+
+    Reconstruct(*tasks[0].hits_left, *tasks[0].hits_right, *tasks[0].fitter, results[0], external_prim_vertex);
+
+    group.wait();
+  } else {
+    for (unsigned int i = 0; i < tasks.size(); ++i)
+      Reconstruct(*tasks[i].hits_left, *tasks[i].hits_right, *tasks[i].fitter, results[i], external_prim_vertex);
+  }
+
+  for (const auto &rec_prot_pair : results)
+    rec_prot_pair_col.push_back(rec_prot_pair);
+}
+
+//----------------------------------------------------------------------------------------------------
+
 void RPPrimaryVertex2ArmReconstruction::Reconstruct(const rec_tracks_collection &rec_col_1, 
     const rec_tracks_collection &rec_col_2, RPInverse2SidedParameterization &inv_par, 
-    RPReconstructedProtonPairCollection & rec_prot_pair_col, bool external_prim_vertex)
+    RPReconstructedProtonPair &rec_prot_pair, bool external_prim_vertex)
 {
   inv_par.ClearEvent();
   inv_par.AddProtonAtRPCollection(rec_col_1);
@@ -566,12 +621,10 @@ void RPPrimaryVertex2ArmReconstruction::Reconstruct(const rec_tracks_collection
   if(external_prim_vertex)
     inv_par.SetPrimaryVertex(primary_vertex_, primary_vertex_error_);
   
-  RPReconstructedProtonPair rec_prot_pair;
   if(verbosity_)
     inv_par.PrintFittedHitsInfo(std::cout);
     
   inv_par.Fit(rec_prot_pair);
-  rec_prot_pair_col.push_back(rec_prot_pair);
 }
 
 DEFINE_FWK_MODULE(RPPrimaryVertex2ArmReconstruction);
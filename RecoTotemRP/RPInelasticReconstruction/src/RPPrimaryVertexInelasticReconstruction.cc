@@ -40,6 +40,8 @@
 #include <map>
 #include <memory>
 
+#include "tbb/task_group.h"
+
 /**
  \brief Inelastic proton reconstruction.
 **/
@@ -67,6 +69,17 @@ class RPPrimaryVertexInelasticReconstruction : public edm::EDProducer
     std::auto_ptr<RPInverseParameterization> inv_param_right_;
     std::auto_ptr<RPInverseParameterization> inv_param_left_;
 
+    /// one independent proton fit: the hits of one arm and the fitter of that arm
+    struct FitTask
+    {
+      const rec_tracks_collection *hits;
+      RPInverseParameterization *fitter;
+      double zdirection;
+    };
+
+    /// whether the fit tasks of an event run concurrently
+    bool parallel_fits_;
+
     std::string param_file_name_220_right_;
     std::string param_file_name_220_left_;
     std::string param_file_name_210_right_;
@@ -112,9 +125,13 @@ class RPPrimaryVertexInelasticReconstruction : public edm::EDProducer
     /// Returns the number of vertices found.
     bool FindPrimaryVertex(edm::Event& e);
 
+    /// Runs the fit tasks, each with its own fitter, and stores the protons in the order of the tasks.
+    void RunFitTasks(const std::vector<FitTask> &tasks, RPReconstructedProtonCollection &rec_prot_col,
+      bool external_prim_vertex);
+
     /// Runs the proton reconstruction for one arm.
     void Reconstruct(const rec_tracks_collection &rec_col, RPInverseParameterization &inv_par,
-      RPReconstructedProtonCollection & rec_prot_col, double zdirection, bool eternal_prim_vert);
+      RPReconstructedProton &rec_prot, double zdirection, bool eternal_prim_vert);
 };
 
 //----------------------------------------------------------------------------------------------------
@@ -258,6 +275,8 @@ void RPPrimaryVertexInelasticReconstruction::beginRun(edm::Run const&, edm::Even
   inv_param_right_ = std::auto_ptr<RPInverseParameterization>(new RPInverseParameterization(1.0, conf_, BOPar_));
   inv_param_left_ = std::auto_ptr<RPInverseParameterization>(new RPInverseParameterization(-1.0, conf_, BOPar_));
 
+  parallel_fits_ = conf_.exists("ParallelFits") ? conf_.getParameter<bool>("ParallelFits") : false;
+
   verbosity_ = conf_.getParameter<int>("Verbosity");
   inv_param_right_->Verbosity(verbosity_);
   inv_param_left_->Verbosity(verbosity_);
@@ -357,23 +376,25 @@ void RPPrimaryVertexInelasticReconstruction::produce(edm::Event& e, const edm::E
   printf("right_reconstructable = %u\n", right_reconstructable);
   */
   
-  // run the reconstruction
+  // collect the fits: left arm first, then right arm
+  std::vector<FitTask> tasks;
   if (left_reconstructable)
   {
     AddInStationMultipleScatteringContribution(hits_l, rp_multiple_scattering_sigma_);
-    //printf("* reconstruction left\n");
-    Reconstruct(hits_l, *inv_param_left_, reconstructed_proton_collection, -1.0,
-      external_primary_vertex_ || set_primary_vertex_to_zero_);
+    FitTask task = { &hits_l, inv_param_left_.get(), -1.0 };
+    tasks.push_back(task);
   }
 
   if (right_reconstructable)
   {
     AddInStationMultipleScatteringContribution(hits_r, rp_multiple_scattering_sigma_);
-    //printf("* reconstruction right\n");
-    Reconstruct(hits_r, *inv_param_right_, reconstructed_proton_collection, 1.0,
-      external_primary_vertex_ || set_primary_vertex_to_zero_);
+    FitTask task = { &hits_r, inv_param_right_.get(), 1.0 };
+    tasks.push_back(task);
   }
 
+  // run the reconstruction
+  RunFitTasks(tasks, reconstructed_proton_collection, external_primary_vertex_ || set_primary_vertex_to_zero_);
+
   e.put(make_unique<RPReconstructedProtonCollection>(reconstructed_proton_collection));
 }
 
@@ -518,9 +539,40 @@ int RPPrimaryVertexInelasticReconstruction::SelectHits(const DetSetVector<TotemR
 
 //----------------------------------------------------------------------------------------------------
 
+void RPPrimaryVertexInelasticReconstruction::RunFitTasks(const std::vector<FitTask> &tasks,
+  RPReconstructedProtonCollection &rec_prot_col, bool external_prim_vertex)
+{
+  // each task writes only to its own slot, the output order does not depend on the scheduling
+  std::vector<RPReconstructedProton> results(tasks.size());
+
+  if (parallel_fits_ && tasks.size() > 1)
+  {
+    // the fits go to the TBB pool of the framework, no threads are started by the module
+    tbb::task_group group;
+    for (unsigned int i = 1; i < tasks.size(); ++i)
+    {
+      group.run([this, &tasks, &results, i, external_prim_vertex]() {
+        Reconstruct(*tasks[i].hits, *tasks[i].fitter, results[i], tasks[i].zdirection, external_prim_vertex);
+      });
+    }
+
+    Reconstruct(*tasks[0].hits, *tasks[0].fitter, results[0], tasks[0].zdirection, external_prim_vertex);
+
+    group.wait();
+  } else {
+    for (unsigned int i = 0; i < tasks.size(); ++i)
+      Reconstruct(*tasks[i].hits, *tasks[i].fitter, results[i], tasks[i].zdirection, external_prim_vertex);
+  }
+
+  for (const auto &rec_prot : results)
+    rec_prot_col.push_back(rec_prot);
+}
+
+//----------------------------------------------------------------------------------------------------
+
 void RPPrimaryVertexInelasticReconstruction::Reconstruct(const rec_tracks_collection &rec_col,
   RPInverseParameterization &inv_par,
-  RPReconstructedProtonCollection & rec_prot_col, double zdirection, bool external_prim_vertex)
+  RPReconstructedProton &rec_prot, double zdirection, bool external_prim_vertex)
 {
   inv_par.ClearEvent();
   inv_par.AddProtonAtRPCollection(rec_col);
@@ -528,7 +580,6 @@ void RPPrimaryVertexInelasticReconstruction::Reconstruct(const rec_tracks_collec
   if (external_prim_vertex)
     inv_par.SetPrimaryVertex(primary_vertex_, primary_vertex_error_);
 
-  RPReconstructedProton rec_prot;
   rec_prot.Fitted(RPReconstructedProton::nx, true);
   rec_prot.Fitted(RPReconstructedProton::ntheta_x, true);
   rec_prot.Fitted(RPReconstructedProton::ny, true);
@@ -541,8 +592,6 @@ void RPPrimaryVertexInelasticReconstruction::Reconstruct(const rec_tracks_collec
   inv_par.Fit(rec_prot);
 
   //printf("rec_prot.Valid = %u, xi=%.4f, th_x=%.2E, th_y=%.2E\n", rec_prot.Valid(), rec_prot.Ksi(), rec_prot.Theta_x(), rec_prot.Theta_y());
-
-  rec_prot_col.push_back(rec_prot);
 }
 
 DEFINE_FWK_MODULE(RPPrimaryVertexInelasticReconstruction);
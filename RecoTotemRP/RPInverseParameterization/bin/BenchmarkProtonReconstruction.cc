@@ -0,0 +1,138 @@
+#include "RecoTotemRP/RPInverseParameterization/interface/ProtonReconstructionBenchmark.h"
+#include "TotemProtonTransport/TotemRPProtonTransportParametrization/interface/LHCOpticsApproximator.h"
+#include "TFile.h"
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+
+//sets a fitter parameter given as Name=value, the type is taken from the default configuration
+//parameters not present there (the optional switches) are accepted as bool
+bool SetFitterParameter(edm::ParameterSet &conf, const std::string &arg)
+{
+  size_t eq = arg.find('=');
+  if(eq == std::string::npos)
+    return false;
+
+  std::string name = arg.substr(0, eq);
+  std::string value = arg.substr(eq + 1);
+
+  if(conf.existsAs<double>(name))
+    conf.addParameter<double>(name, atof(value.c_str()));
+  else if(conf.existsAs<int>(name))
+    conf.addParameter<int>(name, atoi(value.c_str()));
+  else if(value == "true" || value == "false")
+    conf.addParameter<bool>(name, value == "true");
+  else
+    return false;
+  return true;
+}
+
+//benchmarks the one-arm and two-arm proton fits on generated protons
+int main(int argc, char *args[])
+{
+  if(argc < 3)
+  {
+    std::cout<<"Usage: "<<args[0]<<" <protons> <toy | optics ROOT file> [<rp id>:<approximator>:<z [mm]> ...] [<fitter parameter>=<value> ...]"<<std::endl;
+    std::cout<<"  the pots with id >= 100 belong to the right arm, toy optics come with pots 20, 24, 120 and 124"<<std::endl;
+    return 1;
+  }
+
+  ProtonReconstructionBenchmark::Settings settings;
+  settings.protons = atoi(args[1]);
+
+  edm::ParameterSet conf = ProtonReconstructionBenchmark::DefaultFitterConfig();
+  BeamOpticsParams bop = ProtonReconstructionBenchmark::DefaultBeamOpticsParams();
+
+  ProtonReconstructionBenchmark::transport_to_rp_type optics_right, optics_left;
+  ProtonReconstructionBenchmark::rp_z_type rp_z;
+
+  bool toy = !strcmp(args[2], "toy");
+  TFile *f = NULL;
+  if(toy)
+  {
+    optics_right[120] = ProtonReconstructionBenchmark::MakeToyOptics("lhcb1", 20., 2., 0.05);
+    optics_right[124] = ProtonReconstructionBenchmark::MakeToyOptics("lhcb1", 15., 3., 0.07);
+    optics_left[20] = ProtonReconstructionBenchmark::MakeToyOptics("lhcb2", 20., 2., 0.05);
+    optics_left[24] = ProtonReconstructionBenchmark::MakeToyOptics("lhcb2", 15., 3., 0.07);
+    rp_z[120] = 214630.;
+    rp_z[124] = 220000.;
+    rp_z[20] = -214630.;
+    rp_z[24] = -220000.;
+  }
+  else
+  {
+    f = TFile::Open(args[2]);
+    if(!f || f->IsZombie())
+    {
+      std::cout<<"File "<<args[2]<<" cannot be opened."<<std::endl;
+      return 1;
+    }
+  }
+
+  for(int i=3; i<argc; i++)
+  {
+    std::string arg(args[i]);
+    if(arg.find('=') != std::string::npos)
+    {
+      if(!SetFitterParameter(conf, arg))
+      {
+        std::cout<<"Invalid fitter parameter "<<arg<<std::endl;
+        return 1;
+      }
+      continue;
+    }
+
+    size_t c1 = arg.find(':'), c2 = arg.rfind(':');
+    if(!f || c1 == std::string::npos || c1 == c2)
+    {
+      std::cout<<"Invalid pot definition "<<arg<<std::endl;
+      return 1;
+    }
+
+    unsigned int rp_id = atoi(arg.substr(0, c1).c_str());
+    std::string name = arg.substr(c1 + 1, c2 - c1 - 1);
+    LHCOpticsApproximator *approx = (LHCOpticsApproximator *) f->Get(name.c_str());
+    if(!approx)
+    {
+      std::cout<<"Approximator "<<name<<" not found."<<std::endl;
+      return 1;
+    }
+
+    (rp_id >= 100 ? optics_right : optics_left)[rp_id] = *approx;
+    rp_z[rp_id] = atof(arg.substr(c2 + 1).c_str());
+  }
+
+  if(f)
+    f->Close();
+
+  if(optics_right.size() >= 2)
+  {
+    RPInverseParameterization fitter(1.0, conf, bop);
+    fitter.SetParameterizations(optics_right);
+    ProtonReconstructionBenchmark benchmark(settings);
+    std::cout<<"one-arm fit, right arm"<<std::endl;
+    benchmark.RunOneArm(fitter, optics_right, rp_z, 1.0).Print(std::cout);
+  }
+
+  if(optics_left.size() >= 2)
+  {
+    RPInverseParameterization fitter(-1.0, conf, bop);
+    fitter.SetParameterizations(optics_left);
+    ProtonReconstructionBenchmark benchmark(settings);
+    std::cout<<"one-arm fit, left arm"<<std::endl;
+    benchmark.RunOneArm(fitter, optics_left, rp_z, -1.0).Print(std::cout);
+  }
+
+  if(optics_right.size() >= 2 && optics_left.size() >= 2)
+  {
+    RPInverse2SidedParameterization fitter(conf, bop);
+    fitter.AddParameterizationsRight(optics_right);
+    fitter.AddParameterizationsLeft(optics_left);
+    ProtonReconstructionBenchmark benchmark(settings);
+    std::cout<<"two-arm fit"<<std::endl;
+    benchmark.RunTwoArm(fitter, optics_right, optics_left, rp_z).Print(std::cout);
+  }
+
+  return 0;
+}
@@ -0,0 +1,26 @@
+#ifndef RecoTotemRPRPInverseParameterizationinterfaceAnalyticGradientFCN_h
+#define RecoTotemRPRPInverseParameterizationinterfaceAnalyticGradientFCN_h
+
+#include <Minuit2/FCNGradientBase.h>
+#include <vector>
+
+//Minuit2 view of a fitter providing the analytic gradient of its chi2
+//FCN has to provide operator(), Up() and Gradient()
+template <class FCN> class AnalyticGradientFCN : public ROOT::Minuit2::FCNGradientBase
+{
+  public:
+    explicit AnalyticGradientFCN(const FCN &fcn) : fcn_(fcn) {}
+    virtual ~AnalyticGradientFCN() {}
+
+    virtual double operator()(const std::vector<double>& par) const {return fcn_(par);}
+    virtual double Up() const {return fcn_.Up();}
+    virtual std::vector<double> Gradient(const std::vector<double>& par) const {return fcn_.Gradient(par);}
+
+    //the gradients are verified by the unit tests, no need for the Minuit2 numerical check
+    virtual bool CheckGradient() const {return false;}
+
+  private:
+    const FCN &fcn_;
+};
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef RecoTotemRP_RPInverseParameterization_ProtonReconstructionBenchmark_h
+#define RecoTotemRP_RPInverseParameterization_ProtonReconstructionBenchmark_h
+
+#include "RecoTotemRP/RPInverseParameterization/interface/RPInverseParameterization.h"
+#include "RecoTotemRP/RPInverseParameterization/interface/RPInverse2SidedParameterization.h"
+#include "TotemProtonTransport/TotemRPProtonTransportParametrization/interface/LHCOpticsApproximator.h"
+#include "TotemCondFormats/BeamOpticsParamsObjects/interface/BeamOpticsParams.h"
+#include "FWCore/ParameterSet/interface/ParameterSet.h"
+#include "TRandom3.h"
+#include <map>
+#include <vector>
+#include <string>
+#include <iostream>
+
+
+/**
+ *\brief Standalone speed and accuracy benchmark of the proton reconstruction fitters.
+ * Protons with known kinematics are generated, transported with the given optics to the pots,
+ * the hits are smeared with the hit resolution and fitted. Reported are the fit rate, the FCN calls
+ * per fit and, per parameter, the bias, the residual RMS and the pulls of the converged fits.
+**/
+class ProtonReconstructionBenchmark
+{
+  public:
+    typedef std::map<unsigned int, LHCOpticsApproximator> transport_to_rp_type;
+    typedef std::map<unsigned int, double> rp_z_type;  ///< z position of the pots [mm], negative for the left arm
+
+    struct Settings
+    {
+      unsigned int protons;
+      unsigned int seed;
+      double hit_resolution;    ///< [mm]
+      double vertex_sigma_xy;   ///< [mm]
+      double vertex_sigma_z;    ///< [mm]
+      double theta_sigma;       ///< [rad]
+      double xi_min, xi_max;
+      bool constrain_vertex;    ///< vertex constraint at the origin with the vertex sigmas, as in the reconstruction
+
+      Settings();
+    };
+
+    struct ParameterStatistics
+    {
+      std::string name;
+      unsigned int entries, pull_entries;
+      double sum_res, sum_res2, sum_pull, sum_pull2;
+
+      explicit ParameterStatistics(const std::string &n = std::string());
+      void Fill(double residual, double variance);
+      double Bias() const;
+      double ResidualRMS() const;
+      double PullMean() const;
+      double PullRMS() const;
+    };
+
+    struct Report
+    {
+      unsigned int fits, converged;
+      double seconds;           ///< spent in the fits
+      unsigned long fcn_calls, gradient_calls;
+      std::vector<ParameterStatistics> parameters;
+
+      Report();
+      double FitsPerSecond() const;
+      double FcnCallsPerFit() const;
+      double GradientCallsPerFit() const;
+      void Print(std::ostream &o) const;
+    };
+
+    explicit ProtonReconstructionBenchmark(const Settings &settings);
+
+    /// one-arm fits; the hits are generated with optics, which can differ from the fitter's optics
+    Report RunOneArm(RPInverseParameterization &fitter, const transport_to_rp_type &optics,
+        const rp_z_type &rp_z, double z_direction);
+
+    /// two-arm fits; the right arm pots have ids >= 100
+    Report RunTwoArm(RPInverse2SidedParameterization &fitter, const transport_to_rp_type &optics_right,
+        const transport_to_rp_type &optics_left, const rp_z_type &rp_z);
+
+    /// toy optics: linear transport with xi-dependent terms, trained on a generated sample
+    /// L: effective length [m], v: magnification, D: dispersion [m]
+    static LHCOpticsApproximator MakeToyOptics(const std::string &beam, double L, double v, double D);
+
+    /// fitter configuration of the 6500 GeV, beta* = 90 m reconstruction
+    static edm::ParameterSet DefaultFitterConfig();
+    static BeamOpticsParams DefaultBeamOpticsParams();
+
+  private:
+    Settings settings_;
+    TRandom3 rand_;
+
+    /// transports par_m (x, theta_x, y, theta_y, xi) [m, rad, m, rad, 1] and smears the hit
+    bool MakeHit(const LHCOpticsApproximator &optics, const double *par_m, double z, RP2DHit &hit);
+};
+
+#endif
@@ -45,6 +45,15 @@ class RPInverse2SidedParameterization : public ROOT::Minuit2::FCNBase
     double FullVarianceCalculation(const std::vector<double>& par) const;
     virtual double Up() const {return 1.0;}
 
+    /// analytic gradient of operator(), requires the fit contexts of both arms (see GradientAvailable)
+    std::vector<double> Gradient(const std::vector<double>& par) const;
+    bool GradientAvailable() const;
+
+    /// number of operator() and Gradient calls since the last reset, including the one-arm initialisation fits
+    unsigned long FcnCalls() const;
+    unsigned long GradientCalls() const;
+    void ResetCallCounters();
+
     void AddRomanPot(unsigned int rp_id, const LHCOpticsApproximator &approx);
     void AddParameterizationsRight(const transport_to_rp_type& param_map);
     void AddParameterizationsLeft(const transport_to_rp_type& param_map);
@@ -71,6 +80,10 @@ class RPInverse2SidedParameterization : public ROOT::Minuit2::FCNBase
           RPReconstructedProtonPair &rec_proton_pair);
     double ElasticReconstrChi2Contrib(const std::vector<double> &par_left, const std::vector<double> &par_right) const;
     double ChiSqPrimaryVertexContrib(const std::vector<double>& par) const;
+    void ElasticReconstrChi2ContribGradient(const std::vector<double> &par_left, const std::vector<double> &par_right,
+        std::vector<double> &gradient) const;
+    void AddArmGradient(const double *arm_gradient, const std::vector<double> &par, bool right_arm,
+        std::vector<double> &gradient) const;
     void FindInitialParameterValues(RPReconstructedProtonPair &rec_proton_pair);
 //    void FindInitialParameterValues(RPReconstructedProtonPair &rec_proton_pair, 
 //            unsigned int param_id);
@@ -78,7 +91,6 @@ class RPInverse2SidedParameterization : public ROOT::Minuit2::FCNBase
     inline bool RightArm(unsigned int id) const {return id>=100;}
     inline bool LeftArm(unsigned int id) const {return id<100;}
     
-    transport_to_rp_type transport_to_rp_;
     hits_at_rp_type hits_at_rp_;
     int verbosity_;
 //    const double beam_energy_;  //GeV
@@ -104,6 +116,9 @@ class RPInverse2SidedParameterization : public ROOT::Minuit2::FCNBase
     
     BeamOpticsParams BOPar_;
     bool elastic_reconstruction_;
+    bool analytic_gradient_;  //Migrad with the analytic chi2 gradient
+    bool parallel_arm_fits_;  //the one-arm initialisation fits run concurrently
+    mutable unsigned long fcn_calls_, gradient_calls_;
 };
 
 #endif
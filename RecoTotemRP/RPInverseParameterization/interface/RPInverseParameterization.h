@@ -41,6 +41,8 @@ class RPInverseParameterization : public ROOT::Minuit2::FCNBase/*, public TMVA::
   public:
     typedef std::map<unsigned int, LHCOpticsApproximator> transport_to_rp_type;
     typedef std::map<unsigned int, RP2DHit> hits_at_rp_type;
+    /// the optics are read-only during the fits and can be shared by several fitters
+    typedef std::shared_ptr<const transport_to_rp_type> shared_transport_type;
     
     RPInverseParameterization(double beam_direction, const edm::ParameterSet& conf,
         const BeamOpticsParams & BOPar);
@@ -52,11 +54,25 @@ class RPInverseParameterization : public ROOT::Minuit2::FCNBase/*, public TMVA::
 //    Double_t EstimatorFunction( std::vector<Double_t>& parameters);
     virtual double Up() const {return 1.0;}
 
+    /// analytic gradient of operator(), requires the fit context (see GradientAvailable)
+    std::vector<double> Gradient(const std::vector<double>& par) const;
+    /// analytic gradient of GetRPChi2Contribution, gradient: 5 values
+    void GetRPChi2ContributionGradient(const std::vector<double>& par, double *gradient) const;
+    /// true if the fit context of the current event allows the analytic gradient
+    bool GradientAvailable() const;
+
+    /// number of operator() and Gradient calls since the last reset
+    unsigned long FcnCalls() const {return fcn_calls_;}
+    unsigned long GradientCalls() const {return gradient_calls_;}
+    void ResetCallCounters() {fcn_calls_ = 0; gradient_calls_ = 0;}
+
     void AddRomanPot(unsigned int rp_id, const LHCOpticsApproximator &approx);
-    void SetParameterizations(const transport_to_rp_type& param_map) {transport_to_rp_ = param_map;}
-    void RemoveRomanPots() {transport_to_rp_.clear(); ClearEvent();}
-    void ClearEvent() {hits_at_rp_.clear(); primary_vertex_set_=false; xi_rec_constrained_=false;}
-    void AddProtonAtRP(unsigned int rp_id, const RP2DHit &hit) {hits_at_rp_[rp_id]=hit;}
+    void SetParameterizations(const transport_to_rp_type& param_map) {transport_to_rp_.reset(new transport_to_rp_type(param_map)); fit_context_.valid=false;}
+    void SetParameterizations(const shared_transport_type& param_map) {transport_to_rp_ = param_map; fit_context_.valid=false;}
+    const shared_transport_type& GetParameterizations() const {return transport_to_rp_;}
+    void RemoveRomanPots() {transport_to_rp_.reset(new transport_to_rp_type()); ClearEvent();}
+    void ClearEvent() {hits_at_rp_.clear(); primary_vertex_set_=false; xi_rec_constrained_=false; fit_context_.valid=false;}
+    void AddProtonAtRP(unsigned int rp_id, const RP2DHit &hit) {hits_at_rp_[rp_id]=hit; fit_context_.valid=false;}
     void AddProtonAtRPCollection(const hits_at_rp_type &hits_at_rp);
     void SetPrimaryVertex(const TVector3 &vert, const TVector3 &error);
 //    void SetPrimaryProton(const HepMC::FourVector &ip_proton) {ip_proton_=ip_proton;}
@@ -72,6 +88,37 @@ class RPInverseParameterization : public ROOT::Minuit2::FCNBase/*, public TMVA::
     void PrintFittedHitsInfo(std::ostream &o);
     
   private:
+    /// per-event data of the chi2 calculation in flat arrays, compiled once per fit in InitializeFit
+    /// so that the FCN calls do not need any map look-ups nor heap allocations
+    struct FitContext
+    {
+      static const unsigned int max_hits = 16;
+      bool valid;
+      bool variance_valid;                          ///< inverted variance matrices copied
+      unsigned int hits;
+      const LHCOpticsApproximator *transport[max_hits];
+      double x[max_hits], y[max_hits];              ///< [mm]
+      double vx[max_hits], vy[max_hits];            ///< [mm^2]
+      int slot[max_hits];                           ///< position of the hit in the z-ordered residual vector, -1 if shadowed
+      unsigned int var_dim;                         ///< dimension of the inverted variance matrices
+      unsigned int y_offset;                        ///< first y residual in the xy-correlated residual vector
+      double inv_var_x[4*max_hits*max_hits];        ///< row-major, [m^-2]; xy-correlated matrix if xyCorrelation
+      double inv_var_y[max_hits*max_hits];          ///< row-major, [m^-2]
+    };
+
+    void CompileFitContext();
+    void CompileFitContextVariance();
+    double SimplifiedChiSqKernel(double par_m[]) const;
+    double FullVarianceKernel(double par_m[]) const;
+    void SimplifiedChiSqKernelGradient(double par_m[], double grad_m[]) const;
+    void FullVarianceKernelGradient(double par_m[], double grad_m[]) const;
+    ROOT::Minuit2::FunctionMinimum Minimize();
+
+    /// deterministic initial estimate: weighted least squares with the optics linearised
+    /// at a few xi nodes, refined by Gauss-Newton steps; returns false if no estimate found
+    bool LinearizedInitialEstimate(std::vector<double> &par) const;
+    bool LinearizedStep(const double *par0, double *par) const;
+
     void InitializeFit(RPReconstructedProton &rec_proton);
     double FitConstrainedXi(RPReconstructedProton &rec_proton, double xi);
     bool FitNonConstrained(RPReconstructedProton &rec_proton);
@@ -85,6 +132,7 @@ class RPInverseParameterization : public ROOT::Minuit2::FCNBase/*, public TMVA::
           RPReconstructedProton &rec_proton);
     double ElasticReconstrChi2Contrib(const std::vector<double>& par) const;
     double ChiSqPrimaryVertexContrib(const std::vector<double>& par) const;
+    void ChiSqPrimaryVertexContribGradient(const std::vector<double>& par, double *gradient) const;
 //    void FindInitialParameterValues(RPReconstructedProton &rec_proton);
 //    void FindInitialParameterValues(RPReconstructedProton &rec_proton, 
 //            unsigned int param_id);
@@ -95,7 +143,7 @@ class RPInverseParameterization : public ROOT::Minuit2::FCNBase/*, public TMVA::
     inline void FitYCoordsOnly() {fit_x_out_coords_=false; fit_y_out_coords_=true;}
     inline void FitXYCoords() {fit_x_out_coords_=true; fit_y_out_coords_=true;}
     
-    transport_to_rp_type transport_to_rp_;
+    shared_transport_type transport_to_rp_;
     hits_at_rp_type hits_at_rp_;
     int verbosity_;
 //    const double beam_energy_;  //GeV
@@ -145,6 +193,10 @@ class RPInverseParameterization : public ROOT::Minuit2::FCNBase/*, public TMVA::
     
     std::auto_ptr<ReconstructionVarianceService> rec_variance_service_;
     bool elastic_reconstruction_;
+    bool analytic_gradient_;  //Migrad with the analytic chi2 gradient
+    bool linearized_initialization_;  //closed-form initialization tried first, the constrained-xi search remains the fallback
+    FitContext fit_context_;
+    mutable unsigned long fcn_calls_, gradient_calls_;
 //
     bool xyCorrelation;
 };
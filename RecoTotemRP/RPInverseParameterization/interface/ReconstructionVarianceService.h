@@ -4,6 +4,9 @@
 #include "FWCore/ParameterSet/interface/ParameterSet.h"
 #include <iostream>
 #include <map>
+#include <utility>
+#include <vector>
+#include <cstdint>
 #include "TMath.h"
 #include "TMatrixD.h"
 #include "RecoTotemRP/RPRecoDataFormats/interface/RP2DHit.h"
@@ -26,8 +29,23 @@ class ReconstructionVarianceService {
     void ComputeInvertedVarianceMatrices(TMatrixD &var_x, TMatrixD &var_y);
 	void ComputeInvertedVarianceMatrix(TMatrixD &var);
 	void PrintMatrix(std::ostream &o, const TMatrixD &m);
+    /// drops the cached inverted matrices
+    void ClearCache() {cache_.clear();}
     
   private:
+    //the matrices depend only on the plane configuration (effective lengths are the drift lengths),
+    //hence the inverted matrices are cached per configuration; z positions are compared with
+    //the tolerance cache_z_tolerance_ [m]
+    //key: the z positions in units of the tolerance, and the matrix type flag followed by the variances
+    typedef std::pair<std::vector<int64_t>, std::vector<double> > cache_key_type;
+    struct CachedMatrices {
+      TMatrixD inv_var_x;  //the joint matrix for ComputeInvertedVarianceMatrix
+      TMatrixD inv_var_y;
+    };
+    typedef std::map<cache_key_type, CachedMatrices> cache_type;
+    cache_key_type CacheKey(bool joint_matrix) const;
+    void StoreInCache(const cache_key_type &key, const TMatrixD &var_x, const TMatrixD &var_y);
+
     void InitTransportApproximatios(const edm::ParameterSet& conf);
     void ComputeStraightSectionProjMatrix(TMatrixD &tr_mat, double length);
 	bool CalculateEffectiveLengthVectors(scattering_map_type::const_iterator it_scat, TMatrixD &EffLenX,
@@ -44,6 +62,12 @@ class ReconstructionVarianceService {
     double direction_; //>0 lhcb1 (right), <0 lhcb2 (left)
 
     int verbosity_;
+
+    bool use_cache_;
+    double cache_z_tolerance_;  //at least kMinCacheZTolerance, so that the rounded z fits in int64_t
+    static const double kMinCacheZTolerance;
+    unsigned int max_cache_entries_;
+    cache_type cache_;
 };
 
 
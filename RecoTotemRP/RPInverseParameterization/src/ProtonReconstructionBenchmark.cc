@@ -0,0 +1,363 @@
+#include "RecoTotemRP/RPInverseParameterization/interface/ProtonReconstructionBenchmark.h"
+#include "RecoTotemRP/RPRecoDataFormats/interface/RPReconstructedProton.h"
+#include "RecoTotemRP/RPRecoDataFormats/interface/RPReconstructedProtonPair.h"
+#include "TotemProtonTransport/TotemRPProtonTransportParametrization/interface/TMultiDimFet.h"
+#include "TTree.h"
+#include "TMath.h"
+#include <chrono>
+
+
+ProtonReconstructionBenchmark::Settings::Settings()
+ : protons(1000), seed(1), hit_resolution(0.016), vertex_sigma_xy(0.01), vertex_sigma_z(50.),
+   theta_sigma(5e-5), xi_min(-0.15), xi_max(-0.02), constrain_vertex(true)
+{
+}
+
+
+ProtonReconstructionBenchmark::ParameterStatistics::ParameterStatistics(const std::string &n)
+ : name(n), entries(0), pull_entries(0), sum_res(0.), sum_res2(0.), sum_pull(0.), sum_pull2(0.)
+{
+}
+
+
+void ProtonReconstructionBenchmark::ParameterStatistics::Fill(double residual, double variance)
+{
+  entries++;
+  sum_res += residual;
+  sum_res2 += residual*residual;
+
+  if(variance > 0.)
+  {
+    double pull = residual/TMath::Sqrt(variance);
+    pull_entries++;
+    sum_pull += pull;
+    sum_pull2 += pull*pull;
+  }
+}
+
+
+double ProtonReconstructionBenchmark::ParameterStatistics::Bias() const
+{
+  return entries ? sum_res/entries : 0.;
+}
+
+
+double ProtonReconstructionBenchmark::ParameterStatistics::ResidualRMS() const
+{
+  return entries ? TMath::Sqrt(sum_res2/entries) : 0.;
+}
+
+
+double ProtonReconstructionBenchmark::ParameterStatistics::PullMean() const
+{
+  return pull_entries ? sum_pull/pull_entries : 0.;
+}
+
+
+double ProtonReconstructionBenchmark::ParameterStatistics::PullRMS() const
+{
+  return pull_entries ? TMath::Sqrt(sum_pull2/pull_entries) : 0.;
+}
+
+
+ProtonReconstructionBenchmark::Report::Report()
+ : fits(0), converged(0), seconds(0.), fcn_calls(0), gradient_calls(0)
+{
+}
+
+
+double ProtonReconstructionBenchmark::Report::FitsPerSecond() const
+{
+  return seconds > 0. ? fits/seconds : 0.;
+}
+
+
+double ProtonReconstructionBenchmark::Report::FcnCallsPerFit() const
+{
+  return fits ? double(fcn_calls)/fits : 0.;
+}
+
+
+double ProtonReconstructionBenchmark::Report::GradientCallsPerFit() const
+{
+  return fits ? double(gradient_calls)/fits : 0.;
+}
+
+
+void ProtonReconstructionBenchmark::Report::Print(std::ostream &o) const
+{
+  o<<"ProtonReconstructionBenchmark: "<<fits<<" fits, "<<converged<<" converged, "
+      <<FitsPerSecond()<<" fits/s, "<<FcnCallsPerFit()<<" FCN calls/fit, "
+      <<GradientCallsPerFit()<<" gradient calls/fit"<<std::endl;
+  for(unsigned int i=0; i<parameters.size(); i++)
+  {
+    const ParameterStatistics &p = parameters[i];
+    o<<"  "<<p.name<<": bias = "<<p.Bias()<<", rms = "<<p.ResidualRMS()
+        <<", pull mean = "<<p.PullMean()<<", pull rms = "<<p.PullRMS()<<std::endl;
+  }
+}
+
+
+ProtonReconstructionBenchmark::ProtonReconstructionBenchmark(const Settings &settings)
+ : settings_(settings), rand_(settings.seed)
+{
+}
+
+
+bool ProtonReconstructionBenchmark::MakeHit(const LHCOpticsApproximator &optics, const double *par_m, double z,
+    RP2DHit &hit)
+{
+  double out[2];
+  //no aperture check, beam coordinate systems inverted as in the fitters' chi2
+  bool ok = optics.Transport2D(par_m, out, false, true);
+
+  //the random numbers are drawn in any case, the sequence does not depend on the acceptance
+  double dx = rand_.Gaus(0., settings_.hit_resolution);
+  double dy = rand_.Gaus(0., settings_.hit_resolution);
+  double var = settings_.hit_resolution*settings_.hit_resolution;
+  hit = RP2DHit(out[0]*1000. + dx, out[1]*1000. + dy, var, var, z);
+  return ok;
+}
+
+
+ProtonReconstructionBenchmark::Report ProtonReconstructionBenchmark::RunOneArm(RPInverseParameterization &fitter,
+    const transport_to_rp_type &optics, const rp_z_type &rp_z, double z_direction)
+{
+  typedef RPReconstructedProton index;
+  const char *names[index::dimension] = {"x", "theta_x", "y", "theta_y", "xi"};
+
+  Report report;
+  for(int i=0; i<index::dimension; i++)
+    report.parameters.push_back(ParameterStatistics(names[i]));
+
+  fitter.ResetCallCounters();
+  std::chrono::steady_clock::duration fit_time(0);
+
+  for(unsigned int n=0; n<settings_.protons; n++)
+  {
+    //(x, theta_x, y, theta_y, xi) [mm, rad, mm, rad, 1]
+    double truth[index::dimension];
+    truth[index::nx] = rand_.Gaus(0., settings_.vertex_sigma_xy);
+    truth[index::ntheta_x] = rand_.Gaus(0., settings_.theta_sigma);
+    truth[index::ny] = rand_.Gaus(0., settings_.vertex_sigma_xy);
+    truth[index::ntheta_y] = rand_.Gaus(0., settings_.theta_sigma);
+    truth[index::nksi] = rand_.Uniform(settings_.xi_min, settings_.xi_max);
+
+    double par_m[5] = {truth[index::nx]/1000., truth[index::ntheta_x], truth[index::ny]/1000.,
+        truth[index::ntheta_y], truth[index::nksi]};
+
+    RPInverseParameterization::hits_at_rp_type hits;
+    bool transported = true;
+    for(transport_to_rp_type::const_iterator it = optics.begin(); it != optics.end(); ++it)
+    {
+      rp_z_type::const_iterator z_it = rp_z.find(it->first);
+      if(z_it == rp_z.end())
+        continue;
+      transported = MakeHit(it->second, par_m, z_it->second, hits[it->first]) && transported;
+    }
+    if(!transported || hits.size() < 2)
+      continue;
+
+    RPReconstructedProton rec_proton;
+    rec_proton.ZDirection(z_direction);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    fitter.ClearEvent();
+    fitter.AddProtonAtRPCollection(hits);
+    if(settings_.constrain_vertex)
+      fitter.SetPrimaryVertex(TVector3(0., 0., 0.),
+          TVector3(settings_.vertex_sigma_xy, settings_.vertex_sigma_xy, settings_.vertex_sigma_z));
+    fitter.Fit(rec_proton);
+    fit_time += std::chrono::steady_clock::now() - start;
+
+    report.fits++;
+    if(!rec_proton.Valid())
+      continue;
+    report.converged++;
+
+    double rec[index::dimension] = {rec_proton.X(), rec_proton.Theta_x(), rec_proton.Y(), rec_proton.Theta_y(),
+        rec_proton.Ksi()};
+    for(int i=0; i<index::dimension; i++)
+      report.parameters[i].Fill(rec[i] - truth[i], rec_proton.CovarianceMartixElement(i, i));
+  }
+
+  report.seconds = std::chrono::duration<double>(fit_time).count();
+  report.fcn_calls = fitter.FcnCalls();
+  report.gradient_calls = fitter.GradientCalls();
+  return report;
+}
+
+
+ProtonReconstructionBenchmark::Report ProtonReconstructionBenchmark::RunTwoArm(RPInverse2SidedParameterization &fitter,
+    const transport_to_rp_type &optics_right, const transport_to_rp_type &optics_left, const rp_z_type &rp_z)
+{
+  typedef RPReconstructedProtonPair index;
+  const char *names[index::dimension] = {"x", "y", "z", "theta_x_left", "theta_y_left", "xi_left",
+      "theta_x_right", "theta_y_right", "xi_right"};
+
+  Report report;
+  for(int i=0; i<index::dimension; i++)
+    report.parameters.push_back(ParameterStatistics(names[i]));
+
+  fitter.ResetCallCounters();
+  std::chrono::steady_clock::duration fit_time(0);
+
+  for(unsigned int n=0; n<settings_.protons; n++)
+  {
+    //x, y, z [mm], theta_x0, theta_y0, ksi0 (left), theta_x1, theta_y1, ksi1 (right)
+    double truth[index::dimension];
+    truth[index::nx] = rand_.Gaus(0., settings_.vertex_sigma_xy);
+    truth[index::ny] = rand_.Gaus(0., settings_.vertex_sigma_xy);
+    truth[index::nz] = rand_.Gaus(0., settings_.vertex_sigma_z);
+    truth[index::ntheta_x0] = rand_.Gaus(0., settings_.theta_sigma);
+    truth[index::ntheta_y0] = rand_.Gaus(0., settings_.theta_sigma);
+    truth[index::nksi0] = rand_.Uniform(settings_.xi_min, settings_.xi_max);
+    truth[index::ntheta_x1] = rand_.Gaus(0., settings_.theta_sigma);
+    truth[index::ntheta_y1] = rand_.Gaus(0., settings_.theta_sigma);
+    truth[index::nksi1] = rand_.Uniform(settings_.xi_min, settings_.xi_max);
+
+    double par_left[5], par_right[5];
+    index::FillMADTransportNtupleLeft(truth, par_left);
+    index::FillMADTransportNtupleRight(truth, par_right);
+
+    RPInverse2SidedParameterization::hits_at_rp_type hits;
+    bool transported = true;
+    unsigned int hits_left = 0, hits_right = 0;
+    for(int arm=0; arm<2; arm++)
+    {
+      const transport_to_rp_type &optics = arm ? optics_right : optics_left;
+      for(transport_to_rp_type::const_iterator it = optics.begin(); it != optics.end(); ++it)
+      {
+        rp_z_type::const_iterator z_it = rp_z.find(it->first);
+        if(z_it == rp_z.end())
+          continue;
+        transported = MakeHit(it->second, arm ? par_right : par_left, z_it->second, hits[it->first])
+            && transported;
+        (arm ? hits_right : hits_left)++;
+      }
+    }
+    if(!transported || hits_left < 2 || hits_right < 2)
+      continue;
+
+    RPReconstructedProtonPair rec_pair;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    fitter.ClearEvent();
+    fitter.AddProtonAtRPCollection(hits);
+    if(settings_.constrain_vertex)
+      fitter.SetPrimaryVertex(TVector3(0., 0., 0.),
+          TVector3(settings_.vertex_sigma_xy, settings_.vertex_sigma_xy, settings_.vertex_sigma_z));
+    fitter.Fit(rec_pair);
+    fit_time += std::chrono::steady_clock::now() - start;
+
+    report.fits++;
+    if(!rec_pair.Valid())
+      continue;
+    report.converged++;
+
+    for(int i=0; i<index::dimension; i++)
+      report.parameters[i].Fill(rec_pair.Parameter(i) - truth[i], rec_pair.CovarianceMartixElement(i, i));
+  }
+
+  report.seconds = std::chrono::duration<double>(fit_time).count();
+  report.fcn_calls = fitter.FcnCalls();
+  report.gradient_calls = fitter.GradientCalls();
+  return report;
+}
+
+
+LHCOpticsApproximator ProtonReconstructionBenchmark::MakeToyOptics(const std::string &beam, double L, double v,
+    double D)
+{
+  double in[6], out[7];
+  TTree tree("transport_samples", "transport_samples");
+  tree.SetDirectory(0);
+  const char *in_names[6] = {"x_in", "theta_x_in", "y_in", "theta_y_in", "ksi_in", "s_in"};
+  const char *out_names[7] = {"def_x_out", "def_theta_x_out", "def_y_out", "def_theta_y_out", "def_ksi_out",
+      "def_s_out", "def_valid_out"};
+  for(int i=0; i<6; i++)
+    tree.Branch(in_names[i], &in[i], (std::string(in_names[i]) + "/D").c_str());
+  for(int i=0; i<7; i++)
+    tree.Branch(out_names[i], &out[i], (std::string(out_names[i]) + "/D").c_str());
+
+  TRandom3 r(1);
+  for(int n=0; n<3000; n++)
+  {
+    in[0] = r.Uniform(-5e-4, 5e-4);
+    in[1] = r.Uniform(-3e-4, 3e-4);
+    in[2] = r.Uniform(-5e-4, 5e-4);
+    in[3] = r.Uniform(-3e-4, 3e-4);
+    in[4] = r.Uniform(-0.2, 0.);
+    in[5] = 0.;
+
+    out[0] = v*in[0] + L*in[1]*(1. + in[4]) + D*in[4] + 0.5*D*in[4]*in[4];
+    out[1] = 0.1*in[0] + 0.5*in[1];
+    out[2] = 0.5*v*in[2] + 1.5*L*in[3]*(1. - in[4]);
+    out[3] = 0.2*in[2] + 0.3*in[3];
+    out[4] = in[4];
+    out[5] = 220.;
+    out[6] = 1.;
+    tree.Fill();
+  }
+
+  LHCOpticsApproximator approx("toy", "toy", TMultiDimFet::kMonomials, beam, 6500.);
+  approx.Train(&tree, "def", LHCOpticsApproximator::PREDEFINED, 3, 2, 3, 2);
+  return approx;
+}
+
+
+edm::ParameterSet ProtonReconstructionBenchmark::DefaultFitterConfig()
+{
+  edm::ParameterSet conf;
+  conf.addParameter<int>("Verbosity", 0);
+  conf.addParameter<double>("ReconstructionPrecisionX", 0.001);
+  conf.addParameter<double>("ReconstructionPrecisionThetaX", 1e-6);
+  conf.addParameter<double>("ReconstructionPrecisionY", 0.001);
+  conf.addParameter<double>("ReconstructionPrecisionThetaY", 2e-7);
+  conf.addParameter<double>("ReconstructionPrecisionZ", 0.001);
+  conf.addParameter<double>("ReconstructionPrecisionKsi", 0.001);
+  conf.addParameter<double>("InitMinX", -0.6);
+  conf.addParameter<double>("InitMinThetaX", -0.00045);
+  conf.addParameter<double>("InitMinY", -0.6);
+  conf.addParameter<double>("InitMinThetaY", -0.00045);
+  conf.addParameter<double>("InitMinKsi", -0.3);
+  conf.addParameter<double>("InitMaxX", 0.6);
+  conf.addParameter<double>("InitMaxThetaX", 0.00045);
+  conf.addParameter<double>("InitMaxY", 0.6);
+  conf.addParameter<double>("InitMaxThetaY", 0.00045);
+  conf.addParameter<double>("InitMaxKsi", 0.);
+  conf.addParameter<int>("InitIterationsNumber", 20);
+  conf.addParameter<int>("InverseParamRandSeed", 14142135);
+  conf.addParameter<bool>("ElasticScatteringReconstruction", false);
+  conf.addParameter<double>("RandomSearchProbability", 0.3);
+  conf.addParameter<double>("MaxChiSqNDFOfConvergedProton", 15.);
+  conf.addParameter<double>("MaxAllowedReconstructedXi", 0.05);
+  conf.addParameter<double>("OutOfXiRangePenaltyFactor", 10000.);
+  conf.addParameter<double>("MaxChiSqOfConvergedInitialisation", 100.);
+  conf.addParameter<double>("ExpectedRPResolution", 0.016);
+  conf.addParameter<double>("RPMultipleScatteringSigma", 5.7e-7);
+  conf.addParameter<bool>("ComputeFullVarianceMatrix", true);
+  return conf;
+}
+
+
+BeamOpticsParams ProtonReconstructionBenchmark::DefaultBeamOpticsParams()
+{
+  edm::ParameterSet p;
+  p.addParameter<double>("BeamEnergy", 6500.);
+  p.addParameter<double>("ProtonMass", 0.938272029);
+  p.addParameter<double>("LightSpeed", 299792458.);
+  p.addParameter<double>("NormalizedEmittanceX", 3.75e-6);
+  p.addParameter<double>("NormalizedEmittanceY", 3.75e-6);
+  p.addParameter<double>("BetaStarX", 90.);
+  p.addParameter<double>("BetaStarY", 90.);
+  p.addParameter<double>("BunchSizeZ", 0.07);
+  p.addParameter<double>("CrossingAngleX", 0.);
+  p.addParameter<double>("CrossingAngleY", 0.);
+  p.addParameter<double>("BeamDisplacementX", 0.);
+  p.addParameter<double>("BeamDisplacementY", 0.);
+  p.addParameter<double>("BeamDisplacementZ", 0.);
+  p.addParameter<double>("MeanXi", 0.);
+  p.addParameter<double>("SigmaXi", 1e-4);
+  return BeamOpticsParams(p);
+}
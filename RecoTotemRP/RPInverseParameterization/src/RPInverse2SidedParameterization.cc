@@ -1,9 +1,11 @@
 #include "RecoTotemRP/RPInverseParameterization/interface/RPInverse2SidedParameterization.h"
+#include "RecoTotemRP/RPInverseParameterization/interface/AnalyticGradientFCN.h"
 #include "TotemProtonTransport/TotemRPProtonTransportParametrization/interface/LHCOpticsApproximator.h"
 #include "RecoTotemRP/RPRecoDataFormats/interface/RP2DHitDebug.h"
 #include "FWCore/ParameterSet/interface/ParameterSet.h"
 #include <cassert>
 #include <iostream>
+#include "tbb/task_group.h"
 #include "TMath.h"
 #include "TRandom2.h"
 #include "TotemCondFormats/BeamOpticsParamsObjects/interface/BeamOpticsParams.h"
@@ -67,6 +69,36 @@ RPInverse2SidedParameterization::RPInverse2SidedParameterization(
       -1.0, conf, BOPar));
   
   converged_chisqndf_max_ = conf.getParameter<double>("MaxChiSqNDFOfConvergedProton");
+
+  analytic_gradient_ = false;
+  if(conf.exists("AnalyticGradient"))
+    analytic_gradient_ = conf.getParameter<bool>("AnalyticGradient");
+
+  parallel_arm_fits_ = false;
+  if(conf.exists("ParallelFits"))
+    parallel_arm_fits_ = conf.getParameter<bool>("ParallelFits");
+
+  fcn_calls_ = gradient_calls_ = 0;
+}
+
+
+unsigned long RPInverse2SidedParameterization::FcnCalls() const
+{
+  return fcn_calls_ + inverse_param_right_->FcnCalls() + inverse_param_left_->FcnCalls();
+}
+
+
+unsigned long RPInverse2SidedParameterization::GradientCalls() const
+{
+  return gradient_calls_ + inverse_param_right_->GradientCalls() + inverse_param_left_->GradientCalls();
+}
+
+
+void RPInverse2SidedParameterization::ResetCallCounters()
+{
+  fcn_calls_ = gradient_calls_ = 0;
+  inverse_param_right_->ResetCallCounters();
+  inverse_param_left_->ResetCallCounters();
 }
 
 
@@ -84,6 +116,7 @@ double RPInverse2SidedParameterization::operator()(const std::vector<double>& pa
   typedef RPReconstructedProtonPair index;
   
   assert(par.size() == 9);
+  ++fcn_calls_;
 
   double chi2 = 0.;
 
@@ -166,6 +199,121 @@ double RPInverse2SidedParameterization::ElasticReconstrChi2Contrib(const std::ve
 }
 
 
+bool RPInverse2SidedParameterization::GradientAvailable() const
+{
+  return inverse_param_right_->GradientAvailable() && inverse_param_left_->GradientAvailable();
+}
+
+
+//adds the gradient of a one-arm chi2 contribution, given in the 5-dim. arm parameters,
+//propagated through Vertex3DTo2DLeft/Right
+void RPInverse2SidedParameterization::AddArmGradient(const double *arm_gradient, 
+    const std::vector<double> &par, bool right_arm, std::vector<double> &gradient) const
+{
+  typedef RPReconstructedProtonPair index;
+  
+  const int n_theta_x = right_arm ? index::ntheta_x1 : index::ntheta_x0;
+  const int n_theta_y = right_arm ? index::ntheta_y1 : index::ntheta_y0;
+  const int n_ksi = right_arm ? index::nksi1 : index::nksi0;
+  
+  //x_2D = x +- theta_x/(1+ksi)*z, "-" for the right arm
+  double sign = right_arm ? -1.0 : 1.0;
+  double ksi_plus_1 = 1.0 + par[n_ksi];
+  double z = par[index::nz];
+  
+  gradient[index::nx] += arm_gradient[0];
+  gradient[index::nz] += sign*(arm_gradient[0]*par[n_theta_x] + arm_gradient[2]*par[n_theta_y])/ksi_plus_1;
+  gradient[n_theta_x] += arm_gradient[1] + arm_gradient[0]*sign*z/ksi_plus_1;
+  gradient[index::ny] += arm_gradient[2];
+  gradient[n_theta_y] += arm_gradient[3] + arm_gradient[2]*sign*z/ksi_plus_1;
+  gradient[n_ksi] += arm_gradient[4] - sign*z*(arm_gradient[0]*par[n_theta_x] 
+      + arm_gradient[2]*par[n_theta_y])/(ksi_plus_1*ksi_plus_1);
+}
+
+
+void RPInverse2SidedParameterization::ElasticReconstrChi2ContribGradient(const std::vector<double> &par_left, 
+    const std::vector<double> &par_right, std::vector<double> &gradient) const
+{
+  typedef RPReconstructedProtonPair index;
+  
+  double xi_beam_mean = BOPar_.GetMeanXi();
+  double xi_beam_smearing = BOPar_.GetSigmaXi();
+  double var_xi_beam_smearing = xi_beam_smearing*xi_beam_smearing; 
+  
+  gradient[index::nksi1] += 2.0*(par_right[4] - xi_beam_mean)/var_xi_beam_smearing;
+  gradient[index::nksi0] += 2.0*(par_left[4] - xi_beam_mean)/var_xi_beam_smearing;
+  
+  //theta = asin(theta_madx/(1+ksi)) - crossing angle, see ElasticReconstrChi2Contrib
+  double th[2][2], d_th_d_madx[2][2], d_th_d_ksi[2][2];  //[left, right][x, y]
+  const std::vector<double> *pars[2] = {&par_left, &par_right};
+  double crossing[2] = {BOPar_.GetCrossingAngleX(), BOPar_.GetCrossingAngleY()};
+  for(int side=0; side<2; ++side)
+  {
+    double ksi_plus_1 = 1.0 + (*pars[side])[4];
+    for(int proj=0; proj<2; ++proj)
+    {
+      double u = (*pars[side])[1 + 2*proj]/ksi_plus_1;
+      double d_asin = 1.0/TMath::Sqrt(1.0 - u*u);
+      th[side][proj] = TMath::ASin(u) - crossing[proj];
+      d_th_d_madx[side][proj] = d_asin/ksi_plus_1;
+      d_th_d_ksi[side][proj] = -d_asin*u/ksi_plus_1;
+    }
+  }
+  
+  double beam_divergence[2] = {BOPar_.GetBeamDivergenceX(), BOPar_.GetBeamDivergenceY()};
+  const int n_theta[2][2] = {{index::ntheta_x0, index::ntheta_y0}, {index::ntheta_x1, index::ntheta_y1}};
+  const int n_ksi[2] = {index::nksi0, index::nksi1};
+  for(int proj=0; proj<2; ++proj)
+  {
+    double diff = th[0][proj] + th[1][proj];
+    double d_chi2_d_th = diff/(beam_divergence[proj]*beam_divergence[proj]);
+    for(int side=0; side<2; ++side)
+    {
+      gradient[n_theta[side][proj]] += d_chi2_d_th*d_th_d_madx[side][proj];
+      gradient[n_ksi[side]] += d_chi2_d_th*d_th_d_ksi[side][proj];
+    }
+  }
+}
+
+
+//x, y, z, theta_x0, theta_y0, ksi0, theta_x1, theta_y1, ksi1 - canonical MAD coordinates
+//0  1  2      3          4      5       6        7       8
+std::vector<double> RPInverse2SidedParameterization::Gradient(const std::vector<double>& par) const
+{
+  typedef RPReconstructedProtonPair index;
+  
+  assert(par.size() == 9);
+  ++gradient_calls_;
+  std::vector<double> gradient(9, 0.);
+
+  std::vector<double> par_left(5);
+  std::vector<double> par_right(5);
+  index::Fill5DimReconstructionVectorRight(par, par_right);
+  index::Fill5DimReconstructionVectorLeft(par, par_left);
+  
+  double arm_gradient[5];
+  inverse_param_right_->GetRPChi2ContributionGradient(par_right, arm_gradient);
+  AddArmGradient(arm_gradient, par, true, gradient);
+  inverse_param_left_->GetRPChi2ContributionGradient(par_left, arm_gradient);
+  AddArmGradient(arm_gradient, par, false, gradient);
+  
+  if(primary_vertex_set_)
+  {
+    double err_x = primary_vertex_error_.X();
+    double err_y = primary_vertex_error_.Y();
+    double err_z = primary_vertex_error_.Z();
+    gradient[index::nx] += 2.0*(par[index::nx] - primary_vertex_.X())/(err_x*err_x);
+    gradient[index::ny] += 2.0*(par[index::ny] - primary_vertex_.Y())/(err_y*err_y);
+    gradient[index::nz] += 2.0*(par[index::nz] - primary_vertex_.Z())/(err_z*err_z);
+  }
+  
+  if(elastic_reconstruction_)
+    ElasticReconstrChi2ContribGradient(par_left, par_right, gradient);
+  
+  return gradient;
+}
+
+
 void RPInverse2SidedParameterization::PrintFittedHitsInfo(std::ostream &o)
 {
   hits_at_rp_type::const_iterator it = hits_at_rp_.begin();
@@ -219,21 +367,19 @@ void RPInverse2SidedParameterization::AddProtonAtRPCollection(const hits_at_rp_t
 
 void RPInverse2SidedParameterization::AddParameterizationsRight(const transport_to_rp_type& param_map)
 {
-  transport_to_rp_.insert(param_map.begin(), param_map.end());
   inverse_param_right_->SetParameterizations(param_map);
 }
 
 
 void RPInverse2SidedParameterization::AddParameterizationsLeft(const transport_to_rp_type& param_map)
 {
-  transport_to_rp_.insert(param_map.begin(), param_map.end());
   inverse_param_left_->SetParameterizations(param_map);
 }
 
 
 void RPInverse2SidedParameterization::RemoveRomanPots()
 {
-  transport_to_rp_.clear(); ClearEvent();
+  ClearEvent();
   inverse_param_right_->RemoveRomanPots();
   inverse_param_left_->RemoveRomanPots();
 }
@@ -280,8 +426,19 @@ void RPInverse2SidedParameterization::FindInitialValues(
   RPReconstructedProton rec_proton_left_;
   rec_proton_left_.ZDirection(-1.0);
   
-  inverse_param_right_->Fit(rec_proton_right_, true);
-  inverse_param_left_->Fit(rec_proton_left_, true);
+  // the arm fitters share no mutable state, the right arm can be fitted as a task of the framework TBB pool
+  if(parallel_arm_fits_)
+  {
+    tbb::task_group group;
+    group.run([this, &rec_proton_right_]() { inverse_param_right_->Fit(rec_proton_right_, true); });
+    inverse_param_left_->Fit(rec_proton_left_, true);
+    group.wait();
+  }
+  else
+  {
+    inverse_param_right_->Fit(rec_proton_right_, true);
+    inverse_param_left_->Fit(rec_proton_left_, true);
+  }
   
   double x_mean = (rec_proton_right_.X() + rec_proton_left_.X())/2.0;
   double y_mean = (rec_proton_right_.Y() + rec_proton_left_.Y())/2.0;
@@ -353,7 +510,10 @@ bool RPInverse2SidedParameterization::Fit(RPReconstructedProtonPair &rec_proton_
   
   if(verbosity_)
     PrintProtonsAtRP();
-  ROOT::Minuit2::FunctionMinimum min = theMinimizer_.Minimize(*this, nm_params_, strategy_, 5000);
+  AnalyticGradientFCN<RPInverse2SidedParameterization> gradient_fcn(*this);
+  ROOT::Minuit2::FunctionMinimum min = (analytic_gradient_ && GradientAvailable()) ?
+      theMinimizer_.Minimize(gradient_fcn, nm_params_, strategy_, 5000) :
+      theMinimizer_.Minimize(*this, nm_params_, strategy_, 5000);
 //  if(verbosity_)
 //    std::cout<<min<<std::endl;
   bool res = SetResults(min, rec_proton_pair);
@@ -446,8 +606,13 @@ void RPInverse2SidedParameterization::SetPulls(const std::vector< ROOT::Minuit2:
       ++it)
   {
     double *par_m = LeftArm(it->first)?(par_left):(par_right);
+    const RPInverseParameterization::shared_transport_type &transport = LeftArm(it->first) ?
+        inverse_param_left_->GetParameterizations() : inverse_param_right_->GetParameterizations();
+    transport_to_rp_type::const_iterator tr_it = transport->find(it->first);
+    if(tr_it == transport->end())
+      continue;
     
-    transport_to_rp_[it->first].Transport2D(par_m, out, false);
+    tr_it->second.Transport2D(par_m, out, false);
     out[0]*=1000;  //convert [m] to [mm]
     out[1]*=1000;
     RP2DHitDebug hit_deb(it->second);
@@ -1,4 +1,5 @@
 #include "RecoTotemRP/RPInverseParameterization/interface/RPInverseParameterization.h"
+#include "RecoTotemRP/RPInverseParameterization/interface/AnalyticGradientFCN.h"
 #include "TotemProtonTransport/TotemRPProtonTransportParametrization/interface/LHCOpticsApproximator.h"
 #include "RecoTotemRP/RPRecoDataFormats/interface/RP2DHitDebug.h"
 #include "FWCore/ParameterSet/interface/ParameterSet.h"
@@ -28,6 +29,7 @@
 //beam_direction: +1.0 beam to the right, -1.0 - beam to the left
 RPInverseParameterization::RPInverseParameterization(double beam_direction, const edm::ParameterSet& conf,
         const BeamOpticsParams & BOPar) :
+	transport_to_rp_(new transport_to_rp_type()),
 	beam_direction_(beam_direction / TMath::Abs(beam_direction)), strategy_(2), smart_init_values_(5) {
 	BOPar_ = BOPar;
 	verbosity_ = 0;
@@ -94,10 +96,21 @@ RPInverseParameterization::RPInverseParameterization(double beam_direction, cons
 		        new ReconstructionVarianceService(conf));
 	}
 	variance_marices_initialised_ = false;
+	fit_context_.valid = false;
+	fit_context_.variance_valid = false;
+	fcn_calls_ = gradient_calls_ = 0;
 	xyCorrelation = false;
 	if (conf.exists("xyCorrelation")) {
 		xyCorrelation = conf.getParameter<bool> ("xyCorrelation");
 	}
+	analytic_gradient_ = false;
+	if (conf.exists("AnalyticGradient")) {
+		analytic_gradient_ = conf.getParameter<bool> ("AnalyticGradient");
+	}
+	linearized_initialization_ = false;
+	if (conf.exists("LinearizedInitialization")) {
+		linearized_initialization_ = conf.getParameter<bool> ("LinearizedInitialization");
+	}
 }
 
 //MADX canonical variables
@@ -122,12 +135,12 @@ double RPInverseParameterization::SimplifiedChiSqCalculation(const std::vector<d
 	hits_at_rp_type::const_iterator it = hits_at_rp_.begin();
 	hits_at_rp_type::const_iterator end = hits_at_rp_.end();
 	for (; it != end; ++it) {
-		transport_to_rp_type::const_iterator tr_it = transport_to_rp_.find(it->first);
-		if (tr_it == transport_to_rp_.end()) {
+		transport_to_rp_type::const_iterator tr_it = transport_to_rp_->find(it->first);
+		if (tr_it == transport_to_rp_->end()) {
 			std::cout << it->first << " RP proton transport parameterization missing, fatal error"
 			        << std::endl;
-			for (transport_to_rp_type::const_iterator it1 = transport_to_rp_.begin(); it1
-			        != transport_to_rp_.end(); ++it1) {
+			for (transport_to_rp_type::const_iterator it1 = transport_to_rp_->begin(); it1
+			        != transport_to_rp_->end(); ++it1) {
 				std::cout << it1->first << ", ";
 			}
 			std::cout << std::endl;
@@ -199,12 +212,12 @@ double RPInverseParameterization::FullVarianceCalculation(const std::vector<doub
 	hits_at_rp_type::const_iterator it = hits_at_rp_.begin();
 	hits_at_rp_type::const_iterator end = hits_at_rp_.end();
 	for (; it != end; ++it) {
-		transport_to_rp_type::const_iterator tr_it = transport_to_rp_.find(it->first);
-		if (tr_it == transport_to_rp_.end()) {
+		transport_to_rp_type::const_iterator tr_it = transport_to_rp_->find(it->first);
+		if (tr_it == transport_to_rp_->end()) {
 			std::cout << it->first << " RP proton transport parameterization missing, fatal error"
 			        << std::endl;
-			for (transport_to_rp_type::const_iterator it1 = transport_to_rp_.begin(); it1
-			        != transport_to_rp_.end(); ++it1) {
+			for (transport_to_rp_type::const_iterator it1 = transport_to_rp_->begin(); it1
+			        != transport_to_rp_->end(); ++it1) {
 				std::cout << it1->first << ", ";
 			}
 			std::cout << std::endl;
@@ -270,11 +283,315 @@ double RPInverseParameterization::FullVarianceCalculation(const std::vector<doub
 	return chi2;
 }
 
+void RPInverseParameterization::CompileFitContext() {
+	FitContext &ctx = fit_context_;
+	ctx.valid = false;
+	ctx.variance_valid = false;
+	ctx.hits = 0;
+
+	if (hits_at_rp_.size() > FitContext::max_hits)
+		return;
+
+	// hit z positions, in the order of hits_at_rp_
+	double z[FitContext::max_hits];
+
+	for (hits_at_rp_type::const_iterator it = hits_at_rp_.begin(); it != hits_at_rp_.end(); ++it) {
+		transport_to_rp_type::const_iterator tr_it = transport_to_rp_->find(it->first);
+		if (tr_it == transport_to_rp_->end()) {
+			std::cout << it->first << " RP proton transport parameterization missing, fatal error"
+			        << std::endl;
+			assert(false);
+		}
+
+		unsigned int k = ctx.hits++;
+		ctx.transport[k] = &tr_it->second;
+		ctx.x[k] = it->second.X();
+		ctx.y[k] = it->second.Y();
+		ctx.vx[k] = it->second.Vx();
+		ctx.vy[k] = it->second.Vy();
+		z[k] = it->second.Z();
+	}
+
+	// residual slots as in the z-keyed maps of FullVarianceCalculation: ordered in z,
+	// of several hits with the same z only the last one counts
+	bool last_of_its_z[FitContext::max_hits];
+	for (unsigned int k = 0; k < ctx.hits; ++k) {
+		last_of_its_z[k] = true;
+		for (unsigned int l = k + 1; l < ctx.hits; ++l)
+			last_of_its_z[k] = last_of_its_z[k] && z[l] != z[k];
+	}
+
+	for (unsigned int k = 0; k < ctx.hits; ++k) {
+		ctx.slot[k] = -1;
+		if (!last_of_its_z[k])
+			continue;
+		ctx.slot[k] = 0;
+		for (unsigned int l = 0; l < ctx.hits; ++l) {
+			if (last_of_its_z[l] && z[l] < z[k])
+				ctx.slot[k]++;
+		}
+	}
+
+	ctx.valid = true;
+}
+
+void RPInverseParameterization::CompileFitContextVariance() {
+	FitContext &ctx = fit_context_;
+	ctx.variance_valid = false;
+	if (!ctx.valid)
+		return;
+
+	unsigned int dim = inv_var_x_.GetNrows();
+	if (xyCorrelation) {
+		if (dim != 2 * ctx.hits || (unsigned int) inv_var_x_.GetNcols() != dim)
+			return;
+	} else {
+		if (dim != ctx.hits || (unsigned int) inv_var_x_.GetNcols() != dim
+		        || (unsigned int) inv_var_y_.GetNrows() != dim || (unsigned int) inv_var_y_.GetNcols() != dim)
+			return;
+		for (unsigned int i = 0; i < dim; ++i)
+			for (unsigned int j = 0; j < dim; ++j)
+				ctx.inv_var_y[i * dim + j] = inv_var_y_(i, j);
+	}
+
+	for (unsigned int i = 0; i < dim; ++i)
+		for (unsigned int j = 0; j < dim; ++j)
+			ctx.inv_var_x[i * dim + j] = inv_var_x_(i, j);
+
+	ctx.var_dim = dim;
+	ctx.y_offset = ctx.hits;
+	ctx.variance_valid = true;
+}
+
+//equivalent to SimplifiedChiSqCalculation, evaluated from the fit context
+//par_m: (x, theta_x, y, theta_y, ksi) [m, rad, m, rad, -1..0]
+double RPInverseParameterization::SimplifiedChiSqKernel(double par_m[]) const {
+	const FitContext &ctx = fit_context_;
+	double chi2 = 0.;
+	double out[2];
+
+	for (unsigned int k = 0; k < ctx.hits; ++k) {
+		double penalty = ctx.transport[k]->ParameterOutOfRangePenalty(par_m);
+		//no aperture check, beam coordinate systems inverted (lhcb2 x and theta_x flipped)
+		ctx.transport[k]->Transport2D(par_m, out, false, true);
+
+		//convert to from [m] to [mm]
+		out[0] = out[0] * 1000.;
+		out[1] = out[1] * 1000.;
+
+		if (fit_x_out_coords_)
+			chi2 += (ctx.x[k] - out[0]) * (ctx.x[k] - out[0]) / ctx.vx[k];
+		if (fit_y_out_coords_)
+			chi2 += (ctx.y[k] - out[1]) * (ctx.y[k] - out[1]) / ctx.vy[k];
+
+		chi2 += penalty;
+	}
+
+	return chi2;
+}
+
+//equivalent to FullVarianceCalculation, evaluated from the fit context
+//par_m: (x, theta_x, y, theta_y, ksi) [m, rad, m, rad, -1..0]
+double RPInverseParameterization::FullVarianceKernel(double par_m[]) const {
+	const FitContext &ctx = fit_context_;
+	double chi2 = 0.;
+	double out[2];
+
+	// residuals in [m], z-ordered
+	double diff[2 * FitContext::max_hits];
+	double diff_y[FitContext::max_hits];
+	for (unsigned int i = 0; i < ctx.var_dim; ++i)
+		diff[i] = 0.;
+	for (unsigned int i = 0; i < ctx.hits; ++i)
+		diff_y[i] = 0.;
+
+	for (unsigned int k = 0; k < ctx.hits; ++k) {
+		double penalty = ctx.transport[k]->ParameterOutOfRangePenalty(par_m);
+		chi2 += penalty;
+		ctx.transport[k]->Transport2D(par_m, out, false, true);
+
+		if (ctx.slot[k] < 0)
+			continue;
+
+		double dx = ctx.x[k] * 0.001 - out[0]; //convert [mm] to [m]
+		double dy = ctx.y[k] * 0.001 - out[1];
+		diff[ctx.slot[k]] = dx;
+		if (xyCorrelation)
+			diff[ctx.y_offset + ctx.slot[k]] = dy;
+		else
+			diff_y[ctx.slot[k]] = dy;
+	}
+
+	const unsigned int dim = ctx.var_dim;
+	for (unsigned int i = 0; i < dim; ++i) {
+		double row = 0.;
+		for (unsigned int j = 0; j < dim; ++j)
+			row += ctx.inv_var_x[i * dim + j] * diff[j];
+		chi2 += diff[i] * row;
+	}
+
+	if (!xyCorrelation) {
+		for (unsigned int i = 0; i < dim; ++i) {
+			double row = 0.;
+			for (unsigned int j = 0; j < dim; ++j)
+				row += ctx.inv_var_y[i * dim + j] * diff_y[j];
+			chi2 += diff_y[i] * row;
+		}
+	}
+
+	return chi2;
+}
+
+//gradient of SimplifiedChiSqKernel with respect to par_m
+void RPInverseParameterization::SimplifiedChiSqKernelGradient(double par_m[], double grad_m[]) const {
+	const FitContext &ctx = fit_context_;
+	double out[2];
+	double jacobian[2][5];
+	double penalty_grad[5];
+
+	for (int j = 0; j < 5; ++j)
+		grad_m[j] = 0.;
+
+	for (unsigned int k = 0; k < ctx.hits; ++k) {
+		ctx.transport[k]->ParameterOutOfRangePenaltyGradient(par_m, penalty_grad);
+		//same beam coordinate systems as SimplifiedChiSqKernel
+		ctx.transport[k]->Transport2DJacobian(par_m, out, jacobian, true);
+
+		//residuals in [mm], d out[mm] / d par_m = 1000 * jacobian
+		double res_x = ctx.x[k] - out[0] * 1000.;
+		double res_y = ctx.y[k] - out[1] * 1000.;
+
+		for (int j = 0; j < 5; ++j) {
+			if (fit_x_out_coords_)
+				grad_m[j] -= 2. * res_x * 1000. * jacobian[0][j] / ctx.vx[k];
+			if (fit_y_out_coords_)
+				grad_m[j] -= 2. * res_y * 1000. * jacobian[1][j] / ctx.vy[k];
+			grad_m[j] += penalty_grad[j];
+		}
+	}
+}
+
+//gradient of FullVarianceKernel with respect to par_m
+void RPInverseParameterization::FullVarianceKernelGradient(double par_m[], double grad_m[]) const {
+	const FitContext &ctx = fit_context_;
+	double out[2];
+	double jacobian[FitContext::max_hits][2][5];
+	double penalty_grad[5];
+
+	double diff[2 * FitContext::max_hits];
+	double diff_y[FitContext::max_hits];
+	for (unsigned int i = 0; i < ctx.var_dim; ++i)
+		diff[i] = 0.;
+	for (unsigned int i = 0; i < ctx.hits; ++i)
+		diff_y[i] = 0.;
+
+	for (int j = 0; j < 5; ++j)
+		grad_m[j] = 0.;
+
+	for (unsigned int k = 0; k < ctx.hits; ++k) {
+		ctx.transport[k]->ParameterOutOfRangePenaltyGradient(par_m, penalty_grad);
+		for (int j = 0; j < 5; ++j)
+			grad_m[j] += penalty_grad[j];
+
+		//same beam coordinate systems as FullVarianceKernel
+		ctx.transport[k]->Transport2DJacobian(par_m, out, jacobian[k], true);
+		if (ctx.slot[k] < 0)
+			continue;
+
+		diff[ctx.slot[k]] = ctx.x[k] * 0.001 - out[0];
+		if (xyCorrelation)
+			diff[ctx.y_offset + ctx.slot[k]] = ctx.y[k] * 0.001 - out[1];
+		else
+			diff_y[ctx.slot[k]] = ctx.y[k] * 0.001 - out[1];
+	}
+
+	//d(d^T M d)/dd = (M + M^T) d
+	const unsigned int dim = ctx.var_dim;
+	double m_diff[2 * FitContext::max_hits];
+	double m_diff_y[FitContext::max_hits];
+	for (unsigned int i = 0; i < dim; ++i) {
+		m_diff[i] = 0.;
+		for (unsigned int j = 0; j < dim; ++j)
+			m_diff[i] += (ctx.inv_var_x[i * dim + j] + ctx.inv_var_x[j * dim + i]) * diff[j];
+	}
+	if (!xyCorrelation) {
+		for (unsigned int i = 0; i < dim; ++i) {
+			m_diff_y[i] = 0.;
+			for (unsigned int j = 0; j < dim; ++j)
+				m_diff_y[i] += (ctx.inv_var_y[i * dim + j] + ctx.inv_var_y[j * dim + i]) * diff_y[j];
+		}
+	}
+
+	//the residuals depend on par_m through -out
+	for (unsigned int k = 0; k < ctx.hits; ++k) {
+		if (ctx.slot[k] < 0)
+			continue;
+		double g_x = m_diff[ctx.slot[k]];
+		double g_y = xyCorrelation ? m_diff[ctx.y_offset + ctx.slot[k]] : m_diff_y[ctx.slot[k]];
+		for (int j = 0; j < 5; ++j)
+			grad_m[j] -= g_x * jacobian[k][0][j] + g_y * jacobian[k][1][j];
+	}
+}
+
+bool RPInverseParameterization::GradientAvailable() const {
+	bool full_variance = compute_full_variance_matrix_ && variance_marices_initialised_;
+	return fit_context_.valid && (!full_variance || fit_context_.variance_valid);
+}
+
+//MADX canonical variables
+//(x, theta_x, y, theta_y, ksi) [mm, rad, mm, rad, -1..0]
+void RPInverseParameterization::GetRPChi2ContributionGradient(const std::vector<double>& par, double *gradient) const {
+	assert(GradientAvailable());
+	bool full_variance = compute_full_variance_matrix_ && variance_marices_initialised_;
+
+	//convert position from [mm] to [m]
+	double par_m[5] = { par[0] / 1000., par[1], par[2] / 1000., par[3], par[4] };
+	double grad_m[5];
+	if (full_variance)
+		FullVarianceKernelGradient(par_m, grad_m);
+	else
+		SimplifiedChiSqKernelGradient(par_m, grad_m);
+
+	gradient[0] = grad_m[0] / 1000.;
+	gradient[1] = grad_m[1];
+	gradient[2] = grad_m[2] / 1000.;
+	gradient[3] = grad_m[3];
+	gradient[4] = grad_m[4];
+
+	if (par[4] > xi_edge_)
+		gradient[4] += xi_steepness_factor_ * TMath::Exp((par[4] - xi_edge_) * xi_steepness_factor_);
+}
+
+//MADX canonical variables
+//(x, theta_x, y, theta_y, ksi) [mm, rad, mm, rad, -1..0]
+std::vector<double> RPInverseParameterization::Gradient(const std::vector<double>& par) const {
+	assert(par.size() == 5);
+	++gradient_calls_;
+	std::vector<double> gradient(5);
+	GetRPChi2ContributionGradient(par, &gradient[0]);
+
+	if (elastic_reconstruction_) {
+		double xi_beam_smearing = BOPar_.GetSigmaXi();
+		gradient[4] += 2. * (par[4] - BOPar_.GetMeanXi()) / (xi_beam_smearing * xi_beam_smearing);
+	}
+
+	if (primary_vertex_set_)
+		ChiSqPrimaryVertexContribGradient(par, &gradient[0]);
+
+	return gradient;
+}
+
 //MADX canonical variables
 //(x, theta_x, y, theta_y, ksi) [mm, rad, mm, rad, -1..0]
 double RPInverseParameterization::GetRPChi2Contribution(const std::vector<double>& par) const {
 	double chi2 = 0.0;
-	if (compute_full_variance_matrix_ && variance_marices_initialised_)
+	bool full_variance = compute_full_variance_matrix_ && variance_marices_initialised_;
+
+	if (fit_context_.valid && !verbosity_ && (!full_variance || fit_context_.variance_valid)) {
+		//convert position from [mm] to [m]
+		double par_m[5] = { par[0] / 1000., par[1], par[2] / 1000., par[3], par[4] };
+		chi2 = full_variance ? FullVarianceKernel(par_m) : SimplifiedChiSqKernel(par_m);
+	} else if (full_variance)
 		chi2 = FullVarianceCalculation(par);
 	else
 		chi2 = SimplifiedChiSqCalculation(par);
@@ -293,6 +610,7 @@ double RPInverseParameterization::GetRPChi2Contribution(const std::vector<double
 //(x, theta_x, y, theta_y, ksi) [mm, rad, mm, rad, -1..0]
 double RPInverseParameterization::operator()(const std::vector<double>& par) const {
 	assert(par.size() == 5);
+	++fcn_calls_;
 	double chi2 = 0.0;
 	chi2 = GetRPChi2Contribution(par);
 
@@ -371,8 +689,40 @@ double RPInverseParameterization::ChiSqPrimaryVertexContrib(const std::vector<do
 	return chi_sq_prim_vert_contrib;
 }
 
+//adds the gradient of ChiSqPrimaryVertexContrib
+void RPInverseParameterization::ChiSqPrimaryVertexContribGradient(const std::vector<double>& par,
+        double *gradient) const {
+	if (!primary_vertex_set_)
+		return;
+	double ksi_plus_1 = par[4] + 1.0;
+	double pz = ksi_plus_1 * beam_direction_;
+	double dir_x = par[1] / pz;
+	double dir_y = par[3] / pz;
+	double z = primary_vertex_.Z();
+	double var_z = primary_vertex_error_.Z() * primary_vertex_error_.Z();
+
+	double variance_vertex_x = primary_vertex_error_.X() * primary_vertex_error_.X() + dir_x * dir_x * var_z;
+	double variance_vertex_y = primary_vertex_error_.Y() * primary_vertex_error_.Y() + dir_y * dir_y * var_z;
+
+	double x_diff = primary_vertex_.X() - (par[0] + z * dir_x);
+	double y_diff = primary_vertex_.Y() - (par[2] + z * dir_y);
+
+	//derivatives with respect to the direction tangents
+	double d_dir_x = -2. * x_diff * z / variance_vertex_x
+	        - x_diff * x_diff / (variance_vertex_x * variance_vertex_x) * 2. * dir_x * var_z;
+	double d_dir_y = -2. * y_diff * z / variance_vertex_y
+	        - y_diff * y_diff / (variance_vertex_y * variance_vertex_y) * 2. * dir_y * var_z;
+
+	gradient[0] += -2. * x_diff / variance_vertex_x;
+	gradient[1] += d_dir_x / pz;
+	gradient[2] += -2. * y_diff / variance_vertex_y;
+	gradient[3] += d_dir_y / pz;
+	gradient[4] += -(d_dir_x * dir_x + d_dir_y * dir_y) / ksi_plus_1;
+}
+
 void RPInverseParameterization::AddProtonAtRPCollection(const hits_at_rp_type &hits_at_rp) {
 	hits_at_rp_.insert(hits_at_rp.begin(), hits_at_rp.end());
+	fit_context_.valid = false;
 }
 
 void RPInverseParameterization::SetPrimaryVertex(const TVector3 &vert, const TVector3 &error) {
@@ -535,7 +885,7 @@ double RPInverseParameterization::FitConstrainedXi(RPReconstructedProton &rec_pr
 	SetInitialParameters(rec_proton);
 	if (verbosity_)
 		PrintProtonsAtRP();
-	ROOT::Minuit2::FunctionMinimum min = theMinimizer_.Minimize(*this, nm_params_, strategy_, 5000);
+	ROOT::Minuit2::FunctionMinimum min = Minimize();
 
 	if (verbosity_) {
 		std::cout << "End of constrained fit" << std::endl;
@@ -554,7 +904,7 @@ bool RPInverseParameterization::FitNonConstrained(RPReconstructedProton &rec_pro
 	SetInitialParameters(rec_proton);
 	if (verbosity_)
 		PrintProtonsAtRP();
-	ROOT::Minuit2::FunctionMinimum min = theMinimizer_.Minimize(*this, nm_params_, strategy_, 5000);
+	ROOT::Minuit2::FunctionMinimum min = Minimize();
 	//  double chi2 = min.UserState().Fval();
 	//  double chi2_div_N = chi2/degrees_of_freedom_;
 
@@ -567,9 +917,165 @@ bool RPInverseParameterization::FitNonConstrained(RPReconstructedProton &rec_pro
 	return converged; //to be changed accordingly
 }
 
+ROOT::Minuit2::FunctionMinimum RPInverseParameterization::Minimize() {
+	if (analytic_gradient_ && GradientAvailable()) {
+		AnalyticGradientFCN<RPInverseParameterization> gradient_fcn(*this);
+		return theMinimizer_.Minimize(gradient_fcn, nm_params_, strategy_, 5000);
+	}
+	return theMinimizer_.Minimize(*this, nm_params_, strategy_, 5000);
+}
+
+namespace {
+	//solves the symmetric positive definite system a x = b (Cholesky), a and b are overwritten
+	bool SolveSymmetric5(double a[5][5], double b[5]) {
+		for (int i = 0; i < 5; ++i) {
+			for (int j = 0; j <= i; ++j) {
+				double sum = a[i][j];
+				for (int k = 0; k < j; ++k)
+					sum -= a[i][k] * a[j][k];
+				if (i == j) {
+					if (sum <= 0.)
+						return false;
+					a[i][i] = TMath::Sqrt(sum);
+				} else
+					a[i][j] = sum / a[j][j];
+			}
+		}
+		for (int i = 0; i < 5; ++i) {
+			for (int k = 0; k < i; ++k)
+				b[i] -= a[i][k] * b[k];
+			b[i] /= a[i][i];
+		}
+		for (int i = 4; i >= 0; --i) {
+			for (int k = i + 1; k < 5; ++k)
+				b[i] -= a[k][i] * b[k];
+			b[i] /= a[i][i];
+		}
+		return true;
+	}
+}
+
+//one weighted least-squares step with the optics linearised at par0
+//the init ranges act as a weak prior, which keeps the problem regular for 2 pots
+//par: (x, theta_x, y, theta_y, ksi) [mm, rad, mm, rad, -1..0]
+bool RPInverseParameterization::LinearizedStep(const double *par0, double *par) const {
+	const FitContext &ctx = fit_context_;
+	double a[5][5], b[5];
+	for (int i = 0; i < 5; ++i) {
+		b[i] = 0.;
+		for (int j = 0; j < 5; ++j)
+			a[i][j] = 0.;
+	}
+
+	double par_m[5] = { par0[0] / 1000., par0[1], par0[2] / 1000., par0[3], par0[4] };
+	double out[2], jacobian[2][5];
+	for (unsigned int k = 0; k < ctx.hits; ++k) {
+		//same beam coordinate systems as the chi2 (SimplifiedChiSqKernel)
+		ctx.transport[k]->Transport2DJacobian(par_m, out, jacobian, true);
+
+		//everything in [mm]
+		double res[2] = { ctx.x[k] - out[0] * 1000., ctx.y[k] - out[1] * 1000. };
+		double weight[2] = { fit_x_out_coords_ ? 1. / ctx.vx[k] : 0., fit_y_out_coords_ ? 1. / ctx.vy[k] : 0. };
+		double d[2][5];
+		for (int c = 0; c < 2; ++c)
+			for (int j = 0; j < 5; ++j)
+				d[c][j] = jacobian[c][j] * ((j == 0 || j == 2) ? 1. : 1000.);
+
+		for (int c = 0; c < 2; ++c) {
+			for (int i = 0; i < 5; ++i) {
+				b[i] += d[c][i] * weight[c] * res[c];
+				for (int j = 0; j < 5; ++j)
+					a[i][j] += d[c][i] * weight[c] * d[c][j];
+			}
+		}
+	}
+
+	for (int i = 0; i < 5; ++i) {
+		double center = (min_random_init_[i] + max_random_init_[i]) / 2.;
+		double sigma = (max_random_init_[i] - min_random_init_[i]) / 2.;
+		if (i == 4 && elastic_reconstruction_) {
+			center = BOPar_.GetMeanXi();
+			sigma = BOPar_.GetSigmaXi();
+		}
+		if (sigma <= 0.)
+			sigma = rec_precision_[i];
+		a[i][i] += 1. / (sigma * sigma);
+		b[i] += (center - par0[i]) / (sigma * sigma);
+	}
+
+	if (!SolveSymmetric5(a, b))
+		return false;
+
+	for (int i = 0; i < 5; ++i)
+		par[i] = par0[i] + b[i];
+	return true;
+}
+
+bool RPInverseParameterization::LinearizedInitialEstimate(std::vector<double> &par) const {
+	if (!fit_context_.valid || fit_context_.hits == 0)
+		return false;
+
+	const int xi_nodes = 8;
+	const int gauss_newton_steps = 3;
+
+	std::vector<double> best(5), candidate(5);
+	double best_chi2 = -1.;
+
+	for (int n = 0; n < xi_nodes; ++n) {
+		double par0[5];
+		for (int i = 0; i < 4; ++i)
+			par0[i] = (min_random_init_[i] + max_random_init_[i]) / 2.;
+		par0[4] = min_random_init_[4] + (n + 0.5) * (max_random_init_[4] - min_random_init_[4]) / xi_nodes;
+
+		if (!LinearizedStep(par0, &candidate[0]))
+			continue;
+
+		double chi2 = (*this)(candidate);
+		if (verbosity_)
+			std::cout << "linearised initialisation: xi node=" << par0[4] << " xi=" << candidate[4]
+			        << " chi2=" << chi2 << std::endl;
+		if (best_chi2 < 0. || chi2 < best_chi2) {
+			best_chi2 = chi2;
+			best = candidate;
+		}
+	}
+
+	if (best_chi2 < 0.)
+		return false;
+
+	for (int step = 0; step < gauss_newton_steps; ++step) {
+		if (!LinearizedStep(&best[0], &candidate[0]))
+			break;
+		double chi2 = (*this)(candidate);
+		if (!(chi2 < best_chi2))
+			break;
+		best_chi2 = chi2;
+		best = candidate;
+	}
+
+	par = best;
+	return true;
+}
+
 void RPInverseParameterization::InitializeFit(RPReconstructedProton &rec_proton) {
 	binom_min_search_->Clear();
 	variance_marices_initialised_ = false;
+	CompileFitContext();
+
+	//the random xi search is kept as the fallback for the events the linearisation does not describe well
+	FitXYCoords();
+	std::vector<double> init_par;
+	if (linearized_initialization_ && LinearizedInitialEstimate(init_par)
+	        && (*this)(init_par) < init_converged_chisq_) {
+		smart_init_values_.SetValues(init_par);
+		smart_init_values_.ReleaseAll();
+		rec_proton.X(init_par[0]);
+		rec_proton.Theta_x(init_par[1]);
+		rec_proton.Y(init_par[2]);
+		rec_proton.Theta_y(init_par[3]);
+		rec_proton.Ksi(init_par[4]);
+		return;
+	}
 
 	bool initialization_converged = false;
 
@@ -622,6 +1128,7 @@ void RPInverseParameterization::InitializeMatrixBasedFitting(RPReconstructedProt
 			rec_variance_service_->ComputeInvertedVarianceMatrices(inv_var_x_, inv_var_y_);
 		}
 		variance_marices_initialised_ = true;
+		CompileFitContextVariance();
 	}
 }
 
@@ -686,7 +1193,10 @@ void RPInverseParameterization::SetPulls(const std::vector<ROOT::Minuit2::Minuit
 	double out[2];
 
 	for (hits_at_rp_type::const_iterator it = hits_at_rp_.begin(); it != hits_at_rp_.end(); ++it) {
-		transport_to_rp_[it->first].Transport2D(par_m, out, false);
+		transport_to_rp_type::const_iterator tr_it = transport_to_rp_->find(it->first);
+		if (tr_it == transport_to_rp_->end())
+			continue;
+		tr_it->second.Transport2D(par_m, out, false);
 		out[0] *= 1000; //convert [m] to [mm]
 		out[1] *= 1000;
 		RP2DHitDebug hit_deb(it->second);
@@ -1,6 +1,7 @@
 #include "RecoTotemRP/RPInverseParameterization/interface/ReconstructionVarianceService.h"
 #include <iostream>
 #include <string>
+#include <cmath>
 #include "TFile.h"
 #include "TMath.h"
 #include "FWCore/ServiceRegistry/interface/Service.h"
@@ -8,9 +9,53 @@
 #include "FWCore/Utilities/interface/Exception.h"
 #include "FWCore/ParameterSet/interface/ParameterSet.h"
 
+const double ReconstructionVarianceService::kMinCacheZTolerance = 1e-12;
+
 ReconstructionVarianceService::ReconstructionVarianceService(const edm::ParameterSet& conf) {
 	service_initialized_ = false;
 	InitTransportApproximatios(conf);
+
+	use_cache_ = conf.exists("VarianceMatrixCache") ? conf.getParameter<bool> ("VarianceMatrixCache") : true;
+	cache_z_tolerance_ = conf.exists("VarianceMatrixCacheZTolerance") ?
+	        conf.getParameter<double> ("VarianceMatrixCacheZTolerance") : 1e-6;
+	max_cache_entries_ = conf.exists("VarianceMatrixCacheSize") ?
+	        conf.getParameter<unsigned int> ("VarianceMatrixCacheSize") : 1024;
+
+	if (use_cache_ && !(cache_z_tolerance_ >= kMinCacheZTolerance))
+		throw cms::Exception("ReconstructionVarianceService::ReconstructionVarianceService")
+		        << " VarianceMatrixCacheZTolerance = " << cache_z_tolerance_ << " is invalid, it must be at least "
+		        << kMinCacheZTolerance << " m";
+}
+
+ReconstructionVarianceService::cache_key_type ReconstructionVarianceService::CacheKey(bool joint_matrix) const {
+	cache_key_type key;
+	key.first.reserve(1 + detector_planes_.size() + scattering_planes_.size());
+	key.second.reserve(1 + detector_planes_.size() + scattering_planes_.size());
+	key.first.push_back(detector_planes_.size());
+	key.second.push_back(joint_matrix ? 1. : 0.);
+	for (readout_det_set_type::const_iterator it = detector_planes_.begin(); it != detector_planes_.end(); ++it) {
+		key.first.push_back(std::llround(it->first / cache_z_tolerance_));
+		key.second.push_back(it->second);
+	}
+	for (scattering_map_type::const_iterator it = scattering_planes_.begin(); it != scattering_planes_.end(); ++it) {
+		key.first.push_back(std::llround(it->first / cache_z_tolerance_));
+		key.second.push_back(it->second);
+	}
+	return key;
+}
+
+void ReconstructionVarianceService::StoreInCache(const cache_key_type &key, const TMatrixD &var_x,
+        const TMatrixD &var_y) {
+	if (cache_.size() >= max_cache_entries_)
+		cache_.clear();
+
+	CachedMatrices &entry = cache_[key];
+	entry.inv_var_x.ResizeTo(var_x);
+	entry.inv_var_x = var_x;
+	if (var_y.GetNoElements() > 0) {
+		entry.inv_var_y.ResizeTo(var_y);
+		entry.inv_var_y = var_y;
+	}
 }
 
 //[m], [rad]
@@ -168,6 +213,21 @@ void ReconstructionVarianceService::PrintMatrix(std::ostream &o, const TMatrixD
  * during minimization of chi2 function.
  */
 void ReconstructionVarianceService::ComputeInvertedVarianceMatrices(TMatrixD &var_x, TMatrixD &var_y) {
+	cache_key_type key;
+	if (use_cache_) {
+		key = CacheKey(false);
+		cache_type::const_iterator it = cache_.find(key);
+		if (it != cache_.end()) {
+			var_x.ResizeTo(it->second.inv_var_x);
+			var_x = it->second.inv_var_x;
+			var_y.ResizeTo(it->second.inv_var_y);
+			var_y = it->second.inv_var_y;
+			if (verbosity_)
+				std::cout << "ComputeInvertedVarianceMatrices: cached matrices used" << std::endl;
+			return;
+		}
+	}
+
 	ComputeVarianceMatrices(var_x, var_y);
 	if (verbosity_ > 1) {
 		std::cout << "-------------variance--------------\n";
@@ -176,6 +236,8 @@ void ReconstructionVarianceService::ComputeInvertedVarianceMatrices(TMatrixD &va
 	}
 	var_x.Invert();
 	var_y.Invert();
+	if (use_cache_)
+		StoreInCache(key, var_x, var_y);
 	if (verbosity_) {
 		std::cout << "ComputeInvertedVarianceMatrices" << std::endl;
 		PrintMatrix(std::cout, var_x);
@@ -190,6 +252,19 @@ void ReconstructionVarianceService::ComputeInvertedVarianceMatrices(TMatrixD &va
  * The difference is that in this function we create only one covariance matrix (joined for x and y).
  */
 void ReconstructionVarianceService::ComputeInvertedVarianceMatrix(TMatrixD &var) {
+	cache_key_type key;
+	if (use_cache_) {
+		key = CacheKey(true);
+		cache_type::const_iterator it = cache_.find(key);
+		if (it != cache_.end()) {
+			var.ResizeTo(it->second.inv_var_x);
+			var = it->second.inv_var_x;
+			if (verbosity_)
+				std::cout << "ComputeInvertedVarianceMatrix: cached matrix used" << std::endl;
+			return;
+		}
+	}
+
 	var.ResizeTo(2 * detector_planes_.size(), 2 * detector_planes_.size());
 	var *= 0;
 	TMatrixD var_x, var_y;
@@ -203,6 +278,8 @@ void ReconstructionVarianceService::ComputeInvertedVarianceMatrix(TMatrixD &var)
 		PrintMatrix(std::cout, var);
 	}
 	var.Invert();
+	if (use_cache_)
+		StoreInCache(key, var, TMatrixD());
 	if (verbosity_) {
 		std::cout << "odwrocona\n";
 		PrintMatrix(std::cout, var);
@@ -0,0 +1,275 @@
+/**
+   \file
+   unit test of the analytic gradients of the proton reconstruction FCNs,
+   checked against central finite differences on a toy optics
+*/
+
+#include <cppunit/extensions/HelperMacros.h>
+#include "RecoTotemRP/RPInverseParameterization/interface/RPInverseParameterization.h"
+#include "RecoTotemRP/RPInverseParameterization/interface/RPInverse2SidedParameterization.h"
+#include "RecoTotemRP/RPInverseParameterization/interface/ProtonReconstructionBenchmark.h"
+#include "TotemProtonTransport/TotemRPProtonTransportParametrization/interface/LHCOpticsApproximator.h"
+#include "TotemProtonTransport/TotemRPProtonTransportParametrization/interface/TMultiDimFet.h"
+#include "TotemCondFormats/BeamOpticsParamsObjects/interface/BeamOpticsParams.h"
+#include "FWCore/ParameterSet/interface/ParameterSet.h"
+#include "TRandom3.h"
+#include "TMath.h"
+#include <vector>
+
+class testGradientFCN: public CppUnit::TestFixture {
+
+  CPPUNIT_TEST_SUITE(testGradientFCN);
+
+  CPPUNIT_TEST(testPolynomialGradient);
+  CPPUNIT_TEST(testOneArmGradient);
+  CPPUNIT_TEST(testTwoArmGradient);
+
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void setUp(){}
+  void tearDown(){}
+  void testPolynomialGradient();
+  void testOneArmGradient();
+  void testTwoArmGradient();
+
+  static edm::ParameterSet MakeConfig(bool elastic);
+
+  /// largest relative deviation of the analytic gradient from the central differences
+  template <class FCN> static double CompareGradient(const FCN &fcn, const std::vector<double> &par,
+      const std::vector<double> &steps);
+}; 
+
+///registration of the test so that the runner can find it
+CPPUNIT_TEST_SUITE_REGISTRATION(testGradientFCN);
+
+
+edm::ParameterSet testGradientFCN::MakeConfig(bool elastic)
+{
+  //the benchmark configuration with the analytic gradient and the diagonal variance matrix; the tight xi range
+  //puts the out-of-range penalty into the checked gradient
+  edm::ParameterSet conf = ProtonReconstructionBenchmark::DefaultFitterConfig();
+  conf.addParameter<bool>("ElasticScatteringReconstruction", elastic);
+  conf.addParameter<bool>("AnalyticGradient", true);
+  conf.addParameter<bool>("ComputeFullVarianceMatrix", false);
+  conf.addParameter<double>("MaxAllowedReconstructedXi", 0.01);
+  conf.addParameter<double>("OutOfXiRangePenaltyFactor", 1000.);
+  conf.addParameter<int>("InitIterationsNumber", 5);
+  return conf;
+}
+
+
+template <class FCN> double testGradientFCN::CompareGradient(const FCN &fcn, const std::vector<double> &par,
+    const std::vector<double> &steps)
+{
+  std::vector<double> gradient = fcn.Gradient(par);
+  CPPUNIT_ASSERT(gradient.size() == par.size());
+
+  double max_dev = 0.;
+  for(unsigned int i=0; i<par.size(); i++)
+  {
+    std::vector<double> p_up = par, p_down = par;
+    p_up[i] += steps[i];
+    p_down[i] -= steps[i];
+    double numerical = (fcn(p_up) - fcn(p_down)) / (2.*steps[i]);
+
+    double scale = TMath::Max(TMath::Abs(numerical), TMath::Abs(gradient[i])) + 1e-6;
+    double dev = TMath::Abs(gradient[i] - numerical) / scale;
+    if(dev > max_dev)
+      max_dev = dev;
+  }
+  return max_dev;
+}
+
+
+void testGradientFCN::testPolynomialGradient()
+{
+  TMultiDimFet::EMDFPolyType types[3] = {TMultiDimFet::kMonomials, TMultiDimFet::kChebyshev, TMultiDimFet::kLegendre};
+  TRandom3 r(2);
+
+  TVectorD min_var(5), max_var(5);
+  for(int j=0; j<5; j++)
+  {
+    min_var(j) = -1. - j;
+    max_var(j) = 2. + 0.5*j;
+  }
+
+  const int n_coef = 20;
+  double coefficients[n_coef];
+  int powers[n_coef*5];
+  for(int i=0; i<n_coef; i++)
+  {
+    coefficients[i] = r.Uniform(-1., 1.);
+    for(int j=0; j<5; j++)
+      powers[i*5 + j] = 1 + r.Integer(5);
+  }
+
+  for(int t=0; t<3; t++)
+  {
+    TMultiDimFet pol(5, types[t], "k");
+    pol.SetParameterization(types[t], 0.3, min_var, max_var, n_coef, coefficients, powers);
+
+    for(int n=0; n<20; n++)
+    {
+      double x[5], gradient[5];
+      for(int j=0; j<5; j++)
+        x[j] = r.Uniform(min_var(j), max_var(j));
+
+      double value = pol.EvalGradient(x, gradient);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(pol.Eval(x), value, 1e-12*(1. + TMath::Abs(value)));
+
+      for(int j=0; j<5; j++)
+      {
+        const double h = 1e-6;
+        double x_up[5], x_down[5];
+        for(int k=0; k<5; k++)
+          x_up[k] = x_down[k] = x[k];
+        x_up[j] += h;
+        x_down[j] -= h;
+        double numerical = (pol.Eval(x_up) - pol.Eval(x_down)) / (2.*h);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(numerical, gradient[j], 1e-5*(1. + TMath::Abs(numerical)));
+      }
+    }
+  }
+}
+
+
+void testGradientFCN::testOneArmGradient()
+{
+  BeamOpticsParams bop = ProtonReconstructionBenchmark::DefaultBeamOpticsParams();
+  RPInverseParameterization::transport_to_rp_type optics;
+  optics[120] = ProtonReconstructionBenchmark::MakeToyOptics("lhcb1", 20., 2., 0.05);
+  optics[124] = ProtonReconstructionBenchmark::MakeToyOptics("lhcb1", 15., 3., 0.07);
+
+  for(int elastic=0; elastic<2; elastic++)
+  {
+    RPInverseParameterization fitter(1.0, MakeConfig(elastic), bop);
+    fitter.SetParameterizations(optics);
+
+    //hits of a proton with theta_x = 5e-5, theta_y = 3e-5, xi = -0.05, in [mm]
+    double par_m[5] = {0., 5e-5, 0., 3e-5, -0.05}, out[2];
+    RPInverseParameterization::transport_to_rp_type::const_iterator it = optics.begin();
+    for(double z = 215000.; it != optics.end(); ++it, z += 5000.)
+    {
+      it->second.Transport2D(par_m, out, false, true);
+      fitter.AddProtonAtRP(it->first, RP2DHit(out[0]*1000. + 0.01, out[1]*1000. - 0.02, 4e-4, 4e-4, z));
+    }
+    fitter.SetPrimaryVertex(TVector3(1e-3, -2e-3, 0.5), TVector3(0.05, 0.05, 50.));
+
+    RPReconstructedProton proton;
+    proton.ZDirection(1.0);
+    fitter.Fit(proton);
+    CPPUNIT_ASSERT(fitter.GradientAvailable());
+
+    std::vector<double> steps(5);
+    steps[0] = 1e-4; steps[1] = 1e-8; steps[2] = 1e-4; steps[3] = 1e-8; steps[4] = 1e-6;
+
+    TRandom3 r(3);
+    for(int n=0; n<10; n++)
+    {
+      std::vector<double> par(5);
+      par[0] = r.Uniform(-0.1, 0.1);
+      par[1] = r.Uniform(-1e-4, 1e-4);
+      par[2] = r.Uniform(-0.1, 0.1);
+      par[3] = r.Uniform(-1e-4, 1e-4);
+      par[4] = r.Uniform(-0.15, -0.01);
+      CPPUNIT_ASSERT(CompareGradient(fitter, par, steps) < 1e-3);
+    }
+  }
+}
+
+
+void testGradientFCN::testTwoArmGradient()
+{
+  BeamOpticsParams bop = ProtonReconstructionBenchmark::DefaultBeamOpticsParams();
+  RPInverse2SidedParameterization::transport_to_rp_type optics_right, optics_left;
+  optics_right[120] = ProtonReconstructionBenchmark::MakeToyOptics("lhcb1", 20., 2., 0.05);
+  optics_right[124] = ProtonReconstructionBenchmark::MakeToyOptics("lhcb1", 15., 3., 0.07);
+  optics_left[20] = ProtonReconstructionBenchmark::MakeToyOptics("lhcb2", 20., 2., 0.05);
+  optics_left[24] = ProtonReconstructionBenchmark::MakeToyOptics("lhcb2", 15., 3., 0.07);
+
+  for(int elastic=0; elastic<2; elastic++)
+  {
+    RPInverse2SidedParameterization fitter(MakeConfig(elastic), bop);
+    fitter.AddParameterizationsRight(optics_right);
+    fitter.AddParameterizationsLeft(optics_left);
+
+    double par_m[5] = {0., 5e-5, 0., 3e-5, -0.05}, out[2];
+    RPInverse2SidedParameterization::transport_to_rp_type::const_iterator it;
+    for(it = optics_right.begin(); it != optics_right.end(); ++it)
+    {
+      it->second.Transport2D(par_m, out, false, true);
+      fitter.AddProtonAtRP(it->first, RP2DHit(out[0]*1000., out[1]*1000., 4e-4, 4e-4, 220000.));
+    }
+    par_m[1] = -5e-5;
+    par_m[3] = -3e-5;
+    for(it = optics_left.begin(); it != optics_left.end(); ++it)
+    {
+      it->second.Transport2D(par_m, out, false, true);
+      fitter.AddProtonAtRP(it->first, RP2DHit(out[0]*1000., out[1]*1000., 4e-4, 4e-4, -220000.));
+    }
+    fitter.SetPrimaryVertex(TVector3(1e-3, -2e-3, 0.5), TVector3(0.05, 0.05, 50.));
+
+    RPReconstructedProtonPair pair;
+    fitter.Fit(pair);
+    CPPUNIT_ASSERT(fitter.GradientAvailable());
+
+    //x, y, z, theta_x0, theta_y0, ksi0, theta_x1, theta_y1, ksi1
+    std::vector<double> steps(9, 1e-8);
+    steps[0] = steps[1] = 1e-4;
+    steps[2] = 1e-2;
+    steps[5] = steps[8] = 1e-6;
+
+    TRandom3 r(4);
+    for(int n=0; n<10; n++)
+    {
+      std::vector<double> par(9);
+      par[0] = r.Uniform(-0.1, 0.1);
+      par[1] = r.Uniform(-0.1, 0.1);
+      par[2] = r.Uniform(-10., 10.);
+      par[3] = r.Uniform(-1e-4, 1e-4);
+      par[4] = r.Uniform(-1e-4, 1e-4);
+      par[5] = r.Uniform(-0.15, -0.01);
+      par[6] = r.Uniform(-1e-4, 1e-4);
+      par[7] = r.Uniform(-1e-4, 1e-4);
+      par[8] = r.Uniform(-0.15, -0.01);
+      CPPUNIT_ASSERT(CompareGradient(fitter, par, steps) < 1e-3);
+    }
+  }
+
+  //left arm alone: the lhcb2 optics inverts x and theta_x, the analytic gradient has to be taken in the same frame as the chi2
+  for(int elastic=0; elastic<2; elastic++)
+  {
+    RPInverseParameterization fitter(-1.0, MakeConfig(elastic), bop);
+    fitter.SetParameterizations(optics_left);
+
+    double par_m[5] = {0., -5e-5, 0., -3e-5, -0.05}, out[2];
+    RPInverse2SidedParameterization::transport_to_rp_type::const_iterator it = optics_left.begin();
+    for(double z = -215000.; it != optics_left.end(); ++it, z -= 5000.)
+    {
+      it->second.Transport2D(par_m, out, false, true);
+      fitter.AddProtonAtRP(it->first, RP2DHit(out[0]*1000. - 0.01, out[1]*1000. + 0.02, 4e-4, 4e-4, z));
+    }
+    fitter.SetPrimaryVertex(TVector3(1e-3, -2e-3, 0.5), TVector3(0.05, 0.05, 50.));
+
+    RPReconstructedProton proton;
+    proton.ZDirection(-1.0);
+    fitter.Fit(proton);
+    CPPUNIT_ASSERT(fitter.GradientAvailable());
+
+    std::vector<double> steps(5);
+    steps[0] = 1e-4; steps[1] = 1e-8; steps[2] = 1e-4; steps[3] = 1e-8; steps[4] = 1e-6;
+
+    TRandom3 r(5);
+    for(int n=0; n<10; n++)
+    {
+      std::vector<double> par(5);
+      par[0] = r.Uniform(-0.1, 0.1);
+      par[1] = r.Uniform(-1e-4, 1e-4);
+      par[2] = r.Uniform(-0.1, 0.1);
+      par[3] = r.Uniform(-1e-4, 1e-4);
+      par[4] = r.Uniform(-0.15, -0.01);
+      CPPUNIT_ASSERT(CompareGradient(fitter, par, steps) < 1e-3);
+    }
+  }
+}
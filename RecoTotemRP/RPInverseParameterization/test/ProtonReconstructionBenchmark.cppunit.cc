@@ -0,0 +1,154 @@
+/**
+   \file
+   regression test of the proton reconstruction: fits of generated protons on a toy optics
+   must converge, be unbiased and have pulls of unit width
+*/
+
+#include <cppunit/extensions/HelperMacros.h>
+#include "RecoTotemRP/RPInverseParameterization/interface/ProtonReconstructionBenchmark.h"
+#include "TMath.h"
+
+class testProtonReconstructionBenchmark: public CppUnit::TestFixture {
+
+  CPPUNIT_TEST_SUITE(testProtonReconstructionBenchmark);
+
+  CPPUNIT_TEST(testStatistics);
+  CPPUNIT_TEST(testOneArm);
+  CPPUNIT_TEST(testTwoArm);
+  CPPUNIT_TEST(testReproducibility);
+
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void setUp();
+  void tearDown(){}
+  void testStatistics();
+  void testOneArm();
+  void testTwoArm();
+  void testReproducibility();
+
+  /// converged fits, bias compatible with zero, pull widths around 1
+  static void CheckReport(const ProtonReconstructionBenchmark::Report &report);
+
+private:
+  ProtonReconstructionBenchmark::transport_to_rp_type optics_right_, optics_left_;
+  ProtonReconstructionBenchmark::rp_z_type rp_z_;
+}; 
+
+///registration of the test so that the runner can find it
+CPPUNIT_TEST_SUITE_REGISTRATION(testProtonReconstructionBenchmark);
+
+
+void testProtonReconstructionBenchmark::setUp()
+{
+  optics_right_[120] = ProtonReconstructionBenchmark::MakeToyOptics("lhcb1", 20., 2., 0.05);
+  optics_right_[124] = ProtonReconstructionBenchmark::MakeToyOptics("lhcb1", 15., 3., 0.07);
+  optics_left_[20] = ProtonReconstructionBenchmark::MakeToyOptics("lhcb2", 20., 2., 0.05);
+  optics_left_[24] = ProtonReconstructionBenchmark::MakeToyOptics("lhcb2", 15., 3., 0.07);
+  rp_z_[120] = 214630.;
+  rp_z_[124] = 220000.;
+  rp_z_[20] = -214630.;
+  rp_z_[24] = -220000.;
+}
+
+
+void testProtonReconstructionBenchmark::CheckReport(const ProtonReconstructionBenchmark::Report &report)
+{
+  CPPUNIT_ASSERT(report.fits > 0);
+  CPPUNIT_ASSERT(report.converged >= 0.9*report.fits);
+  CPPUNIT_ASSERT(report.FcnCallsPerFit() > 0.);
+
+  for(unsigned int i=0; i<report.parameters.size(); i++)
+  {
+    const ProtonReconstructionBenchmark::ParameterStatistics &p = report.parameters[i];
+    CPPUNIT_ASSERT(p.entries == report.converged);
+
+    //bias within 5 standard errors of the mean
+    CPPUNIT_ASSERT(TMath::Abs(p.Bias()) < 5.*p.ResidualRMS()/TMath::Sqrt(p.entries) + 1e-12);
+
+    if(p.pull_entries > 0)
+    {
+      CPPUNIT_ASSERT(p.PullRMS() > 0.5);
+      CPPUNIT_ASSERT(p.PullRMS() < 2.);
+    }
+  }
+}
+
+
+void testProtonReconstructionBenchmark::testStatistics()
+{
+  ProtonReconstructionBenchmark::ParameterStatistics s("a");
+  s.Fill(1., 4.);
+  s.Fill(-3., 4.);
+  s.Fill(2., 0.);
+
+  CPPUNIT_ASSERT(s.entries == 3);
+  CPPUNIT_ASSERT(s.pull_entries == 2);
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(0., s.Bias(), 1e-12);
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(TMath::Sqrt(14./3.), s.ResidualRMS(), 1e-12);
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(-0.5, s.PullMean(), 1e-12);
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(TMath::Sqrt(1.25), s.PullRMS(), 1e-12);
+}
+
+
+void testProtonReconstructionBenchmark::testOneArm()
+{
+  ProtonReconstructionBenchmark::Settings settings;
+  settings.protons = 200;
+
+  edm::ParameterSet conf = ProtonReconstructionBenchmark::DefaultFitterConfig();
+  BeamOpticsParams bop = ProtonReconstructionBenchmark::DefaultBeamOpticsParams();
+
+  RPInverseParameterization fitter_right(1.0, conf, bop);
+  fitter_right.SetParameterizations(optics_right_);
+  ProtonReconstructionBenchmark benchmark_right(settings);
+  CheckReport(benchmark_right.RunOneArm(fitter_right, optics_right_, rp_z_, 1.0));
+
+  RPInverseParameterization fitter_left(-1.0, conf, bop);
+  fitter_left.SetParameterizations(optics_left_);
+  ProtonReconstructionBenchmark benchmark_left(settings);
+  CheckReport(benchmark_left.RunOneArm(fitter_left, optics_left_, rp_z_, -1.0));
+}
+
+
+void testProtonReconstructionBenchmark::testTwoArm()
+{
+  ProtonReconstructionBenchmark::Settings settings;
+  settings.protons = 100;
+
+  RPInverse2SidedParameterization fitter(ProtonReconstructionBenchmark::DefaultFitterConfig(),
+      ProtonReconstructionBenchmark::DefaultBeamOpticsParams());
+  fitter.AddParameterizationsRight(optics_right_);
+  fitter.AddParameterizationsLeft(optics_left_);
+
+  ProtonReconstructionBenchmark benchmark(settings);
+  CheckReport(benchmark.RunTwoArm(fitter, optics_right_, optics_left_, rp_z_));
+}
+
+
+void testProtonReconstructionBenchmark::testReproducibility()
+{
+  ProtonReconstructionBenchmark::Settings settings;
+  settings.protons = 50;
+
+  edm::ParameterSet conf = ProtonReconstructionBenchmark::DefaultFitterConfig();
+  BeamOpticsParams bop = ProtonReconstructionBenchmark::DefaultBeamOpticsParams();
+
+  ProtonReconstructionBenchmark::Report reports[2];
+  for(int i=0; i<2; i++)
+  {
+    RPInverseParameterization fitter(1.0, conf, bop);
+    fitter.SetParameterizations(optics_right_);
+    ProtonReconstructionBenchmark benchmark(settings);
+    reports[i] = benchmark.RunOneArm(fitter, optics_right_, rp_z_, 1.0);
+  }
+
+  CPPUNIT_ASSERT(reports[0].fits == reports[1].fits);
+  CPPUNIT_ASSERT(reports[0].converged == reports[1].converged);
+  CPPUNIT_ASSERT(reports[0].fcn_calls == reports[1].fcn_calls);
+  for(unsigned int i=0; i<reports[0].parameters.size(); i++)
+  {
+    CPPUNIT_ASSERT(reports[0].parameters[i].sum_res == reports[1].parameters[i].sum_res);
+    CPPUNIT_ASSERT(reports[0].parameters[i].sum_pull2 == reports[1].parameters[i].sum_pull2);
+  }
+}
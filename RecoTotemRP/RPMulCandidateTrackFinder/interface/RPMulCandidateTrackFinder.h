@@ -19,6 +19,7 @@
 #include "FWCore/Framework/interface/Event.h"
 #include "FWCore/Framework/interface/EventSetup.h"
 #include "FWCore/Framework/interface/ESHandle.h"
+#include "FWCore/Framework/interface/ESWatcher.h"
 #include "FWCore/ParameterSet/interface/ParameterSet.h"
 #include "FWCore/MessageLogger/interface/MessageLogger.h"
 
@@ -61,6 +62,7 @@ class RPMulCandidateTrackFinder : public edm::EDProducer
     void run(const edm::DetSetVector<TotemRPRecHit> & input, RPMulTrackCandidateCollection& output, const TotemRPGeometry & rp_geometry);
     const edm::ParameterSet conf_;
     RPMulCandidateTrackFinderAlgorithm RPMulCandidateTrackFinderAlgorithm_;
+    edm::ESWatcher<VeryForwardRealGeometryRecord> geometryWatcher;
     int verbosity_;
     unsigned int minimal_hits_count_per_rp_; // the minimal amount of (U&V) hits for starting the track finding
 
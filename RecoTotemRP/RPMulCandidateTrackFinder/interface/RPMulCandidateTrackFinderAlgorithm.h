@@ -31,22 +31,12 @@
 #include <limits>
 #include <vector>
 #include <map>
+#include <memory>
+#include <bitset>
 #include <functional>
 
 //ROOT
-#include "TFile.h"
-#include "TDirectory.h"
-#include "TCanvas.h"
-#include "TPad.h"
-#include "TTree.h"
-#include "TBranch.h"
-#include "TH1D.h"
-#include "TH1I.h"
-#include "TH2I.h"
-#include "TH2D.h"
-#include "TLine.h"
 #include "TMath.h"
-#include "TRint.h"
 
 //CLHEP
 #include "CLHEP/Vector/ThreeVector.h"
@@ -54,10 +44,14 @@
 #include "DataFormats/CTPPSReco/interface/TotemRPRecHit.h"
 
 
+class TFile;
+class RPMulCandidateTrackFinderDiagnostics;
+
 class RPMulCandidateTrackFinderAlgorithm
 {
   public:
     RPMulCandidateTrackFinderAlgorithm(const edm::ParameterSet& conf);
+    ~RPMulCandidateTrackFinderAlgorithm();
     void BuildTrackCandidates(unsigned int rp_copy_no, 
         const std::map<unsigned int, std::vector<TotemRPRecHit> > & det_u_hits, 
         const std::map<unsigned int, std::vector<TotemRPRecHit> > & det_v_hits, 
@@ -65,36 +59,46 @@ class RPMulCandidateTrackFinderAlgorithm
         const TotemRPGeometry & rp_geometry);
     void WriteAllPlots(TFile *of);
 
+    /// precomputes the strip alignment offsets of all detectors, to be called whenever the geometry changes
+    void ResetGeometry(const TotemRPGeometry & rp_geometry);
+
   private:
 
     typedef std::map<unsigned int, double> strip_rough_alignment_map; //det 32 bit id vs. shift value
     
+    // the hits are referenced, not copied, the cluster is valid only during the BuildTrackCandidates call
     class RecoHitCluster
     {
       public:
-        RecoHitCluster() : g_pos_sum_(0.0), l_pos_sum_(0.0) {}
-        inline const std::vector<TotemRPRecHit> & GetRecHits() { return hit_vect_; }
-        inline const std::map<unsigned int, int> & GetHitNumDetMap() { return det_nhit_map_; }
-        inline double GetMeanPosition() { return g_pos_sum_ / hit_vect_.size(); }
-        inline double GetMeanPositionLocal() { return l_pos_sum_ / hit_vect_.size(); }
-        inline unsigned int GetHitsNumber() { return hit_vect_.size(); }
-        inline unsigned int GetActiveDetsNumber() { return det_nhit_map_.size(); }
-
-        void AddHit(const TotemRPRecHit &hit, double pos)
+        RecoHitCluster() { Clear(); }
+        inline const std::vector<const TotemRPRecHit *> & GetRecHits() const { return hit_vect_; }
+        inline double GetMeanPosition() const { return g_pos_sum_ / hit_vect_.size(); }
+        inline double GetMeanPositionLocal() const { return l_pos_sum_ / hit_vect_.size(); }
+        inline unsigned int GetHitsNumber() const { return hit_vect_.size(); }
+        inline unsigned int GetActiveDetsNumber() const { return det_mask_.count(); }
+
+        // keeps the capacity of the hit vector
+        void Clear()
+        {
+          hit_vect_.clear();
+          det_mask_.reset();
+          g_pos_sum_ = 0.0;
+          l_pos_sum_ = 0.0;
+        }
+
+        void AddHit(const TotemRPRecHit &hit, double pos, unsigned int det)
         {
-          hit_vect_.push_back(hit);
+          hit_vect_.push_back(&hit);
           g_pos_sum_ += pos;
           l_pos_sum_ += hit.getPosition();
-
-          // TODO: fix
-          //++det_nhit_map_[TotemRPDetId(hit.DetId()).detector()];
+          det_mask_.set(det);
         }
 
       private:
         // the vector of all hits belonging to this cluster (or road)
-        std::vector<TotemRPRecHit> hit_vect_;
-        // the map of detector id (0 - 9) ==> hits number
-        std::map<unsigned int, int, std::less<unsigned int> > det_nhit_map_;
+        std::vector<const TotemRPRecHit *> hit_vect_;
+        // the detectors (0 - 9) with hits in this cluster (or road)
+        std::bitset<16> det_mask_;
         // the sum of all hits from this cluster (or road) to calculating the global mean position
         // of this road
         double g_pos_sum_;
@@ -103,15 +107,37 @@ class RPMulCandidateTrackFinderAlgorithm
         double l_pos_sum_;
     };
 
+    // the roads of one projection, all buffers are reused between the calls
+    struct ProjectionRoads
+    {
+      std::vector<RecoHitCluster> clusters;   // only the first used_clusters are valid
+      unsigned int used_clusters;
+      std::vector<unsigned int> roads;        // indices of the clusters which make valid roads
+      std::vector<double> roads_mean;         // local mean position of the roads
+
+      ProjectionRoads() : used_clusters(0) {}
+      RecoHitCluster & NewCluster();
+    };
+
+    // a hit with its aligned position, the input of the road finding
+    struct RoadHit
+    {
+      double position;
+      unsigned int det;
+      const TotemRPRecHit *hit;
+
+      bool operator< (const RoadHit &other) const { return position < other.position; }
+    };
+
     double GetDetStripAlignment(unsigned int det_id, const TotemRPGeometry & rp_geometry);
-    void FindRecoHitRoads(const std::map<unsigned int, std::vector<TotemRPRecHit> > & det_hits,
-        std::vector< std::vector<TotemRPRecHit> > & hits_clusters,
-        std::vector<double> & roads_mean,
+    unsigned int GetRoadBucket(double position) const;
+    void FindRecoHitRoads(unsigned int rp_copy_no,
+        const std::map<unsigned int, std::vector<TotemRPRecHit> > & det_hits,
+        ProjectionRoads & roads,
         const TotemRPGeometry & rp_geometry);
     double CalcCandidateTrackWeight(const double u_mean, const double v_mean,
-        const std::vector<TotemRPRecHit> & u_hits_vec,
-        const std::vector<TotemRPRecHit> & v_hits_vec);
-    void DrawRPPlaneEnvelope();
+        const std::vector<const TotemRPRecHit *> & u_hits_vec,
+        const std::vector<const TotemRPRecHit *> & v_hits_vec);
  
     const edm::ParameterSet& conf_;
     int verbosity_;
@@ -123,26 +149,16 @@ class RPMulCandidateTrackFinderAlgorithm
     strip_rough_alignment_map the_align_map_;
     RPTopology det_topology_;
 
-    int output_;
-    int outputHitsNumTree_;
-    int outputRPHitsPlot_;
-    int outputRPRoadsPlot_;
-    int outputRPTracksPlot_;
-
-    std::ostringstream oss;
-    std::map<unsigned int, int> rp_hits_map;  // Roman Pot Id ==> index of hits information
-    int u_nhits_det_array[24][5];      // number of U hits on five detectors for each Roman Pot array
-    int v_nhits_det_array[24][5];      // number of V hits on five detectors for each Roman Pot array
-    TTree *u_nhits_det_trees[24];      // number of U hits on five detectors for each Roman Pot trees
-    TTree *v_nhits_det_trees[24];      // number of V hits on five detectors for each Roman Pot trees
-    TH1I *u_nhits_det_hist[24];        // number of U hits per detector for each Roman Pot histograms
-    TH1I *v_nhits_det_hist[24];        // number of V hits per detector for each Roman Pot histograms
-    TH1D *u_hits_pos_rp_hist[24];      // U hits position distribution in local coordinate for each Roman Pot histogram
-    TH1D *v_hits_pos_rp_hist[24];      // V hits position distribution in local coordinate for each Roman Pot histogram
-    TH1I *u_nroads_rp_hist[24];        // total number of U roads for each Roman Pot histograms
-    TH1I *v_nroads_rp_hist[24];        // total number of V roads for each Roman Pot histograms
-    TH2I *uv_nroads_pair_rp_hist[24];  // (U,V) roads number pair for each Roman Pot 2D histograms
-    TH2D *track_pos_rp_hist[24][3];    // Track position distribution histgrams, [..][0] U = V = 1, [..][1] U = V > 1, [..][2] U != V
+    // road finding buffers, reused between the calls
+    std::vector<RoadHit> road_hits_;                      // the hits of a projection sorted by the aligned position
+    std::vector< std::vector<unsigned int> > road_grid_;  // bucket of width road_width_ ==> indices of the roads with the mean inside
+    double road_grid_min_;                                // the lower edge of the first bucket
+    unsigned int road_grid_size_;                         // the number of buckets in use
+
+    ProjectionRoads u_roads_, v_roads_;
+
+    // the diagnostic plots, only present if Output is set
+    std::unique_ptr<RPMulCandidateTrackFinderDiagnostics> diagnostics_;
 };
 
 
@@ -0,0 +1,90 @@
+/****************************************************************************
+ *
+ * Diagnostic plots of RPMulCandidateTrackFinderAlgorithm, split off the
+ * algorithm so that they are only built when requested (Output != 0).
+ * Original Authors:
+ *   Hubert Niewiadomski (Hubert.Niewiadomski@cern.ch)
+ * Secondary Authors:
+ *   Zhang Zhengkui (zhang.zhengkui.fin@gmail.com)
+ *
+ ****************************************************************************/
+
+
+#ifndef RecoTotemRP_RPMulCandidateTrackFinder_RPMulCandidateTrackFinderDiagnostics_h
+#define RecoTotemRP_RPMulCandidateTrackFinder_RPMulCandidateTrackFinderDiagnostics_h
+
+
+//edm
+#include "FWCore/ParameterSet/interface/ParameterSet.h"
+
+//Data format
+#include "DataFormats/CTPPSReco/interface/TotemRPRecHit.h"
+
+//C++ and STL
+#include <sstream>
+#include <vector>
+#include <map>
+
+//ROOT
+#include "TFile.h"
+#include "TDirectory.h"
+#include "TCanvas.h"
+#include "TPad.h"
+#include "TTree.h"
+#include "TBranch.h"
+#include "TH1D.h"
+#include "TH1I.h"
+#include "TH2I.h"
+#include "TH2D.h"
+#include "TLine.h"
+
+//CLHEP
+#include "CLHEP/Vector/ThreeVector.h"
+
+
+/**
+ *\brief Observer of RPMulCandidateTrackFinderAlgorithm filling the per Roman Pot hit, road and track plots.
+ **/
+class RPMulCandidateTrackFinderDiagnostics
+{
+  public:
+    RPMulCandidateTrackFinderDiagnostics(const edm::ParameterSet& conf);
+
+    /// fills the plots with the hits and the local road means of one Roman Pot
+    void Fill(unsigned int rp_copy_no,
+        const std::map<unsigned int, std::vector<TotemRPRecHit> > & det_u_hits,
+        const std::map<unsigned int, std::vector<TotemRPRecHit> > & det_v_hits,
+        const std::vector<double> & u_roads_mean,
+        const std::vector<double> & v_roads_mean);
+
+    /// writes all plots into different folders of the file
+    void Write(TFile *of);
+
+  private:
+    void DrawRPPlaneEnvelope();
+
+    unsigned int maximum_hits_multiplicity_per_det_;
+
+    int outputHitsNumTree_;
+    int outputRPHitsPlot_;
+    int outputRPRoadsPlot_;
+    int outputRPTracksPlot_;
+
+    std::ostringstream oss;
+    std::map<unsigned int, int> rp_hits_map;  // Roman Pot Id ==> index of hits information
+    int u_nhits_det_array[24][5];      // number of U hits on five detectors for each Roman Pot array
+    int v_nhits_det_array[24][5];      // number of V hits on five detectors for each Roman Pot array
+    TTree *u_nhits_det_trees[24];      // number of U hits on five detectors for each Roman Pot trees
+    TTree *v_nhits_det_trees[24];      // number of V hits on five detectors for each Roman Pot trees
+    TH1I *u_nhits_det_hist[24];        // number of U hits per detector for each Roman Pot histograms
+    TH1I *v_nhits_det_hist[24];        // number of V hits per detector for each Roman Pot histograms
+    TH1D *u_hits_pos_rp_hist[24];      // U hits position distribution in local coordinate for each Roman Pot histogram
+    TH1D *v_hits_pos_rp_hist[24];      // V hits position distribution in local coordinate for each Roman Pot histogram
+    TH1I *u_nroads_rp_hist[24];        // total number of U roads for each Roman Pot histograms
+    TH1I *v_nroads_rp_hist[24];        // total number of V roads for each Roman Pot histograms
+    TH2I *uv_nroads_pair_rp_hist[24];  // (U,V) roads number pair for each Roman Pot 2D histograms
+    TH2D *track_pos_rp_hist[24][3];    // Track position distribution histgrams, [..][0] U = V = 1, [..][1] U = V > 1, [..][2] U != V
+};
+
+
+#endif
@@ -0,0 +1,359 @@
+#include "RecoTotemRP/RPMulCandidateTrackFinder/interface/RPMulCandidateTrackFinderDiagnostics.h"
+
+#include <iomanip>
+
+
+RPMulCandidateTrackFinderDiagnostics::RPMulCandidateTrackFinderDiagnostics(const edm::ParameterSet& conf)
+{
+  maximum_hits_multiplicity_per_det_ = conf.getParameter<unsigned int>("MaxHitsPerDetector");
+
+  std::vector<unsigned int> rpList = conf.getParameter< std::vector<unsigned int> >("RPList");
+  outputHitsNumTree_ = conf.getParameter<int>("ProduceHitsNumTree");
+  outputRPHitsPlot_ = conf.getParameter<int>("ProduceRPHitsPlot");
+  outputRPRoadsPlot_ = conf.getParameter<int>("ProduceRPRoadsPlot");
+  outputRPTracksPlot_ = conf.getParameter<int>("ProduceRPTracksPlot");
+
+  for(unsigned int i = 0; i < rpList.size(); i++)
+  {
+    // initialize RP_ID ==> Hits_Information_Index map
+    rp_hits_map[rpList[i]] = i;
+
+    // initialize u/v_nhits_det_trees and create branches for each detector
+    if(outputHitsNumTree_)
+    {
+      // create U Hit Num RP Tree
+      oss.str("");
+      oss << "U_Hit_Num_Tree_RP_" << std::setw(3) << std::setfill('0') << rpList[i];
+      u_nhits_det_trees[i] = new TTree(oss.str().c_str(), "U Hit Num");
+      // create V Hit Num RP Tree
+      oss.str("");
+      oss << "V_Hit_Num_Tree_RP" << std::setw(3) << std::setfill('0') << rpList[i];
+      v_nhits_det_trees[i] = new TTree(oss.str().c_str(), "V Hit Num");
+      // create branches for each detector of this Roman Pot
+      for(int j = 0; j < 5; j++)
+      {
+        oss.str("");
+        oss << "U_DET" << 2 * j + 1;
+        u_nhits_det_trees[i]->Branch(oss.str().c_str(), &u_nhits_det_array[i][j], (oss.str() + "/I").c_str());
+        oss.str("");
+        oss << "V_DET" << 2 * j;
+        v_nhits_det_trees[i]->Branch(oss.str().c_str(), &v_nhits_det_array[i][j], (oss.str() + "/I").c_str());;
+      }
+    }
+
+    // initialize u/v_avg_nhits_det_hist and u/v_hits_pos_rp_hist
+    if(outputRPHitsPlot_)
+    {
+      oss.str("");
+      oss << "U_Hit_Num_Per_Det_Hist_RP" << std::setw(3) << std::setfill('0') << rpList[i];
+      u_nhits_det_hist[i] = new TH1I(oss.str().c_str(), "Number of U hits per detector", 
+          maximum_hits_multiplicity_per_det_, 0, maximum_hits_multiplicity_per_det_); 
+      oss.str("");
+      oss << "V_Hit_Num_Per_Det_Hist_RP" << std::setw(3) << std::setfill('0') << rpList[i];
+      v_nhits_det_hist[i] = new TH1I(oss.str().c_str(), "Number of V hits per detector", 
+          maximum_hits_multiplicity_per_det_, 0, maximum_hits_multiplicity_per_det_);
+      oss.str("");
+      oss << "U_Hit_Pos_Hist_RP" << std::setw(3) << std::setfill('0') << rpList[i];
+      u_hits_pos_rp_hist[i] = new TH1D(oss.str().c_str(), "U hits postion distribution", 500, -20.0, 20.0);
+      oss.str("");
+      oss << "V_Hit_Pos_Hist_RP" << std::setw(3) << std::setfill('0') << rpList[i];
+      v_hits_pos_rp_hist[i] = new TH1D(oss.str().c_str(), "V hits postion distribution", 500, -20.0, 20.0);
+    }
+
+    // initialize u/v_nroads_rp_hist and uv_nroads_pair_rp_hist
+    if(outputRPRoadsPlot_)
+    {
+      oss.str("");
+      oss << "U_Road_Total_Num_Hist_RP" << std::setw(3) << std::setfill('0') << rpList[i];
+      u_nroads_rp_hist[i] = new TH1I(oss.str().c_str(), "Total number of U roads", 
+          maximum_hits_multiplicity_per_det_, 0, maximum_hits_multiplicity_per_det_);
+      oss.str("");
+      oss << "V_Road_Total_Num_Hist_RP" << std::setw(3) << std::setfill('0') << rpList[i];
+      v_nroads_rp_hist[i] = new TH1I(oss.str().c_str(), "Total number of V roads", 
+          maximum_hits_multiplicity_per_det_, 0, maximum_hits_multiplicity_per_det_);
+      oss.str("");
+      oss << "UV_Road_Pair_Hist_RP" << std::setw(3) << std::setfill('0') << rpList[i];
+      uv_nroads_pair_rp_hist[i] = new TH2I(oss.str().c_str(), "(U,V) roads pair", 
+          maximum_hits_multiplicity_per_det_, 0, maximum_hits_multiplicity_per_det_,
+          maximum_hits_multiplicity_per_det_, 0, maximum_hits_multiplicity_per_det_);
+    }
+
+    // initialize track_pos_rp_dist
+    if(outputRPTracksPlot_)
+    {
+      oss.str("");
+      oss << "Track_Pos_UeqVeq1_RP" << std::setw(3) << std::setfill('0') << rpList[i];
+      track_pos_rp_hist[i][0] = new TH2D(oss.str().c_str(), "Candidate track position distribution (U = V = 1)", 500, -20., +20., 500, -20., +20.);
+      oss.str("");
+      oss << "Track_Pos_UeqVgt1_RP" << std::setw(3) << std::setfill('0') << rpList[i];
+      track_pos_rp_hist[i][1] = new TH2D(oss.str().c_str(), "Candidate track position distribution (U = V > 1)", 500, -20., +20., 500, -20., +20.);
+      oss.str("");
+      oss << "Track_Pos_UneqV_RP" << std::setw(3) << std::setfill('0') << rpList[i];
+      track_pos_rp_hist[i][2] = new TH2D(oss.str().c_str(), "Candidate track position distribution (U != V)", 500, -20., +20., 500, -20., +20.);
+    }
+  } // for(;;) 
+}
+
+
+/// ---------------------------------------------------------------------------------------------------
+
+void RPMulCandidateTrackFinderDiagnostics::Fill(unsigned int rp_copy_no,
+    const std::map<unsigned int, std::vector<TotemRPRecHit> > & det_u_hits, 
+    const std::map<unsigned int, std::vector<TotemRPRecHit> > & det_v_hits, 
+    const std::vector<double> & u_roads_mean,
+    const std::vector<double> & v_roads_mean)
+{
+  std::map<unsigned int, std::vector<TotemRPRecHit> >::const_iterator u_det_hits_it, v_det_hits_it;
+  std::vector<TotemRPRecHit>::const_iterator hits_it;
+  int idx = rp_hits_map[rp_copy_no];
+  int u_nhits = 0;
+  int v_nhits = 0;
+  TH2D *tr_hist = NULL;
+
+  for(unsigned int i = 0; i < 5; i++)
+  {
+    // U Detector
+    u_det_hits_it = det_u_hits.find(2*i+1);
+    u_nhits = ((u_det_hits_it == det_u_hits.end()) ? 0 : (u_det_hits_it->second).size());  // assume the present detectors always has hits
+    // V Detector
+    v_det_hits_it = det_v_hits.find(2*i);
+    v_nhits = ((v_det_hits_it == det_v_hits.end()) ? 0 : (v_det_hits_it->second).size());  // assume the present detectors always has hits
+
+    if(outputHitsNumTree_)
+    {
+      u_nhits_det_array[idx][i] = u_nhits;
+      v_nhits_det_array[idx][i] = v_nhits;
+    }
+
+    if(outputRPHitsPlot_)
+    {
+      if(u_det_hits_it != det_u_hits.end())
+      {
+        u_nhits_det_hist[idx]->Fill((u_det_hits_it->second).size());
+        for(hits_it = (u_det_hits_it->second).begin(); hits_it != (u_det_hits_it->second).end(); hits_it++)
+        {
+          u_hits_pos_rp_hist[idx]->Fill(hits_it->getPosition());
+        }
+      }
+      if(v_det_hits_it != det_v_hits.end())
+      {
+        v_nhits_det_hist[idx]->Fill((v_det_hits_it->second).size());
+        for(hits_it = (v_det_hits_it->second).begin(); hits_it != (v_det_hits_it->second).end(); hits_it++)
+        {
+          v_hits_pos_rp_hist[idx]->Fill(hits_it->getPosition());
+        }
+      }
+    }
+  }
+
+  if(outputHitsNumTree_)
+  {
+    u_nhits_det_trees[idx]->Fill();
+    v_nhits_det_trees[idx]->Fill();
+  }
+
+  if(outputRPRoadsPlot_)
+  {
+    unsigned int u_nroads = u_roads_mean.size();
+    unsigned int v_nroads = v_roads_mean.size();
+    if(u_nroads != 0)
+    {
+      u_nroads_rp_hist[idx]->Fill(u_nroads);
+    }
+    if(v_nroads != 0)
+    {
+      v_nroads_rp_hist[idx]->Fill(v_nroads);
+    }
+    if(u_nroads != 0 || v_nroads != 0)
+    {
+      uv_nroads_pair_rp_hist[idx]->Fill(u_nroads, v_nroads);
+    }
+  }
+
+  if(outputRPTracksPlot_)
+  {
+    if(u_roads_mean.size() != 0 && v_roads_mean.size() != 0)
+    {
+      if(u_roads_mean.size() == v_roads_mean.size())
+      {
+        tr_hist = ((u_roads_mean.size() == 1) ? track_pos_rp_hist[idx][0] : track_pos_rp_hist[idx][1]);
+      }
+      else
+      {
+        tr_hist = track_pos_rp_hist[idx][2];
+      }
+      for(unsigned int ui = 0; ui < u_roads_mean.size(); ui++)
+      {
+        for(unsigned int vi = 0; vi < v_roads_mean.size(); vi++)
+        {
+          tr_hist->Fill(u_roads_mean[ui], v_roads_mean[vi]);
+        }
+      }
+    }
+  }
+}
+
+
+/// ---------------------------------------------------------------------------------------------------
+
+void RPMulCandidateTrackFinderDiagnostics::Write(TFile *of)
+{
+  // write all plots into different folders
+  std::map<unsigned int, int>::const_iterator it;
+  int idx;
+ 
+  if(outputHitsNumTree_)
+  {
+    dir = of->mkdir("HitsNumDetTrees", "Hits Number Per Detector for each Roman Pot");
+    for(unsigned int i = 0; i < rp_hits_map.size(); i++)
+    {
+      dir->WriteTObject(u_nhits_det_trees[i]);
+      dir->WriteTObject(v_nhits_det_trees[i]);
+    }
+  }
+
+  if(outputRPHitsPlot_)
+  {
+    dir = of->mkdir("HitsRPHists", "Hits Number and Distribution for each Roman Pot");
+    for(it = rp_hits_map.begin(); it != rp_hits_map.end(); it++)
+    {
+      oss.str("");
+      oss << "RP" << std::setw(3) << std::setfill('0') << it->first << "_hits_hists";
+      idx = rp_hits_map[it->first];
+      TCanvas *c4h = new TCanvas(oss.str().c_str(), "Hits Number and Distribution", 10, 10, 800, 800);
+      c4h->SetFillColor(41);
+      c4h->Divide(2, 2);
+      // in top left pad, draw the U hits number per RP
+      c4h->cd(1);
+      u_nhits_det_hist[idx]->Draw();
+      // in top right pad, draw the V hits number per RP
+      c4h->cd(2);
+      v_nhits_det_hist[idx]->Draw();
+      // in bottom left pad, draw the U hits distribution per RP
+      c4h->cd(3);
+      u_hits_pos_rp_hist[idx]->Draw();
+      // in bottom right pad, draw the V hits distribution per RP
+      c4h->cd(4);
+      v_hits_pos_rp_hist[idx]->Draw();
+      // write this canvas
+      dir->WriteTObject(c4h);
+    }
+  }
+
+  if(outputRPRoadsPlot_)
+  {
+    dir = of->mkdir("RoadsRPHists", "Roads Number and Pair for each Roman Pot");
+    for(it = rp_hits_map.begin(); it != rp_hits_map.end(); it++)
+    {
+      oss.str("");
+      oss << "RP" << std::setw(3) << std::setfill('0') << it->first << "_roads_hists";
+      idx = rp_hits_map[it->first];
+      TCanvas *c3h = new TCanvas(oss.str().c_str(), "Roads Number and Pair", 10, 10, 900, 600);
+      TPad *pad1 = new TPad("pad1", "U Roads Number", 0.01, 0.51, 0.32, 0.99, 21);
+      TPad *pad2 = new TPad("pad2", "V Roads Number", 0.01, 0.01, 0.32, 0.49, 21);
+      TPad *pad3 = new TPad("pad3", "(U,V) Roads Pair", 0.34, 0.01, 0.99, 0.99, 41);
+      pad1->Draw();
+      pad2->Draw();
+      pad3->Draw();
+      // in the 1st pad, draw the U roads number per RP
+      pad1->cd();
+      u_nroads_rp_hist[idx]->Draw();
+      // in the 2nd pad, draw the V roads number per RP
+      pad2->cd();
+      v_nroads_rp_hist[idx]->Draw();
+      // in the 3rd pad, draw the (U,V) roads pair per RP
+      pad3->cd();
+      pad3->SetGrid();
+      uv_nroads_pair_rp_hist[idx]->GetXaxis()->SetTitle("U Roads");
+      uv_nroads_pair_rp_hist[idx]->GetYaxis()->SetTitle("V Roads");
+      uv_nroads_pair_rp_hist[idx]->Draw("text");
+      // write this canvas
+      dir->WriteTObject(c3h);
+    }
+  }
+
+  if(outputRPTracksPlot_)
+  {
+    dir = of->mkdir("TracksRPHists", "Track Position Distribution for each Roman Pot");
+    for(it = rp_hits_map.begin(); it != rp_hits_map.end(); it++)
+    {
+      oss.str("");
+      oss << "RP" << std::setw(3) << std::setfill('0') << it->first << "_track_hist";
+      idx = rp_hits_map[it->first];
+      TCanvas *c2h = new TCanvas(oss.str().c_str(), "Track Position Distribution", 10, 10, 800, 800);
+      c2h->SetFillColor(41);
+      c2h->Divide(2, 2);
+      // in the top left pad, draw the track position distribution (U = V = 1)
+      c2h->cd(1);
+      track_pos_rp_hist[idx][0]->GetXaxis()->SetTitle("V");
+      track_pos_rp_hist[idx][0]->GetYaxis()->SetTitle("U");
+      track_pos_rp_hist[idx][0]->SetMarkerColor(1);
+      track_pos_rp_hist[idx][0]->SetMarkerStyle(20);
+      track_pos_rp_hist[idx][0]->SetMarkerSize(0.3);
+      track_pos_rp_hist[idx][0]->Draw();
+      DrawRPPlaneEnvelope();
+      // in the top right pad, draw the track position distribution (U = V > 1)
+      c2h->cd(2); 
+      track_pos_rp_hist[idx][1]->GetXaxis()->SetTitle("V");
+      track_pos_rp_hist[idx][1]->GetYaxis()->SetTitle("U");
+      track_pos_rp_hist[idx][1]->SetMarkerColor(2);
+      track_pos_rp_hist[idx][1]->SetMarkerStyle(20);
+      track_pos_rp_hist[idx][1]->SetMarkerSize(0.3);
+      track_pos_rp_hist[idx][1]->Draw();
+      DrawRPPlaneEnvelope();
+      // in the bottom left pad, draw the track position distribution (U != V)
+      c2h->cd(3);
+      track_pos_rp_hist[idx][2]->GetXaxis()->SetTitle("V");
+      track_pos_rp_hist[idx][2]->GetYaxis()->SetTitle("U");
+      track_pos_rp_hist[idx][2]->SetMarkerColor(6);
+      track_pos_rp_hist[idx][2]->SetMarkerStyle(20);
+      track_pos_rp_hist[idx][2]->SetMarkerSize(0.3);
+      track_pos_rp_hist[idx][2]->Draw();
+      DrawRPPlaneEnvelope();
+      // write this canvas
+      dir->WriteTObject(c2h);
+    } 
+  }
+}
+
+
+/// ---------------------------------------------------------------------------------------------------
+
+// Draw Roman Pot Plane Envelope
+void RPMulCandidateTrackFinderDiagnostics::DrawRPPlaneEnvelope()
+{
+  CLHEP::Hep3Vector pA,pB,pC,pD,pE;
+  double half_len = 18.0325; // half length of detector's edge
+  double cut = 20.25338527;  // length of the edge adjacent to the cut
+
+  pA.setX(half_len);
+  pA.setY(-half_len);
+
+  pB.setX(half_len);
+  pB.setY(half_len);
+
+  pC.setX(-half_len);
+  pC.setY(half_len);
+
+  pD.setX(-half_len);
+  pD.setY(half_len-cut);
+
+  pE.setX(half_len-cut);
+  pE.setY(-half_len);
+
+  TLine *lAB = new TLine(pA.x(), pA.y(), pB.x(), pB.y());
+  lAB->SetLineColor(4);
+  lAB->Draw();
+  TLine *lBC = new TLine(pB.x(), pB.y(), pC.x(), pC.y());
+  lBC->SetLineColor(4);
+  lBC->Draw();
+  TLine *lCD = new TLine(pC.x(), pC.y(), pD.x(), pD.y());
+  lCD->SetLineColor(4);
+  lCD->Draw();
+  TLine *lDE = new TLine(pD.x(), pD.y(), pE.x(), pE.y());
+  lDE->SetLineColor(4);
+  lDE->Draw();
+  TLine *lEA = new TLine(pE.x(), pE.y(), pA.x(), pA.y());
+  lEA->SetLineColor(4);
+  lEA->Draw();
+}
@@ -27,6 +27,9 @@
 #include "RecoTotemRP/RPRecoDataFormats/interface/RPMulTrackCandidateCollection.h"
 #include "RecoTotemRP/RPRecoDataFormats/interface/RPMulFittedTrackCollection.h"
 //#include "RecoTotemRP/RPTrackCandidateFitter/interface/RPTrackCandidateFitter.h"
+#include "RecoTotemRP/RPMulTrackCandidateCollectionFitter/interface/RPUVPairSelector.h"
+#include "RecoCTPPS/TotemRPLocal/interface/TotemRPLocalTrackFitterAlgorithm.h"
+#include "DataFormats/CTPPSReco/interface/TotemRPUVPattern.h"
 #include "Geometry/VeryForwardRPTopology/interface/RPTopology.h"
 
 #include <string>
@@ -37,6 +40,10 @@
  *\brief Fits every track candidate in RPMulTrackCandidateCollection.
  *
  * Result is collection of fitted tracks (RPMulFittedTrackCollection). The fit itself is performed by class RPTrackCandidateFitter.
+ *
+ * With readReconstructedPatterns, the U-V pairs of the recognized patterns are first selected by RPUVPairSelector
+ * and only the selected ones are fitted (TotemRPLocalTrackFitterAlgorithm). The RPs can be fitted in parallel
+ * by FitThreads workers running as TBB tasks, the tracks of an RP are stored in the order of the pair selection regardless of the scheduling.
  **/
 class RPMulTrackCandidateCollectionFitter : public edm::EDProducer
 {
@@ -51,6 +58,23 @@ class RPMulTrackCandidateCollectionFitter : public edm::EDProducer
     void produceFromReconstructedPatterns(edm::Event& e, const edm::EventSetup& c, RPMulFittedTrackCollection& fitTrackColl);
   
   private:
+    /// the selected pairs of one RP and their fits (one slot per pair)
+    struct RPFitTask
+    {
+      unsigned int rp;
+      const edm::DetSet<TotemRPUVPattern> *patterns;
+      std::vector<RPUVPairSelector::Pair> pairs;
+      std::vector<TotemRPLocalTrack> tracks;
+    };
+
+    void FitPairs(RPFitTask &task, TotemRPLocalTrackFitterAlgorithm &fitter, const TotemRPGeometry &geometry);
+
+    /// fits the tasks with task i assigned to worker i % workers, each worker has its own fitter
+    void FitWorker(std::vector<RPFitTask> &tasks, unsigned int worker, unsigned int workers,
+        const TotemRPGeometry &geometry);
+
+    void RunFitTasks(std::vector<RPFitTask> &tasks, const TotemRPGeometry &geometry);
+
     edm::InputTag rPMulTrackCandidateCollectionLabel;
     edm::EDGetTokenT< RPMulTrackCandidateCollection > rPMulTrackCandidateCollectionToken;
     double calculateMeanValue(const std::vector<TotemRPRecHit> &coll, std::vector<TotemRPRecHit> &obj_coll);
@@ -59,8 +83,13 @@ class RPMulTrackCandidateCollectionFitter : public edm::EDProducer
     //RPTrackCandidateFitter the_track_candidate_fitter_;
     bool readReconstructedPatterns_;
     std::string reconstructedPatternsInstance_;
+    edm::EDGetTokenT< edm::DetSetVector<TotemRPUVPattern> > reconstructedPatternsToken_;
     RPTopology det_topology_;
 
+    RPUVPairSelector pair_selector_;
+    unsigned int fit_threads_;
+    std::vector<TotemRPLocalTrackFitterAlgorithm> fitters_;   ///< one per fit worker
+
     /// A watcher to detect geometry changes.
     edm::ESWatcher<VeryForwardRealGeometryRecord> geometryWatcher;
 };
@@ -0,0 +1,100 @@
+/****************************************************************************
+ *
+ * U-V pattern pair selection for RPMulTrackCandidateCollectionFitter.
+ *
+ ****************************************************************************/
+
+#ifndef RecoTotemRP_RPMulTrackCandidateCollectionFitter_RPUVPairSelector_h
+#define RecoTotemRP_RPMulTrackCandidateCollectionFitter_RPUVPairSelector_h
+
+#include "FWCore/ParameterSet/interface/ParameterSet.h"
+#include "DataFormats/Common/interface/DetSet.h"
+#include "DataFormats/CTPPSReco/interface/TotemRPUVPattern.h"
+#include "Geometry/VeryForwardGeometryBuilder/interface/TotemRPGeometry.h"
+
+#include <vector>
+#include <utility>
+#include <unordered_map>
+
+
+/**
+ *\brief Selects the U-V pattern pairs of a Roman Pot which are worth a full track fit.
+ *
+ * Every pattern gets the chi^2 of the best straight line through its hits in its projection (closed form).
+ * As long as the strips of one projection are parallel in all planes, the fit of any track made of the pattern
+ * cannot do better in that projection, so the sum of the U and V values is a lower bound of the chi^2 of the pair's
+ * track fit (for the ideal geometry it is the fit chi^2 itself).
+ *
+ * Rejected are the pairs outside the sensitive area, with too few hits to fit or with a bound per degree of freedom
+ * above MaxPairChiSqPerNdf. A pair whose U and V hits are contained in a pair with lower (or equal) bound per degree
+ * of freedom is dominated and rejected too. The survivors are sorted by the bound per degree of freedom, ties by the
+ * pattern indices, and at most MaxPairsPerRP of them are kept.
+ **/
+class RPUVPairSelector
+{
+  public:
+    struct Pair
+    {
+      unsigned int u, v;    ///< indices of the U and V patterns in the RP pattern collection
+      unsigned int hits;    ///< number of U and V hits
+      double chi2_bound;    ///< lower bound of the track fit chi^2
+
+      /// the bound per degree of freedom, the track has 4 parameters
+      double Score() const { return chi2_bound / (hits - 4); }
+    };
+
+    RPUVPairSelector(const edm::ParameterSet &conf);
+
+    /// Resets the detector cache, to be called every time the geometry changes.
+    void Reset();
+
+    /// Fills the selected pairs of one RP in the order of preference.
+    /// Returns the number of pairs before the selection.
+    unsigned int Select(const edm::DetSet<TotemRPUVPattern> &patterns, const TotemRPGeometry &geometry,
+        std::vector<Pair> &pairs);
+
+  private:
+    /// z and readout offset of a detector, the same convention as in TotemRPLocalTrackFitterAlgorithm
+    struct DetData
+    {
+      double z;
+      double u_0;
+    };
+
+    struct PatternData
+    {
+      unsigned int index;
+      unsigned int hits;
+      double chi2;                                           ///< of the best line in the projection
+      double mean_local;                                     ///< mean local hit position
+      std::vector< std::pair<unsigned int, double> > keys;   ///< (detector id, position) of the hits, sorted
+    };
+
+    struct Candidate
+    {
+      Pair pair;
+      unsigned int u_idx, v_idx;    ///< indices in u_patterns_ and v_patterns_
+      double score;
+
+      bool operator< (const Candidate &other) const;
+    };
+
+    double max_chi2_per_ndf_;          ///< <= 0 means no cut
+    unsigned int max_pairs_per_rp_;    ///< 0 means no limit
+    bool prune_dominated_;
+
+    std::unordered_map<unsigned int, DetData> det_data_map_;
+
+    // buffers reused between the calls
+    std::vector<PatternData> u_patterns_, v_patterns_;
+    std::vector<Candidate> candidates_, selected_;
+
+    const DetData& GetDetData(unsigned int det_id, const TotemRPGeometry &geometry);
+    void PreparePattern(unsigned int index, const TotemRPUVPattern &pattern, const TotemRPGeometry &geometry,
+        PatternData &data);
+
+    /// true if the hits of the candidate a are contained in the hits of the candidate b
+    bool Contains(const Candidate &b, const Candidate &a) const;
+};
+
+#endif
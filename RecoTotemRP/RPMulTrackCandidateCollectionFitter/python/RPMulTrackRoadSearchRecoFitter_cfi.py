@@ -3,6 +3,10 @@ import FWCore.ParameterSet.Config as cms
 RPMulTrackRoadSearchedCandCollFit = cms.EDProducer("RPMulTrackCandidateCollectionFitter",
     Verbosity = cms.int32(0),
     readReconstructedPatterns = cms.bool(True),
+    MaxPairChiSqPerNdf = cms.double(0.),      # U-V pairs with higher chi^2/ndf lower bound are not fitted, 0 = no cut
+    MaxPairsPerRP = cms.uint32(0),            # the maximum number of fitted U-V pairs per RP, 0 = no limit
+    PruneDominatedPairs = cms.bool(True),     # do not fit the pairs whose hits are contained in a better pair
+    FitThreads = cms.uint32(1),               # the number of workers (TBB tasks) fitting the RPs in parallel
     reconstructedPatternsInstance = cms.string('RPSinglTrackCandFind'),
     RPMulTrackCandidateCollectionLabel = cms.InputTag("RPMulTrackCandFind")
 #    reconstructedPatternsInstance = cms.string('NonParallelTrackFinder')
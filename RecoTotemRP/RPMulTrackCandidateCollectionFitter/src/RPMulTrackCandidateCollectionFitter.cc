@@ -12,12 +12,17 @@
 
 #include "RecoTotemRP/RPMulTrackCandidateCollectionFitter/interface/RPMulTrackCandidateCollectionFitter.h"
 
+#include <algorithm>
+
+#include "tbb/task_group.h"
+
 //#include "RecoTotemRP/RPRecoDataFormats/interface/RPRecognizedPatternsCollection.h"
 
 
 RPMulTrackCandidateCollectionFitter::RPMulTrackCandidateCollectionFitter(const edm::ParameterSet& conf) :
   //the_track_candidate_fitter_(conf),
-  readReconstructedPatterns_(false)
+  readReconstructedPatterns_(false),
+  pair_selector_(conf)
 {
 
   edm::LogInfo("RPMulTrackCandidateCollectionFitter") << "[RPMulTrackCandidateCollectionFitter::RPMulTrackCandidateCollectionFitter] Constructing object...";
@@ -26,10 +31,17 @@ RPMulTrackCandidateCollectionFitter::RPMulTrackCandidateCollectionFitter(const e
   {
     readReconstructedPatterns_ = conf.getParameter<bool> ("readReconstructedPatterns");
     reconstructedPatternsInstance_ = conf.getParameter<string> ("reconstructedPatternsInstance");
+    reconstructedPatternsToken_ = consumes< edm::DetSetVector<TotemRPUVPattern> >(edm::InputTag(reconstructedPatternsInstance_));
   }else{
 	  rPMulTrackCandidateCollectionLabel = conf.getParameter<edm::InputTag>("RPMulTrackCandidateCollectionLabel");
       rPMulTrackCandidateCollectionToken = consumes< RPMulTrackCandidateCollection >(rPMulTrackCandidateCollectionLabel);
   }
+
+  fit_threads_ = conf.exists("FitThreads") ? conf.getParameter<unsigned int>("FitThreads") : 1;
+  if(fit_threads_ < 1)
+    fit_threads_ = 1;
+  for(unsigned int i = 0; i < fit_threads_; i++)
+    fitters_.push_back(TotemRPLocalTrackFitterAlgorithm(conf));
   
   produces< RPMulFittedTrackCollection > ();
 }
@@ -113,8 +125,8 @@ void RPMulTrackCandidateCollectionFitter::produceFromReconstructedPatterns(edm::
   edm::ESHandle<TotemRPGeometry> Totem_RP_geometry;
   c.get<VeryForwardRealGeometryRecord>().get(Totem_RP_geometry);
   
-  //edm::Handle< RPRecognizedPatternsCollection > patterns;
-  //e.getByLabel(reconstructedPatternsInstance_, "", patterns);
+  edm::Handle< edm::DetSetVector<TotemRPUVPattern> > patterns;
+  e.getByToken(reconstructedPatternsToken_, patterns);
   
   if(!Totem_RP_geometry.isValid())
   {
@@ -122,76 +134,111 @@ void RPMulTrackCandidateCollectionFitter::produceFromReconstructedPatterns(edm::
     exit(0);
   }
   
-// TODO: uncomment
-#if 0
   if( !patterns.isValid() )
   {
-    std::cout<<"RPMulTrackCandidateCollectionFitter: RPRecognizedPatternsCollection missing, exiting."<<std::endl;
+    std::cout<<"RPMulTrackCandidateCollectionFitter: TotemRPUVPattern collection missing, exiting."<<std::endl;
     exit(0);
   }
 
-  for (RPRecognizedPatternsCollection::const_iterator rpit = patterns->begin(); rpit != patterns->end(); ++rpit)
+  // select the U-V pairs worth fitting, RP by RP
+  std::vector<RPFitTask> tasks;
+  for (edm::DetSetVector<TotemRPUVPattern>::const_iterator rpit = patterns->begin(); rpit != patterns->end(); ++rpit)
+  {
+    RPFitTask task;
+    task.rp = rpit->detId();
+    task.patterns = &(*rpit);
+    unsigned int all_pairs = pair_selector_.Select(*rpit, *Totem_RP_geometry, task.pairs);
+
+    if(verbosity_)
+    {
+      std::cout << "RP " << task.rp << ": " << task.pairs.size() << " of " << all_pairs << " U-V pairs selected" << std::endl;
+    }
+
+    if(!task.pairs.empty())
+      tasks.push_back(task);
+  }
+
+  RunFitTasks(tasks, *Totem_RP_geometry);
+
+  for(unsigned int ti = 0; ti < tasks.size(); ti++)
   {
-    unsigned int rp = rpit->first;
+    for(unsigned int pi = 0; pi < tasks[ti].tracks.size(); pi++)
+    {
+      if(tasks[ti].tracks[pi].isValid())
+      {
+        fitTrackColl[tasks[ti].rp].push_back(tasks[ti].tracks[pi]);
+      }
+    }
+  }
+}
+
+
+void RPMulTrackCandidateCollectionFitter::FitPairs(RPFitTask &task, TotemRPLocalTrackFitterAlgorithm &fitter,
+    const TotemRPGeometry &geometry)
+{
+  double z0 = geometry.GetRPGlobalTranslation(task.rp).z();
 
-    int i = 0;
-    int j = 0; 
-    for (std::vector<RPRecognizedPatterns::Line>::const_iterator ulit = rpit->second.uLines.begin(); ulit != rpit->second.uLines.end(); ++ulit)
+  task.tracks.resize(task.pairs.size());
+  for(unsigned int pi = 0; pi < task.pairs.size(); pi++)
+  {
+    // combine U and V hits
+    edm::DetSetVector<TotemRPRecHit> hits;
+    const TotemRPUVPattern *uv[2] = { &(*task.patterns)[task.pairs[pi].u], &(*task.patterns)[task.pairs[pi].v] };
+    for(unsigned int k = 0; k < 2; k++)
     {
-      for (std::vector<RPRecognizedPatterns::Line>::const_iterator vlit = rpit->second.vLines.begin(); vlit != rpit->second.vLines.end(); ++vlit)
+      for(edm::DetSetVector<TotemRPRecHit>::const_iterator ids = uv[k]->getHits().begin(); ids != uv[k]->getHits().end(); ++ids)
       {
-        std::vector<TotemRPRecHit> u_roads, v_roads;
-                
-        double mean_u = calculateMeanValue(ulit->hits, u_roads);
-        double mean_v = calculateMeanValue(vlit->hits, v_roads);
-        
-        if(!det_topology_.IsHit(mean_u, mean_v))
-        {
-          if(verbosity_)
-          {
-            std::cout << "ignore on candidate track" << std::endl;
-          }
-          continue;
-        }
-        // calculate the reliability of a certain U&V candidate track
-        // double weight = CalcCandidateTrackWeight(mean_u, mean_v, uhits, vhits);
-        double weight = u_roads.size() + v_roads.size();
-        
-        RPTrackCandidate tr_cand;
-        tr_cand.InsertHits(u_roads, 0);
-        tr_cand.InsertHits(v_roads, 0);
-        tr_cand.Weight(weight);
-        tr_cand.SetUVid(i,j);
-        //TODO: build the candidate track if the weight satisfies a certain condition
-        
-        //fit the track
-        // TODO: uncomment
-        /*
-        RPFittedTrack fitted_track;
-        CLHEP::Hep3Vector rp_glob_trans = (*Totem_RP_geometry).GetRPGlobalTranslation(rp);
-        
-        the_track_candidate_fitter_.FitTrack(tr_cand, rp_glob_trans.z(), fitted_track, *Totem_RP_geometry);
-
-        if(fitted_track.IsValid())
-        {
-          fitTrackColl[rp].push_back(fitted_track);
-        }
-        */
-        j++;
+        edm::DetSet<TotemRPRecHit> &ods = hits.find_or_insert(ids->detId());
+        for(edm::DetSet<TotemRPRecHit>::const_iterator h = ids->begin(); h != ids->end(); ++h)
+          ods.push_back(*h);
       }
-      i++;
     }
+
+    fitter.fitTrack(hits, z0, geometry, task.tracks[pi]);
+  }
+}
+
+
+void RPMulTrackCandidateCollectionFitter::FitWorker(std::vector<RPFitTask> &tasks, unsigned int worker,
+    unsigned int workers, const TotemRPGeometry &geometry)
+{
+  for(unsigned int ti = worker; ti < tasks.size(); ti += workers)
+    FitPairs(tasks[ti], fitters_[worker], geometry);
+}
+
+
+void RPMulTrackCandidateCollectionFitter::RunFitTasks(std::vector<RPFitTask> &tasks, const TotemRPGeometry &geometry)
+{
+  // each task is written by one worker only, the output order does not depend on the scheduling
+  unsigned int workers = std::min<unsigned int>(fit_threads_, tasks.size());
+
+  if(workers > 1)
+  {
+    // the workers run as tasks in the TBB pool of the framework, no threads are started by the module
+    tbb::task_group group;
+    for(unsigned int w = 1; w < workers; w++)
+      group.run([this, &tasks, &geometry, w, workers]() { FitWorker(tasks, w, workers, geometry); });
+
+    FitWorker(tasks, 0, workers, geometry);
+
+    group.wait();
+  }
+  else
+  {
+    FitWorker(tasks, 0, 1, geometry);
   }
-#endif
 }
 
 
 void RPMulTrackCandidateCollectionFitter::produce(edm::Event& e, const edm::EventSetup& c)
 {
-  /*
   if (geometryWatcher.check(c))
-    the_track_candidate_fitter_.Reset();
-  */
+  {
+    //the_track_candidate_fitter_.Reset();
+    pair_selector_.Reset();
+    for(unsigned int i = 0; i < fitters_.size(); i++)
+      fitters_[i].reset();
+  }
 
   RPMulFittedTrackCollection mfitted_tracks_collection;
   
@@ -0,0 +1,214 @@
+/****************************************************************************
+ *
+ * U-V pattern pair selection for RPMulTrackCandidateCollectionFitter.
+ *
+ ****************************************************************************/
+
+#include "RecoTotemRP/RPMulTrackCandidateCollectionFitter/interface/RPUVPairSelector.h"
+#include "Geometry/VeryForwardRPTopology/interface/RPTopology.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+RPUVPairSelector::RPUVPairSelector(const edm::ParameterSet& conf)
+{
+  max_chi2_per_ndf_ = conf.exists("MaxPairChiSqPerNdf") ? conf.getParameter<double>("MaxPairChiSqPerNdf") : 0.;
+  max_pairs_per_rp_ = conf.exists("MaxPairsPerRP") ? conf.getParameter<unsigned int>("MaxPairsPerRP") : 0;
+  prune_dominated_ = conf.exists("PruneDominatedPairs") ? conf.getParameter<bool>("PruneDominatedPairs") : true;
+}
+
+
+void RPUVPairSelector::Reset()
+{
+  det_data_map_.clear();
+}
+
+
+bool RPUVPairSelector::Candidate::operator< (const Candidate &other) const
+{
+  if(score != other.score)
+    return score < other.score;
+  if(pair.u != other.pair.u)
+    return pair.u < other.pair.u;
+  return pair.v < other.pair.v;
+}
+
+
+const RPUVPairSelector::DetData& RPUVPairSelector::GetDetData(unsigned int det_id, const TotemRPGeometry &geometry)
+{
+  std::unordered_map<unsigned int, DetData>::const_iterator it = det_data_map_.find(det_id);
+  if(it != det_data_map_.end())
+  {
+    return it->second;
+  }
+
+  RPTopology topology;
+  HepMC::ThreeVector readout = topology.GetStripReadoutAxisDir();
+  CLHEP::Hep3Vector readout_global = geometry.LocalToGlobalDirection(det_id,
+      CLHEP::Hep3Vector(readout.x(), readout.y(), readout.z()));
+  CLHEP::Hep3Vector centre = geometry.GetDetTranslation(det_id);
+
+  double norm = std::sqrt(readout_global.x()*readout_global.x() + readout_global.y()*readout_global.y());
+  DetData data;
+  data.z = centre.z();
+  data.u_0 = - (readout_global.x()*centre.x() + readout_global.y()*centre.y()) / norm;
+
+  return det_data_map_[det_id] = data;
+}
+
+
+void RPUVPairSelector::PreparePattern(unsigned int index, const TotemRPUVPattern &pattern,
+    const TotemRPGeometry &geometry, PatternData &data)
+{
+  data.index = index;
+  data.hits = 0;
+  data.keys.clear();
+
+  // weighted sums of the readout positions m (global) vs. z
+  double s_w = 0., s_z = 0., s_m = 0., s_local = 0.;
+  for(edm::DetSetVector<TotemRPRecHit>::const_iterator ds = pattern.getHits().begin(); ds != pattern.getHits().end(); ++ds)
+  {
+    const DetData &det = GetDetData(ds->detId(), geometry);
+    for(edm::DetSet<TotemRPRecHit>::const_iterator h = ds->begin(); h != ds->end(); ++h)
+    {
+      double w = 1. / (h->getSigma() * h->getSigma());
+      s_w += w;
+      s_z += w * det.z;
+      s_m += w * (h->getPosition() - det.u_0);
+      s_local += h->getPosition();
+      data.hits++;
+      data.keys.push_back(std::make_pair((unsigned int) ds->detId(), h->getPosition()));
+    }
+  }
+
+  std::sort(data.keys.begin(), data.keys.end());
+  data.mean_local = (data.hits > 0) ? s_local / data.hits : 0.;
+
+  if(data.hits < 3)
+  {
+    data.chi2 = 0.;
+    return;
+  }
+
+  // chi^2 of the best line, in the centred form
+  double z_mean = s_z / s_w, m_mean = s_m / s_w;
+  double c_zz = 0., c_zm = 0., c_mm = 0.;
+  for(edm::DetSetVector<TotemRPRecHit>::const_iterator ds = pattern.getHits().begin(); ds != pattern.getHits().end(); ++ds)
+  {
+    const DetData &det = GetDetData(ds->detId(), geometry);
+    for(edm::DetSet<TotemRPRecHit>::const_iterator h = ds->begin(); h != ds->end(); ++h)
+    {
+      double w = 1. / (h->getSigma() * h->getSigma());
+      double dz = det.z - z_mean, dm = h->getPosition() - det.u_0 - m_mean;
+      c_zz += w * dz * dz;
+      c_zm += w * dz * dm;
+      c_mm += w * dm * dm;
+    }
+  }
+
+  data.chi2 = (c_zz > 0.) ? c_mm - c_zm * c_zm / c_zz : c_mm;
+  if(data.chi2 < 0.)
+    data.chi2 = 0.;
+}
+
+
+bool RPUVPairSelector::Contains(const Candidate &b, const Candidate &a) const
+{
+  const PatternData &a_u = u_patterns_[a.u_idx], &a_v = v_patterns_[a.v_idx];
+  const PatternData &b_u = u_patterns_[b.u_idx], &b_v = v_patterns_[b.v_idx];
+
+  if(a_u.hits > b_u.hits || a_v.hits > b_v.hits)
+    return false;
+
+  return (a.u_idx == b.u_idx || std::includes(b_u.keys.begin(), b_u.keys.end(), a_u.keys.begin(), a_u.keys.end()))
+    && (a.v_idx == b.v_idx || std::includes(b_v.keys.begin(), b_v.keys.end(), a_v.keys.begin(), a_v.keys.end()));
+}
+
+
+unsigned int RPUVPairSelector::Select(const edm::DetSet<TotemRPUVPattern> &patterns, const TotemRPGeometry &geometry,
+    std::vector<Pair> &pairs)
+{
+  pairs.clear();
+
+  // prepare the fittable patterns of both projections
+  unsigned int n_u = 0, n_v = 0;
+  for(unsigned int i = 0; i < patterns.size(); i++)
+  {
+    const TotemRPUVPattern &pattern = patterns[i];
+    if(!pattern.getFittable())
+      continue;
+
+    if(pattern.getProjection() == TotemRPUVPattern::projU)
+    {
+      if(u_patterns_.size() <= n_u)
+        u_patterns_.resize(n_u + 1);
+      PreparePattern(i, pattern, geometry, u_patterns_[n_u++]);
+    }
+    if(pattern.getProjection() == TotemRPUVPattern::projV)
+    {
+      if(v_patterns_.size() <= n_v)
+        v_patterns_.resize(n_v + 1);
+      PreparePattern(i, pattern, geometry, v_patterns_[n_v++]);
+    }
+  }
+
+  // score all pairs, drop the ones which cannot make a track
+  candidates_.clear();
+  for(unsigned int i = 0; i < n_u; i++)
+  {
+    for(unsigned int j = 0; j < n_v; j++)
+    {
+      const PatternData &u = u_patterns_[i], &v = v_patterns_[j];
+
+      // the fit needs at least 5 hits
+      if(u.hits + v.hits < 5)
+        continue;
+
+      // check if the virtual track built from the U/V patterns can exist in the sensitive area of a detector
+      if(!RPTopology::IsHit(u.mean_local, v.mean_local))
+        continue;
+
+      Candidate c;
+      c.pair.u = u.index;
+      c.pair.v = v.index;
+      c.pair.hits = u.hits + v.hits;
+      c.pair.chi2_bound = u.chi2 + v.chi2;
+      c.u_idx = i;
+      c.v_idx = j;
+      c.score = c.pair.Score();
+
+      // the full fit cannot have lower chi^2
+      if(max_chi2_per_ndf_ > 0. && c.score > max_chi2_per_ndf_)
+        continue;
+
+      candidates_.push_back(c);
+    }
+  }
+
+  std::sort(candidates_.begin(), candidates_.end());
+
+  // a candidate is dominated by an earlier (not worse) one containing all its hits, it is sufficient to
+  // check the selected ones, since containment is transitive
+  selected_.clear();
+  for(unsigned int ci = 0; ci < candidates_.size(); ci++)
+  {
+    if(max_pairs_per_rp_ > 0 && selected_.size() >= max_pairs_per_rp_)
+      break;
+
+    bool dominated = false;
+    if(prune_dominated_)
+    {
+      for(unsigned int si = 0; si < selected_.size() && !dominated; si++)
+        dominated = Contains(selected_[si], candidates_[ci]);
+    }
+
+    if(!dominated)
+      selected_.push_back(candidates_[ci]);
+  }
+
+  for(unsigned int si = 0; si < selected_.size(); si++)
+    pairs.push_back(selected_[si].pair);
+
+  return n_u * n_v;
+}
@@ -10,10 +10,10 @@ class RP2DHitDebug : public RP2DHit
   public:
     RP2DHitDebug() : RP2DHit() {}
     RP2DHitDebug(const RP2DHit & hit) : RP2DHit(hit) {}
-    inline double DeltaX() {return d_x_;}
-    inline double DeltaY() {return d_y_;}
-    inline double PullX() {return pull_x_;}
-    inline double PullY() {return pull_y_;}
+    inline double DeltaX() const {return d_x_;}
+    inline double DeltaY() const {return d_y_;}
+    inline double PullX() const {return pull_x_;}
+    inline double PullY() const {return pull_y_;}
     
     inline void DeltaX(double val) {d_x_ = val;}
     inline void DeltaY(double val) {d_y_ = val;}
@@ -0,0 +1,191 @@
+#ifndef RecoTotemRP_RPRecoDataFormats_RPCompactProtonCollection_h
+#define RecoTotemRP_RPRecoDataFormats_RPCompactProtonCollection_h
+
+#include "RecoTotemRP/RPRecoDataFormats/interface/RP2DHitDebug.h"
+#include "RecoTotemRP/RPRecoDataFormats/interface/RPReconstructedProton.h"
+#include "RecoTotemRP/RPRecoDataFormats/interface/RPReconstructedProtonCollection.h"
+#include "RecoTotemRP/RPRecoDataFormats/interface/RPReconstructedProtonPair.h"
+#include "RecoTotemRP/RPRecoDataFormats/interface/RPReconstructedProtonPairCollection.h"
+#include <vector>
+
+
+/**
+ *\brief Fitted hits of many protons, one column per quantity.
+ * The hits of one proton are contiguous, see RPCompactFitCollection::HitsBegin.
+**/
+class RPCompactHitTable
+{
+  public:
+    inline unsigned int size() const {return rp_id_.size();}
+    void clear();
+    void reserve(unsigned int n);
+
+    void Add(unsigned int rp_id, const RP2DHitDebug &hit);
+    RP2DHitDebug Hit(unsigned int i) const;
+
+    inline unsigned int RPId(unsigned int i) const {return rp_id_[i];}
+    inline double X(unsigned int i) const {return x_[i];}
+    inline double Y(unsigned int i) const {return y_[i];}
+    inline double Z(unsigned int i) const {return z_[i];}
+    inline double Vx(unsigned int i) const {return vx_[i];}
+    inline double Vy(unsigned int i) const {return vy_[i];}
+    inline double DeltaX(unsigned int i) const {return d_x_[i];}
+    inline double DeltaY(unsigned int i) const {return d_y_[i];}
+    inline double PullX(unsigned int i) const {return pull_x_[i];}
+    inline double PullY(unsigned int i) const {return pull_y_[i];}
+
+  private:
+    std::vector<unsigned int> rp_id_;
+    std::vector<double> x_, y_, z_;
+    std::vector<double> vx_, vy_;
+    std::vector<double> d_x_, d_y_;
+    std::vector<double> pull_x_, pull_y_;
+};
+
+
+/**
+ *\brief Structure-of-arrays storage of D-parameter fits (one row per fit).
+ * The parameters are stored as D consecutive values per row, the symmetric covariance
+ * matrix as its D(D+1)/2 upper-triangle values per row (row-major). The fitted hits of
+ * row i are the entries [HitsBegin(i), HitsEnd(i)) of the hit table.
+**/
+template <int D> class RPCompactFitCollection
+{
+  public:
+    enum { dimension = D };
+    enum { packed_cov_dimension = D*(D+1)/2 };
+    enum { flag_valid = 1 };  ///< the following D bits: parameter fitted
+
+    RPCompactFitCollection() : hits_begin_(1, 0) {}
+
+    inline unsigned int size() const {return flags_.size();}
+    inline bool empty() const {return flags_.empty();}
+
+    void clear()
+    {
+      flags_.clear(); chi2_.clear(); chi2_norm_.clear(); ndf_.clear();
+      parameters_.clear(); covariance_.clear();
+      hits_begin_.assign(1, 0);
+      hits_.clear();
+    }
+
+    void reserve(unsigned int n)
+    {
+      flags_.reserve(n); chi2_.reserve(n); chi2_norm_.reserve(n); ndf_.reserve(n);
+      parameters_.reserve(n*D); covariance_.reserve(n*packed_cov_dimension);
+      hits_begin_.reserve(n+1);
+    }
+
+    inline bool Valid(unsigned int i) const {return flags_[i] & flag_valid;}
+    inline bool Fitted(unsigned int i, int n) const {return flags_[i] & (flag_valid << (n+1));}
+    inline double Chi2(unsigned int i) const {return chi2_[i];}
+    inline double Chi2Norm(unsigned int i) const {return chi2_norm_[i];}
+    inline int DegreesOfFreedom(unsigned int i) const {return ndf_[i];}
+
+    inline double Parameter(unsigned int i, int n) const {return parameters_[i*D + n];}
+    inline const double* Parameters(unsigned int i) const {return &parameters_[i*D];}
+    inline double CovarianceMatrixElement(unsigned int i, int n, int m) const
+      {return covariance_[i*packed_cov_dimension + PackedIndex(n, m)];}
+
+    inline unsigned int HitsBegin(unsigned int i) const {return hits_begin_[i];}
+    inline unsigned int HitsEnd(unsigned int i) const {return hits_begin_[i+1];}
+    inline const RPCompactHitTable& Hits() const {return hits_;}
+
+    /// index of the element (n, m) in the packed upper triangle
+    static inline int PackedIndex(int n, int m)
+    {
+      if(n > m)
+      {
+        int t = n; n = m; m = t;
+      }
+      return n*D - n*(n-1)/2 + (m-n);
+    }
+
+  protected:
+    /// appends a row, the hits are to be added with AddHit afterwards
+    template <class T> void AddRow(const T &fit, unsigned short fitted_mask)
+    {
+      flags_.push_back((fit.Valid() ? flag_valid : 0) | (fitted_mask << 1));
+      chi2_.push_back(fit.Chi2());
+      chi2_norm_.push_back(fit.Chi2Norm());
+      ndf_.push_back(fit.DegreesOfFreedom());
+      for(int n=0; n<D; ++n)
+        parameters_.push_back(fit.Parameter(n));
+      for(int n=0; n<D; ++n)
+        for(int m=n; m<D; ++m)
+          covariance_.push_back(fit.CovarianceMartixElement(n, m));
+      hits_begin_.push_back(hits_.size());
+    }
+
+    void AddHit(unsigned int rp_id, const RP2DHitDebug &hit)
+    {
+      hits_.Add(rp_id, hit);
+      hits_begin_.back() = hits_.size();
+    }
+
+    /// fills the common columns of row i into a fit object
+    template <class T> void FillRow(unsigned int i, T &fit) const
+    {
+      fit.Valid(Valid(i));
+      fit.Chi2(chi2_[i]);
+      fit.Chi2Norm(chi2_norm_[i]);
+      fit.DegreesOfFreedom(ndf_[i]);
+      for(int n=0; n<D; ++n)
+      {
+        fit.Parameter(n, Parameter(i, n));
+        for(int m=0; m<D; ++m)
+          fit.CovarianceMartixElement(n, m, CovarianceMatrixElement(i, n, m));
+      }
+      for(unsigned int h=HitsBegin(i); h<HitsEnd(i); ++h)
+        fit.AddDebugHit(hits_.RPId(h), hits_.Hit(h));
+    }
+
+  private:
+    std::vector<unsigned short> flags_;
+    std::vector<double> chi2_, chi2_norm_;
+    std::vector<int> ndf_;
+    std::vector<double> parameters_;
+    std::vector<double> covariance_;
+    std::vector<unsigned int> hits_begin_;  ///< size() + 1 entries
+    RPCompactHitTable hits_;
+};
+
+
+/**
+ *\brief Columnar version of RPReconstructedProtonCollection.
+**/
+class RPCompactProtonCollection : public RPCompactFitCollection<RPReconstructedProton::dimension>
+{
+  public:
+    RPCompactProtonCollection() {}
+    explicit RPCompactProtonCollection(const RPReconstructedProtonCollection &coll);
+
+    void clear();
+    void reserve(unsigned int n);
+
+    /// converters from and to the object format
+    void Add(const RPReconstructedProton &prot);
+    RPReconstructedProton Get(unsigned int i) const;
+
+    inline double ZDirection(unsigned int i) const {return z_direction_[i];}
+
+  private:
+    std::vector<double> z_direction_;
+};
+
+
+/**
+ *\brief Columnar version of RPReconstructedProtonPairCollection.
+**/
+class RPCompactProtonPairCollection : public RPCompactFitCollection<RPReconstructedProtonPair::dimension>
+{
+  public:
+    RPCompactProtonPairCollection() {}
+    explicit RPCompactProtonPairCollection(const RPReconstructedProtonPairCollection &coll);
+
+    /// converters from and to the object format
+    void Add(const RPReconstructedProtonPair &pair);
+    RPReconstructedProtonPair Get(unsigned int i) const;
+};
+
+#endif
@@ -0,0 +1,123 @@
+#include "RecoTotemRP/RPRecoDataFormats/interface/RPCompactProtonCollection.h"
+
+
+void RPCompactHitTable::clear()
+{
+  rp_id_.clear();
+  x_.clear(); y_.clear(); z_.clear();
+  vx_.clear(); vy_.clear();
+  d_x_.clear(); d_y_.clear();
+  pull_x_.clear(); pull_y_.clear();
+}
+
+
+void RPCompactHitTable::reserve(unsigned int n)
+{
+  rp_id_.reserve(n);
+  x_.reserve(n); y_.reserve(n); z_.reserve(n);
+  vx_.reserve(n); vy_.reserve(n);
+  d_x_.reserve(n); d_y_.reserve(n);
+  pull_x_.reserve(n); pull_y_.reserve(n);
+}
+
+
+void RPCompactHitTable::Add(unsigned int rp_id, const RP2DHitDebug &hit)
+{
+  rp_id_.push_back(rp_id);
+  x_.push_back(hit.X());
+  y_.push_back(hit.Y());
+  z_.push_back(hit.Z());
+  vx_.push_back(hit.Vx());
+  vy_.push_back(hit.Vy());
+  d_x_.push_back(hit.DeltaX());
+  d_y_.push_back(hit.DeltaY());
+  pull_x_.push_back(hit.PullX());
+  pull_y_.push_back(hit.PullY());
+}
+
+
+RP2DHitDebug RPCompactHitTable::Hit(unsigned int i) const
+{
+  RP2DHitDebug hit(RP2DHit(x_[i], y_[i], vx_[i], vy_[i], z_[i]));
+  hit.DeltaX(d_x_[i]);
+  hit.DeltaY(d_y_[i]);
+  hit.PullX(pull_x_[i]);
+  hit.PullY(pull_y_[i]);
+  return hit;
+}
+
+
+RPCompactProtonCollection::RPCompactProtonCollection(const RPReconstructedProtonCollection &coll)
+{
+  reserve(coll.size());
+  for(RPReconstructedProtonCollection::const_iterator it = coll.begin(); it != coll.end(); ++it)
+    Add(*it);
+}
+
+
+void RPCompactProtonCollection::clear()
+{
+  RPCompactFitCollection<RPReconstructedProton::dimension>::clear();
+  z_direction_.clear();
+}
+
+
+void RPCompactProtonCollection::reserve(unsigned int n)
+{
+  RPCompactFitCollection<RPReconstructedProton::dimension>::reserve(n);
+  z_direction_.reserve(n);
+}
+
+
+void RPCompactProtonCollection::Add(const RPReconstructedProton &prot)
+{
+  unsigned short fitted_mask = 0;
+  for(int n=0; n<dimension; ++n)
+    if(prot.Fitted(n))
+      fitted_mask |= (1 << n);
+
+  AddRow(prot, fitted_mask);
+  z_direction_.push_back(prot.ZDirection());
+
+  const RPReconstructedProton::debug_hits_map_type &hits = prot.DebugHits();
+  for(RPReconstructedProton::debug_hits_map_type::const_iterator it = hits.begin(); it != hits.end(); ++it)
+    AddHit(it->first, it->second);
+}
+
+
+RPReconstructedProton RPCompactProtonCollection::Get(unsigned int i) const
+{
+  RPReconstructedProton prot;
+  FillRow(i, prot);
+  prot.ZDirection(z_direction_[i]);
+  for(int n=0; n<dimension; ++n)
+    prot.Fitted(n, Fitted(i, n));
+  return prot;
+}
+
+
+RPCompactProtonPairCollection::RPCompactProtonPairCollection(const RPReconstructedProtonPairCollection &coll)
+{
+  reserve(coll.size());
+  for(RPReconstructedProtonPairCollection::const_iterator it = coll.begin(); it != coll.end(); ++it)
+    Add(*it);
+}
+
+
+void RPCompactProtonPairCollection::Add(const RPReconstructedProtonPair &pair)
+{
+  // all parameters of the pair fit are free
+  AddRow(pair, (1 << dimension) - 1);
+
+  const RPReconstructedProtonPair::debug_hits_map_type &hits = pair.DebugHits();
+  for(RPReconstructedProtonPair::debug_hits_map_type::const_iterator it = hits.begin(); it != hits.end(); ++it)
+    AddHit(it->first, it->second);
+}
+
+
+RPReconstructedProtonPair RPCompactProtonPairCollection::Get(unsigned int i) const
+{
+  RPReconstructedProtonPair pair;
+  FillRow(i, pair);
+  return pair;
+}
@@ -13,6 +13,7 @@
 #include "RecoTotemRP/RPRecoDataFormats/interface/RP2DHitDebug.h"
 #include "RecoTotemRP/RPRecoDataFormats/interface/RPReconstructedProtonPair.h"
 #include "RecoTotemRP/RPRecoDataFormats/interface/RPReconstructedProtonPairCollection.h"
+#include "RecoTotemRP/RPRecoDataFormats/interface/RPCompactProtonCollection.h"
 
 #include <vector>
 #include "RecoTotemRP/RPRecoDataFormats/interface/CentralMassInfo.h"
@@ -67,6 +68,14 @@ namespace {
     RPReconstructedProtonPairCollection pc;
     edm::Wrapper<RPReconstructedProtonPairCollection> wpc;
 
+    RPCompactHitTable rpcht;
+    RPCompactFitCollection<RPReconstructedProton::dimension> rpcfc5;
+    RPCompactFitCollection<RPReconstructedProtonPair::dimension> rpcfc9;
+    RPCompactProtonCollection rpcpc;
+    edm::Wrapper<RPCompactProtonCollection> wrpcpc;
+    RPCompactProtonPairCollection rpcppc;
+    edm::Wrapper<RPCompactProtonPairCollection> wrpcppc;
+
 	RPStationTrackFit rpstf;
 	std::vector<RPStationTrackFit> vrpstf;
 	std::map<unsigned int, std::vector<RPStationTrackFit> > m_ui_vrpstf;
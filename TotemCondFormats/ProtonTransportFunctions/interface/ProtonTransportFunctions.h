@@ -12,8 +12,12 @@
 
 #include <vector>
 #include <map>
+#include <string>
+#include <memory>
+#include <mutex>
 
 class LHCOpticsApproximator;
+class LHCOpticsCompactFile;
 class TFile;
 
 /**
@@ -33,7 +37,24 @@ class ProtonTransportFunctions
     /// map RPId -> transport functions
     MapType functionMap;
 
+    /// functions loaded on first access from a compact optics file, shared (read-only) by all copies
+    struct LazyFunctions
+    {
+      std::shared_ptr<LHCOpticsCompactFile> source;
+      std::map<unsigned int, std::string> names;              ///< RPId -> function name, not loaded yet
+      std::map<std::string, LHCOpticsApproximator *> ideal;   ///< name -> loaded ideal function
+      MapType functionMap;                                    ///< RPId -> loaded functions
+      std::mutex mutex;
+
+      ~LazyFunctions();
+      const FunctionPair* Load(unsigned int RPId);
+    };
+
+    std::shared_ptr<LazyFunctions> lazyFunctions;
+
     void InitFunction(unsigned int RPId, LHCOpticsApproximator *);
+    void InitLazyFunction(unsigned int RPId, const std::string &name);
+    void SetLazySource(const std::shared_ptr<LHCOpticsCompactFile> &source);
 
     friend class ProtonTransportFunctionsESSource;
 
@@ -45,7 +66,8 @@ class ProtonTransportFunctions
     /// throws an exception if doesn't exist
     LHCOpticsApproximator* GetFunction(unsigned int RPId) const;
 
-    const MapType& GetFunctionMap() const { return functionMap; }
+    /// loads all lazy functions, if any
+    const MapType& GetFunctionMap() const;
 };
 
 #endif
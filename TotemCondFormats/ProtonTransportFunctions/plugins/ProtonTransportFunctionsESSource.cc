@@ -21,6 +21,7 @@
 #include "TotemCondFormats/BeamOpticsParamsObjects/interface/BeamOpticsParams.h"
 #include "TotemCondFormats/ProtonTransportFunctions/interface/ProtonTransportFunctions.h"
 #include "TotemProtonTransport/TotemRPProtonTransportParametrization/interface/LHCOpticsApproximator.h"
+#include "TotemProtonTransport/TotemRPProtonTransportParametrization/interface/LHCOpticsCompactFile.h"
 #include "Geometry/Records/interface/VeryForwardRealGeometryRecord.h"
 #include "Geometry/VeryForwardGeometryBuilder/interface/TotemRPGeometry.h"
 
@@ -48,6 +49,15 @@ class ProtonTransportFunctionsESSource : public edm::ESProducer
     bool idealFunctionsLoaded;
 
     void LoadIdealFunctions(const ProtonTransportRcd &ptRcd);
+
+    /// sets up lazy loading from a compact optics file, returns false if opticsFile is not in the compact format
+    bool IndexCompactFunctions();
+
+    /// decodes function name `ip5_to_station_...', returns false if not an RP transport function
+    static bool ParseFunctionName(const std::string &full, unsigned int &arm, unsigned int &st, unsigned int &pos, unsigned int &unit);
+
+    /// list of RPs served by the given function
+    static std::vector<unsigned int> GetFunctionRPs(unsigned int arm, unsigned int st, unsigned int pos, unsigned int unit);
 };
 
 //----------------------------------------------------------------------------------------------------
@@ -97,6 +107,12 @@ void ProtonTransportFunctionsESSource::LoadIdealFunctions(const ProtonTransportR
     opticsFile = std::string(cmsswPath) + "/src/" + opticsFile;
   }
 
+  // compact optics format: only index it, functions are loaded on first access
+  if (IndexCompactFunctions()) {
+    idealFunctionsLoaded = true;
+    return;
+  }
+
   // open file
   ofFile = new TFile(opticsFile.c_str());
   if (ofFile->IsZombie())
@@ -115,43 +131,17 @@ void ProtonTransportFunctionsESSource::LoadIdealFunctions(const ProtonTransportR
 
     // process name
     string full(key->GetName());
-    string begin(full, 0, 15);
-
-    if (begin.compare("ip5_to_station_")) continue;
-
-    string sSt(full, 15, 3);
-    unsigned int st = 0;
-    if (!sSt.compare("150")) st = 0;
-      else if (!sSt.compare("220")) st = 2;
-        else continue;
-
-    string sPos(full, 19, 1);
-    unsigned int pos = 0;
-    if (!sPos.compare("v")) pos = 0;
-      else if (!sPos.compare("h")) pos = 1;
-        else continue;
-
-    unsigned int unit = atoi(full.substr(21, 1).c_str());
-    if (unit != 1 && unit != 2) continue;
-
-    unsigned int arm = 2 - atoi(full.substr(27, 1).c_str());  // to standard
-    if (arm != 0 && arm != 1) continue;
-
-    //printf("> st %i, pos %i, unit %i, arm %i\n", st, pos, unit, arm);
+    unsigned int arm, st, pos, unit;
+    if (!ParseFunctionName(full, arm, st, pos, unit)) continue;
 
     // name OK, add the object
     LHCOpticsApproximator *optFun = (LHCOpticsApproximator *) key->ReadObj();
     fCount++;
 
     // update map RP->function
-    unsigned int RPId = 100 * arm + 10 * st;
-    //printf("> %i\n", RPId);
-    if (unit == 1 && pos == 0) data.InitFunction(RPId + 0, optFun);
-    if (unit == 1 && pos == 0) data.InitFunction(RPId + 1, optFun);
-    if (unit == 1 && pos == 1) data.InitFunction(RPId + 2, optFun);
-    if (unit == 2 && pos == 1) data.InitFunction(RPId + 3, optFun);
-    if (unit == 2 && pos == 0) data.InitFunction(RPId + 4, optFun);
-    if (unit == 2 && pos == 0) data.InitFunction(RPId + 5, optFun);
+    vector<unsigned int> rps = GetFunctionRPs(arm, st, pos, unit);
+    for (unsigned int i = 0; i < rps.size(); i++)
+      data.InitFunction(rps[i], optFun);
 
     // add symmetric links to the RP->functions map, if permitted
     if (!maySymmetrize)
@@ -164,13 +154,9 @@ void ProtonTransportFunctionsESSource::LoadIdealFunctions(const ProtonTransportR
     if (ofFile->Get(reflected.c_str()))
       continue;
     arm = 1 - arm;
-	RPId = 100 * arm + 10 * st;
-    if (unit == 1 && pos == 0) data.InitFunction(RPId + 0, optFun);
-    if (unit == 1 && pos == 0) data.InitFunction(RPId + 1, optFun);
-    if (unit == 1 && pos == 1) data.InitFunction(RPId + 2, optFun);
-    if (unit == 2 && pos == 1) data.InitFunction(RPId + 3, optFun);
-    if (unit == 2 && pos == 0) data.InitFunction(RPId + 4, optFun);
-    if (unit == 2 && pos == 0) data.InitFunction(RPId + 5, optFun);
+    rps = GetFunctionRPs(arm, st, pos, unit);
+    for (unsigned int i = 0; i < rps.size(); i++)
+      data.InitFunction(rps[i], optFun);
   }
 
 
@@ -190,6 +176,100 @@ void ProtonTransportFunctionsESSource::LoadIdealFunctions(const ProtonTransportR
 
 //----------------------------------------------------------------------------------------------------
 
+bool ProtonTransportFunctionsESSource::ParseFunctionName(const string &full, unsigned int &arm, unsigned int &st,
+  unsigned int &pos, unsigned int &unit)
+{
+  if (full.size() < 28) return false;
+
+  string begin(full, 0, 15);
+  if (begin.compare("ip5_to_station_")) return false;
+
+  string sSt(full, 15, 3);
+  if (!sSt.compare("150")) st = 0;
+    else if (!sSt.compare("220")) st = 2;
+      else return false;
+
+  string sPos(full, 19, 1);
+  if (!sPos.compare("v")) pos = 0;
+    else if (!sPos.compare("h")) pos = 1;
+      else return false;
+
+  unit = atoi(full.substr(21, 1).c_str());
+  if (unit != 1 && unit != 2) return false;
+
+  arm = 2 - atoi(full.substr(27, 1).c_str());  // to standard
+  if (arm != 0 && arm != 1) return false;
+
+  //printf("> st %i, pos %i, unit %i, arm %i\n", st, pos, unit, arm);
+  return true;
+}
+
+//----------------------------------------------------------------------------------------------------
+
+vector<unsigned int> ProtonTransportFunctionsESSource::GetFunctionRPs(unsigned int arm, unsigned int st, unsigned int pos,
+  unsigned int unit)
+{
+  vector<unsigned int> rps;
+  unsigned int RPId = 100 * arm + 10 * st;
+  if (unit == 1 && pos == 0) rps.push_back(RPId + 0);
+  if (unit == 1 && pos == 0) rps.push_back(RPId + 1);
+  if (unit == 1 && pos == 1) rps.push_back(RPId + 2);
+  if (unit == 2 && pos == 1) rps.push_back(RPId + 3);
+  if (unit == 2 && pos == 0) rps.push_back(RPId + 4);
+  if (unit == 2 && pos == 0) rps.push_back(RPId + 5);
+  return rps;
+}
+
+//----------------------------------------------------------------------------------------------------
+
+bool ProtonTransportFunctionsESSource::IndexCompactFunctions()
+{
+  std::shared_ptr<LHCOpticsCompactFile> compact(new LHCOpticsCompactFile);
+  if (!compact->Open(opticsFile))
+    return false;
+
+  data.SetLazySource(compact);
+
+  unsigned int fCount = 0;
+  const vector<string> &names = compact->GetNames();
+  for (unsigned int k = 0; k < names.size(); k++) {
+    const string &full = names[k];
+    unsigned int arm, st, pos, unit;
+    if (!ParseFunctionName(full, arm, st, pos, unit)) continue;
+    fCount++;
+
+    vector<unsigned int> rps = GetFunctionRPs(arm, st, pos, unit);
+    for (unsigned int i = 0; i < rps.size(); i++)
+      data.InitLazyFunction(rps[i], full);
+
+    // add symmetric links to the RP->functions map, if permitted
+    if (!maySymmetrize)
+      continue;
+    string reflected(full);
+    reflected.replace(27, 1, (arm == 0) ? "1" : "2");
+    if (compact->Contains(reflected))
+      continue;
+    rps = GetFunctionRPs(1 - arm, st, pos, unit);
+    for (unsigned int i = 0; i < rps.size(); i++)
+      data.InitLazyFunction(rps[i], full);
+  }
+
+  if (verbosity)
+    printf(">> ProtonTransportFunctionsESSource::IndexCompactFunctions : %u optical functions indexed, mapped to %lu RPs\n",
+        fCount, data.lazyFunctions->names.size());
+
+  if (verbosity > 4) {
+    printf(">> ProtonTransportFunctionsESSource::IndexCompactFunctions : map RPId --> optical function\n");
+    for (map<unsigned int, string>::const_iterator it = data.lazyFunctions->names.begin(); it != data.lazyFunctions->names.end(); ++it) {
+      printf("\t%3u --> %s\n", it->first, it->second.c_str());
+    }
+  }
+
+  return true;
+}
+
+//----------------------------------------------------------------------------------------------------
+
 std::unique_ptr<ProtonTransportFunctions> ProtonTransportFunctionsESSource::produce(const ProtonTransportRcd &ptRcd)
 {
 #if DEBUG > 1
@@ -11,6 +11,7 @@
 #include "TotemCondFormats/BeamOpticsParamsObjects/interface/BeamOpticsParams.h"
 #include "FWCore/Utilities/interface/typelookup.h"
 #include "TotemProtonTransport/TotemRPProtonTransportParametrization/interface/LHCOpticsApproximator.h"
+#include "TotemProtonTransport/TotemRPProtonTransportParametrization/interface/LHCOpticsCompactFile.h"
 #include "FWCore/Utilities/interface/Exception.h"
 
 #include "TFile.h"
@@ -54,13 +55,92 @@ void ProtonTransportFunctions::InitFunction(unsigned int RPId, LHCOpticsApproxim
 
 //----------------------------------------------------------------------------------------------------
 
+void ProtonTransportFunctions::SetLazySource(const std::shared_ptr<LHCOpticsCompactFile> &source)
+{
+  lazyFunctions.reset(new LazyFunctions);
+  lazyFunctions->source = source;
+}
+
+//----------------------------------------------------------------------------------------------------
+
+void ProtonTransportFunctions::InitLazyFunction(unsigned int RPId, const std::string &name)
+{
+  lazyFunctions->names[RPId] = name;
+}
+
+//----------------------------------------------------------------------------------------------------
+
+ProtonTransportFunctions::LazyFunctions::~LazyFunctions()
+{
+  for (MapType::iterator it = functionMap.begin(); it != functionMap.end(); ++it)
+    delete it->second.real;
+
+  for (map<string, LHCOpticsApproximator *>::iterator it = ideal.begin(); it != ideal.end(); ++it)
+    delete it->second;
+}
+
+//----------------------------------------------------------------------------------------------------
+
+const ProtonTransportFunctions::FunctionPair* ProtonTransportFunctions::LazyFunctions::Load(unsigned int RPId)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+
+  MapType::const_iterator fit = functionMap.find(RPId);
+  if (fit != functionMap.end())
+    return &fit->second;
+
+  map<unsigned int, string>::const_iterator nit = names.find(RPId);
+  if (nit == names.end())
+    return NULL;
+
+  LHCOpticsApproximator *&of = ideal[nit->second];
+  if (!of)
+    of = source->Load(nit->second);
+  if (!of)
+    throw cms::Exception("ProtonTransportFunctions::GetFunction") << "Optical function `" << nit->second << "' cannot be loaded." << endl;
+
+  FunctionPair &fp = functionMap[RPId];
+  fp.ideal = of;
+  fp.real = new LHCOpticsApproximator(*of);
+  return &fp;
+}
+
+//----------------------------------------------------------------------------------------------------
+
 LHCOpticsApproximator* ProtonTransportFunctions::GetFunction(unsigned int RPId) const
 {
   map<unsigned int, FunctionPair>::const_iterator it = functionMap.find(RPId);
   if (it != functionMap.end()) return it->second.real;
 
+  if (lazyFunctions) {
+    const FunctionPair *fp = lazyFunctions->Load(RPId);
+    if (fp) return fp->real;
+  }
+
   throw cms::Exception("ProtonTransportFunctions::GetFunction") << "RP Id " << RPId << " has not been found." << endl;
 }
 
 
+//----------------------------------------------------------------------------------------------------
+
+const ProtonTransportFunctions::MapType& ProtonTransportFunctions::GetFunctionMap() const
+{
+  if (!lazyFunctions)
+    return functionMap;
+
+  vector<unsigned int> ids;
+  {
+    std::lock_guard<std::mutex> lock(lazyFunctions->mutex);
+    for (map<unsigned int, string>::const_iterator it = lazyFunctions->names.begin(); it != lazyFunctions->names.end(); ++it)
+      ids.push_back(it->first);
+  }
+
+  for (unsigned int i = 0; i < ids.size(); i++)
+    lazyFunctions->Load(ids[i]);
+
+  return lazyFunctions->functionMap;
+}
+
+//----------------------------------------------------------------------------------------------------
+
 TYPELOOKUP_DATA_REG(ProtonTransportFunctions);
@@ -0,0 +1,45 @@
+#include "TotemProtonTransport/TotemRPProtonTransportParametrization/interface/LHCOpticsApproximator.h"
+#include "TotemProtonTransport/TotemRPProtonTransportParametrization/interface/LHCOpticsCompactFile.h"
+#include "TFile.h"
+#include "TKey.h"
+#include <iostream>
+#include <cstring>
+#include <vector>
+
+//converts all optics approximators of a ROOT file into the compact optics format
+int main(int argc, char *args[])
+{
+  if(argc!=3)
+  {
+    std::cout<<"Usage: "<<args[0]<<" <input ROOT file> <output compact file>"<<std::endl;
+    return 1;
+  }
+
+  TFile *f = TFile::Open(args[1]);
+  if(!f || f->IsZombie())
+  {
+    std::cout<<"File "<<args[1]<<" cannot be opened."<<std::endl;
+    return 1;
+  }
+
+  std::vector<const LHCOpticsApproximator *> approximators;
+  TIter next(f->GetListOfKeys());
+  TKey *key;
+  while((key = (TKey *)next()))
+  {
+    if(strcmp(key->GetClassName(), "LHCOpticsApproximator"))
+      continue;
+    approximators.push_back((LHCOpticsApproximator *) key->ReadObj());
+    std::cout<<approximators.back()->GetName()<<std::endl;
+  }
+
+  if(!LHCOpticsCompactFile::Write(args[2], approximators))
+  {
+    std::cout<<"File "<<args[2]<<" cannot be written."<<std::endl;
+    return 1;
+  }
+
+  std::cout<<approximators.size()<<" approximators written to "<<args[2]<<std::endl;
+  f->Close();
+  return 0;
+}
@@ -0,0 +1,38 @@
+#include "TotemProtonTransport/TotemRPProtonTransportParametrization/interface/FitData.h"
+#include "TotemProtonTransport/TotemRPProtonTransportParametrization/interface/TransportSampleFile.h"
+#include <iostream>
+#include <vector>
+#include <string>
+
+//converts MAD-X TFS input/tracking files to the binary sample format (appends if the output exists)
+int main(int argc, char *args[])
+{
+  if(argc<6)
+  {
+    std::cout<<"Usage: "<<args[0]<<" <particles in> <track file> <station> <branch prefix> <output file> [scoring planes...]"<<std::endl;
+    return 1;
+  }
+
+  std::vector<std::string> scoring_planes;
+  for(int i=6; i<argc; i++)
+    scoring_planes.push_back(args[i]);
+
+  FitData converter;
+  converter.readIn(args[1]);
+  converter.readOut(args[2], args[3]);
+  converter.readAdditionalScoringPlanes(args[2], scoring_planes);
+
+  std::vector<std::string> planes;
+  planes.push_back(args[4]);
+  planes.insert(planes.end(), scoring_planes.begin(), scoring_planes.end());
+
+  TransportSampleWriter writer;
+  if(!writer.Open(args[5], planes))
+    return 1;
+
+  int rows = converter.AppendBinarySampleFile(writer);
+  writer.Close();
+
+  std::cout<<rows<<" samples written to "<<args[5]<<std::endl;
+  return 0;
+}
@@ -0,0 +1,47 @@
+#include "TotemProtonTransport/TotemRPProtonTransportParametrization/interface/LHCOpticsApproximator.h"
+#include "TotemProtonTransport/TotemRPProtonTransportParametrization/interface/LHCOpticsGrid.h"
+#include "TFile.h"
+#include "TKey.h"
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+
+//tabulates all optics approximators of a ROOT file and reports the accuracy of the lookup grids
+int main(int argc, char *args[])
+{
+  if(argc!=3 && argc!=4)
+  {
+    std::cout<<"Usage: "<<args[0]<<" <input ROOT file> <nodes per variable> [linear|cubic]"<<std::endl;
+    return 1;
+  }
+
+  TFile *f = TFile::Open(args[1]);
+  if(!f || f->IsZombie())
+  {
+    std::cout<<"File "<<args[1]<<" cannot be opened."<<std::endl;
+    return 1;
+  }
+
+  unsigned int n = atoi(args[2]);
+  unsigned int nodes[5] = {n, n, n, n, n};
+  LHCOpticsGrid::interpolation_type type = (argc==4 && !strcmp(args[3], "cubic")) ? LHCOpticsGrid::CUBIC : LHCOpticsGrid::LINEAR;
+
+  TIter next(f->GetListOfKeys());
+  TKey *key;
+  while((key = (TKey *)next()))
+  {
+    if(strcmp(key->GetClassName(), "LHCOpticsApproximator"))
+      continue;
+
+    LHCOpticsApproximator *approx = (LHCOpticsApproximator *) key->ReadObj();
+    LHCOpticsGrid grid;
+    if(!grid.Build(*approx, nodes, type))
+      continue;
+
+    std::cout<<approx->GetName()<<": "<<grid.GetNumberOfNodes()<<" nodes"<<std::endl;
+    grid.TestAccuracy(*approx).Print();
+  }
+
+  f->Close();
+  return 0;
+}
@@ -11,6 +11,7 @@
 #include <vector>
 #include <map>
 
+class TransportSampleWriter;
 
 class FitData{
 
@@ -60,6 +61,7 @@ void readAdditionalScoringPlanes(std::string name, const std::vector<std::string
 
 void writeOut(std::string name);
 int AppendRootFile(TTree *inp_tree, std::string data_prefix = std::string("def"));
+int AppendBinarySampleFile(TransportSampleWriter &writer);  //planes taken from the writer, the first one is the destination plane
 int AppendLostParticlesRootFile(TTree *lost_particles_tree);
 int AppendAcceleratorAcceptanceRootFile(TTree *acceptance_tree);
 
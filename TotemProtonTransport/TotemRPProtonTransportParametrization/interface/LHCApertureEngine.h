@@ -0,0 +1,63 @@
+#ifndef SimG4Core_TotemRPProtonTransportParametrization_LHCApertureEngine_H
+#define SimG4Core_TotemRPProtonTransportParametrization_LHCApertureEngine_H
+
+#include <vector>
+
+class LHCOpticsApproximator;
+class TMultiDimFet;
+
+
+/**
+ *\brief Evaluates all apertures of an LHCOpticsApproximator in one pass.
+ * The x and y polynomials of the aperture approximators are flattened at construction (the theta polynomials
+ * are not needed), the evaluation stops at the first aperture the proton does not pass.
+ * The results are identical to the ones of LHCOpticsApproximator::Transport(in, out, true).
+ * The engine is a snapshot: it has to be rebuilt if the apertures of the approximator change.
+**/
+class LHCApertureEngine
+{
+  public:
+    LHCApertureEngine();
+    explicit LHCApertureEngine(const LHCOpticsApproximator &approx);
+
+    void Build(const LHCOpticsApproximator &approx);
+    unsigned int GetNumberOfApertures() const { return apertures_.size(); }
+
+    /// checks all apertures for a proton (x, theta_x, y, theta_y, xi) [m, rad, m, rad, 1]
+    bool Check(const double *in) const;
+
+    /// checks n protons stored as consecutive (x, theta_x, y, theta_y, xi) rows
+    /// sets the accepted flags and returns the number of accepted protons
+    unsigned int CheckBatch(const double *in, unsigned int n, bool *accepted) const;
+
+  private:
+    /// polynomial of 5 variables in the TMultiDimFet convention (powers + 1)
+    struct Polynomial
+    {
+      int poly_type;
+      double mean;
+      double scale[5], shift[5];    ///< normalised variable = 1 + scale * (x - shift), as in TMultiDimFet::Eval
+      int max_power[5];
+      std::vector<double> coefficients;
+      std::vector<unsigned char> powers;
+
+      void Build(const TMultiDimFet &pol);
+      double Eval(const double *in) const;
+    };
+
+    struct Aperture
+    {
+      bool trained;
+      bool invert;                   ///< lhcb2: x and theta_x inverted
+      double min[5], max[5];         ///< valid input range of the aperture approximator
+      bool rect_ellipse;
+      double rect_x, rect_y, r_el_x2, r_el_y2;
+      Polynomial x, y;
+    };
+
+    std::vector<Aperture> apertures_;
+
+    static bool Passes(const Aperture &ap, const double *in);
+};
+
+#endif  //SimG4Core_TotemRPProtonTransportParametrization_LHCApertureEngine_H
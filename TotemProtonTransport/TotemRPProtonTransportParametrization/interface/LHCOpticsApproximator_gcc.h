@@ -21,6 +21,8 @@ struct MadKinematicDescriptor
 };
 
 class LHCApertureApproximator;
+class LHCApertureEngine;
+class TransportSampleReader;
 
 /**
  *\brief Class finds the parametrisation of MADX proton transport and transports the protons according to it
@@ -41,6 +43,9 @@ class LHCOpticsApproximator : public TNamed
     enum beam_type{lhcb1, lhcb2};
     void Train(TTree *inp_tree, std::string data_prefix = std::string("def"), polynomials_selection mode = PREDEFINED, int max_degree_x = 10, int max_degree_tx = 10, int max_degree_y = 10, int max_degree_ty = 10, bool common_terms = false, double *prec=NULL);
     void Test(TTree *inp_tree, TFile *f_out, std::string data_prefix = std::string("def"), std::string base_out_dir = std::string(""));
+    /// same as above, the samples are streamed in chunks from a memory-mapped binary sample file
+    void Train(const TransportSampleReader &samples, std::string data_prefix = std::string("def"), polynomials_selection mode = PREDEFINED, int max_degree_x = 10, int max_degree_tx = 10, int max_degree_y = 10, int max_degree_ty = 10, bool common_terms = false, double *prec=NULL);
+    void Test(const TransportSampleReader &samples, TFile *f_out, std::string data_prefix = std::string("def"), std::string base_out_dir = std::string(""));
     void TestAperture(TTree *in_tree, TTree *out_tree);  ///< x, theta_x, y, theta_y, ksi, mad_accepted, parametriz_accepted
 
     double ParameterOutOfRangePenalty(double par_m[], bool invert_beam_coord_sytems=true) const;
@@ -60,6 +65,14 @@ class LHCOpticsApproximator : public TNamed
     /// returns true if transport possible
     bool Transport2D(const double *in, double *out, bool check_apertures=false, bool invert_beam_coord_sytems=true) const;  
 
+    /// 2D transport together with its Jacobian, jacobian[i][j] = d out[i] / d in[j]
+    /// IN : (x, theta_x, y, theta_y, xi) [m, rad, m, rad, 1]
+    /// OUT : (x, y) [m, m]
+    bool Transport2DJacobian(const double *in, double *out, double jacobian[2][5], bool invert_beam_coord_sytems=true) const;
+
+    /// returns ParameterOutOfRangePenalty(in), fills its gradient with respect to in
+    double ParameterOutOfRangePenaltyGradient(const double *in, double *gradient, bool invert_beam_coord_sytems=true) const;
+
     bool Transport_m_GeV(double in_pos[3], double in_momentum[3], double out_pos[3], double out_momentum[3],
           bool check_apertures, double z2_z1_dist) const;  ///< pos, momentum: x,y,z;  pos in m, momentum in GeV/c
 
@@ -113,7 +126,16 @@ class LHCOpticsApproximator : public TNamed
     std::vector<std::string> coord_names;
     std::vector<LHCApertureApproximator> apertures_;  ///< apertures on the way
 
+    /// flattened apertures_, used by the transport methods when checking the apertures
+    mutable std::shared_ptr<const LHCApertureEngine> aperture_engine_;  //! built on first use
+
+    /// returns the aperture engine, (re)builds it if it does not match apertures_
+    std::shared_ptr<const LHCApertureEngine> GetApertureEngine() const;
+
     friend class ProtonTransportFunctionsESSource;
+    friend class LHCOpticsCompactFile;
+    friend class LHCApertureEngine;
+    friend class LHCOpticsGrid;
 
     TMultiDimFet x_parametrisation;                   ///< polynomial approximation for x
     TMultiDimFet theta_x_parametrisation;             ///< polynomial approximation for theta_x
@@ -123,6 +145,7 @@ class LHCOpticsApproximator : public TNamed
     //train_mode mode_;  //polynomial selection mode - selection done by fitting function or selection from the list according to the specified order
     enum variable_type {X, THETA_X, Y, THETA_Y};
     //internal methods
+    void FindParameterizations(double *prec);
     void InitializeApproximators(polynomials_selection mode, int max_degree_x, int max_degree_tx, int max_degree_y, int max_degree_ty, bool common_terms);
     void SetDefaultAproximatorSettings(TMultiDimFet &approximator, variable_type var_type, int max_degree);
     void SetTermsManually(TMultiDimFet &approximator, variable_type variable, int max_degree, bool common_terms);
@@ -158,6 +181,9 @@ class LHCApertureApproximator : public LHCOpticsApproximator
     double rect_x_, rect_y_, r_el_x_, r_el_y_;
     aperture_type ap_type_;
 
+    friend class LHCOpticsCompactFile;
+    friend class LHCApertureEngine;
+
     ClassDef(LHCApertureApproximator,1) // Aperture approximator
 };
 
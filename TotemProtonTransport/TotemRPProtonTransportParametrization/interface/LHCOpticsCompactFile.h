@@ -0,0 +1,62 @@
+#ifndef SimG4Core_TotemRPProtonTransportParametrization_LHCOpticsCompactFile_H
+#define SimG4Core_TotemRPProtonTransportParametrization_LHCOpticsCompactFile_H
+
+#include <string>
+#include <vector>
+#include <map>
+
+class LHCOpticsApproximator;
+class TMultiDimFet;
+
+
+/**
+ *\brief Compact, coefficient-only storage of optics approximators.
+ * Only what is needed for the transport is kept: for each polynomial the powers, the coefficients
+ * and the normalisation ranges; for each approximator the beam settings and the apertures.
+ * The file starts with an index (name, offset, size), so that individual approximators
+ * can be loaded on demand from the memory-mapped file.
+**/
+class LHCOpticsCompactFile
+{
+  public:
+    static const unsigned int kVersion = 1;
+    static const unsigned int kNameLength = 64;
+
+    LHCOpticsCompactFile();
+    ~LHCOpticsCompactFile();
+
+    /// writes the given approximators, returns false on failure
+    static bool Write(const std::string &file_name, const std::vector<const LHCOpticsApproximator *> &approximators);
+
+    /// maps the file, returns false if it cannot be opened or it is not a compact optics file
+    bool Open(const std::string &file_name);
+    void Close();
+
+    const std::vector<std::string>& GetNames() const { return names_; }
+    bool Contains(const std::string &name) const { return index_.find(name) != index_.end(); }
+
+    /// deserializes the approximator with the given name, returns NULL if not present; the caller takes the ownership
+    LHCOpticsApproximator* Load(const std::string &name) const;
+
+  private:
+    struct Entry
+    {
+      unsigned long long offset;
+      unsigned long long size;
+    };
+
+    void *map_;
+    unsigned long map_size_;
+    std::vector<std::string> names_;
+    std::map<std::string, Entry> index_;
+
+    static void WriteApproximator(std::string &buf, const LHCOpticsApproximator &approx);
+    static void WritePolynomial(std::string &buf, const TMultiDimFet &pol);
+    static bool ReadApproximator(const char *&p, const char *end, LHCOpticsApproximator &approx);
+    static bool ReadPolynomial(const char *&p, const char *end, TMultiDimFet &pol);
+
+    LHCOpticsCompactFile(const LHCOpticsCompactFile &);
+    LHCOpticsCompactFile& operator=(const LHCOpticsCompactFile &);
+};
+
+#endif  //SimG4Core_TotemRPProtonTransportParametrization_LHCOpticsCompactFile_H
@@ -0,0 +1,71 @@
+#ifndef SimG4Core_TotemRPProtonTransportParametrization_LHCOpticsGrid_H
+#define SimG4Core_TotemRPProtonTransportParametrization_LHCOpticsGrid_H
+
+#include <vector>
+
+class LHCOpticsApproximator;
+
+
+/**
+ *\brief Lookup-grid approximation of an LHCOpticsApproximator.
+ * The polynomials are tabulated on a regular 5D grid spanning the valid input range of the approximator
+ * (the one of CheckInputRange) and the transport is evaluated by multilinear or cubic (Catmull-Rom)
+ * interpolation. The cost of a call does not depend on the size of the polynomials.
+ * Meant for workloads where a per-mille level accuracy is sufficient, use TestAccuracy to check it.
+ * The apertures are not tabulated.
+**/
+class LHCOpticsGrid
+{
+  public:
+    enum interpolation_type {LINEAR, CUBIC};
+
+    /// deviations of the grid from the polynomials, per output coordinate (x, theta_x, y, theta_y)
+    struct ErrorReport
+    {
+      unsigned int samples;
+      double mean_abs[4];
+      double rms[4];
+      double max_abs[4];
+
+      void Print() const;
+    };
+
+    LHCOpticsGrid();
+
+    /// tabulates the approximator with nodes[i] nodes along the input variable i (x, theta_x, y, theta_y, xi)
+    bool Build(const LHCOpticsApproximator &approx, const unsigned int nodes[5], interpolation_type type = LINEAR);
+
+    void SetInterpolationType(interpolation_type type) { type_ = type; }
+    interpolation_type GetInterpolationType() const { return type_; }
+    bool IsBuilt() const { return built_; }
+    unsigned long GetNumberOfNodes() const { return values_.size()/4; }
+
+    /// same interface as in LHCOpticsApproximator (without the aperture check)
+    /// IN/OUT: (x, theta_x, y, theta_y, xi) [m, rad, m, rad, 1]
+    bool Transport(const double *in, double *out, bool invert_beam_coord_sytems=true) const;
+
+    /// IN : (x, theta_x, y, theta_y, xi) [m, rad, m, rad, 1]
+    /// OUT : (x, y) [m, m]
+    bool Transport2D(const double *in, double *out, bool invert_beam_coord_sytems=true) const;
+
+    bool CheckInputRange(const double *in, bool invert_beam_coord_sytems=true) const;
+
+    /// compares the grid with the polynomials at uniformly distributed random points of the input range
+    ErrorReport TestAccuracy(const LHCOpticsApproximator &approx, unsigned int samples = 100000, unsigned int seed = 1) const;
+
+  private:
+    bool built_;
+    bool invert_;                   ///< lhcb2: x and theta_x inverted
+    interpolation_type type_;
+    unsigned int nodes_[5];
+    unsigned long stride_[5];       ///< node index strides
+    double min_[5], max_[5];
+    double step_[5];
+    std::vector<double> values_;    ///< x, theta_x, y, theta_y per node
+
+    /// interpolates all 4 outputs, the input is in the coordinate system of the polynomials
+    void Interpolate(const double *in, double *out) const;
+    void CorrectInput(const double *in, double *in_corrected, bool invert_beam_coord_sytems) const;
+};
+
+#endif  //SimG4Core_TotemRPProtonTransportParametrization_LHCOpticsGrid_H
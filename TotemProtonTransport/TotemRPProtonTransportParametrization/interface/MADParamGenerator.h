@@ -12,8 +12,10 @@
 #include "TotemProtonTransport/TotemRPProtonTransportParametrization/interface/TMultiDimFet.h"
 #include "TotemProtonTransport/TotemRPProtonTransportParametrization/interface/LHCOpticsApproximator.h"
 #include "TotemProtonTransport/TotemRPProtonTransportParametrization/interface/RPXMLConfig.h"
+#include "TotemProtonTransport/TotemRPProtonTransportParametrization/interface/TransportSampleFile.h"
 
 struct Parametisation_aperture_configuration;
+class TRandom3;
 
 struct Parametisation_configuration
 {
@@ -46,6 +48,10 @@ struct Parametisation_configuration
   std::string samples_test_root_file_name;
   std::string samples_aperture_test_file_name;
   std::string destination_branch_prefix;
+  std::string samples_train_binary_file_name;  ///< optional binary cache of the training samples, empty if not used
+  std::string samples_test_binary_file_name;   ///< optional binary cache of the testing samples, empty if not used
+  int parallel_jobs;                           ///< number of concurrent MAD-X shards, 1 for the sequential generation
+  unsigned int random_seed;                    ///< base seed of the sample generation, 0 for a time-based seed
 
   TMultiDimFet::EMDFPolyType polynomials_type;
   LHCOpticsApproximator::polynomials_selection terms_selelection_mode;
@@ -82,9 +88,35 @@ struct Parametisation_aperture_configuration
 std::ostream & operator<<(std::ostream &s, const Parametisation_aperture_configuration &c);
 
 
+/**
+ *\brief Tracks the particles of one sample shard.
+ * The shard reads <file_prefix>part.in and writes <file_prefix>trackone (and <file_prefix>trackloss).
+ * Track is called concurrently for different shards.
+**/
+class SampleTracker
+{
+  public:
+    virtual ~SampleTracker() {}
+    virtual void Track(const std::string &conf_file, const std::string &file_prefix) = 0;
+};
+
+
+/// runs a local MAD-X process
+class MADXSampleTracker : public SampleTracker
+{
+  public:
+    virtual void Track(const std::string &conf_file, const std::string &file_prefix);
+};
+
+
 class MADParamGenerator
 {
   public:
+    MADParamGenerator();
+
+    /// replaces the MAD-X tracker (e.g. by a stub), the tracker is not owned
+    void SetSampleTracker(SampleTracker *tracker) { tracker_ = tracker; }
+
     int GenerateTrainingData(const Parametisation_configuration &conf);
     int GenerateTestingData(const Parametisation_configuration &conf);
     int GenerateApertureTestingData(const Parametisation_configuration &conf);
@@ -108,23 +140,27 @@ class MADParamGenerator
 
  // private:
     int BuildSample(const Parametisation_configuration &conf, std::string sample_file_name, bool recloss=false, bool compare_apert = false);
+    int BuildSampleSharded(const Parametisation_configuration &conf, std::string sample_file_name, bool recloss, bool compare_apert,
+        const std::vector<std::string> &aperture_markers, const std::string &binary_file_name, unsigned int base_seed);
 
     void GenerateMADConfFile(const std::string &base_conf_file, const std::string &out_conf_file, const std::string &from_marker_name,
         double from_marker_s_pos, bool define_from, const std::string &to_marker_name, double to_marker_s_pos,
         bool define_to, int particles_number, bool aperture_limit=false,
-        std::vector<std::string> scoring_planes = std::vector<std::string>(), const std::string &beam = std::string("lhcb1") );
-    void GenerateRandomSamples(int number_of_particles, double x_min, double x_max, double theta_x_min, double theta_x_max, double y_min, double y_max, double theta_y_min, double theta_y_max, double ksi_min, double ksi_max, const std::string &out_file_name);
-    int AppendRootTree(std::string root_file_name, std::string out_prefix, std::string out_station, bool recloss, std::string lost_particles_tree_filename, const std::vector<std::string> &scoring_planes, bool compare_apert);  //return number of uppended entries
+        std::vector<std::string> scoring_planes = std::vector<std::string>(), const std::string &beam = std::string("lhcb1"),
+        const std::string &file_prefix = std::string() );
+    void GenerateRandomSamples(int number_of_particles, double x_min, double x_max, double theta_x_min, double theta_x_max, double y_min, double y_max, double theta_y_min, double theta_y_max, double ksi_min, double ksi_max, const std::string &out_file_name, unsigned int seed = 0);  //seed 0: time-based
+    int AppendRootTree(std::string root_file_name, std::string out_prefix, std::string out_station, bool recloss, std::string lost_particles_tree_filename, const std::vector<std::string> &scoring_planes, bool compare_apert, std::string binary_file_name = std::string(), std::string file_prefix = std::string());  //return number of uppended entries
     void RunMAD(const std::string &conf_file);
+    unsigned int DrawSeed(TRandom3 &seeder);  ///< next per-batch seed, never 0
 
     //auxiliary functions
     void Conf_file_processing(std::fstream &base_conf_file, std::fstream & conf_file, const std::string &from_marker_name, double from_marker_s_pos,
         bool define_from, const std::string &to_marker_name, double to_marker_s_pos, bool define_to, int particles_number, bool aperture_limit,
-        const std::vector<std::string> &scoring_planes, const std::string &beam);
+        const std::vector<std::string> &scoring_planes, const std::string &beam, const std::string &file_prefix);
     std::string GetToken(std::fstream &base_conf_file);
     void ProcessToken(std::fstream &conf_file, const std::string &from_marker_name, double from_marker_s_pos, bool define_from,
         const std::string &to_marker_name, double to_marker_s_pos, bool define_to, int particles_number, bool aperture_limit,
-        const std::string &token, const std::vector<std::string> &scoring_planes, const std::string &beam);
+        const std::string &token, const std::vector<std::string> &scoring_planes, const std::string &beam, const std::string &file_prefix);
     TTree *CreateSamplesTree(TFile *f, std::string out_prefix, const std::vector<std::string> &scoring_planes);
     TTree *CreateAccelAcceptTree(TFile *f, std::string name = std::string("acc_acept_tree"));
     TTree *CreateLostParticlesTree(TFile *lost_particles_file);
@@ -138,9 +174,13 @@ class MADParamGenerator
     void DeleteApertureTestFiles(const Parametisation_configuration &conf);
     void PrintTreeInfo(const Parametisation_configuration &conf, std::string sample_file_name);
     TTree *GetSamplesTree(const Parametisation_configuration &conf, std::string sample_file_name);
+    std::string GetBinarySampleFileName(const Parametisation_configuration &conf, const std::string &sample_file_name);
+    std::string GetOptionalParameter(int id, const char *name);
 
     private:
       RPXMLConfig xml_parser;
+      MADXSampleTracker mad_tracker_;
+      SampleTracker *tracker_;
 };
 
 
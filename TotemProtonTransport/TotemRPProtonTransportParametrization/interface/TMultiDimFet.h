@@ -125,6 +125,7 @@ protected:
    Bool_t       fIsVerbose;            //
 
    virtual Double_t EvalFactor(Int_t p, Double_t x) const;
+   void             EvalFactorDerivative(Int_t p, Double_t x, Double_t &factor, Double_t &derivative) const;
    virtual Double_t EvalControl(const Int_t *powers);
    virtual void     MakeCoefficientErrors();
    virtual void     MakeCorrelation();
@@ -156,6 +157,8 @@ public:
    virtual void     Clear(Option_t *option=""); // *MENU*
    virtual void     Draw(Option_t * ="d") { }
    virtual Double_t Eval(const Double_t *x, const Double_t *coeff=0) const;
+   /// evaluates the parameterisation and its gradient d/dx[j] at point x (at most 16 variables)
+   Double_t         EvalGradient(const Double_t *x, Double_t *gradient) const;
    virtual void     FindParameterization(double precision); // *MENU*
    virtual void     Fit(Option_t *option=""); // *MENU*
 
@@ -224,6 +227,12 @@ public:
    void             SetPowerLimit(Double_t limit=1e-3);
    virtual void     SetPowers(const Int_t *powers, Int_t terms);
 
+   /// sets a parameterisation found elsewhere (e.g. read from the compact optics format)
+   /// powers in the internal convention (power + 1), fNVariables values per coefficient
+   void             SetParameterization(EMDFPolyType type, Double_t meanQuantity,
+                                        const TVectorD &minVariables, const TVectorD &maxVariables,
+                                        Int_t nCoefficients, const Double_t *coefficients, const Int_t *powers);
+
    void ReducePolynomial(double error);
    void ZeroDoubiousCoefficients(double error);
 
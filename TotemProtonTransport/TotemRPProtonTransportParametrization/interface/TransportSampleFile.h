@@ -0,0 +1,99 @@
+#ifndef SimG4Core_TotemRPProtonTransportParametrization_TransportSampleFile_H
+#define SimG4Core_TotemRPProtonTransportParametrization_TransportSampleFile_H
+
+#include <string>
+#include <vector>
+#include <cstdio>
+
+
+/**
+ *\brief Compact binary cache of MAD-X transport samples.
+ * The file holds a fixed header, the list of output planes and a row-major table of doubles.
+ * Each row has the layout of the "transport_samples" ntuple:
+ *   x_in, theta_x_in, y_in, theta_y_in, ksi_in, s_in,
+ *   and for each plane: x_out, theta_x_out, y_out, theta_y_out, ksi_out, s_out, valid_out
+ * The header and the plane names are padded to a multiple of 8 bytes, so that the table can be mmapped.
+**/
+class TransportSampleFile
+{
+  public:
+    static const unsigned int kVersion = 1;
+    static const unsigned int kInputColumns = 6;
+    static const unsigned int kPlaneColumns = 7;
+    static const unsigned int kPlaneNameLength = 64;
+
+    struct Header
+    {
+      char magic[8];              ///< "TRSMPL\0\0"
+      unsigned int version;
+      unsigned int planes;
+      unsigned long long rows;
+    };
+
+    static bool CheckHeader(const Header &h);
+    static unsigned int RowSize(unsigned int planes) { return kInputColumns + kPlaneColumns*planes; }
+    static unsigned long DataOffset(unsigned int planes) { return sizeof(Header) + planes*kPlaneNameLength; }
+};
+
+
+/**
+ *\brief Appends sample rows to a binary sample file.
+ * Opening an existing file appends to it, provided the plane list matches.
+**/
+class TransportSampleWriter
+{
+  public:
+    TransportSampleWriter();
+    ~TransportSampleWriter();
+
+    /// the first plane is the destination plane, the others are the additional scoring planes
+    bool Open(const std::string &file_name, const std::vector<std::string> &planes);
+    void AppendRow(const double *row);
+    void Close();
+
+    const std::vector<std::string>& GetPlanes() const { return planes_; }
+
+  private:
+    FILE *file_;
+    std::vector<std::string> planes_;
+    TransportSampleFile::Header header_;
+};
+
+
+/**
+ *\brief Read-only, memory-mapped view of a binary sample file.
+ * The rows are served in chunks, so that the consumers can stream through multi-GB samples.
+**/
+class TransportSampleReader
+{
+  public:
+    TransportSampleReader();
+    ~TransportSampleReader();
+
+    bool Open(const std::string &file_name);
+    void Close();
+
+    bool IsOpen() const { return data_ != NULL; }
+    unsigned long GetRows() const { return rows_; }
+    unsigned int GetRowSize() const { return row_size_; }
+    const std::vector<std::string>& GetPlanes() const { return planes_; }
+
+    /// returns the column offset of the output block of the given plane (branch prefix), -1 if not present
+    int GetPlaneOffset(const std::string &plane) const;
+
+    /// sets rows to the first row of the chunk, returns the number of rows in the chunk
+    unsigned long GetChunk(unsigned long first_row, unsigned long max_rows, const double *&rows) const;
+
+  private:
+    void *map_;
+    unsigned long map_size_;
+    const double *data_;
+    unsigned long rows_;
+    unsigned int row_size_;
+    std::vector<std::string> planes_;
+
+    TransportSampleReader(const TransportSampleReader &);
+    TransportSampleReader& operator=(const TransportSampleReader &);
+};
+
+#endif  //SimG4Core_TotemRPProtonTransportParametrization_TransportSampleFile_H
@@ -1,5 +1,6 @@
 
 #include "TotemProtonTransport/TotemRPProtonTransportParametrization/interface/FitData.h"
+#include "TotemProtonTransport/TotemRPProtonTransportParametrization/interface/TransportSampleFile.h"
 
 FitData::FitData(){
 }
@@ -474,6 +475,72 @@ int FitData::AppendRootFile(TTree *inp_tree, std::string data_prefix)
   return this->outSize;
 }
 
+int FitData::AppendBinarySampleFile(TransportSampleWriter &writer)
+{
+  const std::vector<std::string> &planes = writer.GetPlanes();
+
+  //additional scoring planes, in the order of the writer columns
+  std::vector<TMatrixD*> inter_planes;
+  std::vector<int> cur_index;
+  for(unsigned int j=1; j<planes.size(); j++)
+  {
+    std::map<std::string, TMatrixD>::iterator it = additional_scoring_planes.find(planes[j]);
+    if(it == additional_scoring_planes.end())
+    {
+      std::cout << "Scoring plane " << planes[j] << " not read in" << std::endl;
+      return 0;
+    }
+    inter_planes.push_back(&(it->second));
+    cur_index.push_back(0);
+  }
+
+  std::vector<double> row(TransportSampleFile::RowSize(planes.size()), 0.0);
+
+  for (int i=0; i < this->outSize; i++)
+  {
+    int in_index = (Int_t)(this->dataOut)[0][i]-1;
+    int in_part_number = (Int_t)(this->dataOut)[0][i];
+
+    //x_in, theta_x_in, y_in, theta_y_in, ksi_in, s_in
+    row[0] = (this->dataIn)[1][in_index];
+    row[1] = (this->dataIn)[2][in_index];
+    row[2] = (this->dataIn)[3][in_index];
+    row[3] = (this->dataIn)[4][in_index];
+    row[4] = (this->dataIn)[5][in_index];
+    row[5] = 0;  //temporarily
+
+    //x_out, theta_x_out, y_out, theta_y_out, ksi_out, s_out, valid_out
+    double *out = &row[TransportSampleFile::kInputColumns];
+    out[0] = (this->dataOut)[1][i];
+    out[1] = (this->dataOut)[2][i];
+    out[2] = (this->dataOut)[3][i];
+    out[3] = (this->dataOut)[4][i];
+    out[4] = (this->dataOut)[5][i];
+    out[5] = 0;  //temporarily
+    out[6] = 1.0;
+
+    for(unsigned int j=0; j<inter_planes.size(); j++)
+    {
+      const TMatrixD &data = *inter_planes[j];
+      while(data[0][cur_index[j]] != in_part_number)
+      {
+        cur_index[j]++;
+      }
+      out += TransportSampleFile::kPlaneColumns;
+      out[0] = data[1][cur_index[j]];
+      out[1] = data[2][cur_index[j]];
+      out[2] = data[3][cur_index[j]];
+      out[3] = data[4][cur_index[j]];
+      out[4] = data[5][cur_index[j]];
+      out[5] = 0;
+      out[6] = 1.0;
+    }
+
+    writer.AppendRow(&row[0]);
+  }
+  return this->outSize;
+}
+
 int FitData::AppendLostParticlesRootFile(TTree *lost_part_tree)
 {
   if(lost_part_tree==NULL)
@@ -0,0 +1,245 @@
+#include "TotemProtonTransport/TotemRPProtonTransportParametrization/interface/LHCApertureEngine.h"
+#include "TotemProtonTransport/TotemRPProtonTransportParametrization/interface/LHCOpticsApproximator.h"
+
+namespace
+{
+  /// powers (in the TMultiDimFet convention) below this limit are tabulated
+  const int tabulated_powers = 32;
+
+  /// same recurrence as TMultiDimFet::EvalFactor
+  double EvalFactor(int poly_type, int p, double x)
+  {
+    if(p == 1)
+      return 1;
+    if(p == 2)
+      return x;
+
+    double p1 = 1, p2 = x, p3 = 0;
+    for(int i = 3; i <= p; i++)
+    {
+      p3 = p2 * x;
+      if(poly_type == TMultiDimFet::kLegendre)
+        p3 = ((2 * i - 3) * p2 * x - (i - 2) * p1) / (i - 1);
+      else if(poly_type == TMultiDimFet::kChebyshev)
+        p3 = 2 * x * p2 - p1;
+      p1 = p2;
+      p2 = p3;
+    }
+    return p3;
+  }
+}
+
+
+void LHCApertureEngine::Polynomial::Build(const TMultiDimFet &pol)
+{
+  const int n_var = pol.GetNVariables();
+  const int n_coef = pol.GetNCoefficients();
+  std::vector<Int_t> all_powers = pol.GetPowers();
+  std::vector<Int_t> power_index = pol.GetPowerIndex();
+
+  poly_type = pol.GetPolyType();
+  mean = pol.GetMeanQuantity();
+  for(int j=0; j<5; j++)
+  {
+    scale[j] = 2. / ((*pol.GetMaxVariables())(j) - (*pol.GetMinVariables())(j));
+    shift[j] = (*pol.GetMaxVariables())(j);
+    max_power[j] = 1;
+  }
+
+  coefficients.resize(n_coef);
+  powers.assign(n_coef*5, 1);
+  for(int i=0; i<n_coef; i++)
+  {
+    coefficients[i] = (*pol.GetCoefficients())(i);
+    for(int j=0; j<5 && j<n_var; j++)
+    {
+      int p = all_powers[power_index[i]*n_var + j];
+      powers[i*5 + j] = p;
+      if(p > max_power[j] && p < tabulated_powers)
+        max_power[j] = p;
+    }
+  }
+}
+
+
+double LHCApertureEngine::Polynomial::Eval(const double *in) const
+{
+  // factor tables of the normalised variables, shared by all terms
+  double y[5];
+  double factors[5][tabulated_powers];
+  for(int j=0; j<5; j++)
+  {
+    y[j] = 1 + scale[j] * (in[j] - shift[j]);
+    factors[j][1] = 1;
+    factors[j][2] = y[j];
+    for(int p=3; p<=max_power[j]; p++)
+      factors[j][p] = EvalFactor(poly_type, p, y[j]);
+  }
+
+  double result = mean;
+  const unsigned int n_coef = coefficients.size();
+  for(unsigned int i=0; i<n_coef; i++)
+  {
+    double term = coefficients[i];
+    for(int j=0; j<5; j++)
+    {
+      int p = powers[i*5 + j];
+      term *= (p < tabulated_powers) ? factors[j][p] : EvalFactor(poly_type, p, y[j]);
+    }
+    result += term;
+  }
+  return result;
+}
+
+
+LHCApertureEngine::LHCApertureEngine()
+{
+}
+
+
+LHCApertureEngine::LHCApertureEngine(const LHCOpticsApproximator &approx)
+{
+  Build(approx);
+}
+
+
+void LHCApertureEngine::Build(const LHCOpticsApproximator &approx)
+{
+  apertures_.clear();
+  apertures_.resize(approx.apertures_.size());
+
+  for(unsigned int i=0; i<approx.apertures_.size(); i++)
+  {
+    const LHCApertureApproximator &in = approx.apertures_[i];
+    Aperture &ap = apertures_[i];
+
+    // LHCApertureApproximator::CheckAperture is always called with the default coordinate inversion
+    ap.trained = in.trained_;
+    ap.invert = (in.beam == LHCOpticsApproximator::lhcb2);
+    for(int j=0; j<5; j++)
+    {
+      ap.min[j] = (*in.x_parametrisation.GetMinVariables())(j);
+      ap.max[j] = (*in.x_parametrisation.GetMaxVariables())(j);
+    }
+
+    ap.rect_ellipse = (in.ap_type_ == LHCApertureApproximator::RECTELLIPSE);
+    ap.rect_x = in.rect_x_;
+    ap.rect_y = in.rect_y_;
+    ap.r_el_x2 = in.r_el_x_*in.r_el_x_;
+    ap.r_el_y2 = in.r_el_y_*in.r_el_y_;
+
+    ap.x.Build(in.x_parametrisation);
+    ap.y.Build(in.y_parametrisation);
+  }
+}
+
+
+bool LHCApertureEngine::Passes(const Aperture &ap, const double *in)
+{
+  if(!ap.trained)
+    return false;
+
+  double in_corrected[5] = { in[0], in[1], in[2], in[3], in[4] };
+  if(ap.invert)
+  {
+    in_corrected[0] = -in[0];
+    in_corrected[1] = -in[1];
+  }
+
+  bool res = true;
+  for(int j=0; j<5; j++)
+    res = res && in_corrected[j]>=ap.min[j] && in_corrected[j]<=ap.max[j];
+
+  if(!res || !ap.rect_ellipse)
+    return res;
+
+  // the sign of x does not matter for the symmetric rectellipse
+  double x = ap.x.Eval(in_corrected);
+  double y = ap.y.Eval(in_corrected);
+  return x<ap.rect_x && x>-ap.rect_x && y<ap.rect_y && y>-ap.rect_y &&
+      ( x*x/ap.r_el_x2 + y*y/ap.r_el_y2 < 1 );
+}
+
+
+bool LHCApertureEngine::Check(const double *in) const
+{
+  for(unsigned int i=0; i<apertures_.size(); i++)
+  {
+    if(!Passes(apertures_[i], in))
+      return false;
+  }
+  return true;
+}
+
+
+unsigned int LHCApertureEngine::CheckBatch(const double *in, unsigned int n, bool *accepted) const
+{
+  // indices of the protons which passed all apertures so far
+  std::vector<unsigned int> alive(n);
+  for(unsigned int k=0; k<n; k++)
+  {
+    alive[k] = k;
+    accepted[k] = true;
+  }
+
+  std::vector<double> xs(n), ys(n);
+  std::vector<char> in_range(n);
+
+  for(unsigned int i=0; i<apertures_.size() && !alive.empty(); i++)
+  {
+    const Aperture &ap = apertures_[i];
+    const unsigned int n_alive = alive.size();
+
+    if(!ap.trained)
+    {
+      for(unsigned int k=0; k<n_alive; k++)
+        accepted[alive[k]] = false;
+      alive.clear();
+      break;
+    }
+
+    // range check and transport of the surviving protons
+    for(unsigned int k=0; k<n_alive; k++)
+    {
+      const double *row = in + 5*alive[k];
+      double in_corrected[5] = { row[0], row[1], row[2], row[3], row[4] };
+      if(ap.invert)
+      {
+        in_corrected[0] = -row[0];
+        in_corrected[1] = -row[1];
+      }
+
+      bool res = true;
+      for(int j=0; j<5; j++)
+        res = res && in_corrected[j]>=ap.min[j] && in_corrected[j]<=ap.max[j];
+      in_range[k] = res;
+
+      xs[k] = (res && ap.rect_ellipse) ? ap.x.Eval(in_corrected) : 0.;
+      ys[k] = (res && ap.rect_ellipse) ? ap.y.Eval(in_corrected) : 0.;
+    }
+
+    // branch-free rectellipse test
+    if(ap.rect_ellipse)
+    {
+      for(unsigned int k=0; k<n_alive; k++)
+      {
+        const double x = xs[k], y = ys[k];
+        in_range[k] &= (x<ap.rect_x) & (x>-ap.rect_x) & (y<ap.rect_y) & (y>-ap.rect_y) &
+          ( x*x/ap.r_el_x2 + y*y/ap.r_el_y2 < 1 );
+      }
+    }
+
+    // keep the survivors
+    unsigned int kept = 0;
+    for(unsigned int k=0; k<n_alive; k++)
+    {
+      if(in_range[k])
+        alive[kept++] = alive[k];
+      else
+        accepted[alive[k]] = false;
+    }
+    alive.resize(kept);
+  }
+
+  return alive.size();
+}
@@ -1,11 +1,20 @@
 #include "TotemProtonTransport/TotemRPProtonTransportParametrization/interface/LHCOpticsApproximator.h"
+#include "TotemProtonTransport/TotemRPProtonTransportParametrization/interface/TransportSampleFile.h"
+#include "TotemProtonTransport/TotemRPProtonTransportParametrization/interface/LHCApertureEngine.h"
 #include <vector>
+#include <algorithm>
 #include <iostream>
 #include "TROOT.h"
 #include <memory>
 #include "TMatrixD.h"
 #include "TMath.h"
 
+namespace
+{
+  /// number of rows read from the binary sample files at once
+  const unsigned long sample_chunk_rows = 65536;
+}
+
 ClassImp(LHCOpticsApproximator)
 ClassImp(LHCApertureApproximator)
 
@@ -14,6 +23,7 @@ void LHCOpticsApproximator::Init()
 {
   out_polynomials.clear();
   apertures_.clear();
+  aperture_engine_.reset();
   out_polynomials.push_back(&x_parametrisation);
   out_polynomials.push_back(&theta_x_parametrisation);
   out_polynomials.push_back(&y_parametrisation);
@@ -145,12 +155,7 @@ bool LHCOpticsApproximator::Transport(const double *in, double *out,
   }
 
   if(check_apertures)
-  {
-    for(unsigned int i=0; i<apertures_.size(); i++)
-    {
-      res = res && apertures_[i].CheckAperture(in);
-    }
-  }
+    res = res && GetApertureEngine()->Check(in);
   return res;
 }
 
@@ -187,10 +192,85 @@ bool LHCOpticsApproximator::Transport2D(const double *in, double *out,
   }
 
   if(check_apertures)
+    res = res && GetApertureEngine()->Check(in);
+  return res;
+}
+
+
+std::shared_ptr<const LHCApertureEngine> LHCOpticsApproximator::GetApertureEngine() const
+{
+  // the approximators can be shared by concurrent fits: the engine is published atomically,
+  // a thread which loses the race only builds an identical engine
+  // (the apertures read from a file or a compact file do not pass through AddRectEllipseAperture,
+  // hence the size check)
+  std::shared_ptr<const LHCApertureEngine> engine = std::atomic_load(&aperture_engine_);
+  if(!engine || engine->GetNumberOfApertures() != apertures_.size())
+  {
+    engine = std::make_shared<const LHCApertureEngine>(*this);
+    std::atomic_store(&aperture_engine_, engine);
+  }
+  return engine;
+}
+
+
+bool LHCOpticsApproximator::Transport2DJacobian(const double *in, double *out, double jacobian[2][5],
+    bool invert_beam_coord_sytems) const
+{
+  if(in==NULL || out==NULL || !trained_)
+    return false;
+
+  bool res = CheckInputRange(in);
+  bool invert = (beam==lhcb2 && invert_beam_coord_sytems);
+  double sign[5] = {1., 1., 1., 1., 1.};
+  if(invert)
+  {
+    sign[0] = -1.;
+    sign[1] = -1.;
+  }
+
+  double in_corrected[5];
+  for(int j=0; j<5; j++)
+    in_corrected[j] = sign[j]*in[j];
+
+  double grad_x[5], grad_y[5];
+  out[0] = sign[0]*x_parametrisation.EvalGradient(in_corrected, grad_x);
+  out[1] = y_parametrisation.EvalGradient(in_corrected, grad_y);
+
+  for(int j=0; j<5; j++)
+  {
+    jacobian[0][j] = sign[0]*grad_x[j]*sign[j];
+    jacobian[1][j] = grad_y[j]*sign[j];
+  }
+  return res;
+}
+
+
+double LHCOpticsApproximator::ParameterOutOfRangePenaltyGradient(const double *in, double *gradient,
+    bool invert_beam_coord_sytems) const
+{
+  bool invert = (beam==lhcb2 && invert_beam_coord_sytems);
+  const TVectorD* min_var = x_parametrisation.GetMinVariables();
+  const TVectorD* max_var = x_parametrisation.GetMaxVariables();
+  double res = 0.;
+
+  for(int i=0; i<5; i++)
   {
-    for(unsigned int i=0; i<apertures_.size(); i++)
+    double sign = (invert && i<2) ? -1. : 1.;
+    double in_corrected = sign*in[i];
+    double range = (*max_var)(i)-(*min_var)(i);
+    gradient[i] = 0.;
+
+    if(in_corrected<(*min_var)(i))
     {
-      res = res && apertures_[i].CheckAperture(in);
+      double dist = TMath::Abs( ((*min_var)(i)-in_corrected)/range );
+      res += 8*(TMath::Exp(dist)-1.0);
+      gradient[i] = -8*TMath::Exp(dist)/TMath::Abs(range)*sign;
+    }
+    else if(in_corrected>(*max_var)(i))
+    {
+      double dist = TMath::Abs( ( in_corrected-(*max_var)(i) )/range );
+      res += 8*(TMath::Exp(dist)-1.0);
+      gradient[i] = 8*TMath::Exp(dist)/TMath::Abs(range)*sign;
     }
   }
   return res;
@@ -384,6 +464,49 @@ void LHCOpticsApproximator::Train(TTree *inp_tree, std::string data_prefix, poly
     }
   }
 
+  FindParameterizations(prec);
+}
+
+
+void LHCOpticsApproximator::Train(const TransportSampleReader &samples, std::string data_prefix, polynomials_selection mode, int max_degree_x, int max_degree_tx, int max_degree_y, int max_degree_ty, bool common_terms, double *prec)
+{
+  int out_offset = samples.GetPlaneOffset(data_prefix);
+  if(!samples.IsOpen() || out_offset<0)
+    return;
+
+  InitializeApproximators(mode, max_degree_x, max_degree_tx, max_degree_y, max_degree_ty, common_terms);
+
+  //row: x_in, theta_x_in, y_in, theta_y_in, ksi_in, s_in, ..., x_out, theta_x_out, y_out, theta_y_out, ksi_out, s_out, valid_out, ...
+  const double *rows;
+  if(samples.GetChunk(0, 1, rows))
+  {
+    s_begin_ = rows[5];
+    s_end_ = rows[out_offset+5];
+  }
+
+  const unsigned int row_size = samples.GetRowSize();
+  for(unsigned long first=0, n=0; (n = samples.GetChunk(first, sample_chunk_rows, rows)) > 0; first += n)
+  {
+    for(unsigned long i=0; i<n; ++i)
+    {
+      const double *in_var = rows + i*row_size;
+      const double *out_var = in_var + out_offset;
+      if(out_var[6] != 0)  //if out data valid
+      {
+        x_parametrisation.AddRow(in_var, out_var[0], 0);
+        theta_x_parametrisation.AddRow(in_var, out_var[1], 0);
+        y_parametrisation.AddRow(in_var, out_var[2], 0);
+        theta_y_parametrisation.AddRow(in_var, out_var[3], 0);
+      }
+    }
+  }
+
+  FindParameterizations(prec);
+}
+
+
+void LHCOpticsApproximator::FindParameterizations(double *prec)
+{
   std::cout<<"Optical functions parametrizations from "<<s_begin_<<" to "<<s_end_<<std::endl;
   PrintInputRange();
   for(int i=0; i<4; i++)
@@ -710,6 +833,56 @@ void LHCOpticsApproximator::Test(TTree *inp_tree, TFile *f_out, std::string data
 }
 
 
+void LHCOpticsApproximator::Test(const TransportSampleReader &samples, TFile *f_out, std::string data_prefix, std::string base_out_dir)
+{
+  int out_offset = samples.GetPlaneOffset(data_prefix);
+  if(!samples.IsOpen() || out_offset<0 || f_out==NULL)
+    return;
+
+  //test histogramms
+  TH1D *err_hists[4];
+  TH2D *err_inp_cor_hists[4][5];
+  TH2D *err_out_cor_hists[4][5];
+
+  AllocateErrorHists(err_hists);
+  AllocateErrorInputCorHists(err_inp_cor_hists);
+  AllocateErrorOutputCorHists(err_out_cor_hists);
+
+  const unsigned int row_size = samples.GetRowSize();
+  const double *rows;
+  for(unsigned long first=0, n=0; (n = samples.GetChunk(first, sample_chunk_rows, rows)) > 0; first += n)
+  {
+    for(unsigned long i=0; i<n; ++i)
+    {
+      double in_var[5];
+      double out_var[5];
+      const double *row = rows + i*row_size;
+      for(int j=0; j<5; ++j)
+      {
+        in_var[j] = row[j];
+        out_var[j] = row[out_offset+j];
+      }
+
+      double errors[4];
+      errors[0] = out_var[0] - x_parametrisation.Eval(in_var);
+      errors[1] = out_var[1] - theta_x_parametrisation.Eval(in_var);
+      errors[2] = out_var[2] - y_parametrisation.Eval(in_var);
+      errors[3] = out_var[3] - theta_y_parametrisation.Eval(in_var);
+
+      FillErrorHistograms(errors, err_hists);
+      FillErrorDataCorHistograms(errors, in_var, err_inp_cor_hists);
+      FillErrorDataCorHistograms(errors, out_var, err_out_cor_hists);
+    }
+  }
+
+  WriteHistograms(err_hists, err_inp_cor_hists, err_out_cor_hists, f_out, base_out_dir);
+
+  DeleteErrorHists(err_hists);
+  DeleteErrorCorHistograms(err_inp_cor_hists);
+  DeleteErrorCorHistograms(err_out_cor_hists);
+}
+
+
 void LHCOpticsApproximator::AllocateErrorHists(TH1D *err_hists[4])
 {
   std::vector<std::string> error_labels;
@@ -736,7 +909,6 @@ void LHCOpticsApproximator::TestAperture(TTree *inp_tree, TTree *out_tree)  //x,
 
   Long64_t entries = inp_tree->GetEntries();
   double entry[7];
-  double parametrization_out[5];
 
   inp_tree->SetBranchAddress("x", &(entry[0]) );
   inp_tree->SetBranchAddress("theta_x", &(entry[1]) );
@@ -754,21 +926,41 @@ void LHCOpticsApproximator::TestAperture(TTree *inp_tree, TTree *out_tree)  //x,
   out_tree->SetBranchAddress("mad_accept", &(entry[5]) );
   out_tree->SetBranchAddress("par_accept", &(entry[6]) );
 
-//  int ind=0;
-  for(Long64_t i=0; i<entries; i++)
+  // the apertures are evaluated in batches by the flattened aperture engine,
+  // the result is identical to the one of Transport(entry, out, true, false)
+  LHCApertureEngine engine(*this);
+  const Long64_t batch_size = 4096;
+  std::vector<double> batch(batch_size*7);
+  std::vector<double> batch_in(batch_size*5);
+  bool accepted[batch_size];
+
+  for(Long64_t first=0; first<entries; first+=batch_size)
   {
-    inp_tree->GetEntry(i);
+    Long64_t n = std::min(batch_size, entries-first);
+    for(Long64_t k=0; k<n; k++)
+    {
+      inp_tree->GetEntry(first+k);
+      std::copy(entry, entry+7, &batch[k*7]);
+      std::copy(entry, entry+5, &batch_in[k*5]);
+    }
+
+    engine.CheckBatch(&batch_in[0], (unsigned int) n, accepted);
+
+    for(Long64_t k=0; k<n; k++)
+    {
+      std::copy(&batch[k*7], &batch[k*7]+7, entry);
 
-    //Don't invert the coordinate systems, appertures are defined in the
-    //coordinate system of the beam - perhaps to be changed
-    bool res = Transport(entry, parametrization_out, true, false);
+      //Don't invert the coordinate systems, appertures are defined in the
+      //coordinate system of the beam - perhaps to be changed
+      bool res = trained_ && CheckInputRange(entry) && accepted[k];
 
-    if( res )
-      entry[6] = 1.0;
-    else
-      entry[6] = 0.0;
+      if( res )
+        entry[6] = 1.0;
+      else
+        entry[6] = 0.0;
 
-    out_tree->Fill();
+      out_tree->Fill();
+    }
   }
 }
 
@@ -981,6 +1173,7 @@ bool LHCOpticsApproximator::CheckInputRange(const double *in, bool invert_beam_c
 void LHCOpticsApproximator::AddRectEllipseAperture(const LHCOpticsApproximator &in, double rect_x, double rect_y, double r_el_x, double r_el_y)
 {
   apertures_.push_back(LHCApertureApproximator(in, rect_x, rect_y, r_el_x, r_el_y, LHCApertureApproximator::RECTELLIPSE));
+  aperture_engine_.reset();
 }
 
 
@@ -1003,13 +1196,14 @@ LHCApertureApproximator::LHCApertureApproximator(const LHCOpticsApproximator &in
 
 bool LHCApertureApproximator::CheckAperture(const double *in, bool invert_beam_coord_sytems) const //x, thx. y, thy, ksi
 {
-  double out[5];
-  bool result = Transport(in, out, false, invert_beam_coord_sytems);
+  // only x and y are needed, the theta polynomials are not evaluated
+  double out[2];
+  bool result = Transport2D(in, out, false, invert_beam_coord_sytems);
 
   if(ap_type_==RECTELLIPSE)
   {
-    result = result && out[0]<rect_x_ && out[0]>-rect_x_ && out[2]<rect_y_ && out[2]>-rect_y_ &&
-        ( out[0]*out[0]/(r_el_x_*r_el_x_) + out[2]*out[2]/(r_el_y_*r_el_y_) < 1 );
+    result = result && out[0]<rect_x_ && out[0]>-rect_x_ && out[1]<rect_y_ && out[1]>-rect_y_ &&
+        ( out[0]*out[0]/(r_el_x_*r_el_x_) + out[1]*out[1]/(r_el_y_*r_el_y_) < 1 );
   }
   return result;
 }
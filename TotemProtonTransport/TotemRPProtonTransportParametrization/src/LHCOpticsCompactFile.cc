@@ -0,0 +1,321 @@
+#include "TotemProtonTransport/TotemRPProtonTransportParametrization/interface/LHCOpticsCompactFile.h"
+#include "TotemProtonTransport/TotemRPProtonTransportParametrization/interface/LHCOpticsApproximator.h"
+
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+  const char compact_optics_magic[8] = {'O', 'P', 'T', 'C', 'M', 'P', 'T', 0};
+
+  struct FileHeader
+  {
+    char magic[8];
+    unsigned int version;
+    unsigned int entries;
+  };
+
+  struct IndexEntry
+  {
+    char name[LHCOpticsCompactFile::kNameLength];
+    unsigned long long offset;
+    unsigned long long size;
+  };
+
+  template <class T> void Put(std::string &buf, const T &val)
+  {
+    buf.append((const char *) &val, sizeof(T));
+  }
+
+  void PutString(std::string &buf, const std::string &val)
+  {
+    Put<unsigned int>(buf, val.size());
+    buf.append(val);
+  }
+
+  template <class T> bool Get(const char *&p, const char *end, T &val)
+  {
+    if(p + sizeof(T) > end)
+      return false;
+    memcpy(&val, p, sizeof(T));
+    p += sizeof(T);
+    return true;
+  }
+
+  bool GetString(const char *&p, const char *end, std::string &val)
+  {
+    unsigned int size;
+    if(!Get(p, end, size) || p + size > end)
+      return false;
+    val.assign(p, size);
+    p += size;
+    return true;
+  }
+}
+
+
+LHCOpticsCompactFile::LHCOpticsCompactFile() : map_(NULL), map_size_(0)
+{
+}
+
+
+LHCOpticsCompactFile::~LHCOpticsCompactFile()
+{
+  Close();
+}
+
+
+void LHCOpticsCompactFile::WritePolynomial(std::string &buf, const TMultiDimFet &pol)
+{
+  int n_var = pol.GetNVariables();
+  int n_coef = pol.GetNCoefficients();
+  std::vector<Int_t> powers = pol.GetPowers();
+  std::vector<Int_t> power_index = pol.GetPowerIndex();
+
+  Put<int>(buf, pol.GetPolyType());
+  Put<int>(buf, n_var);
+  Put<double>(buf, pol.GetMeanQuantity());
+  for(int j=0; j<n_var; j++)
+    Put<double>(buf, (*pol.GetMinVariables())(j));
+  for(int j=0; j<n_var; j++)
+    Put<double>(buf, (*pol.GetMaxVariables())(j));
+
+  Put<int>(buf, n_coef);
+  for(int i=0; i<n_coef; i++)
+    Put<double>(buf, (*pol.GetCoefficients())(i));
+  for(int i=0; i<n_coef; i++)
+    for(int j=0; j<n_var; j++)
+      Put<int>(buf, powers[power_index[i]*n_var + j]);
+}
+
+
+void LHCOpticsCompactFile::WriteApproximator(std::string &buf, const LHCOpticsApproximator &approx)
+{
+  PutString(buf, approx.GetName());
+  PutString(buf, approx.GetTitle());
+  Put<int>(buf, approx.beam);
+  Put<double>(buf, approx.nominal_beam_momentum_);
+  Put<double>(buf, approx.nominal_beam_energy_);
+  Put<double>(buf, approx.s_begin_);
+  Put<double>(buf, approx.s_end_);
+  Put<int>(buf, approx.trained_);
+
+  WritePolynomial(buf, approx.x_parametrisation);
+  WritePolynomial(buf, approx.theta_x_parametrisation);
+  WritePolynomial(buf, approx.y_parametrisation);
+  WritePolynomial(buf, approx.theta_y_parametrisation);
+
+  Put<unsigned int>(buf, approx.apertures_.size());
+  for(unsigned int i=0; i<approx.apertures_.size(); i++)
+  {
+    const LHCApertureApproximator &ap = approx.apertures_[i];
+    Put<int>(buf, ap.ap_type_);
+    Put<double>(buf, ap.rect_x_);
+    Put<double>(buf, ap.rect_y_);
+    Put<double>(buf, ap.r_el_x_);
+    Put<double>(buf, ap.r_el_y_);
+    WriteApproximator(buf, ap);
+  }
+}
+
+
+bool LHCOpticsCompactFile::Write(const std::string &file_name, const std::vector<const LHCOpticsApproximator *> &approximators)
+{
+  std::vector<std::string> blobs(approximators.size());
+  for(unsigned int i=0; i<approximators.size(); i++)
+    WriteApproximator(blobs[i], *approximators[i]);
+
+  FileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, compact_optics_magic, sizeof(compact_optics_magic));
+  header.version = kVersion;
+  header.entries = approximators.size();
+
+  std::vector<IndexEntry> index(approximators.size());
+  unsigned long long offset = sizeof(FileHeader) + approximators.size()*sizeof(IndexEntry);
+  for(unsigned int i=0; i<approximators.size(); i++)
+  {
+    memset(index[i].name, 0, kNameLength);
+    strncpy(index[i].name, approximators[i]->GetName(), kNameLength-1);
+    index[i].offset = offset;
+    index[i].size = blobs[i].size();
+    offset += blobs[i].size();
+  }
+
+  std::ofstream ofs(file_name.c_str(), std::ios::binary);
+  if(!ofs.good())
+    return false;
+
+  ofs.write((const char *) &header, sizeof(header));
+  if(!index.empty())
+    ofs.write((const char *) &index[0], index.size()*sizeof(IndexEntry));
+  for(unsigned int i=0; i<blobs.size(); i++)
+    ofs.write(blobs[i].data(), blobs[i].size());
+
+  return ofs.good();
+}
+
+
+bool LHCOpticsCompactFile::Open(const std::string &file_name)
+{
+  Close();
+
+  int fd = open(file_name.c_str(), O_RDONLY);
+  if(fd < 0)
+    return false;
+
+  struct stat st;
+  if(fstat(fd, &st) != 0 || (unsigned long) st.st_size < sizeof(FileHeader))
+  {
+    close(fd);
+    return false;
+  }
+
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(map == MAP_FAILED)
+    return false;
+
+  FileHeader header;
+  memcpy(&header, map, sizeof(header));
+  if(memcmp(header.magic, compact_optics_magic, sizeof(compact_optics_magic)) != 0 || header.version != kVersion
+      || (unsigned long) st.st_size < sizeof(FileHeader) + header.entries*sizeof(IndexEntry))
+  {
+    munmap(map, st.st_size);
+    return false;
+  }
+
+  const char *p = (const char *) map + sizeof(FileHeader);
+  for(unsigned int i=0; i<header.entries; i++, p += sizeof(IndexEntry))
+  {
+    IndexEntry e;
+    memcpy(&e, p, sizeof(e));
+    if(e.offset + e.size > (unsigned long long) st.st_size)
+    {
+      munmap(map, st.st_size);
+      names_.clear();
+      index_.clear();
+      return false;
+    }
+
+    std::string name(e.name, strnlen(e.name, kNameLength));
+    Entry &entry = index_[name];
+    entry.offset = e.offset;
+    entry.size = e.size;
+    names_.push_back(name);
+  }
+
+  map_ = map;
+  map_size_ = st.st_size;
+  return true;
+}
+
+
+void LHCOpticsCompactFile::Close()
+{
+  if(map_)
+    munmap(map_, map_size_);
+
+  map_ = NULL;
+  map_size_ = 0;
+  names_.clear();
+  index_.clear();
+}
+
+
+bool LHCOpticsCompactFile::ReadPolynomial(const char *&p, const char *end, TMultiDimFet &pol)
+{
+  int type, n_var, n_coef;
+  double mean;
+  if(!Get(p, end, type) || !Get(p, end, n_var) || !Get(p, end, mean) || n_var <= 0)
+    return false;
+
+  TVectorD min_var(n_var), max_var(n_var);
+  for(int j=0; j<n_var; j++)
+    if(!Get(p, end, min_var(j)))
+      return false;
+  for(int j=0; j<n_var; j++)
+    if(!Get(p, end, max_var(j)))
+      return false;
+
+  if(!Get(p, end, n_coef) || n_coef < 0)
+    return false;
+
+  std::vector<double> coefficients(n_coef);
+  std::vector<int> powers(n_coef*n_var);
+  for(int i=0; i<n_coef; i++)
+    if(!Get(p, end, coefficients[i]))
+      return false;
+  for(unsigned int i=0; i<powers.size(); i++)
+    if(!Get(p, end, powers[i]))
+      return false;
+
+  pol.SetParameterization((TMultiDimFet::EMDFPolyType) type, mean, min_var, max_var, n_coef,
+      (n_coef) ? &coefficients[0] : NULL, (n_coef) ? &powers[0] : NULL);
+  return true;
+}
+
+
+bool LHCOpticsCompactFile::ReadApproximator(const char *&p, const char *end, LHCOpticsApproximator &approx)
+{
+  std::string name, title;
+  int beam, trained;
+  if(!GetString(p, end, name) || !GetString(p, end, title) || !Get(p, end, beam)
+      || !Get(p, end, approx.nominal_beam_momentum_) || !Get(p, end, approx.nominal_beam_energy_)
+      || !Get(p, end, approx.s_begin_) || !Get(p, end, approx.s_end_) || !Get(p, end, trained))
+    return false;
+
+  approx.SetName(name.c_str());
+  approx.SetTitle(title.c_str());
+  approx.beam = (LHCOpticsApproximator::beam_type) beam;
+  approx.trained_ = trained;
+
+  if(!ReadPolynomial(p, end, approx.x_parametrisation) || !ReadPolynomial(p, end, approx.theta_x_parametrisation)
+      || !ReadPolynomial(p, end, approx.y_parametrisation) || !ReadPolynomial(p, end, approx.theta_y_parametrisation))
+    return false;
+
+  unsigned int apertures;
+  if(!Get(p, end, apertures))
+    return false;
+
+  approx.apertures_.clear();
+  approx.apertures_.resize(apertures);
+  for(unsigned int i=0; i<apertures; i++)
+  {
+    LHCApertureApproximator &ap = approx.apertures_[i];
+    int ap_type;
+    if(!Get(p, end, ap_type) || !Get(p, end, ap.rect_x_) || !Get(p, end, ap.rect_y_)
+        || !Get(p, end, ap.r_el_x_) || !Get(p, end, ap.r_el_y_))
+      return false;
+    ap.ap_type_ = (LHCApertureApproximator::aperture_type) ap_type;
+
+    if(!ReadApproximator(p, end, ap))
+      return false;
+  }
+  return true;
+}
+
+
+LHCOpticsApproximator* LHCOpticsCompactFile::Load(const std::string &name) const
+{
+  std::map<std::string, Entry>::const_iterator it = index_.find(name);
+  if(it == index_.end() || !map_)
+    return NULL;
+
+  const char *p = (const char *) map_ + it->second.offset;
+  const char *end = p + it->second.size;
+
+  LHCOpticsApproximator *approx = new LHCOpticsApproximator();
+  if(!ReadApproximator(p, end, *approx))
+  {
+    std::cout<<"LHCOpticsCompactFile: corrupted entry "<<name<<std::endl;
+    delete approx;
+    return NULL;
+  }
+  return approx;
+}
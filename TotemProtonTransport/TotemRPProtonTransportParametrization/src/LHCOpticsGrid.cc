@@ -0,0 +1,265 @@
+#include "TotemProtonTransport/TotemRPProtonTransportParametrization/interface/LHCOpticsGrid.h"
+#include "TotemProtonTransport/TotemRPProtonTransportParametrization/interface/LHCOpticsApproximator.h"
+
+#include <iostream>
+#include <cmath>
+#include "TRandom3.h"
+
+
+void LHCOpticsGrid::ErrorReport::Print() const
+{
+  const char *names[4] = {"x", "theta_x", "y", "theta_y"};
+  std::cout<<"LHCOpticsGrid: deviation from the polynomials, "<<samples<<" samples"<<std::endl;
+  for(int k=0; k<4; k++)
+  {
+    std::cout<<"  "<<names[k]<<": mean |d| = "<<mean_abs[k]<<", rms = "<<rms[k]
+        <<", max |d| = "<<max_abs[k]<<std::endl;
+  }
+}
+
+
+LHCOpticsGrid::LHCOpticsGrid() : built_(false), invert_(false), type_(LINEAR)
+{
+  for(int j=0; j<5; j++)
+  {
+    nodes_[j] = 1;
+    stride_[j] = 0;
+    min_[j] = max_[j] = 0;
+    step_[j] = 1;
+  }
+}
+
+
+bool LHCOpticsGrid::Build(const LHCOpticsApproximator &approx, const unsigned int nodes[5], interpolation_type type)
+{
+  built_ = false;
+  values_.clear();
+  if(!approx.trained_)
+  {
+    std::cout<<"LHCOpticsGrid: approximator "<<approx.GetName()<<" not trained"<<std::endl;
+    return false;
+  }
+
+  type_ = type;
+  invert_ = (approx.beam == LHCOpticsApproximator::lhcb2);
+
+  unsigned long total = 1;
+  for(int j=0; j<5; j++)
+  {
+    min_[j] = (*approx.x_parametrisation.GetMinVariables())(j);
+    max_[j] = (*approx.x_parametrisation.GetMaxVariables())(j);
+    nodes_[j] = (nodes[j] < 2 || max_[j] <= min_[j]) ? 1 : nodes[j];
+    step_[j] = (nodes_[j] > 1) ? (max_[j] - min_[j]) / (nodes_[j] - 1) : 1;
+    stride_[j] = total;
+    total *= nodes_[j];
+  }
+
+  // the polynomials are tabulated in their own coordinate system
+  values_.resize(total*4);
+  double in[5], out[5];
+  for(unsigned long n=0; n<total; n++)
+  {
+    for(int j=0; j<5; j++)
+    {
+      unsigned int i = (n / stride_[j]) % nodes_[j];
+      in[j] = (i == nodes_[j] - 1 && nodes_[j] > 1) ? max_[j] : min_[j] + i*step_[j];
+    }
+
+    approx.Transport(in, out, false, false);
+    for(int k=0; k<4; k++)
+      values_[n*4 + k] = out[k];
+  }
+
+  built_ = true;
+  return true;
+}
+
+
+void LHCOpticsGrid::CorrectInput(const double *in, double *in_corrected, bool invert_beam_coord_sytems) const
+{
+  bool invert = invert_ && invert_beam_coord_sytems;
+  in_corrected[0] = invert ? -in[0] : in[0];
+  in_corrected[1] = invert ? -in[1] : in[1];
+  in_corrected[2] = in[2];
+  in_corrected[3] = in[3];
+  in_corrected[4] = in[4];
+}
+
+
+bool LHCOpticsGrid::CheckInputRange(const double *in, bool invert_beam_coord_sytems) const
+{
+  double in_corrected[5];
+  CorrectInput(in, in_corrected, invert_beam_coord_sytems);
+
+  bool res = true;
+  for(int j=0; j<5; j++)
+    res = res && in_corrected[j]>=min_[j] && in_corrected[j]<=max_[j];
+  return res;
+}
+
+
+void LHCOpticsGrid::Interpolate(const double *in, double *out) const
+{
+  // per dimension: offsets and weights of the contributing nodes
+  unsigned long offset[5][4];
+  double weight[5][4];
+  unsigned int count[5];
+
+  for(int j=0; j<5; j++)
+  {
+    const int n = nodes_[j];
+    if(n == 1)
+    {
+      count[j] = 1;
+      offset[j][0] = 0;
+      weight[j][0] = 1;
+      continue;
+    }
+
+    double u = (in[j] - min_[j]) / step_[j];
+    int i = (int) std::floor(u);
+    if(i < 0)
+      i = 0;
+    if(i > n-2)
+      i = n-2;
+    double t = u - i;
+    if(t < 0)
+      t = 0;
+    if(t > 1)
+      t = 1;
+
+    if(type_ == LINEAR)
+    {
+      count[j] = 2;
+      offset[j][0] = i*stride_[j];
+      offset[j][1] = (i+1)*stride_[j];
+      weight[j][0] = 1 - t;
+      weight[j][1] = t;
+    }
+    else
+    {
+      // Catmull-Rom spline, the missing nodes beyond the borders are extrapolated linearly
+      // (p_-1 = 2 p_0 - p_1), so that the spline stays exact for linear dependences up to the borders
+      double t2 = t*t, t3 = t2*t;
+      count[j] = 4;
+      weight[j][0] = 0.5*(-t + 2*t2 - t3);
+      weight[j][1] = 0.5*(2 - 5*t2 + 3*t3);
+      weight[j][2] = 0.5*(t + 4*t2 - 3*t3);
+      weight[j][3] = 0.5*(-t2 + t3);
+      if(i == 0)
+      {
+        weight[j][1] += 2*weight[j][0];
+        weight[j][2] -= weight[j][0];
+        weight[j][0] = 0;
+      }
+      if(i == n-2)
+      {
+        weight[j][2] += 2*weight[j][3];
+        weight[j][1] -= weight[j][3];
+        weight[j][3] = 0;
+      }
+      for(int m=0; m<4; m++)
+      {
+        int k = i - 1 + m;
+        if(k < 0)
+          k = 0;
+        if(k > n-1)
+          k = n-1;
+        offset[j][m] = k*stride_[j];
+      }
+    }
+  }
+
+  double acc[4] = {0, 0, 0, 0};
+  for(unsigned int a=0; a<count[0]; a++)
+  for(unsigned int b=0; b<count[1]; b++)
+  for(unsigned int c=0; c<count[2]; c++)
+  for(unsigned int d=0; d<count[3]; d++)
+  {
+    const unsigned long base = offset[0][a] + offset[1][b] + offset[2][c] + offset[3][d];
+    const double w = weight[0][a]*weight[1][b]*weight[2][c]*weight[3][d];
+    for(unsigned int e=0; e<count[4]; e++)
+    {
+      const double *v = &values_[(base + offset[4][e])*4];
+      const double we = w*weight[4][e];
+      acc[0] += we*v[0];
+      acc[1] += we*v[1];
+      acc[2] += we*v[2];
+      acc[3] += we*v[3];
+    }
+  }
+
+  for(int k=0; k<4; k++)
+    out[k] = acc[k];
+}
+
+
+bool LHCOpticsGrid::Transport(const double *in, double *out, bool invert_beam_coord_sytems) const
+{
+  if(in==NULL || out==NULL || !built_)
+    return false;
+
+  double in_corrected[5];
+  CorrectInput(in, in_corrected, invert_beam_coord_sytems);
+  bool res = CheckInputRange(in);
+
+  Interpolate(in_corrected, out);
+  if(invert_ && invert_beam_coord_sytems)
+  {
+    out[0] = -out[0];
+    out[1] = -out[1];
+  }
+  out[4] = in[4];
+  return res;
+}
+
+
+bool LHCOpticsGrid::Transport2D(const double *in, double *out, bool invert_beam_coord_sytems) const
+{
+  double out_full[5];
+  bool res = Transport(in, out_full, invert_beam_coord_sytems);
+  out[0] = out_full[0];
+  out[1] = out_full[2];
+  return res;
+}
+
+
+LHCOpticsGrid::ErrorReport LHCOpticsGrid::TestAccuracy(const LHCOpticsApproximator &approx, unsigned int samples, unsigned int seed) const
+{
+  ErrorReport report;
+  report.samples = 0;
+  for(int k=0; k<4; k++)
+    report.mean_abs[k] = report.rms[k] = report.max_abs[k] = 0;
+
+  if(!built_)
+    return report;
+
+  TRandom3 r(seed);
+  double in[5], ref[5], out[4];
+  for(unsigned int s=0; s<samples; s++)
+  {
+    for(int j=0; j<5; j++)
+      in[j] = r.Uniform(min_[j], max_[j]);
+
+    // both in the coordinate system of the polynomials
+    approx.Transport(in, ref, false, false);
+    Interpolate(in, out);
+
+    for(int k=0; k<4; k++)
+    {
+      double d = std::fabs(out[k] - ref[k]);
+      report.mean_abs[k] += d;
+      report.rms[k] += d*d;
+      if(d > report.max_abs[k])
+        report.max_abs[k] = d;
+    }
+  }
+
+  report.samples = samples;
+  for(int k=0; k<4 && samples>0; k++)
+  {
+    report.mean_abs[k] /= samples;
+    report.rms[k] = std::sqrt(report.rms[k] / samples);
+  }
+  return report;
+}
@@ -1,11 +1,30 @@
 #include "TotemProtonTransport/TotemRPProtonTransportParametrization/interface/MADParamGenerator.h"
 #include "TTimeStamp.h"
-#include "TRandom.h"
+#include "TRandom3.h"
 #include "TNtupleD.h"
+#include <thread>
+#include <sstream>
+#include <cstdlib>
 
 #include "TotemProtonTransport/TotemRPProtonTransportParametrization/interface/FitData.h"
 
-void MADParamGenerator::GenerateMADConfFile(const std::string &base_conf_file, const std::string &out_conf_file, const std::string &from_marker_name, double from_marker_s_pos, bool define_from, const std::string &to_marker_name, double to_marker_s_pos, bool define_to, int particles_number, bool aperture_limit, std::vector<std::string> scoring_planes, const std::string &beam)
+
+MADParamGenerator::MADParamGenerator() : tracker_(&mad_tracker_)
+{
+}
+
+
+void MADXSampleTracker::Track(const std::string &conf_file, const std::string &file_prefix)
+{
+  std::string cmd;
+  cmd = "rm -f ./" + file_prefix + "trackloss";
+  system(cmd.c_str());
+  cmd = std::string("madx < ") + conf_file + " >/dev/null";
+  system(cmd.c_str());
+}
+
+
+void MADParamGenerator::GenerateMADConfFile(const std::string &base_conf_file, const std::string &out_conf_file, const std::string &from_marker_name, double from_marker_s_pos, bool define_from, const std::string &to_marker_name, double to_marker_s_pos, bool define_to, int particles_number, bool aperture_limit, std::vector<std::string> scoring_planes, const std::string &beam, const std::string &file_prefix)
 {
   std::fstream input;
   input.open(base_conf_file.c_str(), std::ios::in);
@@ -14,14 +33,14 @@ void MADParamGenerator::GenerateMADConfFile(const std::string &base_conf_file, c
   output.open(out_conf_file.c_str(), std::ios::out);
 
   Conf_file_processing(input, output, from_marker_name, from_marker_s_pos, define_from, to_marker_name, to_marker_s_pos,
-      define_to, particles_number, aperture_limit, scoring_planes, beam);
+      define_to, particles_number, aperture_limit, scoring_planes, beam, file_prefix);
   input.close();
 }
 
 
 void MADParamGenerator::Conf_file_processing(std::fstream &base_conf_file, std::fstream & conf_file, const std::string &from_marker_name,
     double from_marker_s_pos, bool define_from, const std::string &to_marker_name, double to_marker_s_pos, bool define_to, int particles_number,
-    bool aperture_limit, const std::vector<std::string> &scoring_planes, const std::string &beam)
+    bool aperture_limit, const std::vector<std::string> &scoring_planes, const std::string &beam, const std::string &file_prefix)
 {
   while(base_conf_file.good() && !base_conf_file.eof())
   {
@@ -32,7 +51,7 @@ void MADParamGenerator::Conf_file_processing(std::fstream &base_conf_file, std::
     {
       std::string token = GetToken(base_conf_file);
       ProcessToken(conf_file, from_marker_name, from_marker_s_pos, define_from, to_marker_name, to_marker_s_pos, define_to,
-          particles_number, aperture_limit, token, scoring_planes, beam);
+          particles_number, aperture_limit, token, scoring_planes, beam, file_prefix);
     }
     else
     {
@@ -58,7 +77,7 @@ std::string MADParamGenerator::GetToken(std::fstream &base_conf_file)
 
 void MADParamGenerator::ProcessToken(std::fstream &conf_file, const std::string &from_marker_name, double from_marker_s_pos, bool define_from,
     const std::string & to_marker_name, double to_marker_s_pos, bool define_to, int particles_number, bool aperture_limit,
-    const std::string &token, const std::vector<std::string> &scoring_planes, const std::string &beam)
+    const std::string &token, const std::vector<std::string> &scoring_planes, const std::string &beam, const std::string &file_prefix)
 {
   if(token == "header_placement")
   {
@@ -111,7 +130,7 @@ void MADParamGenerator::ProcessToken(std::fstream &conf_file, const std::string
   }
   else if(token == "import_particles")
   {
-    conf_file << "readmytable,file=part.in,table=myevent;" << std::endl;
+    conf_file << "readmytable,file=" << file_prefix << "part.in,table=myevent;" << std::endl;
   }
   else if(token == "insert_particles")
   {
@@ -125,7 +144,7 @@ void MADParamGenerator::ProcessToken(std::fstream &conf_file, const std::string
   }
   else if(token == "output_mad_file")
   {
-    conf_file << "track";
+    conf_file << file_prefix << "track";
   }
   else if(token == "options")
   {
@@ -137,7 +156,7 @@ void MADParamGenerator::ProcessToken(std::fstream &conf_file, const std::string
   else if(token == "save_lost_particles")
   {
     if(aperture_limit)
-      conf_file << "write,table=trackloss,file=\"trackloss\"" << std::endl;
+      conf_file << "write,table=trackloss,file=\"" << file_prefix << "trackloss\"" << std::endl;
   }
   else if(token == "beam_type")
   {
@@ -158,7 +177,7 @@ void MADParamGenerator::ProcessToken(std::fstream &conf_file, const std::string
 }
 
 
-void MADParamGenerator::GenerateRandomSamples(int number_of_particles, double x_min, double x_max, double theta_x_min, double theta_x_max, double y_min, double y_max, double theta_y_min, double theta_y_max, double ksi_min, double ksi_max, const std::string &out_file_name)
+void MADParamGenerator::GenerateRandomSamples(int number_of_particles, double x_min, double x_max, double theta_x_min, double theta_x_max, double y_min, double y_max, double theta_y_min, double theta_y_max, double ksi_min, double ksi_max, const std::string &out_file_name, unsigned int seed)
 {
   std::ofstream ofs(out_file_name.c_str());
 
@@ -166,7 +185,7 @@ void MADParamGenerator::GenerateRandomSamples(int number_of_particles, double x_
 
   TTimeStamp time;
 
-  TRandom r( time.GetSec() + time.GetNanoSec() );
+  TRandom3 r( (seed != 0) ? seed : time.GetSec() + time.GetNanoSec() );
 
   Int_t i;
 
@@ -196,6 +215,13 @@ void MADParamGenerator::GenerateRandomSamples(int number_of_particles, double x_
 }
 
 
+unsigned int MADParamGenerator::DrawSeed(TRandom3 &seeder)
+{
+  //TRandom3 treats seed 0 as a request for a time-based seed
+  return 1 + seeder.Integer(4294967294u);
+}
+
+
 void MADParamGenerator::RunMAD(const std::string &conf_file)
 {
   std::string cmd;
@@ -206,12 +232,12 @@ void MADParamGenerator::RunMAD(const std::string &conf_file)
 }
 
 
-int MADParamGenerator::AppendRootTree(std::string root_file_name, std::string out_prefix, std::string out_station, bool recloss, std::string lost_particles_tree_filename, const std::vector<std::string> &scoring_planes, bool compare_apert)
+int MADParamGenerator::AppendRootTree(std::string root_file_name, std::string out_prefix, std::string out_station, bool recloss, std::string lost_particles_tree_filename, const std::vector<std::string> &scoring_planes, bool compare_apert, std::string binary_file_name, std::string file_prefix)
 {
   FitData text2rootconverter;
-  text2rootconverter.readIn("part.in");
-  text2rootconverter.readOut("trackone", out_station.c_str());
-  text2rootconverter.readAdditionalScoringPlanes("trackone", scoring_planes);
+  text2rootconverter.readIn(file_prefix + "part.in");
+  text2rootconverter.readOut(file_prefix + "trackone", out_station.c_str());
+  text2rootconverter.readAdditionalScoringPlanes(file_prefix + "trackone", scoring_planes);
 
   int added_entries=0;
 
@@ -242,6 +268,18 @@ int MADParamGenerator::AppendRootTree(std::string root_file_name, std::string ou
     }
 
     f->Close();
+
+    if(binary_file_name != "")
+    {
+      std::vector<std::string> planes;
+      planes.push_back(out_prefix);
+      planes.insert(planes.end(), scoring_planes.begin(), scoring_planes.end());
+
+      TransportSampleWriter writer;
+      if(writer.Open(binary_file_name, planes))
+        text2rootconverter.AppendBinarySampleFile(writer);
+      writer.Close();
+    }
   }
 
   if(recloss && !compare_apert)
@@ -253,7 +291,7 @@ int MADParamGenerator::AppendRootTree(std::string root_file_name, std::string ou
        lost_particles_tree = CreateLostParticlesTree(lost_particles_file);
        lost_particles_tree->Print();
     }
-    text2rootconverter.readLost("trackloss");
+    text2rootconverter.readLost(file_prefix + "trackloss");
     added_entries = text2rootconverter.AppendLostParticlesRootFile(lost_particles_tree);
     lost_particles_tree->Write(NULL, TObject::kOverwrite);
     lost_particles_file->Close();
@@ -438,12 +476,33 @@ int MADParamGenerator::BuildSample(const Parametisation_configuration &conf, std
   if(compare_apert)
     DeleteApertureTestFiles(conf);
 
+  std::string binary_file_name = GetBinarySampleFileName(conf, sample_file_name);
+  if(binary_file_name != "")
+  {
+    std::string cmd = "rm -f ./" + binary_file_name;
+    system(cmd.c_str());
+  }
+
   MADParamGenerator mad_conf_gen;
 
+  TTimeStamp time;
+  unsigned int base_seed = (conf.random_seed != 0) ? conf.random_seed : time.GetSec() + time.GetNanoSec();
+
   std::vector<std::string> aperture_markers;
   for(unsigned int i=0; i<conf.inter_planes.size(); i++)
     aperture_markers.push_back(conf.inter_planes[i].to_marker_name);
 
+  if(conf.parallel_jobs > 1)
+  {
+    int total_generated_particles = BuildSampleSharded(conf, sample_file_name, recloss, compare_apert, aperture_markers, binary_file_name,
+        base_seed);
+    if(!recloss)
+    {
+      PrintTreeInfo(conf, sample_file_name);
+    }
+    return total_generated_particles;
+  }
+
   mad_conf_gen.GenerateMADConfFile(conf.base_mad_conf_file, conf.processed_mad_conf_file, conf.from_marker_name,
         conf.from_marker_s_pos, conf.define_from, conf.to_marker_name, conf.to_marker_s_pos,
         conf.define_to, conf.number_of_part_per_sample, (conf.aperture_limit||recloss||compare_apert), aperture_markers, conf.beam);
@@ -451,17 +510,19 @@ int MADParamGenerator::BuildSample(const Parametisation_configuration &conf, std
   int current_iteration_particles = 0;
 
   std::cout << std::endl << "Generating random samples, from " << conf.from_marker_name << " to " << conf.to_marker_name << ", file " <<
-  sample_file_name << std::endl;
+  sample_file_name << ", base seed " << base_seed << std::endl;
   std::cout << "Number of inter-planes: " << conf.inter_planes.size() << std::endl;
 
+  TRandom3 seeder(base_seed);
   do
   {
     mad_conf_gen.GenerateRandomSamples(conf.number_of_part_per_sample, conf.x_min, conf.x_max, conf.theta_x_min,
       conf.theta_x_max, conf.y_min, conf.y_max, conf.theta_y_min,
-      conf.theta_y_max, conf.ksi_min, conf.ksi_max, "part.in");
-    mad_conf_gen.RunMAD(conf.processed_mad_conf_file);
+      conf.theta_y_max, conf.ksi_min, conf.ksi_max, "part.in", DrawSeed(seeder));
+    tracker_->Track(conf.processed_mad_conf_file, "");
     current_iteration_particles = mad_conf_gen.AppendRootTree(sample_file_name, conf.destination_branch_prefix,
-        conf.to_marker_name, recloss&&!compare_apert, conf.lost_particles_tree_filename, aperture_markers, compare_apert);
+        conf.to_marker_name, recloss&&!compare_apert, conf.lost_particles_tree_filename, aperture_markers, compare_apert,
+        binary_file_name);
 
     if(!recloss || compare_apert)
     {
@@ -487,6 +548,80 @@ int MADParamGenerator::BuildSample(const Parametisation_configuration &conf, std
 }
 
 
+int MADParamGenerator::BuildSampleSharded(const Parametisation_configuration &conf, std::string sample_file_name, bool recloss,
+    bool compare_apert, const std::vector<std::string> &aperture_markers, const std::string &binary_file_name, unsigned int base_seed)
+{
+  bool aperture_limit = (conf.aperture_limit||recloss||compare_apert);
+
+  std::cout << std::endl << "Generating random samples in " << conf.parallel_jobs << " parallel shards, from " << conf.from_marker_name
+    << " to " << conf.to_marker_name << ", file " << sample_file_name << ", base seed " << base_seed << std::endl;
+  std::cout << "Number of inter-planes: " << conf.inter_planes.size() << std::endl;
+
+  int total_generated_particles = 0;
+  int current_iteration_particles = 0;
+  unsigned int shard = 0;
+  TRandom3 seeder(base_seed);
+
+  do
+  {
+    //each shard works with its own files in the current directory, file names derive from the shard number,
+    //seeds are drawn from the base seed in the shard order
+    std::vector<std::string> file_prefixes(conf.parallel_jobs);
+    std::vector<std::string> conf_files(conf.parallel_jobs);
+    for(int j=0; j<conf.parallel_jobs; j++)
+    {
+      std::ostringstream tag;
+      tag << "shard" << shard + j;
+      file_prefixes[j] = tag.str() + "_";
+      conf_files[j] = conf.processed_mad_conf_file + "." + tag.str();
+
+      GenerateMADConfFile(conf.base_mad_conf_file, conf_files[j], conf.from_marker_name,
+          conf.from_marker_s_pos, conf.define_from, conf.to_marker_name, conf.to_marker_s_pos,
+          conf.define_to, conf.number_of_part_per_sample, aperture_limit, aperture_markers, conf.beam, file_prefixes[j]);
+      GenerateRandomSamples(conf.number_of_part_per_sample, conf.x_min, conf.x_max, conf.theta_x_min,
+          conf.theta_x_max, conf.y_min, conf.y_max, conf.theta_y_min,
+          conf.theta_y_max, conf.ksi_min, conf.ksi_max, file_prefixes[j] + "part.in", DrawSeed(seeder));
+    }
+
+    std::vector<std::thread> workers;
+    for(int j=0; j<conf.parallel_jobs; j++)
+      workers.push_back(std::thread(&SampleTracker::Track, tracker_, conf_files[j], file_prefixes[j]));
+    for(unsigned int j=0; j<workers.size(); j++)
+      workers[j].join();
+
+    //merge in the shard order, independent of the completion order
+    current_iteration_particles = 0;
+    for(int j=0; j<conf.parallel_jobs; j++)
+    {
+      current_iteration_particles += AppendRootTree(sample_file_name, conf.destination_branch_prefix,
+          conf.to_marker_name, recloss&&!compare_apert, conf.lost_particles_tree_filename, aperture_markers, compare_apert,
+          binary_file_name, file_prefixes[j]);
+
+      std::string cmd = "rm -f ./" + file_prefixes[j] + "part.in ./" + file_prefixes[j] + "trackone ./"
+        + file_prefixes[j] + "trackloss ./" + conf_files[j];
+      system(cmd.c_str());
+    }
+    shard += conf.parallel_jobs;
+
+    if(!recloss || compare_apert)
+    {
+      total_generated_particles = GetNumberOfEntries(sample_file_name, conf.destination_branch_prefix);
+      std::cout << "Total number of particles arrived at " << conf.to_marker_name << " " << total_generated_particles << " of "
+        << conf.tot_entries_number << std::endl;
+    }
+    else
+    {
+      total_generated_particles = GetLostParticlesEntries(conf);
+      std::cout << "Total number of particles lost before " << conf.to_marker_name << " " << total_generated_particles << " of "
+        << conf.tot_entries_number << std::endl;
+    }
+  }
+  while(total_generated_particles < conf.tot_entries_number && current_iteration_particles>5 );
+
+  return total_generated_particles;
+}
+
+
 void MADParamGenerator::PrintTreeInfo(const Parametisation_configuration &conf, std::string sample_file_name)
 {
   TFile *f = TFile::Open(sample_file_name.c_str(), "read");
@@ -516,6 +651,16 @@ TTree *MADParamGenerator::GetSamplesTree(const Parametisation_configuration &con
 }
 
 
+std::string MADParamGenerator::GetBinarySampleFileName(const Parametisation_configuration &conf, const std::string &sample_file_name)
+{
+  if(sample_file_name == conf.samples_train_root_file_name)
+    return conf.samples_train_binary_file_name;
+  if(sample_file_name == conf.samples_test_root_file_name)
+    return conf.samples_test_binary_file_name;
+  return std::string();
+}
+
+
 TTree *MADParamGenerator::GetAccelAcceptTree(TFile *f)
 {
   if(!f || !f->IsOpen())
@@ -627,6 +772,12 @@ Parametisation_configuration MADParamGenerator::GetParamConfiguration(int id)
   conf.samples_test_root_file_name = xml_parser.get<std::string>(id, "samples_test_root_file_name");
   conf.samples_aperture_test_file_name = xml_parser.get<std::string>(id, "samples_aperture_test_file_name");
   conf.destination_branch_prefix = xml_parser.get<std::string>(id, "destination_branch_prefix");
+  conf.samples_train_binary_file_name = GetOptionalParameter(id, "samples_train_binary_file_name");
+  conf.samples_test_binary_file_name = GetOptionalParameter(id, "samples_test_binary_file_name");
+  std::string parallel_jobs = GetOptionalParameter(id, "parallel_jobs");
+  conf.parallel_jobs = (parallel_jobs != "") ? atoi(parallel_jobs.c_str()) : 1;
+  std::string random_seed = GetOptionalParameter(id, "random_seed");
+  conf.random_seed = (random_seed != "") ? strtoul(random_seed.c_str(), NULL, 10) : 0;
 
   std::string pol_type = xml_parser.get<std::string>(id, "polynomials_type");
   if(pol_type == "kMonomials")
@@ -673,6 +824,15 @@ Parametisation_configuration MADParamGenerator::GetParamConfiguration(int id)
 }
 
 
+std::string MADParamGenerator::GetOptionalParameter(int id, const char *name)
+{
+  const char *val = xml_parser.get(id, name);
+  if(val == NULL)
+    return std::string();
+  return std::string(val);
+}
+
+
 Parametisation_aperture_configuration MADParamGenerator::GetApertureConfiguration(int param_id, int apreture_id)
 {
   Parametisation_aperture_configuration conf;
@@ -738,10 +898,23 @@ void MADParamGenerator::MakeParametrization(int id, bool generate_samples)
   prec[2] = conf.precision_y;
   prec[3] = conf.precision_ty;
 
-  approximator.Train(this->GetSamplesTree(conf, conf.samples_train_root_file_name), conf.destination_branch_prefix, conf.terms_selelection_mode, conf.max_degree_x, conf.max_degree_tx, conf.max_degree_y, conf.max_degree_ty, conf.common_terms, prec);
+  //binary sample caches are preferred, if available
+  TransportSampleReader train_samples, test_samples;
+  if(conf.samples_train_binary_file_name != "")
+    train_samples.Open(conf.samples_train_binary_file_name);
+  if(conf.samples_test_binary_file_name != "")
+    test_samples.Open(conf.samples_test_binary_file_name);
+
+  if(train_samples.IsOpen())
+    approximator.Train(train_samples, conf.destination_branch_prefix, conf.terms_selelection_mode, conf.max_degree_x, conf.max_degree_tx, conf.max_degree_y, conf.max_degree_ty, conf.common_terms, prec);
+  else
+    approximator.Train(this->GetSamplesTree(conf, conf.samples_train_root_file_name), conf.destination_branch_prefix, conf.terms_selelection_mode, conf.max_degree_x, conf.max_degree_tx, conf.max_degree_y, conf.max_degree_ty, conf.common_terms, prec);
 
   TFile *f = new TFile(conf.approximation_error_histogram_file.c_str(), "update");
-  approximator.Test(this->GetSamplesTree(conf, conf.samples_test_root_file_name), f, conf.destination_branch_prefix, "");
+  if(test_samples.IsOpen())
+    approximator.Test(test_samples, f, conf.destination_branch_prefix, "");
+  else
+    approximator.Test(this->GetSamplesTree(conf, conf.samples_test_root_file_name), f, conf.destination_branch_prefix, "");
 
   TrainAndAddApertures(conf, approximator, f);
 
@@ -766,6 +939,12 @@ void MADParamGenerator::MakeParametrization(int id, bool generate_samples)
 
 void MADParamGenerator::TrainAndAddApertures(const Parametisation_configuration &conf, LHCOpticsApproximator &approximator, TFile *f_out)
 {
+  TransportSampleReader train_samples, test_samples;
+  if(conf.samples_train_binary_file_name != "")
+    train_samples.Open(conf.samples_train_binary_file_name);
+  if(conf.samples_test_binary_file_name != "")
+    test_samples.Open(conf.samples_test_binary_file_name);
+
   for(unsigned int i=0; i<conf.inter_planes.size(); i++)
   {
     std::string name = conf.from_marker_name + "_to_" + conf.inter_planes[i].to_marker_name;
@@ -777,12 +956,21 @@ void MADParamGenerator::TrainAndAddApertures(const Parametisation_configuration
     prec[2] = conf.precision_y;
     prec[3] = conf.precision_ty;
 
-    aper_approx.Train(this->GetSamplesTree(conf, conf.samples_train_root_file_name),
-        conf.inter_planes[i].to_marker_name, conf.terms_selelection_mode, conf.max_degree_x,
-        conf.max_degree_tx, conf.max_degree_y, conf.max_degree_ty, conf.common_terms, prec);
+    if(train_samples.IsOpen())
+      aper_approx.Train(train_samples,
+          conf.inter_planes[i].to_marker_name, conf.terms_selelection_mode, conf.max_degree_x,
+          conf.max_degree_tx, conf.max_degree_y, conf.max_degree_ty, conf.common_terms, prec);
+    else
+      aper_approx.Train(this->GetSamplesTree(conf, conf.samples_train_root_file_name),
+          conf.inter_planes[i].to_marker_name, conf.terms_selelection_mode, conf.max_degree_x,
+          conf.max_degree_tx, conf.max_degree_y, conf.max_degree_ty, conf.common_terms, prec);
 
-    aper_approx.Test(this->GetSamplesTree(conf, conf.samples_test_root_file_name), f_out,
-        conf.inter_planes[i].to_marker_name, conf.optics_parametrisation_name);
+    if(test_samples.IsOpen())
+      aper_approx.Test(test_samples, f_out,
+          conf.inter_planes[i].to_marker_name, conf.optics_parametrisation_name);
+    else
+      aper_approx.Test(this->GetSamplesTree(conf, conf.samples_test_root_file_name), f_out,
+          conf.inter_planes[i].to_marker_name, conf.optics_parametrisation_name);
 
     approximator.AddRectEllipseAperture(aper_approx, conf.inter_planes[i].rect_rx,
         conf.inter_planes[i].rect_ry, conf.inter_planes[i].el_rx, conf.inter_planes[i].el_ry);
@@ -850,6 +1038,10 @@ std::ostream & operator<<(std::ostream &s, const Parametisation_configuration &c
   s << "samples_train_root_file_name " << c.samples_train_root_file_name << std::endl;
   s << "samples_test_root_file_name " << c.samples_test_root_file_name << std::endl;
   s << "destination_branch_prefix " << c.destination_branch_prefix << std::endl;
+  s << "samples_train_binary_file_name " << c.samples_train_binary_file_name << std::endl;
+  s << "samples_test_binary_file_name " << c.samples_test_binary_file_name << std::endl;
+  s << "parallel_jobs " << c.parallel_jobs << std::endl;
+  s << "random_seed " << c.random_seed << std::endl;
 
   s << "polynomials_type " << c.polynomials_type << std::endl;
   s << "terms_selelection_mode " << c.terms_selelection_mode << std::endl;
@@ -2093,6 +2093,125 @@ void TMultiDimFet::SetPowers(const Int_t* powers, Int_t terms)
          fPowers[i * fNVariables + j] = powers[i * fNVariables + j]  + 1;
 }
 
+//____________________________________________________________________
+Double_t TMultiDimFet::EvalGradient(const Double_t *x, Double_t *gradient) const
+{
+   // Evaluate parameterization and its gradient with respect to the
+   // variables at point x. gradient has to be fNVariables elements long.
+   const Int_t maxVariables = 16;
+   if (fNVariables > maxVariables) {
+      Error("EvalGradient", "at most %d variables supported", maxVariables);
+      return 0;
+   }
+
+   Double_t y[maxVariables], dydx[maxVariables];
+   Double_t factor[maxVariables], derivative[maxVariables];
+   Int_t    i, j, k;
+
+   for (j = 0; j < fNVariables; j++) {
+      dydx[j] = 2. / (fMaxVariables(j) - fMinVariables(j));
+      y[j] = 1 + dydx[j] * (x[j] - fMaxVariables(j));
+      gradient[j] = 0;
+   }
+
+   Double_t returnValue = fMeanQuantity;
+   for (i = 0; i < fNCoefficients; i++) {
+      Double_t term = fCoefficients(i);
+      for (j = 0; j < fNVariables; j++) {
+         Int_t p = fPowers[fPowerIndex[i] * fNVariables + j];
+         EvalFactorDerivative(p, y[j], factor[j], derivative[j]);
+         term *= factor[j];
+      }
+      returnValue += term;
+
+      for (j = 0; j < fNVariables; j++) {
+         if (derivative[j] == 0)
+            continue;
+         Double_t dterm = fCoefficients(i) * derivative[j] * dydx[j];
+         for (k = 0; k < fNVariables; k++)
+            if (k != j)
+               dterm *= factor[k];
+         gradient[j] += dterm;
+      }
+   }
+   return returnValue;
+}
+
+
+//____________________________________________________________________
+void TMultiDimFet::EvalFactorDerivative(Int_t p, Double_t x, Double_t &factor, Double_t &derivative) const
+{
+   // PRIVATE METHOD:
+   // Evaluate function with power p at variable value x, together with its
+   // derivative; same recurrences as in EvalFactor
+   if (p == 1) {
+      factor = 1;
+      derivative = 0;
+      return;
+   }
+   if (p == 2) {
+      factor = x;
+      derivative = 1;
+      return;
+   }
+
+   Double_t p1 = 1, p2 = x, p3 = 0;
+   Double_t d1 = 0, d2 = 1, d3 = 0;
+   for (Int_t i = 3; i <= p; i++) {
+      p3 = p2 * x;
+      d3 = d2 * x + p2;
+      if (fPolyType == kLegendre) {
+         p3 = ((2 * i - 3) * p2 * x - (i - 2) * p1) / (i - 1);
+         d3 = ((2 * i - 3) * (d2 * x + p2) - (i - 2) * d1) / (i - 1);
+      }
+      else if (fPolyType == kChebyshev) {
+         p3 = 2 * x * p2 - p1;
+         d3 = 2 * p2 + 2 * x * d2 - d1;
+      }
+      p1 = p2;
+      p2 = p3;
+      d1 = d2;
+      d2 = d3;
+   }
+   factor = p3;
+   derivative = d3;
+}
+
+
+//____________________________________________________________________
+void TMultiDimFet::SetParameterization(EMDFPolyType type, Double_t meanQuantity,
+                                       const TVectorD &minVariables, const TVectorD &maxVariables,
+                                       Int_t nCoefficients, const Double_t *coefficients, const Int_t *powers)
+{
+   // Set the final parameterisation directly, without any training
+   // sample. Only the members used by Eval are set.
+   fPolyType      = type;
+   fMeanQuantity  = meanQuantity;
+   fNVariables    = minVariables.GetNrows();
+
+   fMinVariables.ResizeTo(fNVariables);
+   fMinVariables  = minVariables;
+   fMaxVariables.ResizeTo(fNVariables);
+   fMaxVariables  = maxVariables;
+
+   fNCoefficients = nCoefficients;
+   fMaxFunctions  = nCoefficients;
+   fMaxTerms      = nCoefficients;
+   fMaxFunctionsTimesNVariables = fMaxFunctions * fNVariables;
+
+   fCoefficients.ResizeTo(fNCoefficients);
+   fPowers.resize(fNCoefficients * fNVariables);
+   fPowerIndex.resize(fNCoefficients);
+
+   Int_t i, j;
+   for (i = 0; i < fNCoefficients; i++) {
+      fCoefficients(i) = coefficients[i];
+      fPowerIndex[i] = i;
+      for (j = 0; j < fNVariables; j++)
+         fPowers[i * fNVariables + j] = powers[i * fNVariables + j];
+   }
+}
+
 //____________________________________________________________________
 void TMultiDimFet::SetPowerLimit(Double_t limit)
 {
@@ -0,0 +1,209 @@
+#include "TotemProtonTransport/TotemRPProtonTransportParametrization/interface/TransportSampleFile.h"
+
+#include <iostream>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+  const char sample_file_magic[8] = {'T', 'R', 'S', 'M', 'P', 'L', 0, 0};
+}
+
+
+bool TransportSampleFile::CheckHeader(const Header &h)
+{
+  return memcmp(h.magic, sample_file_magic, sizeof(sample_file_magic)) == 0 && h.version == kVersion;
+}
+
+
+TransportSampleWriter::TransportSampleWriter() : file_(NULL)
+{
+}
+
+
+TransportSampleWriter::~TransportSampleWriter()
+{
+  Close();
+}
+
+
+bool TransportSampleWriter::Open(const std::string &file_name, const std::vector<std::string> &planes)
+{
+  Close();
+  planes_ = planes;
+
+  file_ = fopen(file_name.c_str(), "r+b");
+  if(file_)
+  {
+    // existing file: append, if compatible
+    bool ok = (fread(&header_, sizeof(header_), 1, file_) == 1) && TransportSampleFile::CheckHeader(header_)
+      && header_.planes == planes_.size();
+
+    char name[TransportSampleFile::kPlaneNameLength];
+    for(unsigned int i=0; ok && i<planes_.size(); i++)
+    {
+      ok = (fread(name, sizeof(name), 1, file_) == 1) && planes_[i] == name;
+    }
+
+    if(!ok)
+    {
+      std::cout<<"TransportSampleWriter: "<<file_name<<" is not a compatible sample file"<<std::endl;
+      fclose(file_);
+      file_ = NULL;
+      return false;
+    }
+
+    fseek(file_, TransportSampleFile::DataOffset(header_.planes)
+        + header_.rows*TransportSampleFile::RowSize(header_.planes)*sizeof(double), SEEK_SET);
+    return true;
+  }
+
+  file_ = fopen(file_name.c_str(), "w+b");
+  if(!file_)
+  {
+    std::cout<<"TransportSampleWriter: cannot create "<<file_name<<std::endl;
+    return false;
+  }
+
+  memset(&header_, 0, sizeof(header_));
+  memcpy(header_.magic, sample_file_magic, sizeof(sample_file_magic));
+  header_.version = TransportSampleFile::kVersion;
+  header_.planes = planes_.size();
+  header_.rows = 0;
+  fwrite(&header_, sizeof(header_), 1, file_);
+
+  for(unsigned int i=0; i<planes_.size(); i++)
+  {
+    char name[TransportSampleFile::kPlaneNameLength];
+    memset(name, 0, sizeof(name));
+    strncpy(name, planes_[i].c_str(), sizeof(name)-1);
+    fwrite(name, sizeof(name), 1, file_);
+  }
+  return true;
+}
+
+
+void TransportSampleWriter::AppendRow(const double *row)
+{
+  if(!file_)
+    return;
+
+  fwrite(row, sizeof(double), TransportSampleFile::RowSize(header_.planes), file_);
+  header_.rows++;
+}
+
+
+void TransportSampleWriter::Close()
+{
+  if(!file_)
+    return;
+
+  fseek(file_, 0, SEEK_SET);
+  fwrite(&header_, sizeof(header_), 1, file_);
+  fclose(file_);
+  file_ = NULL;
+}
+
+
+TransportSampleReader::TransportSampleReader() : map_(NULL), map_size_(0), data_(NULL), rows_(0), row_size_(0)
+{
+}
+
+
+TransportSampleReader::~TransportSampleReader()
+{
+  Close();
+}
+
+
+bool TransportSampleReader::Open(const std::string &file_name)
+{
+  Close();
+
+  int fd = open(file_name.c_str(), O_RDONLY);
+  if(fd < 0)
+    return false;
+
+  struct stat st;
+  if(fstat(fd, &st) != 0 || (unsigned long) st.st_size < sizeof(TransportSampleFile::Header))
+  {
+    close(fd);
+    return false;
+  }
+
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(map == MAP_FAILED)
+    return false;
+
+  const TransportSampleFile::Header *header = (const TransportSampleFile::Header *) map;
+  unsigned long data_offset = TransportSampleFile::DataOffset(header->planes);
+  unsigned int row_size = TransportSampleFile::RowSize(header->planes);
+
+  if(!TransportSampleFile::CheckHeader(*header)
+      || (unsigned long) st.st_size < data_offset + header->rows*row_size*sizeof(double))
+  {
+    std::cout<<"TransportSampleReader: "<<file_name<<" is not a valid sample file"<<std::endl;
+    munmap(map, st.st_size);
+    return false;
+  }
+
+  map_ = map;
+  map_size_ = st.st_size;
+  rows_ = header->rows;
+  row_size_ = row_size;
+  data_ = (const double *) ((const char *) map + data_offset);
+
+  const char *names = (const char *) map + sizeof(TransportSampleFile::Header);
+  for(unsigned int i=0; i<header->planes; i++)
+  {
+    const char *name = names + i*TransportSampleFile::kPlaneNameLength;
+    planes_.push_back(std::string(name, strnlen(name, TransportSampleFile::kPlaneNameLength)));
+  }
+
+  madvise(map_, map_size_, MADV_SEQUENTIAL);
+  return true;
+}
+
+
+void TransportSampleReader::Close()
+{
+  if(map_)
+    munmap(map_, map_size_);
+
+  map_ = NULL;
+  map_size_ = 0;
+  data_ = NULL;
+  rows_ = 0;
+  row_size_ = 0;
+  planes_.clear();
+}
+
+
+int TransportSampleReader::GetPlaneOffset(const std::string &plane) const
+{
+  for(unsigned int i=0; i<planes_.size(); i++)
+  {
+    if(planes_[i] == plane)
+      return TransportSampleFile::kInputColumns + i*TransportSampleFile::kPlaneColumns;
+  }
+  return -1;
+}
+
+
+unsigned long TransportSampleReader::GetChunk(unsigned long first_row, unsigned long max_rows, const double *&rows) const
+{
+  rows = NULL;
+  if(!data_ || first_row >= rows_)
+    return 0;
+
+  unsigned long n = rows_ - first_row;
+  if(n > max_rows)
+    n = max_rows;
+
+  rows = data_ + first_row*row_size_;
+  return n;
+}
@@ -0,0 +1,120 @@
+/**
+   \file
+   the flattened aperture engine must accept and reject the same protons as
+   LHCApertureApproximator::CheckAperture, for both beams
+*/
+
+#include <cppunit/extensions/HelperMacros.h>
+#include "TotemProtonTransport/TotemRPProtonTransportParametrization/interface/LHCOpticsApproximator.h"
+#include "TotemProtonTransport/TotemRPProtonTransportParametrization/interface/LHCApertureEngine.h"
+#include "TotemProtonTransport/TotemRPProtonTransportParametrization/test/ToyOptics.h"
+#include "TRandom3.h"
+#include <string>
+#include <vector>
+
+class testLHCApertureEngine: public CppUnit::TestFixture {
+
+  CPPUNIT_TEST_SUITE(testLHCApertureEngine);
+
+  CPPUNIT_TEST(testBeam1);
+  CPPUNIT_TEST(testBeam2);
+
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void setUp(){}
+  void tearDown(){}
+  void testBeam1();
+  void testBeam2();
+
+  /// compares the engine (single and batch) and the transport with apertures to CheckAperture
+  static void Compare(const std::string &beam);
+};
+
+///registration of the test so that the runner can find it
+CPPUNIT_TEST_SUITE_REGISTRATION(testLHCApertureEngine);
+
+
+void testLHCApertureEngine::Compare(const std::string &beam)
+{
+  LHCOpticsApproximator optics = MakeToyOptics(beam, 20., 2., 0.05);
+
+  // two apertures on the way, each cutting part of the phase space (in x, in y and in the ellipse)
+  const unsigned int n_apertures = 2;
+  LHCOpticsApproximator aperture_optics[n_apertures] = { MakeToyOptics(beam, 10., 1., 0.03),
+    MakeToyOptics(beam, 15., 1.5, 0.04) };
+  const double ap_par[n_apertures][4] = { {6e-3, 4e-3, 7e-3, 5e-3}, {8e-3, 4e-3, 9e-3, 5e-3} };
+
+  std::vector<LHCApertureApproximator> apertures;
+  for(unsigned int i=0; i<n_apertures; i++)
+  {
+    optics.AddRectEllipseAperture(aperture_optics[i], ap_par[i][0], ap_par[i][1], ap_par[i][2], ap_par[i][3]);
+    apertures.push_back(LHCApertureApproximator(aperture_optics[i], ap_par[i][0], ap_par[i][1], ap_par[i][2],
+        ap_par[i][3]));
+  }
+
+  LHCApertureEngine engine(optics);
+  CPPUNIT_ASSERT_EQUAL(n_apertures, engine.GetNumberOfApertures());
+
+  // the sign of x and theta_x is inverted for lhcb2, the sample covers (and slightly exceeds) the trained range
+  const double sign = (beam == "lhcb2") ? -1. : 1.;
+  const unsigned int n = 5000;
+  std::vector<double> in(5*n);
+  TRandom3 r(2);
+  for(unsigned int k=0; k<n; k++)
+  {
+    in[5*k + 0] = sign * r.Uniform(-5.5e-4, 5.5e-4);
+    in[5*k + 1] = sign * r.Uniform(-3.3e-4, 3.3e-4);
+    in[5*k + 2] = r.Uniform(-5.5e-4, 5.5e-4);
+    in[5*k + 3] = r.Uniform(-3.3e-4, 3.3e-4);
+    in[5*k + 4] = r.Uniform(-0.22, 0.);
+  }
+
+  bool *accepted_batch = new bool[n];
+  unsigned int n_accepted_batch = engine.CheckBatch(&in[0], n, accepted_batch);
+
+  unsigned int n_accepted = 0;
+  for(unsigned int k=0; k<n; k++)
+  {
+    const double *row = &in[5*k];
+
+    bool expected = true;
+    for(unsigned int i=0; i<n_apertures; i++)
+      expected = expected && apertures[i].CheckAperture(row);
+    if(expected)
+      n_accepted++;
+
+    CPPUNIT_ASSERT_EQUAL(expected, engine.Check(row));
+    CPPUNIT_ASSERT_EQUAL(expected, accepted_batch[k]);
+
+    double out[5], out_2d[2];
+    const bool in_range = optics.CheckInputRange(row);
+    CPPUNIT_ASSERT_EQUAL(in_range && expected, optics.Transport(row, out, true));
+    CPPUNIT_ASSERT_EQUAL(in_range && expected, optics.Transport2D(row, out_2d, true));
+  }
+  delete [] accepted_batch;
+
+  CPPUNIT_ASSERT_EQUAL(n_accepted, n_accepted_batch);
+
+  // both outcomes must be covered for the comparison to be meaningful
+  CPPUNIT_ASSERT(n_accepted > n/10);
+  CPPUNIT_ASSERT(n_accepted < 9*n/10);
+
+  // a copy rebuilds its engine from its own apertures
+  LHCOpticsApproximator copy(optics);
+  double out[5];
+  for(unsigned int k=0; k<100; k++)
+    CPPUNIT_ASSERT_EQUAL(optics.Transport(&in[5*k], out, true), copy.Transport(&in[5*k], out, true));
+}
+
+
+void testLHCApertureEngine::testBeam1()
+{
+  Compare("lhcb1");
+}
+
+
+void testLHCApertureEngine::testBeam2()
+{
+  Compare("lhcb2");
+}
@@ -0,0 +1,123 @@
+/**
+   \file
+   the grid interpolation must reproduce LHCOpticsApproximator::Transport on the toy optics, for both beams;
+   with 9 nodes in xi the only term not interpolated exactly is D xi^2 / 2 in x, bounded by D h^2 / 8 = 3.9e-6 m
+   for D = 0.05 m and h = 0.025, the tolerance is 1e-5 m in x and 1e-7 in the other coordinates
+*/
+
+#include <cppunit/extensions/HelperMacros.h>
+#include "TotemProtonTransport/TotemRPProtonTransportParametrization/interface/LHCOpticsApproximator.h"
+#include "TotemProtonTransport/TotemRPProtonTransportParametrization/interface/LHCOpticsGrid.h"
+#include "TotemProtonTransport/TotemRPProtonTransportParametrization/test/ToyOptics.h"
+#include "TRandom3.h"
+#include <string>
+#include <cmath>
+
+class testLHCOpticsGrid: public CppUnit::TestFixture {
+
+  CPPUNIT_TEST_SUITE(testLHCOpticsGrid);
+
+  CPPUNIT_TEST(testBeam1);
+  CPPUNIT_TEST(testBeam2);
+
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void setUp(){}
+  void tearDown(){}
+  void testBeam1();
+  void testBeam2();
+
+  /// compares the linear and the cubic grid to the transport of the approximator
+  static void Compare(const std::string &beam);
+
+  static const double x_tolerance;        ///< m
+  static const double tolerance;          ///< theta_x, y, theta_y
+};
+
+///registration of the test so that the runner can find it
+CPPUNIT_TEST_SUITE_REGISTRATION(testLHCOpticsGrid);
+
+const double testLHCOpticsGrid::x_tolerance = 1e-5;
+const double testLHCOpticsGrid::tolerance = 1e-7;
+
+
+void testLHCOpticsGrid::Compare(const std::string &beam)
+{
+  LHCOpticsApproximator optics = MakeToyOptics(beam, 20., 2., 0.05);
+
+  const unsigned int nodes[5] = {5, 5, 5, 5, 9};
+  LHCOpticsGrid grids[2];
+  CPPUNIT_ASSERT(grids[0].Build(optics, nodes, LHCOpticsGrid::LINEAR));
+  CPPUNIT_ASSERT(grids[1].Build(optics, nodes, LHCOpticsGrid::CUBIC));
+  CPPUNIT_ASSERT_EQUAL((unsigned long) 5*5*5*5*9, grids[0].GetNumberOfNodes());
+
+  // the sign of x and theta_x is inverted for lhcb2, the sample covers (and slightly exceeds) the trained range
+  const double sign = (beam == "lhcb2") ? -1. : 1.;
+  TRandom3 r(2);
+  unsigned int n_in_range = 0;
+  for(unsigned int k=0; k<2000; k++)
+  {
+    double in[5];
+    in[0] = sign * r.Uniform(-5.5e-4, 5.5e-4);
+    in[1] = sign * r.Uniform(-3.3e-4, 3.3e-4);
+    in[2] = r.Uniform(-5.5e-4, 5.5e-4);
+    in[3] = r.Uniform(-3.3e-4, 3.3e-4);
+    in[4] = r.Uniform(-0.22, 0.);
+
+    double ref[5];
+    const bool in_range = optics.Transport(in, ref, false, true);
+    CPPUNIT_ASSERT_EQUAL(optics.CheckInputRange(in), in_range);
+    if(in_range)
+      n_in_range++;
+
+    for(int g=0; g<2; g++)
+    {
+      double out[5], out_2d[2];
+      CPPUNIT_ASSERT_EQUAL(in_range, grids[g].CheckInputRange(in));
+      CPPUNIT_ASSERT_EQUAL(in_range, grids[g].Transport(in, out, true));
+      CPPUNIT_ASSERT_EQUAL(in_range, grids[g].Transport2D(in, out_2d, true));
+      CPPUNIT_ASSERT_EQUAL(out[0], out_2d[0]);
+      CPPUNIT_ASSERT_EQUAL(out[2], out_2d[1]);
+      CPPUNIT_ASSERT_EQUAL(in[4], out[4]);
+
+      // outside of the range the grid is clamped to its borders, the polynomials extrapolate
+      if(!in_range)
+        continue;
+
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(ref[0], out[0], x_tolerance);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(ref[1], out[1], tolerance);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(ref[2], out[2], tolerance);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(ref[3], out[3], tolerance);
+    }
+  }
+
+  // both outcomes of the range check must be covered
+  CPPUNIT_ASSERT(n_in_range > 100);
+  CPPUNIT_ASSERT(n_in_range < 1900);
+
+  // the spline follows the xi^2 term closer than the linear interpolation
+  LHCOpticsGrid::ErrorReport linear = grids[0].TestAccuracy(optics, 10000);
+  LHCOpticsGrid::ErrorReport cubic = grids[1].TestAccuracy(optics, 10000);
+  CPPUNIT_ASSERT_EQUAL(10000u, linear.samples);
+  CPPUNIT_ASSERT(linear.max_abs[0] < x_tolerance);
+  CPPUNIT_ASSERT(cubic.rms[0] < linear.rms[0]);
+
+  // an empty grid does not transport
+  LHCOpticsGrid empty;
+  double in[5] = {0., 0., 0., 0., -0.1}, out[5];
+  CPPUNIT_ASSERT(!empty.IsBuilt());
+  CPPUNIT_ASSERT(!empty.Transport(in, out, true));
+}
+
+
+void testLHCOpticsGrid::testBeam1()
+{
+  Compare("lhcb1");
+}
+
+
+void testLHCOpticsGrid::testBeam2()
+{
+  Compare("lhcb2");
+}
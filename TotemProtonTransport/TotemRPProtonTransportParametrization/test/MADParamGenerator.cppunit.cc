@@ -0,0 +1,246 @@
+/**
+   \file
+   both the sequential and the sharded sample generation must run through the
+   sample tracker set by SetSampleTracker and must be reproducible for a given seed
+*/
+
+#include <cppunit/extensions/HelperMacros.h>
+#include "TotemProtonTransport/TotemRPProtonTransportParametrization/interface/MADParamGenerator.h"
+#include "TFile.h"
+#include "TTree.h"
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <unistd.h>
+
+/**
+ *\brief Linear drift instead of MAD-X.
+ * Particles with x_out < 0 are lost before the destination marker.
+**/
+class StubSampleTracker : public SampleTracker
+{
+  public:
+    StubSampleTracker() : calls(0) {}
+    virtual void Track(const std::string &conf_file, const std::string &file_prefix);
+
+    std::atomic<int> calls;
+    std::mutex mutex;
+    std::set<std::string> conf_files;
+
+    static const double L;
+};
+
+const double StubSampleTracker::L = 100.;
+
+
+void StubSampleTracker::Track(const std::string &conf_file, const std::string &file_prefix)
+{
+  calls++;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    conf_files.insert(conf_file);
+  }
+
+  std::ifstream ifs((file_prefix + "part.in").c_str());
+  std::vector<double> rows;
+  std::string ln;
+  while(getline(ifs, ln))
+  {
+    double x, tx, y, ty, ksi;
+    if(ln.empty() || ln[0] == '@' || ln[0] == '*' || ln[0] == '$')
+      continue;
+    if(sscanf(ln.c_str(), "%*s %le %le %le %le %*s %le", &x, &tx, &y, &ty, &ksi) != 5)
+      continue;
+    double row[] = {x, tx, y, ty, ksi};
+    rows.insert(rows.end(), row, row + 5);
+  }
+
+  FILE *f = fopen((file_prefix + "trackone").c_str(), "w");
+  fprintf(f, "@ NAME             %%07s \"TRACKONE\"\n");
+  fprintf(f, "*  NUMBER  TURN  X  PX  Y  PY  T  PT  S  E\n");
+  fprintf(f, "$  %%d  %%d  %%le  %%le  %%le  %%le  %%le  %%le  %%le  %%le\n");
+
+  std::vector<unsigned int> arrived;
+  for(unsigned int i=0; i<rows.size()/5; i++)
+    if(rows[5*i] + L*rows[5*i+1] >= 0.)
+      arrived.push_back(i);
+
+  fprintf(f, "#segment 1 1 %u %u end\n", (unsigned int) arrived.size(), (unsigned int) rows.size()/5);
+  for(unsigned int k=0; k<arrived.size(); k++)
+  {
+    const double *r = &rows[5*arrived[k]];
+    fprintf(f, "%u 1 %.17e %.17e %.17e %.17e 0.0 %.17e %.1f 0.0\n", arrived[k] + 1, r[0] + L*r[1], r[1], r[2] + L*r[3], r[3], r[4], L);
+  }
+  fclose(f);
+}
+
+//----------------------------------------------------------------------------------------------------
+
+class testMADParamGenerator: public CppUnit::TestFixture {
+
+  CPPUNIT_TEST_SUITE(testMADParamGenerator);
+
+  CPPUNIT_TEST(testSequential);
+  CPPUNIT_TEST(testSharded);
+
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void setUp();
+  void tearDown();
+  void testSequential();
+  void testSharded();
+
+  /// generates the training sample with the stub, returns x_in and checks the outputs against the drift
+  std::vector<double> Generate(int parallel_jobs, unsigned int seed, StubSampleTracker &tracker);
+
+  static Parametisation_configuration MakeConfiguration(int parallel_jobs, unsigned int seed);
+
+private:
+  std::string work_dir_, old_dir_;
+};
+
+///registration of the test so that the runner can find it
+CPPUNIT_TEST_SUITE_REGISTRATION(testMADParamGenerator);
+
+
+void testMADParamGenerator::setUp()
+{
+  char cwd[4096];
+  old_dir_ = getcwd(cwd, sizeof(cwd)) ? cwd : ".";
+
+  //the generator works in the current directory
+  char dir[] = "/tmp/testMADParamGeneratorXXXXXX";
+  CPPUNIT_ASSERT(mkdtemp(dir) != NULL);
+  work_dir_ = dir;
+  CPPUNIT_ASSERT(chdir(work_dir_.c_str()) == 0);
+
+  std::ofstream base("base.madx");
+  base << "beam;" << std::endl;
+}
+
+
+void testMADParamGenerator::tearDown()
+{
+  CPPUNIT_ASSERT(chdir(old_dir_.c_str()) == 0);
+  std::string cmd = "rm -rf " + work_dir_;
+  system(cmd.c_str());
+}
+
+
+Parametisation_configuration testMADParamGenerator::MakeConfiguration(int parallel_jobs, unsigned int seed)
+{
+  Parametisation_configuration conf;
+  conf.base_mad_conf_file = "base.madx";
+  conf.processed_mad_conf_file = "processed.madx";
+  conf.beam = "lhcb1";
+  conf.nominal_beam_energy = 6500.;
+  conf.from_marker_name = "start";
+  conf.from_marker_s_pos = 0.;
+  conf.define_from = false;
+  conf.to_marker_name = "end";
+  conf.to_marker_s_pos = StubSampleTracker::L;
+  conf.define_to = false;
+  conf.aperture_limit = false;
+  conf.tot_entries_number = 250;
+  conf.number_of_part_per_sample = 100;
+  conf.x_min = -1e-3;
+  conf.x_max = 1e-3;
+  conf.theta_x_min = -1e-5;
+  conf.theta_x_max = 1e-5;
+  conf.y_min = -1e-3;
+  conf.y_max = 1e-3;
+  conf.theta_y_min = -1e-5;
+  conf.theta_y_max = 1e-5;
+  conf.ksi_min = -0.2;
+  conf.ksi_max = 0.;
+  conf.samples_train_root_file_name = "train.root";
+  conf.samples_test_root_file_name = "test.root";
+  conf.samples_aperture_test_file_name = "aperture_test.root";
+  conf.destination_branch_prefix = "def";
+  conf.lost_particles_tree_filename = "lost.root";
+  conf.lost_particles_hist_filename = "lost_hist.root";
+  conf.parallel_jobs = parallel_jobs;
+  conf.random_seed = seed;
+  return conf;
+}
+
+
+std::vector<double> testMADParamGenerator::Generate(int parallel_jobs, unsigned int seed, StubSampleTracker &tracker)
+{
+  Parametisation_configuration conf = MakeConfiguration(parallel_jobs, seed);
+
+  MADParamGenerator generator;
+  generator.SetSampleTracker(&tracker);
+  int entries = generator.GenerateTrainingData(conf);
+  CPPUNIT_ASSERT(entries >= conf.tot_entries_number);
+  CPPUNIT_ASSERT(tracker.calls > 0);
+
+  TFile *f = TFile::Open(conf.samples_train_root_file_name.c_str(), "read");
+  CPPUNIT_ASSERT(f && f->IsOpen());
+  TTree *tree = (TTree*) f->Get("transport_samples");
+  CPPUNIT_ASSERT(tree);
+  CPPUNIT_ASSERT_EQUAL((Long64_t) entries, tree->GetEntries());
+
+  double x_in, theta_x_in, y_in, theta_y_in, ksi_in, x_out, y_out, ksi_out;
+  tree->SetBranchAddress("x_in", &x_in);
+  tree->SetBranchAddress("theta_x_in", &theta_x_in);
+  tree->SetBranchAddress("y_in", &y_in);
+  tree->SetBranchAddress("theta_y_in", &theta_y_in);
+  tree->SetBranchAddress("ksi_in", &ksi_in);
+  tree->SetBranchAddress("def_x_out", &x_out);
+  tree->SetBranchAddress("def_y_out", &y_out);
+  tree->SetBranchAddress("def_ksi_out", &ksi_out);
+
+  std::vector<double> x;
+  for(Long64_t i=0; i<tree->GetEntries(); i++)
+  {
+    tree->GetEntry(i);
+    CPPUNIT_ASSERT(x_out >= 0.);
+    CPPUNIT_ASSERT(std::fabs(x_out - (x_in + StubSampleTracker::L*theta_x_in)) < 1e-15);
+    CPPUNIT_ASSERT(std::fabs(y_out - (y_in + StubSampleTracker::L*theta_y_in)) < 1e-15);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(ksi_in, ksi_out, 1e-15);
+    x.push_back(x_in);
+  }
+  f->Close();
+  delete f;
+
+  return x;
+}
+
+
+void testMADParamGenerator::testSequential()
+{
+  StubSampleTracker tracker, repeated_tracker;
+  std::vector<double> x = Generate(1, 11, tracker);
+  CPPUNIT_ASSERT_EQUAL((size_t) 1, tracker.conf_files.size());
+  CPPUNIT_ASSERT(tracker.conf_files.count("processed.madx") == 1);
+
+  std::vector<double> repeated = Generate(1, 11, repeated_tracker);
+  CPPUNIT_ASSERT(x == repeated);
+}
+
+
+void testMADParamGenerator::testSharded()
+{
+  StubSampleTracker tracker, repeated_tracker, other_seed_tracker;
+  std::vector<double> x = Generate(3, 11, tracker);
+  CPPUNIT_ASSERT(tracker.calls % 3 == 0);
+  CPPUNIT_ASSERT_EQUAL((size_t) tracker.calls, tracker.conf_files.size());
+
+  std::vector<double> repeated = Generate(3, 11, repeated_tracker);
+  CPPUNIT_ASSERT(x == repeated);
+
+  //the shards must not repeat the samples of each other
+  std::set<double> unique(x.begin(), x.end());
+  CPPUNIT_ASSERT_EQUAL(x.size(), unique.size());
+
+  std::vector<double> other = Generate(3, 12, other_seed_tracker);
+  CPPUNIT_ASSERT(x != other);
+}
@@ -0,0 +1,53 @@
+#ifndef TotemProtonTransport_TotemRPProtonTransportParametrization_test_ToyOptics_h
+#define TotemProtonTransport_TotemRPProtonTransportParametrization_test_ToyOptics_h
+
+#include "TotemProtonTransport/TotemRPProtonTransportParametrization/interface/LHCOpticsApproximator.h"
+#include "TTree.h"
+#include "TRandom3.h"
+#include <string>
+
+/**
+ *\brief Toy transport for the tests, quadratic in xi, trained on random samples.
+ * x_out = v x + L theta_x (1 + xi) + D xi + D xi^2 / 2, y_out = v y / 2 + 3/2 L theta_y (1 - xi),
+ * theta_x_out = x / 10 + theta_x / 2, theta_y_out = y / 5 + 3/10 theta_y,
+ * trained in |x|, |y| < 5e-4, |theta_x|, |theta_y| < 3e-4, -0.2 < xi < 0.
+**/
+inline LHCOpticsApproximator MakeToyOptics(const std::string &beam, double L, double v, double D)
+{
+  double in[6], out[7];
+  TTree tree("transport_samples", "transport_samples");
+  tree.SetDirectory(0);
+  const char *in_names[6] = {"x_in", "theta_x_in", "y_in", "theta_y_in", "ksi_in", "s_in"};
+  const char *out_names[7] = {"def_x_out", "def_theta_x_out", "def_y_out", "def_theta_y_out", "def_ksi_out",
+      "def_s_out", "def_valid_out"};
+  for(int i=0; i<6; i++)
+    tree.Branch(in_names[i], &in[i], (std::string(in_names[i]) + "/D").c_str());
+  for(int i=0; i<7; i++)
+    tree.Branch(out_names[i], &out[i], (std::string(out_names[i]) + "/D").c_str());
+
+  TRandom3 r(1);
+  for(int n=0; n<3000; n++)
+  {
+    in[0] = r.Uniform(-5e-4, 5e-4);
+    in[1] = r.Uniform(-3e-4, 3e-4);
+    in[2] = r.Uniform(-5e-4, 5e-4);
+    in[3] = r.Uniform(-3e-4, 3e-4);
+    in[4] = r.Uniform(-0.2, 0.);
+    in[5] = 0.;
+
+    out[0] = v*in[0] + L*in[1]*(1. + in[4]) + D*in[4] + 0.5*D*in[4]*in[4];
+    out[1] = 0.1*in[0] + 0.5*in[1];
+    out[2] = 0.5*v*in[2] + 1.5*L*in[3]*(1. - in[4]);
+    out[3] = 0.2*in[2] + 0.3*in[3];
+    out[4] = in[4];
+    out[5] = 220.;
+    out[6] = 1.;
+    tree.Fill();
+  }
+
+  LHCOpticsApproximator approx("toy", "toy", TMultiDimFet::kMonomials, beam, 6500.);
+  approx.Train(&tree, "def", LHCOpticsApproximator::PREDEFINED, 3, 2, 3, 2);
+  return approx;
+}
+
+#endif